@@ -20,6 +20,7 @@ BedrockCommand::BedrockCommand(SQLiteCommand&& baseCommand, BedrockPlugin* plugi
     processCount(0),
     postProcessCount(0),
     repeek(false),
+    lastConflictPage(0),
     crashIdentifyingValues(*this),
     escalateImmediately(escalateImmediately_),
     destructionCallback(nullptr),
@@ -130,8 +131,36 @@ bool BedrockCommand::areHttpsRequestsComplete() const {
     return true;
 }
 
+void BedrockCommand::watchHTTPSRequests(function<void()>&& onComplete) {
+    list<SHTTPSManager::Transaction*> outstanding;
+    auto requestIt = (_lastContiguousCompletedTransaction == httpsRequests.end()) ? httpsRequests.begin() : _lastContiguousCompletedTransaction;
+    while (requestIt != httpsRequests.end()) {
+        if (!(*requestIt)->response) {
+            outstanding.push_back(*requestIt);
+        }
+        requestIt++;
+    }
+    SStandaloneHTTPSManager::watchTransactions(move(outstanding), timeout(), move(onComplete));
+}
+
 void BedrockCommand::_waitForHTTPSRequests() {
     uint64_t startTime = 0;
+
+    // If the HTTPS reactor is running, it does the polling for us, and we just wait to hear that it's done.
+    if (SStandaloneHTTPSManager::isReactorRunning() && !areHttpsRequestsComplete()) {
+        startTime = STimeNow();
+        mutex m;
+        condition_variable cv;
+        bool done = false;
+        watchHTTPSRequests([&m, &cv, &done]() {
+            lock_guard lock(m);
+            done = true;
+            cv.notify_all();
+        });
+        unique_lock lock(m);
+        cv.wait(lock, [&done]() { return done; });
+    }
+
     while (!areHttpsRequestsComplete()) {
         // Wait until the command's timeout, or break early if the command has timed out.
         uint64_t maxWaitUs = 0;
@@ -207,6 +236,78 @@ void BedrockCommand::waitForHTTPSRequests(SQLite& db) {
     }
 }
 
+bool BedrockCommand::canStreamResponse() const {
+    // Other responses are interleaved with this one on a multiplexed connection, and a plugin that owns its socket has
+    // its own kind of response.
+    return socket && initiatingClientID >= 0 && !request.isSet("MultiplexID") && request["plugin"].empty();
+}
+
+bool BedrockCommand::startChunkedResponse() {
+    SASSERT(canStreamResponse() && streamState == STREAM_STATE::NONE);
+    streamState = STREAM_STATE::STARTED;
+
+    // These are the same headers `BedrockServer::_reply` would add.
+    if (response.methodLine.empty()) {
+        response.methodLine = "200 OK";
+    }
+    if (_plugin) {
+        response["nodeName"] = _plugin->server.args["-nodeName"];
+    }
+    if (SIEquals(request["Connection"], "close") || (_plugin && _plugin->server.isShuttingDown())) {
+        response["Connection"] = "close";
+    }
+    response["Transfer-Encoding"] = "chunked";
+
+    string header = response.methodLine + "\r\n";
+    for (const auto& [name, value] : response.nameValueMap) {
+        header += name + ": " + SEscape(value, "\r\n\t") + "\r\n";
+    }
+    header += "\r\n";
+    return sendResponseData(header);
+}
+
+bool BedrockCommand::sendResponseChunk(const string& chunk) {
+    SASSERT(streamState == STREAM_STATE::STARTED);
+
+    // An empty chunk would end the response.
+    if (chunk.empty()) {
+        return true;
+    }
+
+    // SParseHTTP accepts chunk sizes of up to 8 hex digits.
+    SASSERT(chunk.size() <= UINT32_MAX);
+    return sendResponseData(SToHex((uint64_t)chunk.size(), 8) + "\r\n" + chunk + "\r\n");
+}
+
+bool BedrockCommand::finishChunkedResponse() {
+    SASSERT(streamState == STREAM_STATE::STARTED);
+    if (!sendResponseData("0\r\n\r\n")) {
+        return false;
+    }
+    streamState = STREAM_STATE::FINISHED;
+    return true;
+}
+
+bool BedrockCommand::sendResponseData(const string& data) {
+    if (socket->state.load() >= STCPManager::Socket::SHUTTINGDOWN || !socket->send(data)) {
+        return false;
+    }
+
+    // Client sockets are blocking, so the send above normally takes everything, but if it didn't, wait for room.
+    while (!socket->sendBufferEmpty()) {
+        if (shouldAbort || STimeNow() > _timeout) {
+            SINFO("Gave up sending streamed response to '" << request.methodLine << "'.");
+            return false;
+        }
+        struct pollfd pollStruct = {socket->s, POLLOUT, 0};
+        poll(&pollStruct, 1, 1'000);
+        if (!socket->send()) {
+            return false;
+        }
+    }
+    return true;
+}
+
 void BedrockCommand::reset(BedrockCommand::STAGE stage) {
     if (stage == STAGE::PEEK && !shouldPrePeek()) {
         jsonContent.clear();
@@ -214,7 +315,7 @@ void BedrockCommand::reset(BedrockCommand::STAGE stage) {
     }
 }
 
-void BedrockCommand::finalizeTimingInfo() {
+void BedrockCommand::finalizeTimingInfo(BedrockMetrics& metrics) {
     uint64_t prePeekTotal = 0;
     uint64_t blockingPrePeekTotal = 0;
     uint64_t peekTotal = 0;
@@ -365,6 +466,10 @@ void BedrockCommand::finalizeTimingInfo() {
           "unaccounted:" << upstreamUnaccountedTime/1000 << "."
     );
 
+    // The same totals go into the latency histograms, in `BedrockMetrics::Stage` order.
+    metrics.record(methodName, {prePeekTotal, peekTotal, processTotal, postProcessTotal, commitWorkerTotal, commitSyncTotal,
+                                queueWorkerTotal, queueSyncTotal, queueBlockingTotal, queuePageLockTotal, escalationTimeUS, totalTime});
+
     // And here's where we set our own values.
     for (const auto& p : valuePairs) {
         if (p.second) {
@@ -1,5 +1,6 @@
 #pragma once
 #include <libstuff/SHTTPSManager.h>
+#include "BedrockMetrics.h"
 #include <sqlitecluster/SQLiteCommand.h>
 
 class BedrockPlugin;
@@ -128,12 +129,16 @@ class BedrockCommand : public SQLiteCommand {
     // `startTiming`.
     void stopTiming(TIMING_INFO type);
 
-    // Add a summary of our timing info to our response object.
-    void finalizeTimingInfo();
+    // Add a summary of our timing info to our response object, and record it in `metrics`.
+    void finalizeTimingInfo(BedrockMetrics& metrics);
 
     // Returns true if all of the httpsRequests for this command are complete (or if it has none).
     bool areHttpsRequestsComplete() const;
 
+    // Hands the outstanding httpsRequests to the HTTPS reactor (see `SStandaloneHTTPSManager::startReactor`), which
+    // calls `onComplete` from one of its threads once they're all done.
+    void watchHTTPSRequests(function<void()>&& onComplete);
+
     // If the `peek` portion of this command needs to make an HTTPS request, this is where we store it.
     template <typename T>
     class GrowOnlyList {
@@ -211,6 +216,10 @@ class BedrockCommand : public SQLiteCommand {
     // all HTTPS requests are complete. It will be automatically cleared if the command throws an exception.
     bool repeek;
 
+    // The db page this command last lost a commit conflict on, if we know it, or 0 if not. This lives on the command
+    // rather than in the worker so that it's kept when the command is requeued to retry.
+    int64_t lastConflictPage;
+
     // A list of timing sets, with an info type, start, and end.
     list<tuple<TIMING_INFO, uint64_t, uint64_t>> timingInfo;
 
@@ -278,6 +287,31 @@ class BedrockCommand : public SQLiteCommand {
     // is awaiting a reply.
     STCPManager::Socket* socket;
 
+    // A command can send its response in pieces as it produces them, rather than all at once when it's done, so that a
+    // large response never has to be held in memory. `startChunkedResponse` sends `response`'s method line and headers
+    // with `Transfer-Encoding: chunked`, `sendResponseChunk` sends each piece of content, and `finishChunkedResponse`
+    // sends the empty chunk that ends it. Each blocks until the client has taken what was sent, so a slow client slows
+    // the command down rather than letting data pile up. They return false if the client can't be sent to, or the
+    // command is aborted or times out waiting for it.
+    // This is only possible for commands from a client connection that isn't multiplexed or owned by a plugin.
+    bool canStreamResponse() const;
+    bool startChunkedResponse();
+    bool sendResponseChunk(const string& chunk);
+    bool finishChunkedResponse();
+
+    // Sends `data` on `socket` as is, blocking like the functions above. This is for a plugin that sends a streamed
+    // response in its own protocol on its own port (see `BedrockPlugin::getResultStream`).
+    bool sendResponseData(const string& data);
+
+    // Once a command has started sending its own response (see above), the server doesn't send `response`. If it never
+    // finished, the server closes the connection instead, as that's the only way left to tell the client.
+    enum class STREAM_STATE {
+        NONE,
+        STARTED,
+        FINISHED,
+    };
+    STREAM_STATE streamState = STREAM_STATE::NONE;
+
     // Time at which this command was initially scheduled (typically the time of creation).
     const uint64_t scheduledTime;
 
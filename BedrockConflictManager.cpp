@@ -1,17 +1,79 @@
 #include "BedrockConflictManager.h"
 #include <libstuff/libstuff.h>
 
+BedrockConflictManager::PageWork::PageWork(BedrockConflictManager& manager, int64_t page, BedrockCommandQueue& queue)
+  : _manager(manager), _page(page), _queue(queue)
+{
+    if (_page == 0) {
+        return;
+    }
+
+    lock_guard<mutex> lock(_manager.m);
+    _manager._pageWorkCounts[_page]++;
+}
+
+BedrockConflictManager::PageWork::~PageWork() {
+    if (_page == 0) {
+        return;
+    }
+
+    list<unique_ptr<BedrockCommand>> released;
+    {
+        lock_guard<mutex> lock(_manager.m);
+        auto countIt = _manager._pageWorkCounts.find(_page);
+        if (--countIt->second) {
+            // Someone else is still working on this page, they'll release anything parked here when they're done.
+            return;
+        }
+        _manager._pageWorkCounts.erase(countIt);
+        auto parkedIt = _manager._parkedCommands.find(_page);
+        if (parkedIt != _manager._parkedCommands.end()) {
+            released = move(parkedIt->second);
+            _manager._parkedCommands.erase(parkedIt);
+        }
+    }
+
+    // Queue these outside the lock. They keep their conflict page, so they'll still take turns on it via PageLockGuard.
+    if (released.size()) {
+        SINFO("Releasing " << released.size() << " commands parked on db page " << _page << ".");
+    }
+    for (auto& command : released) {
+        _queue.push(move(command));
+    }
+}
+
 BedrockConflictManager::BedrockConflictManager() {
 }
 
+BedrockConflictManagerCommandInfo& BedrockConflictManager::_getCommandInfo(const string& commandName) {
+    auto commandInfoIt = _commandInfo.find(commandName);
+    if (commandInfoIt == _commandInfo.end()) {
+        commandInfoIt = _commandInfo.emplace(make_pair(commandName, BedrockConflictManagerCommandInfo())).first;
+    }
+    return commandInfoIt->second;
+}
+
+void BedrockConflictManager::recordConflict(const string& commandName) {
+    lock_guard<mutex> lock(m);
+    _getCommandInfo(commandName).conflictCount++;
+}
+
+bool BedrockConflictManager::parkOnPage(int64_t page, unique_ptr<BedrockCommand>& command) {
+    lock_guard<mutex> lock(m);
+
+    // If nobody is working on this page, there's nothing to wait for, and the caller should just run the command again.
+    if (page == 0 || _pageWorkCounts.find(page) == _pageWorkCounts.end()) {
+        return false;
+    }
+    _getCommandInfo(command->request.methodLine).parkedCount++;
+    _parkedCommands[page].push_back(move(command));
+    return true;
+}
+
 void BedrockConflictManager::recordTables(const string& commandName, const set<string>& tables) {
     {
         lock_guard<mutex> lock(m);
-        auto commandInfoIt = _commandInfo.find(commandName);
-        if (commandInfoIt == _commandInfo.end()) {
-            commandInfoIt = _commandInfo.emplace(make_pair(commandName, BedrockConflictManagerCommandInfo())).first;
-        }
-        BedrockConflictManagerCommandInfo& commandInfo = commandInfoIt->second;
+        BedrockConflictManagerCommandInfo& commandInfo = _getCommandInfo(commandName);
 
         // Increase the count of the command in general.
         commandInfo.count++;
@@ -50,6 +112,11 @@ string BedrockConflictManager::generateReport() {
 
             out << "Command: " << commandName << endl;
             out << "Total Count: " << commandInfo.count << endl;
+            out << "Conflicts: " << commandInfo.conflictCount << endl;
+            out << "Parked: " << commandInfo.parkedCount << endl;
+            if (commandInfo.count) {
+                out << "Retries Per Commit: " << ((double)commandInfo.conflictCount / commandInfo.count) << endl;
+            }
             out << "Table usage" << endl;
             for (const auto& table : commandInfo.tableUseCounts) {
                 const string& tableName = table.first;
@@ -5,21 +5,54 @@
 #include <set>
 #include <string>
 
+#include "BedrockCommandQueue.h"
+
 using namespace std;
 
 class BedrockConflictManagerCommandInfo {
   public:
     size_t count = 0;
+    size_t conflictCount = 0;
+    size_t parkedCount = 0;
     map<string, size_t> tableUseCounts;
 };
 
 class BedrockConflictManager {
   public:
+    // Marks a command as working on a page that it previously conflicted on for as long as this object exists.
+    // Other commands that conflict on the same page in the meantime can be parked until it's done, rather than
+    // sleeping for an arbitrary amount of time. When the last command working on the page finishes, anything parked on
+    // it is pushed back onto `queue` to run again.
+    class PageWork {
+      public:
+        PageWork(BedrockConflictManager& manager, int64_t page, BedrockCommandQueue& queue);
+        ~PageWork();
+
+      private:
+        BedrockConflictManager& _manager;
+        int64_t _page;
+        BedrockCommandQueue& _queue;
+    };
+
     BedrockConflictManager();
     void recordTables(const string& commandName, const set<string>& tables);
+
+    // Records that a command lost a commit conflict and will be retried.
+    void recordConflict(const string& commandName);
+
+    // If some other command is currently working on `page`, takes ownership of `command` and holds it until that work
+    // is finished, and returns true. Otherwise, leaves `command` alone and returns false.
+    bool parkOnPage(int64_t page, unique_ptr<BedrockCommand>& command);
+
     string generateReport();
 
   private:
+    BedrockConflictManagerCommandInfo& _getCommandInfo(const string& commandName);
+
     mutex m;
     map<string, BedrockConflictManagerCommandInfo> _commandInfo;
+
+    // The number of commands currently working on each page, and the commands waiting for them to finish.
+    map<int64_t, size_t> _pageWorkCounts;
+    map<int64_t, list<unique_ptr<BedrockCommand>>> _parkedCommands;
 };
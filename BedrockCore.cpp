@@ -166,6 +166,12 @@ BedrockCore::RESULT BedrockCore::peekCommand(unique_ptr<BedrockCommand>& command
                 _db.clearTimeout();
                 _db.clearAbortRef();
                 _db.setQueryOnly(false);
+
+                // Sqlite can't check reads from the read cache for conflicts, so a transaction that used it can't be
+                // the one that commits. `processCommand` will start a new one.
+                if (_db.usedReadCache()) {
+                    _db.rollback();
+                }
                 return RESULT::SHOULD_PROCESS;
             }
 
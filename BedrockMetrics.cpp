@@ -0,0 +1,182 @@
+#include "BedrockMetrics.h"
+#include <libstuff/libstuff.h>
+
+size_t BedrockMetrics::Histogram::bucketIndex(uint64_t value) {
+    if (value < SUB_BUCKETS) {
+        return value;
+    }
+    const uint64_t maxValue = (1ull << (MAX_EXPONENT + 1)) - 1;
+    value = min(value, maxValue);
+
+    // The exponent picks the power of two, and the next `SUB_BUCKET_BITS` bits below the top one pick the bucket in it.
+    size_t exponent = 63 - __builtin_clzll(value);
+    size_t subBucket = (value >> (exponent - SUB_BUCKET_BITS)) & (SUB_BUCKETS - 1);
+    return SUB_BUCKETS + (exponent - SUB_BUCKET_BITS) * SUB_BUCKETS + subBucket;
+}
+
+uint64_t BedrockMetrics::Histogram::bucketUpperBound(size_t index) {
+    if (index < SUB_BUCKETS) {
+        return index;
+    }
+    size_t shift = (index - SUB_BUCKETS) / SUB_BUCKETS;
+    size_t subBucket = (index - SUB_BUCKETS) % SUB_BUCKETS;
+    uint64_t lowerBound = (SUB_BUCKETS + subBucket) << shift;
+    return lowerBound + (1ull << shift) - 1;
+}
+
+void BedrockMetrics::Histogram::record(uint64_t value) {
+    _buckets[bucketIndex(value)].fetch_add(1, memory_order_relaxed);
+    _count.fetch_add(1, memory_order_relaxed);
+    _sum.fetch_add(value, memory_order_relaxed);
+    uint64_t previousMax = _max.load(memory_order_relaxed);
+    while (value > previousMax && !_max.compare_exchange_weak(previousMax, value, memory_order_relaxed));
+}
+
+uint64_t BedrockMetrics::Histogram::percentile(double p) const {
+    // Other threads may be recording while we read, so we count from the buckets rather than trusting `_count` to
+    // match them.
+    array<uint64_t, BUCKET_COUNT> counts;
+    uint64_t total = 0;
+    for (size_t i = 0; i < BUCKET_COUNT; i++) {
+        counts[i] = _buckets[i].load(memory_order_relaxed);
+        total += counts[i];
+    }
+    if (!total) {
+        return 0;
+    }
+
+    uint64_t target = std::max((uint64_t)1, (uint64_t)(p * total + 0.5));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < BUCKET_COUNT; i++) {
+        seen += counts[i];
+        if (seen >= target) {
+            return std::min(bucketUpperBound(i), max());
+        }
+    }
+    return max();
+}
+
+uint64_t BedrockMetrics::Histogram::count() const {
+    return _count.load(memory_order_relaxed);
+}
+
+uint64_t BedrockMetrics::Histogram::sum() const {
+    return _sum.load(memory_order_relaxed);
+}
+
+uint64_t BedrockMetrics::Histogram::max() const {
+    return _max.load(memory_order_relaxed);
+}
+
+const char* BedrockMetrics::stageName(Stage stage) {
+    switch (stage) {
+        case PREPEEK:         return "prePeek";
+        case PEEK:            return "peek";
+        case PROCESS:         return "process";
+        case POSTPROCESS:     return "postProcess";
+        case COMMIT_WORKER:   return "commitWorker";
+        case COMMIT_SYNC:     return "commitSync";
+        case QUEUE_WORKER:    return "queueWorker";
+        case QUEUE_SYNC:      return "queueSync";
+        case QUEUE_BLOCKING:  return "queueBlocking";
+        case QUEUE_PAGE_LOCK: return "queuePageLock";
+        case ESCALATION:      return "escalation";
+        case TOTAL:           return "total";
+        default:              return "unknown";
+    }
+}
+
+BedrockMetrics::StageHistograms& BedrockMetrics::_getHistograms(const string& commandName) {
+    {
+        shared_lock<shared_mutex> lock(_mutex);
+        auto it = _histograms.find(commandName);
+        if (it != _histograms.end()) {
+            return *it->second;
+        }
+    }
+
+    unique_lock<shared_mutex> lock(_mutex);
+    auto it = _histograms.find(commandName);
+    if (it == _histograms.end()) {
+        const string name = _histograms.size() < MAX_COMMAND_NAMES ? commandName : OTHER_COMMAND_NAME;
+        it = _histograms.find(name);
+        if (it == _histograms.end()) {
+            it = _histograms.emplace(name, make_unique<StageHistograms>()).first;
+        }
+    }
+    return *it->second;
+}
+
+void BedrockMetrics::record(const string& commandName, const array<uint64_t, STAGE_COUNT>& stageTimes) {
+    StageHistograms& histograms = _getHistograms(commandName);
+    for (size_t stage = 0; stage < STAGE_COUNT; stage++) {
+        if (stageTimes[stage]) {
+            histograms[stage].record(stageTimes[stage]);
+        }
+    }
+}
+
+string BedrockMetrics::generateReport() {
+    STable commands;
+    shared_lock<shared_mutex> lock(_mutex);
+    for (const auto& [commandName, histograms] : _histograms) {
+        STable stages;
+        for (size_t stage = 0; stage < STAGE_COUNT; stage++) {
+            const Histogram& histogram = (*histograms)[stage];
+            uint64_t count = histogram.count();
+            if (!count) {
+                continue;
+            }
+            stages[stageName((Stage)stage)] = SComposeJSONObject({
+                {"count", to_string(count)},
+                {"avg", to_string(histogram.sum() / count)},
+                {"max", to_string(histogram.max())},
+                {"p50", to_string(histogram.percentile(0.5))},
+                {"p90", to_string(histogram.percentile(0.9))},
+                {"p99", to_string(histogram.percentile(0.99))},
+                {"p999", to_string(histogram.percentile(0.999))},
+            });
+        }
+        commands[commandName] = SComposeJSONObject(stages);
+    }
+    return SComposeJSONObject(commands);
+}
+
+string BedrockMetrics::generatePrometheusText() {
+    // Label values need backslashes, quotes and newlines escaped.
+    auto escape = [](const string& value) {
+        string escaped;
+        for (char c : value) {
+            if (c == '\\' || c == '"') {
+                escaped += '\\';
+                escaped += c;
+            } else if (c == '\n') {
+                escaped += "\\n";
+            } else {
+                escaped += c;
+            }
+        }
+        return escaped;
+    };
+
+    const string metric = "bedrock_command_latency_microseconds";
+    string out = "# HELP " + metric + " Time commands spent in each stage.\n"
+                 "# TYPE " + metric + " summary\n";
+    shared_lock<shared_mutex> lock(_mutex);
+    for (const auto& [commandName, histograms] : _histograms) {
+        for (size_t stage = 0; stage < STAGE_COUNT; stage++) {
+            const Histogram& histogram = (*histograms)[stage];
+            uint64_t count = histogram.count();
+            if (!count) {
+                continue;
+            }
+            const string labels = "command=\"" + escape(commandName) + "\",stage=\"" + stageName((Stage)stage) + "\"";
+            for (const auto& [quantile, label] : {pair<double, string>{0.5, "0.5"}, {0.9, "0.9"}, {0.99, "0.99"}, {0.999, "0.999"}}) {
+                out += metric + "{" + labels + ",quantile=\"" + label + "\"} " + to_string(histogram.percentile(quantile)) + "\n";
+            }
+            out += metric + "_sum{" + labels + "} " + to_string(histogram.sum()) + "\n";
+            out += metric + "_count{" + labels + "} " + to_string(count) + "\n";
+        }
+    }
+    return out;
+}
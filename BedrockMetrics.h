@@ -0,0 +1,88 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+
+using namespace std;
+
+// Aggregates the timing info of finished commands into latency histograms for each command name and stage, so tail
+// latencies can be read from a running server rather than scraped from logs.
+class BedrockMetrics {
+  public:
+    // The stages of a command we keep histograms for. These match the totals logged by
+    // `BedrockCommand::finalizeTimingInfo`.
+    enum Stage {
+        PREPEEK,
+        PEEK,
+        PROCESS,
+        POSTPROCESS,
+        COMMIT_WORKER,
+        COMMIT_SYNC,
+        QUEUE_WORKER,
+        QUEUE_SYNC,
+        QUEUE_BLOCKING,
+        QUEUE_PAGE_LOCK,
+        ESCALATION,
+        TOTAL,
+        STAGE_COUNT
+    };
+
+    // A histogram of durations in microseconds. Buckets are exact below 8us, and above that there are 8 of them for each
+    // power of two, so any value is within 12.5% of the bucket it's counted in. Recording is a few relaxed atomic
+    // increments, with no locking. Values above about 19 hours are counted in the top bucket.
+    class Histogram {
+      public:
+        void record(uint64_t value);
+
+        // Returns the upper bound of the bucket holding the value at fraction `p` (0 to 1) of the way through all the
+        // recorded values, or 0 if there are none.
+        uint64_t percentile(double p) const;
+
+        uint64_t count() const;
+        uint64_t sum() const;
+        uint64_t max() const;
+
+        static constexpr size_t SUB_BUCKET_BITS = 3;
+        static constexpr size_t SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+        static constexpr size_t MAX_EXPONENT = 35;
+        static constexpr size_t BUCKET_COUNT = SUB_BUCKETS + (MAX_EXPONENT - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+
+        static size_t bucketIndex(uint64_t value);
+        static uint64_t bucketUpperBound(size_t index);
+
+      private:
+        array<atomic<uint64_t>, BUCKET_COUNT> _buckets{};
+        atomic<uint64_t> _count{0};
+        atomic<uint64_t> _sum{0};
+        atomic<uint64_t> _max{0};
+    };
+
+    // Commands with names beyond this many are all counted together, so that odd method lines can't grow this without
+    // bound.
+    static constexpr size_t MAX_COMMAND_NAMES = 1000;
+    static constexpr auto OTHER_COMMAND_NAME = "_other";
+
+    static const char* stageName(Stage stage);
+
+    // Records the time (in microseconds) each stage of a command took. Stages with no time aren't recorded, so that
+    // commands that skip a stage don't skew it.
+    void record(const string& commandName, const array<uint64_t, STAGE_COUNT>& stageTimes);
+
+    // Returns a JSON object of count, average, max and percentiles by command name and stage.
+    string generateReport();
+
+    // Returns the same data in the Prometheus text exposition format.
+    string generatePrometheusText();
+
+  private:
+    typedef array<Histogram, STAGE_COUNT> StageHistograms;
+
+    StageHistograms& _getHistograms(const string& commandName);
+
+    // Protects the map only. The histograms themselves are never removed, and are safe to update concurrently.
+    shared_mutex _mutex;
+    map<string, unique_ptr<StageHistograms>> _histograms;
+};
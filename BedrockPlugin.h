@@ -1,6 +1,19 @@
 #pragma once
 #include "BedrockCommand.h"
 class BedrockServer;
+class SQColumnarResult;
+
+// Sends the rows of a query result to a client as they're read, rather than all at once when the command is done, so
+// that a large result never has to be held in memory. `send` is called with each batch of rows in turn, the first of
+// which carries the headers (and may have no rows), and then `finish` once there are no more. Either returns false if
+// the client can't be sent to, which stops the query. Once anything has been sent, the stream is responsible for
+// setting the command's `streamState`, as the server no longer sends the command's response.
+class BedrockResultStream {
+  public:
+    virtual ~BedrockResultStream() {}
+    virtual bool send(const SQColumnarResult& rows) = 0;
+    virtual bool finish() = 0;
+};
 
 // Simple plugin system to add functionality to a node at runtime.
 class BedrockPlugin {
@@ -59,6 +72,15 @@ class BedrockPlugin {
     // s        Optional socket from which this request was received
     virtual void onPortRequestComplete(const BedrockCommand& command, STCPManager::Socket* s) { }
 
+    // Returns a stream to send a query result for `command`, which came from this plugin's port, to its socket in this
+    // plugin's protocol as it's read. A plugin that returns null (the default) gets the whole response in
+    // `onPortRequestComplete` instead.
+    virtual unique_ptr<BedrockResultStream> getResultStream(BedrockCommand& command) { return nullptr; }
+
+    // Called when a socket accepted on this plugin's port has closed, and will get no more calls, so that anything
+    // the plugin kept for the connection can be cleaned up.
+    virtual void onPortClose(STCPManager::Socket* s) { }
+
     virtual bool preventAttach();
 
     // Called when a client or plugin requests that the BedrockServer detaches from the database.
@@ -7,6 +7,8 @@
 #include <csignal>
 #include <cstring>
 #include <fstream>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
 #include <sys/resource.h>
 #include <sys/time.h>
 
@@ -14,6 +16,7 @@
 #include <BedrockCore.h>
 #include <BedrockPlugin.h>
 #include <libstuff/libstuff.h>
+#include <libstuff/SDataView.h>
 #include <libstuff/SRandom.h>
 #include <libstuff/AutoTimer.h>
 #include <PageLockGuard.h>
@@ -31,6 +34,14 @@ struct {
     chrono::time_point<chrono::steady_clock> serverDestructor{chrono::steady_clock::now()};
 } shutdownTimer;
 
+// Interrupts a command port reactor's `epoll_wait` so that it picks up new connections or completed commands.
+static void wakeCommandPortReactor(int wakeFD) {
+    uint64_t one = 1;
+    if (write(wakeFD, &one, sizeof(one)) < 0) {
+        SWARN("Failed to wake command port reactor: " << strerror(errno));
+    }
+}
+
 void BedrockServer::syncWrapper()
 {
     // Initialize the thread.
@@ -104,8 +115,19 @@ void BedrockServer::sync()
     // We use fewer FDs on test machines that have other resource restrictions in place.
 
     SINFO("Setting dbPool size to: " << _dbPoolSize);
-    _dbPool = make_shared<SQLitePool>(_dbPoolSize, args["-db"], args.calc("-cacheSize"), args.calc("-maxJournalSize"), journalTables, mmapSizeGB, args.isSet("-newDBsUseHctree"), args["-checkpointMode"]);
+    _dbPool = make_shared<SQLitePool>(_dbPoolSize, args["-db"], args.calc("-cacheSize"), args.calc("-maxJournalSize"), journalTables, mmapSizeGB, args.isSet("-newDBsUseHctree"), args["-checkpointMode"],
+                                      args.calcU64("-dbPoolWarmHandles"), args.calcU64("-dbPoolIdleTimeout") * STIME_US_PER_S, args.calc64("-dbPoolCacheBudget"),
+                                      args.isSet("-newDBsUseRingJournal"));
     SQLite& db = _dbPool->getBase();
+    if (args.isSet("-commitCacheSize")) {
+        db.setCommitCacheSize(args.calcU64("-commitCacheSize"));
+    }
+    if (args.isSet("-commitCacheMB")) {
+        db.setCommitCacheBytes(args.calcU64("-commitCacheMB") * 1024 * 1024);
+    }
+    if (args.isSet("-readCacheSize")) {
+        db.setReadCacheSize(args.calcU64("-readCacheSize"));
+    }
 
     // Initialize the command processor.
     BedrockCore core(db, *this);
@@ -134,6 +156,9 @@ void BedrockServer::sync()
     unique_ptr<BedrockCommand> command(nullptr);
     bool committingCommand = false;
 
+    // Any other QUORUM commands sharing the commit of `command`.
+    list<unique_ptr<BedrockCommand>> quorumGroup;
+
     // Timer for S_poll performance logging. Created outside the loop because it's cumulative.
     AutoTimer pollTimer("sync thread poll");
     AutoTimer postPollTimer("sync thread PostPoll");
@@ -324,6 +349,13 @@ void BedrockServer::sync()
             // they will need to be re-escalated, potentially to a different leader.
             int requeued = 0;
             int dropped = 0;
+            for (auto& groupedCommand : quorumGroup) {
+                if (groupedCommand->initiatingClientID) {
+                    _resetGroupedCommand(groupedCommand);
+                    _commandQueue.push(move(groupedCommand));
+                }
+            }
+            quorumGroup.clear();
             try {
                 while (true) {
                     // Reset this to blank. This releases the existing command and allows it to get cleaned up.
@@ -398,6 +430,11 @@ void BedrockServer::sync()
             if (command) {
                 command->stopTiming(BedrockCommand::COMMIT_SYNC);
             }
+            for (auto& groupedCommand : quorumGroup) {
+                if (!groupedCommand->complete) {
+                    groupedCommand->stopTiming(BedrockCommand::COMMIT_SYNC);
+                }
+            }
             committingCommand = false;
 
             // If we were upgrading, there's no response to send, we're just done.
@@ -437,7 +474,12 @@ void BedrockServer::sync()
                 // state, because this loop is skipped except when LEADING, FOLLOWING, or STANDINGDOWN. It's also
                 // theoretically feasible for this to happen if a follower fails to commit a transaction, but that
                 // probably indicates a bug (or a follower disk failure).
-                if (command) {
+                if (command && quorumGroup.size()) {
+                    SINFO("requeueing command " << command->request.methodLine << " and " << quorumGroup.size()
+                          << " grouped commands after failed sync commit. Sync thread has " << _syncNodeQueuedCommands.size()
+                          << " queued commands.");
+                    _requeueQuorumGroup(command, quorumGroup);
+                } else if (command) {
                     SINFO("requeueing command " << command->request.methodLine
                           << " after failed sync commit. Sync thread has " << _syncNodeQueuedCommands.size()
                           << " queued commands.");
@@ -446,6 +488,21 @@ void BedrockServer::sync()
                     SERROR("Unexpected sync thread commit state.");
                 }
             }
+
+            // Any commands that shared this commit get the same outcome. Those that finished without needing a commit
+            // may have read the group's writes, so they were waiting for them to be committed before replying.
+            for (auto& groupedCommand : quorumGroup) {
+                if (!groupedCommand->complete) {
+                    if (groupedCommand->shouldPostProcess() && groupedCommand->response.methodLine == "200 OK") {
+                        core.postProcessCommand(groupedCommand, false);
+                    }
+                    _conflictManager.recordTables(groupedCommand->request.methodLine, db.getTablesUsed());
+                    groupedCommand->response["commitCount"] = to_string(db.getCommitCount());
+                    groupedCommand->complete = true;
+                }
+                _reply(groupedCommand);
+            }
+            quorumGroup.clear();
         }
 
         // We're either leading, standing down, or following. There could be a commit in progress on `command`, but
@@ -554,11 +611,32 @@ void BedrockServer::sync()
 
                     BedrockCore::RESULT result = core.processCommand(command, true);
                     if (result == BedrockCore::RESULT::NEEDS_COMMIT) {
+                        // If there are more QUORUM commands waiting behind this one, they can share its commit. Not if
+                        // this one made HTTPS requests or has its own prepare handler, though, as those would then
+                        // apply to the whole group.
+                        void (*onPrepareHandler)(SQLite& db, int64_t tableID) = nullptr;
+                        if (command->writeConsistency == SQLiteNode::QUORUM && _quorumGroupCommitSize > 1 &&
+                            !command->httpsRequests.size() && !command->shouldEnableOnPrepareNotification(db, &onPrepareHandler)) {
+                            if (!_addQueuedCommandsToQuorumGroup(core, db, quorumGroup)) {
+                                SWARN("Lost transaction while grouping QUORUM commands, re-queueing " << (quorumGroup.size() + 1) << " commands.");
+                                _requeueQuorumGroup(command, quorumGroup);
+                                break;
+                            }
+                            if (quorumGroup.size()) {
+                                SINFO("[performance] Sync thread grouped " << quorumGroup.size() << " commands into QUORUM commit with " << command->request.methodLine);
+                            }
+                        }
+
                         // The processor says we need to commit this, so let's start that process.
                         committingCommand = true;
                         SINFO("[performance] Sync thread beginning committing command " << command->request.methodLine);
                         // START TIMING.
                         command->startTiming(BedrockCommand::COMMIT_SYNC);
+                        for (auto& groupedCommand : quorumGroup) {
+                            if (!groupedCommand->complete) {
+                                groupedCommand->startTiming(BedrockCommand::COMMIT_SYNC);
+                            }
+                        }
                         _syncNode->startCommit(command->writeConsistency);
 
                         // And we'll start the next main loop.
@@ -662,6 +740,10 @@ void BedrockServer::sync()
         }
     }
 
+    // An online backup holds a handle from the DB pool, and a snapshot that keeps the WAL from being checkpointed, so
+    // it doesn't survive detaching.
+    _stopOnlineBackup();
+
     // Release the current DB pool, and zero out our pointer. If any socket threads hold a handle to `_syncNode`, they will keep this in existence
     // until they release it.
     _dbPool = nullptr;
@@ -670,6 +752,88 @@ void BedrockServer::sync()
     _syncLoopShouldBeRunning.store(false);
 }
 
+bool BedrockServer::_addQueuedCommandsToQuorumGroup(BedrockCore& core, SQLite& db, list<unique_ptr<BedrockCommand>>& group) {
+    while (group.size() + 1 < _quorumGroupCommitSize) {
+        // We stop at the first command that can't join the group rather than skipping past it, so that commands are
+        // still committed in the order they were queued. Commands with HTTPS requests or their own prepare handler
+        // always commit by themselves. Only the sync thread pops from this queue, so the front can't change under us.
+        unique_ptr<BedrockCommand> command;
+        try {
+            const unique_ptr<BedrockCommand>& next = _syncNodeQueuedCommands.front();
+            void (*onPrepareHandler)(SQLite& db, int64_t tableID) = nullptr;
+            if (next->writeConsistency != SQLiteNode::QUORUM || next->httpsRequests.size() ||
+                next->shouldEnableOnPrepareNotification(db, &onPrepareHandler)) {
+                break;
+            }
+            command = _syncNodeQueuedCommands.pop();
+        } catch (const out_of_range& e) {
+            break;
+        }
+
+        SAUTOPREFIX(command->request);
+        if (command->timeout() < STimeNow()) {
+            SINFO("Command '" << command->request.methodLine << "' timed out in sync thread queue, sending back to main queue.");
+            _commandQueue.push(move(command));
+            continue;
+        }
+
+        // Everything this command does happens inside the savepoint, so that if it fails, rolling it back leaves the
+        // rest of the group intact.
+        db.beginSavepoint();
+        if (command->shouldPrePeek() && !command->repeek) {
+            core.prePeekCommand(command, false);
+        }
+        if (!command->complete && core.peekCommand(command, true) == BedrockCore::RESULT::SHOULD_PROCESS) {
+            if (command->httpsRequests.size()) {
+                SWARN("Killing command " << command->request.methodLine << " that attempted HTTPS request in sync thread.");
+                command->response.clear();
+                command->response.methodLine = "500 Refused";
+                command->complete = true;
+                core.rollback();
+            } else {
+                core.processCommand(command, true);
+            }
+        }
+
+        // If sqlite threw away the whole transaction (rather than just this command's savepoint), the work done by the
+        // rest of the group is gone too. This command goes back ahead of anything queued after it, and the caller puts
+        // the group back ahead of it.
+        if (!db.insideTransaction()) {
+            _resetGroupedCommand(command);
+            _syncNodeQueuedCommands.pushFront(move(command));
+            return false;
+        }
+        db.releaseSavepoint();
+
+        // A command refused for making HTTPS requests did nothing, and can be told so now. Any other command may have
+        // read what the group wrote, so even if it doesn't need a commit itself, it can't reply until the group has
+        // been committed.
+        if (command->httpsRequests.size()) {
+            _reply(command);
+        } else {
+            group.push_back(move(command));
+        }
+    }
+    return true;
+}
+
+void BedrockServer::_requeueQuorumGroup(unique_ptr<BedrockCommand>& command, list<unique_ptr<BedrockCommand>>& group) {
+    for (auto it = group.rbegin(); it != group.rend(); it++) {
+        _resetGroupedCommand(*it);
+        _syncNodeQueuedCommands.pushFront(move(*it));
+    }
+    group.clear();
+    _syncNodeQueuedCommands.pushFront(move(command));
+}
+
+void BedrockServer::_resetGroupedCommand(unique_ptr<BedrockCommand>& command) {
+    if (command->complete) {
+        command->complete = false;
+        command->response.clear();
+        command->jsonContent.clear();
+    }
+}
+
 void BedrockServer::worker(int threadId)
 {
     // Worker 0 is the "blockingCommit" thread.
@@ -697,6 +861,13 @@ void BedrockServer::worker(int threadId)
             SINFO("Dequeued command " << command->request.methodLine << " (" << command->id << ") in worker, "
                   << commandQueue.size() << " commands in " << (threadId ? "" : "blocking") << " queue.");
 
+            // If it was aborted while it waited, its client has gone away, and there's nobody to run it for.
+            if (command->shouldAbort) {
+                SINFO("Dropping aborted command " << command->request.methodLine << " (" << command->id << ").");
+                command.reset();
+                continue;
+            }
+
             runCommand(move(command), threadId == 0, false);
         } catch (const BedrockCommandQueue::timeout_error& e) {
             // No commands to process after 1 second.
@@ -820,9 +991,10 @@ void BedrockServer::runCommand(unique_ptr<BedrockCommand>&& _command, bool isBlo
             (_blacklistedParallelCommands.find(command->request.methodLine) == _blacklistedParallelCommands.end());
     }
 
-    int64_t lastConflictPage = 0;
     string lastConflictLocation;
     while (true) {
+        // Set if this pass loses a commit conflict on a page we can wait for, rather than for some other reason.
+        bool conflictedOnPage = false;
 
         // We just spin until the node looks ready to go. Typically, this doesn't happen expect briefly at startup.
         size_t waitCount = 0;
@@ -850,6 +1022,16 @@ void BedrockServer::runCommand(unique_ptr<BedrockCommand>&& _command, bool isBlo
         canWriteParallel = canWriteParallel && (command->writeConsistency == SQLiteNode::ASYNC);
 
         // If there are outstanding HTTPS requests on this command (from a previous call to `peek`) we process them here.
+        // With the HTTPS reactor running, a command on a worker thread gives up the thread while it waits, and is
+        // queued again once its requests are done.
+        if (!hasDedicatedThread && !isBlocking && SStandaloneHTTPSManager::isReactorRunning() && !command->areHttpsRequestsComplete()) {
+            SINFO("Suspending '" << command->request.methodLine << "' until its HTTPS requests complete.");
+            auto suspendedCommand = make_shared<unique_ptr<BedrockCommand>>(move(command));
+            (*suspendedCommand)->watchHTTPSRequests([this, suspendedCommand]() {
+                _commandQueue.push(move(*suspendedCommand));
+            });
+            return;
+        }
         command->waitForHTTPSRequests();
 
         // Get a DB handle to work on. This will automatically be returned when dbScope goes out of scope.
@@ -907,11 +1089,15 @@ void BedrockServer::runCommand(unique_ptr<BedrockCommand>&& _command, bool isBlo
             }
 
             auto *timer = new BedrockCore::AutoTimer(command, BedrockCommand::QUEUE_PAGE_LOCK);
+            const int64_t lastConflictPage = command->lastConflictPage;
             uint64_t conflictLockStartTime = 0;
             if (lastConflictPage) {
                 conflictLockStartTime = STimeNow();
             }
             {
+                // Register as working on this page before waiting for it, so that anything else that conflicts on it
+                // in the meantime parks until we're done rather than piling up on the lock.
+                BedrockConflictManager::PageWork pageWork(_conflictManager, lastConflictPage, _commandQueue);
                 PageLockGuard pageLock(lastConflictPage);
                 if (lastConflictPage) {
                     SINFO("Waited " << (STimeNow() - conflictLockStartTime) << "us for lock on db page " << lastConflictPage << ".");
@@ -1024,6 +1210,7 @@ void BedrockServer::runCommand(unique_ptr<BedrockCommand>&& _command, bool isBlo
                             command->complete = true;
                         } else {
                             SINFO("Conflict or state change committing " << command->request.methodLine);
+                            _conflictManager.recordConflict(command->request.methodLine);
                             if (_enableConflictPageLocks) {
                                 lastConflictLocation = db.getLastConflictLocation();
 
@@ -1032,7 +1219,8 @@ void BedrockServer::runCommand(unique_ptr<BedrockCommand>&& _command, bool isBlo
                                 // don't need to lock our next commit on this page conflict.
                                 // Plugins may define other tables on which we should not lock our next commit.
                                 if (!SStartsWith(lastConflictLocation, "journal") && (command->getPlugin() == nullptr || command->getPlugin()->shouldLockCommitPageOnConflict(lastConflictLocation))) {
-                                    lastConflictPage = db.getLastConflictPage();
+                                    command->lastConflictPage = db.getLastConflictPage();
+                                    conflictedOnPage = command->lastConflictPage != 0;
                                 }
                             }
                         }
@@ -1081,6 +1269,20 @@ void BedrockServer::runCommand(unique_ptr<BedrockCommand>&& _command, bool isBlo
                 _blockingCommandQueue.push(move(command));
                 return;
             }
+        } else if (conflictedOnPage) {
+            // We know which page we lost on, so rather than guessing how long to wait, we wait for whoever's working on
+            // that page. A dedicated thread can just go around again and block on the page lock. Otherwise, park the
+            // command until the current holder of the page finishes, or requeue it right away if there isn't one.
+            if (!hasDedicatedThread) {
+                const string methodLine = command->request.methodLine;
+                const int64_t page = command->lastConflictPage;
+                if (_conflictManager.parkOnPage(page, command)) {
+                    SINFO("Parked '" << methodLine << "' on db page " << page << " (" << lastConflictLocation << ") until current work on it finishes.");
+                } else {
+                    _commandQueue.push(move(command));
+                }
+                return;
+            }
         } else {
             // If we're not shutting down, see how long we want to wait until we'll try this command again.
             size_t millisecondsToWait = 0;
@@ -1286,6 +1488,12 @@ BedrockServer::BedrockServer(const SData& args_)
         SSyslogFunc = &SSyslogSocketDirect;
     }
 
+    // Hand log lines to a background thread to send in batches, rather than sending each from the thread logging it.
+    if (args.isSet("-logAsync")) {
+        SLogAsyncStart(args.isSet("-logAsyncBufferKB") ? args.calcU64("-logAsyncBufferKB") * 1024 : 64 * 1024);
+        SSyslogFunc = &SSyslogAsync;
+    }
+
     // Check for commands that will be forced to use QUORUM write consistency.
     if (args.isSet("-synchronousCommands")) {
         list<string> syncCommands;
@@ -1320,6 +1528,7 @@ BedrockServer::BedrockServer(const SData& args_)
 
     // Set the quorum checkpoint, or default if not specified.
     _quorumCheckpointSeconds = args.isSet("-quorumCheckpointSeconds") ? args.calc("-quorumCheckpointSeconds") : 60;
+    _quorumGroupCommitSize = args.isSet("-quorumGroupCommitSize") ? max(args.calcU64("-quorumGroupCommitSize"), (uint64_t)1) : 1;
 
     if (args.isSet("-dbPoolSize")){
         _dbPoolSize = args.calcU64("-dbPoolSize");
@@ -1331,6 +1540,56 @@ BedrockServer::BedrockServer(const SData& args_)
         _maxSocketThreads = args.calcU64("-maxSocketThreads");
     }
 
+    if (args.isSet("-replicationThreads")) {
+        SQLiteNode::replicationThreads = max(args.calcU64("-replicationThreads"), (uint64_t)1);
+    }
+
+    if (args.isSet("-synchronizeBatchSize")) {
+        SQLiteNode::synchronizeBatchSize = max(args.calcU64("-synchronizeBatchSize"), (uint64_t)1);
+    }
+
+    SQLiteNode::binaryPeerProtocol = args.isSet("-binaryPeerProtocol");
+    SQLiteNode::peerCompression = args.isSet("-peerCompression");
+
+    if (args.isSet("-statementCacheSize")) {
+        SQLite::statementCacheSize = args.calcU64("-statementCacheSize");
+    }
+
+    SQLiteClusterMessenger::multiplexedConnections = args.calcU64("-escalationConnections");
+
+    // Outbound HTTPS requests from commands can be driven by a few shared threads, and can reuse connections.
+    SStandaloneHTTPSManager::keepAliveTimeout = args.calcU64("-httpsKeepAliveTimeout") * STIME_US_PER_S;
+    SStandaloneHTTPSManager::reactorIdleTimeoutMS = BedrockCommand::DEFAULT_TIMEOUT;
+    if (args.isSet("-httpsReactorThreads")) {
+        SINFO("Starting " << args.calcU64("-httpsReactorThreads") << " HTTPS reactor threads.");
+        SStandaloneHTTPSManager::startReactor(args.calcU64("-httpsReactorThreads"));
+    }
+
+    // If requested, connections on the command ports are multiplexed on a few reactor threads rather than each getting
+    // their own socket thread.
+    if (args.isSet("-commandPortReactorThreads")) {
+        size_t reactorThreads = args.calcU64("-commandPortReactorThreads");
+        SINFO("Starting " << reactorThreads << " command port reactor threads.");
+        for (size_t i = 0; i < reactorThreads; i++) {
+            auto reactor = make_unique<CommandPortReactor>();
+            reactor->epollFD = epoll_create1(EPOLL_CLOEXEC);
+            reactor->wakeFD = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+            if (reactor->epollFD < 0 || reactor->wakeFD < 0) {
+                SERROR("Couldn't create command port reactor: " << strerror(errno));
+            }
+            epoll_event event{};
+            event.events = EPOLLIN;
+            event.data.fd = reactor->wakeFD;
+            if (epoll_ctl(reactor->epollFD, EPOLL_CTL_ADD, reactor->wakeFD, &event)) {
+                SERROR("Couldn't register command port reactor wake event: " << strerror(errno));
+            }
+            _commandPortReactors.push_back(move(reactor));
+        }
+        for (size_t i = 0; i < _commandPortReactors.size(); i++) {
+            _commandPortReactors[i]->reactorThread = thread(&BedrockServer::_commandPortReactorLoop, this, ref(*_commandPortReactors[i]), i);
+        }
+    }
+
     // Start the sync thread, which will start the worker threads.
     SINFO("Launching sync thread '" << _syncThreadName << "'");
     _syncThread = thread(&BedrockServer::syncWrapper, this);
@@ -1342,12 +1601,28 @@ BedrockServer::~BedrockServer() {
     if (_syncThread.joinable()) {
         _syncThread.join();
     }
+    _stopOnlineBackup();
     SINFO("Threads closed.");
 
     if (_outstandingSocketThreads) {
         SWARN("Shutting down with " << _outstandingSocketThreads << " socket threads remaining.");
     }
 
+    // Stop the command port reactors, if we have any. By now, every client has been disconnected.
+    _commandPortReactorsShouldExit = true;
+    for (auto& reactor : _commandPortReactors) {
+        wakeCommandPortReactor(reactor->wakeFD);
+        reactor->reactorThread.join();
+        close(reactor->epollFD);
+        close(reactor->wakeFD);
+    }
+    if (_outstandingReactorConnections) {
+        SWARN("Shutting down with " << _outstandingReactorConnections << " reactor connections remaining.");
+    }
+
+    // Every command is done by now, so nothing is waiting on the HTTPS reactor.
+    SStandaloneHTTPSManager::stopReactor();
+
     // Delete our plugins.
     for (auto& p : plugins) {
         delete p.second;
@@ -1471,10 +1746,11 @@ void BedrockServer::postPoll(fd_map& fdm, uint64_t& nextActivity) {
         unique_lock<shared_mutex> lock(_controlPortExclusionMutex);
 
         size_t count = BedrockCommand::getCommandCount();
-        SINFO("SHUTDOWN Have " << _outstandingSocketThreads << " socket threads and " << count << " commands remaining.");
+        SINFO("SHUTDOWN Have " << _outstandingSocketThreads << " socket threads, " << _outstandingReactorConnections
+              << " reactor connections, and " << count << " commands remaining.");
 
         // Don't tell the sync node to shut down while we still have commands or sockets left.
-        if (!_outstandingSocketThreads && !count) {
+        if (!_outstandingSocketThreads && !_outstandingReactorConnections && !count) {
             _shutdownState.store(COMMANDS_FINISHED);
             shutdownTimer.commandsComplete = chrono::steady_clock::now();
 
@@ -1507,7 +1783,7 @@ unique_ptr<BedrockCommand> BedrockServer::getCommandFromPlugins(unique_ptr<SQLit
 
 void BedrockServer::_reply(unique_ptr<BedrockCommand>& command) {
     // Finalize timing info even for commands we won't respond to (this makes this data available in logs).
-    command->finalizeTimingInfo();
+    command->finalizeTimingInfo(_metrics);
 
     // Don't reply to commands with pseudo-clients (i.e., commands that we generated by other commands, or using
     // `Connection: forget`.
@@ -1518,6 +1794,12 @@ void BedrockServer::_reply(unique_ptr<BedrockCommand>& command) {
 
     command->response["nodeName"] = args["-nodeName"];
 
+    // A client multiplexing requests on one connection needs this to know which request we're responding to.
+    const bool multiplexed = command->request.isSet("MultiplexID");
+    if (multiplexed) {
+        command->response["MultiplexID"] = command->request["MultiplexID"];
+    }
+
     // If we're shutting down, tell the caller to close the connection.
     // Also, if the caller wanted us to close the connection, we'll parrot that back.
     if (_shutdownState.load() != RUNNING || command->request["Connection"] == "close") {
@@ -1528,7 +1810,15 @@ void BedrockServer::_reply(unique_ptr<BedrockCommand>& command) {
     const string& pluginName = command->request["plugin"];
 
     if (command->socket) {
-        if (!pluginName.empty()) {
+        if (command->streamState != BedrockCommand::STREAM_STATE::NONE) {
+            // The command sent its response itself. If it didn't finish, closing the connection is the only way left
+            // to let the client know.
+            if (command->streamState != BedrockCommand::STREAM_STATE::FINISHED) {
+                SINFO("Streamed response to '" << command->request.methodLine << "' is incomplete (" << command->response.methodLine
+                      << "), closing connection #" << command->initiatingClientID);
+                command->socket->shutdown();
+            }
+        } else if (!pluginName.empty()) {
             // Let the plugin handle it
             SINFO("Plugin '" << pluginName << "' handling response '" << command->response.methodLine
                   << "' to request '" << command->request.methodLine << "'");
@@ -1547,8 +1837,10 @@ void BedrockServer::_reply(unique_ptr<BedrockCommand>& command) {
             }
         }
 
-        // If `Connection: close` was set, shut down the socket, in case the caller ignores us.
-        if (SIEquals(command->request["Connection"], "close") || _shutdownState.load() != RUNNING) {
+        // If `Connection: close` was set, shut down the socket, in case the caller ignores us. We don't do this to a
+        // multiplexed connection, as other responses are still due on it. The client stops sending on it when it sees
+        // `Connection: close`, and the socket thread closes it once everything is done.
+        if (!multiplexed && (SIEquals(command->request["Connection"], "close") || _shutdownState.load() != RUNNING)) {
             command->socket->shutdown();
         }
     } else {
@@ -1601,7 +1893,8 @@ bool BedrockServer::_isStatusCommand(const unique_ptr<BedrockCommand>& command)
         SIEquals(command->request.methodLine, STATUS_PING)              ||
         SIEquals(command->request.methodLine, STATUS_STATUS)            ||
         SIEquals(command->request.methodLine, STATUS_BLACKLIST)         ||
-        SIEquals(command->request.methodLine, STATUS_MULTIWRITE)) {
+        SIEquals(command->request.methodLine, STATUS_MULTIWRITE)        ||
+        SIEquals(command->request.methodLine, STATUS_METRICS)) {
         return true;
     }
     return false;
@@ -1664,6 +1957,13 @@ void BedrockServer::_status(unique_ptr<BedrockCommand>& command) {
         }
     }
 
+    // Latency histograms in the Prometheus text format, so they can be scraped.
+    else if (SIEquals(request.methodLine, STATUS_METRICS)) {
+        response.methodLine = "HTTP/1.1 200 OK";
+        response["Content-Type"] = "text/plain; version=0.0.4";
+        response.content = _metrics.generatePrometheusText();
+    }
+
     // All a ping message requires is some response.
     else if (SIEquals(request.methodLine, STATUS_PING)) {
         response.methodLine = "200 OK";
@@ -1685,6 +1985,14 @@ void BedrockServer::_status(unique_ptr<BedrockCommand>& command) {
         content["host"] = args["-nodeHost"];
         content["commandCount"] = BedrockCommand::getCommandCount();
         content["isDetached"] = isDetached() ? "true" : "false";
+        content["onlineBackupRunning"] = _onlineBackupRunning.load();
+        content["lastOnlineBackupCommit"] = _lastOnlineBackupCommit.load();
+        if (!_commandPortReactors.empty()) {
+            content["commandPortReactorConnections"] = _outstandingReactorConnections.load();
+        }
+        content["statementCacheHits"] = SQStatementCache::hits.load();
+        content["statementCacheMisses"] = SQStatementCache::misses.load();
+        content["statementCachePrepareTimeUS"] = SQStatementCache::prepareTimeUS.load();
 
         {
             // Make it known if anything is known to cause crashes.
@@ -1747,11 +2055,30 @@ void BedrockServer::_status(unique_ptr<BedrockCommand>& command) {
             content["CommitCount"] = to_string(_syncNodeCopy->getCommitCount());
             content["priority"] = to_string(_syncNodeCopy->getPriority());
             content["outstandingFramesToCheckpoint"] = to_string(_syncNodeCopy->getOutstandingFramesToCheckpoint());
+            for (auto& item : _syncNodeCopy->getReplicationInfo()) {
+                content[item.first] = item.second;
+            }
             _syncNodeCopy = nullptr;
         } else {
             content["syncNodeAvailable"] = "false";
         }
 
+        shared_ptr<SQLitePool> dbPoolCopy = _dbPool;
+        if (dbPoolCopy) {
+            for (auto& item : dbPoolCopy->getStats()) {
+                content[item.first] = item.second;
+            }
+        }
+
+        auto clusterMessengerCopy = _clusterMessenger;
+        if (clusterMessengerCopy) {
+            for (auto& item : clusterMessengerCopy->getStats()) {
+                content[item.first] = item.second;
+            }
+        }
+
+        content["logLinesDropped"] = to_string(SLogAsyncDropped);
+
         // Done, compose the response.
         response.methodLine = "200 OK";
         response.content = SComposeJSONObject(content);
@@ -1789,10 +2116,12 @@ void BedrockServer::_status(unique_ptr<BedrockCommand>& command) {
 
 bool BedrockServer::_isControlCommand(const unique_ptr<BedrockCommand>& command) {
     if (SIEquals(command->request.methodLine, "BeginBackup")            ||
+        SIEquals(command->request.methodLine, "BeginOnlineBackup")      ||
         SIEquals(command->request.methodLine, "SuppressCommandPort")    ||
         SIEquals(command->request.methodLine, "ClearCommandPort")       ||
         SIEquals(command->request.methodLine, "ClearCrashCommands")     ||
         SIEquals(command->request.methodLine, "ConflictReport")         ||
+        SIEquals(command->request.methodLine, "LatencyReport")          ||
         SIEquals(command->request.methodLine, "Detach")                 ||
         SIEquals(command->request.methodLine, "Attach")                 ||
         SIEquals(command->request.methodLine, "SetConflictParams")      ||
@@ -1808,6 +2137,66 @@ bool BedrockServer::_isControlCommand(const unique_ptr<BedrockCommand>& command)
     return false;
 }
 
+void BedrockServer::_runOnlineBackup(const string& directory, uint64_t fromCommit, int pagesPerStep, uint64_t stepDelayUS) {
+    SInitialize("onlineBackup");
+    shared_ptr<SQLitePool> dbPoolCopy = _dbPool;
+    if (dbPoolCopy) {
+        SQLiteScopedHandle dbScope(*dbPoolCopy, dbPoolCopy->getIndex());
+        SQLite& db = dbScope.db();
+        string filename = db.getFilename();
+        const string dbFile = basename(filename.data());
+        const string partialPath = directory + "/" + dbFile + ".partial";
+        unlink(partialPath.c_str());
+
+        // Each step is followed by a pause, which is where the backup stops if asked to.
+        uint64_t lastLog = STimeNow();
+        auto betweenSteps = [&](int remaining, int pageCount) {
+            if (!_onlineBackupShouldStop && stepDelayUS) {
+                usleep(stepDelayUS);
+            }
+            if (remaining >= 0 && STimeNow() - lastLog > 60 * STIME_US_PER_S) {
+                SINFO("Online backup of " << dbFile << " has copied " << (pageCount - remaining) << " of " << pageCount << " pages.");
+                lastLog = STimeNow();
+            }
+            return !_onlineBackupShouldStop;
+        };
+
+        string path;
+        uint64_t commitCount;
+        if (fromCommit) {
+            commitCount = db.backupCommits(partialPath, fromCommit, pagesPerStep * 4096, [&]() {
+                return betweenSteps(-1, -1);
+            });
+            path = directory + "/" + dbFile + "." + to_string(fromCommit + 1) + "-" + to_string(commitCount) + ".commits";
+        } else {
+            commitCount = db.backup(partialPath, pagesPerStep, betweenSteps);
+            path = directory + "/" + dbFile + "." + to_string(commitCount) + ".backup";
+        }
+
+        if (!commitCount) {
+            SWARN("Online backup of " << dbFile << " failed or was stopped.");
+            unlink(partialPath.c_str());
+        } else if (commitCount == fromCommit) {
+            SINFO("No commits since " << fromCommit << " to back up.");
+            unlink(partialPath.c_str());
+        } else if (rename(partialPath.c_str(), path.c_str())) {
+            SWARN("Couldn't move online backup to " << path << ": " << strerror(errno));
+        } else {
+            SINFO("Online backup of " << dbFile << " at commit " << commitCount << " saved to " << path);
+            _lastOnlineBackupCommit = commitCount;
+        }
+    }
+    _onlineBackupRunning = false;
+}
+
+void BedrockServer::_stopOnlineBackup() {
+    lock_guard lock(_onlineBackupMutex);
+    _onlineBackupShouldStop = true;
+    if (_onlineBackupThread.joinable()) {
+        _onlineBackupThread.join();
+    }
+}
+
 bool BedrockServer::_isNonSecureControlCommand(const unique_ptr<BedrockCommand>& command) {
     // A list of non-secure control commands that can be run from another host
     // TODO: Have some other way to specify privileged commands that can be
@@ -1830,6 +2219,32 @@ void BedrockServer::_control(unique_ptr<BedrockCommand>& command) {
     if (SIEquals(command->request.methodLine, "BeginBackup")) {
         _shouldBackup = true;
         _beginShutdown("Detach", true);
+    } else if (SIEquals(command->request.methodLine, "BeginOnlineBackup")) {
+        // Unlike `BeginBackup`, this doesn't detach. The backup runs on its own thread while we keep serving.
+        uint64_t fromCommit = 0;
+        if (command->request.test("incremental")) {
+            fromCommit = command->request.isSet("fromCommit") ? command->request.calcU64("fromCommit") : _lastOnlineBackupCommit.load();
+        }
+        int pagesPerStep = command->request.calc("pagesPerStep");
+        uint64_t stepDelayMS = command->request.isSet("stepDelayMS") ? command->request.calcU64("stepDelayMS") : 10;
+        string directory = command->request.isSet("directory") ? command->request["directory"] : "/var/tmp";
+        if (command->request.test("incremental") && !fromCommit) {
+            response.methodLine = "400 No Previous Backup";
+        } else if (!_dbPool) {
+            response.methodLine = "400 No Database";
+        } else if (_onlineBackupRunning.exchange(true)) {
+            response.methodLine = "400 Backup Already Running";
+        } else {
+            lock_guard lock(_onlineBackupMutex);
+            if (_onlineBackupThread.joinable()) {
+                _onlineBackupThread.join();
+            }
+            _onlineBackupShouldStop = false;
+            _onlineBackupThread = thread(&BedrockServer::_runOnlineBackup, this, directory, fromCommit,
+                                         pagesPerStep > 0 ? pagesPerStep : 100, stepDelayMS * 1000);
+            response.methodLine = "202 Backup Started";
+            response["fromCommit"] = fromCommit;
+        }
     } else if (SIEquals(command->request.methodLine, "SuppressCommandPort")) {
         if (command->request.isSet("reason") && command->request["reason"].size()) {
             reason = command->request["reason"];
@@ -1845,6 +2260,8 @@ void BedrockServer::_control(unique_ptr<BedrockCommand>& command) {
         _crashCommands.clear();
     } else if (SIEquals(command->request.methodLine, "ConflictReport")) {
         response.content = _conflictManager.generateReport();
+    } else if (SIEquals(command->request.methodLine, "LatencyReport")) {
+        response.content = _metrics.generateReport();
     } else if (SIEquals(command->request.methodLine, "Detach")) {
         if (isDetached()) {
             response.methodLine = "400 Already detached";
@@ -2023,6 +2440,9 @@ void BedrockServer::_beginShutdown(const string& reason, bool detach) {
 
         // Set a 10 second DB timeout for all remaining queries.
         _shutdownTime.store(chrono::steady_clock::now() + chrono::seconds{10});
+
+        // Same as commands polling their own HTTPS requests, give up on connections that are making no progress.
+        SStandaloneHTTPSManager::reactorIdleTimeoutMS = 5'000;
         SINFO("START_SHUTDOWN. Ports shutdown, will perform final socket read. Queries will time out in 10s. Commands queued: " << _commandQueue.size()
               << ", blocking commands queued: " << _blockingCommandQueue.size() << ", total commands: " << BedrockCommand::getCommandCount()
               << ", state: " << SQLiteNode::stateName(currentState));
@@ -2102,10 +2522,14 @@ void BedrockServer::_acceptSockets() {
                 continue;
             }
 
+            // Command port connections are handed to a reactor thread if we have any, and so don't count against
+            // `_maxSocketThreads`.
+            const bool useReactor = !_commandPortReactors.empty() && (port == _commandPortPublic || port == _commandPortPrivate);
+
             // Accept as many sockets as we can.
             while (true) {
                 uint64_t now = STimeNow();
-                if ((port != _controlPort) && (_outstandingSocketThreads >= _maxSocketThreads)) {
+                if ((port != _controlPort) && !useReactor && (_outstandingSocketThreads >= _maxSocketThreads)) {
                     if ((lastLogged < now - 3'000'000)) {
                         SWARN("Not accepting any new socket threads as we already have " << _outstandingSocketThreads << " of " << _maxSocketThreads);
                         lastLogged = now;
@@ -2134,6 +2558,11 @@ void BedrockServer::_acceptSockets() {
                     plugin->second->onPortAccept(&socket);
                 }
 
+                if (useReactor) {
+                    _addReactorConnection(move(socket), port == _commandPortPublic, port == _commandPortPrivate);
+                    continue;
+                }
+
                 // And start up this socket's thread.
                 _outstandingSocketThreads++;
                 thread t;
@@ -2217,6 +2646,13 @@ unique_ptr<BedrockCommand> BedrockServer::buildCommandFromRequest(SData&& reques
         request["_source"] = ip;
     }
 
+    // Only peers escalating over the private command port get to multiplex requests on a connection. Anyone else's are
+    // handled one at a time, like any other request.
+    if (!shouldTreatAsLocalhost && request.isSet("MultiplexID")) {
+        SINFO("Ignoring MultiplexID on a connection not from the private command port.");
+        request.erase("MultiplexID");
+    }
+
     // Pull any serialized https requests off the requests object to apply to the command.
     string serializedHTTPSRequests = request["httpsRequests"];
     string serializedData = request["serializedData"];
@@ -2272,10 +2708,55 @@ void BedrockServer::handleSocket(Socket&& socket, bool fromControlPort, bool fro
     SInitialize(threadName);
     SINFO("[performance] Socket thread starting");
 
+    // Requests sent with a `MultiplexID` header (see `SQLiteClusterMessenger::multiplexedConnections`) are handed to
+    // the worker pool, and we go on reading requests while they run, as the client can match up responses that arrive
+    // out of order. The socket can't go away until all of them are done.
+    mutex multiplexedMutex;
+    condition_variable multiplexedCV;
+    atomic<size_t> multiplexedInFlight = 0;
+
+    // We keep the `shouldAbort` flags of those commands, so that we can abort them if the client disconnects or we're
+    // past the shutdown timeout, as we do for a command we wait on. Each one gets its own destruction callback to
+    // remove its flag, and callbacks that have run are cleaned up as more commands arrive. All of this is protected by
+    // `multiplexedMutex`.
+    list<atomic<bool>*> multiplexedAbortFlags;
+    list<function<void()>> multiplexedCallbacks;
+    vector<list<function<void()>>::iterator> finishedMultiplexedCallbacks;
+    auto abortMultiplexedCommands = [&multiplexedMutex, &multiplexedAbortFlags]() {
+        lock_guard lock(multiplexedMutex);
+        for (atomic<bool>* flag : multiplexedAbortFlags) {
+            *flag = true;
+        }
+    };
+    auto abortMultiplexedCommandsPastShutdown = [this, &multiplexedInFlight, &abortMultiplexedCommands]() {
+        auto shutdownTime = _shutdownTime.load();
+        if (multiplexedInFlight && shutdownTime != chrono::time_point<chrono::steady_clock>{} && chrono::steady_clock::now() >= shutdownTime) {
+            SINFO("Aborting multiplexed commands past shutdown timeout limit.");
+            abortMultiplexedCommands();
+        }
+    };
+
+    // A client multiplexing requests can send several at once, so after handling one, we check whether the next has
+    // already arrived before waiting for more data.
+    bool haveBufferedRequest = false;
+
     // This outer loop just runs until the entire socket life cycle is done, meaning it deserializes a command,
     // waits for it to get processed, deserializes another, etc, until the socket gets closed.
     // This whole block is largely duplicated from `postPoll` and modified to work on a single non-blocking socket.
     while (socket.state != STCPManager::Socket::CLOSED) {
+        // If this connection has as many multiplexed commands in flight as we allow, we don't read anything more from
+        // it until some of them finish. The client blocks sending once the socket buffers fill up.
+        if (multiplexedInFlight >= MAX_MULTIPLEXED_IN_FLIGHT) {
+            {
+                unique_lock<mutex> lock(multiplexedMutex);
+                multiplexedCV.wait_for(lock, chrono::seconds(1), [&multiplexedInFlight]() {
+                    return multiplexedInFlight < MAX_MULTIPLEXED_IN_FLIGHT;
+                });
+            }
+            abortMultiplexedCommandsPastShutdown();
+            continue;
+        }
+
         // We are going to call `poll` in a loop with only this one socket as a file descriptor.
         // The reason for this is because it's possible that a client is connected to us, and not sending us any data.
         // It may be waiting for it's own data before it can send us a request, or it may have just forgotten to
@@ -2289,16 +2770,20 @@ void BedrockServer::handleSocket(Socket&& socket, bool fromControlPort, bool fro
 
         // As long as `poll` returns 0 we've timed out, indicating that we're still waiting for something to happen. In
         // that case, we'll loop again *unless* we're shutting down.
-        while (!(pollResult = poll(&pollStruct, 1, 1'000))) {
-            if (_shutdownState != RUNNING) {
+        while (!haveBufferedRequest && !(pollResult = poll(&pollStruct, 1, 1'000))) {
+            if (_shutdownState != RUNNING && !multiplexedInFlight) {
                 SINFO("Socket thread exiting because no data and shutting down.");
                 socket.shutdown(Socket::CLOSED);
                 break;
             }
+            abortMultiplexedCommandsPastShutdown();
         }
 
         // If the above loop didn't close the socket due to inactivity at shutdown, let's handle the activity.
-        if (socket.state != STCPManager::Socket::CLOSED) {
+        if (haveBufferedRequest) {
+            // Nothing to read, the request is already in the buffer.
+            haveBufferedRequest = false;
+        } else if (socket.state != STCPManager::Socket::CLOSED) {
             if (pollResult < 0) {
                 // This is an exceptional case, we'll just kill the socket if this happens and let the client reconnect.
                 SINFO("Poll failed: " << strerror(errno));
@@ -2330,8 +2815,14 @@ void BedrockServer::handleSocket(Socket&& socket, bool fromControlPort, bool fro
                 // Otherwise, handle any default request.
                 int requestSize = 0;
                 if (socket.recvBuffer.startsWithHTTPRequest()) {
-                    requestSize = request.deserialize(socket.recvBuffer);
-                    socket.recvBuffer.consumeFront(requestSize);
+                    // Only copy the request out of the buffer once all of it has arrived.
+                    SDataView view;
+                    requestSize = view.parse(socket.recvBuffer);
+                    if (requestSize) {
+                        request.deserialize(view);
+                        socket.recvBuffer.consumeFront(requestSize);
+                        haveBufferedRequest = SDataView().parse(socket.recvBuffer) > 0;
+                    }
                 }
 
                 // If this socket was accepted from the public command port, and that's supposed to be closed now, set
@@ -2359,6 +2850,28 @@ void BedrockServer::handleSocket(Socket&& socket, bool fromControlPort, bool fro
                         // which is being turned off, these could cause weird crashes. Instead, just return an error.
                         command->response.methodLine = "500 Server Shutting Down";
                         _reply(command);
+                    } else if (command->socket && command->request.isSet("MultiplexID")) {
+                        {
+                            lock_guard lock(multiplexedMutex);
+                            for (auto it : finishedMultiplexedCallbacks) {
+                                multiplexedCallbacks.erase(it);
+                            }
+                            finishedMultiplexedCallbacks.clear();
+
+                            multiplexedInFlight++;
+                            auto flagIt = multiplexedAbortFlags.insert(multiplexedAbortFlags.end(), &command->shouldAbort);
+                            auto callbackIt = multiplexedCallbacks.emplace(multiplexedCallbacks.end());
+                            *callbackIt = [&multiplexedMutex, &multiplexedCV, &multiplexedInFlight, &multiplexedAbortFlags,
+                                           &finishedMultiplexedCallbacks, flagIt, callbackIt]() {
+                                lock_guard lock(multiplexedMutex);
+                                multiplexedAbortFlags.erase(flagIt);
+                                finishedMultiplexedCallbacks.push_back(callbackIt);
+                                multiplexedInFlight--;
+                                multiplexedCV.notify_all();
+                            };
+                            command->destructionCallback = &*callbackIt;
+                        }
+                        _commandQueue.push(move(command));
                     } else {
                         // If it's not handled by `_handleIfStatusOrControlCommand` we fall into the queuing logic.
                         // If the command has a socket (it's this socket) then we need to wait for it to finish before
@@ -2429,8 +2942,20 @@ void BedrockServer::handleSocket(Socket&& socket, bool fromControlPort, bool fro
         }
     }
 
-    // At this point out socket is closed and we can clean up.
+    // At this point out socket is closed and we can clean up, once any multiplexed commands are done with it. There's
+    // nobody left to reply to, so we abort them rather than wait for them to run to completion.
     // Note that we never return early, we always want to hit this code and decrement our counter and clean up our socket.
+    if (multiplexedInFlight) {
+        SINFO("Socket closed with " << multiplexedInFlight << " multiplexed commands running, aborting.");
+        abortMultiplexedCommands();
+    }
+    {
+        unique_lock<mutex> lock(multiplexedMutex);
+        multiplexedCV.wait(lock, [&multiplexedInFlight]() { return !multiplexedInFlight; });
+    }
+    if (socket.data) {
+        static_cast<BedrockPlugin*>(socket.data)->onPortClose(&socket);
+    }
     _outstandingSocketThreads--;
     SINFO("[performance] Socket thread complete (" << _outstandingSocketThreads << " remaining).");
 
@@ -2449,6 +2974,225 @@ void BedrockServer::handleSocket(Socket&& socket, bool fromControlPort, bool fro
     }
 }
 
+BedrockServer::ReactorConnection::ReactorConnection(Socket&& socket_, bool fromPublicCommandPort_, bool fromPrivateCommandPort_)
+  : socket(move(socket_)), fromPublicCommandPort(fromPublicCommandPort_), fromPrivateCommandPort(fromPrivateCommandPort_),
+    commandInProgress(false), commandShouldAbortFlag(nullptr)
+{ }
+
+void BedrockServer::_addReactorConnection(Socket&& socket, bool fromPublicCommandPort, bool fromPrivateCommandPort) {
+    CommandPortReactor& reactor = *_commandPortReactors[_nextCommandPortReactor++ % _commandPortReactors.size()];
+    auto connection = make_shared<ReactorConnection>(move(socket), fromPublicCommandPort, fromPrivateCommandPort);
+
+    // This runs on whichever thread destroys the command. The connection can't be closed while its command exists, so
+    // it's safe to refer to it and its file descriptor here.
+    ReactorConnection* connectionPtr = connection.get();
+    int fd = connection->socket.s;
+    connection->commandCompleteCallback = [&reactor, connectionPtr, fd]() {
+        {
+            lock_guard<mutex> lock(connectionPtr->commandMutex);
+            connectionPtr->commandShouldAbortFlag = nullptr;
+        }
+        {
+            lock_guard<mutex> lock(reactor.pendingMutex);
+            reactor.completedConnections.push_back(fd);
+        }
+        wakeCommandPortReactor(reactor.wakeFD);
+    };
+
+    _outstandingReactorConnections++;
+    {
+        lock_guard<mutex> lock(reactor.pendingMutex);
+        reactor.newConnections.push_back(move(connection));
+    }
+    wakeCommandPortReactor(reactor.wakeFD);
+}
+
+void BedrockServer::_commandPortReactorLoop(CommandPortReactor& reactor, int threadId) {
+    SInitialize("reactor" + to_string(threadId));
+    SINFO("[performance] Command port reactor starting");
+
+    const int maxEvents = 256;
+    epoll_event events[maxEvents];
+    while (!_commandPortReactorsShouldExit) {
+        // We wake up at least once a second so that we can close idle connections when shutting down.
+        int eventCount = epoll_wait(reactor.epollFD, events, maxEvents, 1'000);
+        if (eventCount < 0) {
+            if (errno != EINTR) {
+                SWARN("epoll_wait failed: " << strerror(errno));
+            }
+            eventCount = 0;
+        }
+
+        for (int i = 0; i < eventCount; i++) {
+            int fd = events[i].data.fd;
+            if (fd == reactor.wakeFD) {
+                uint64_t wakeCount;
+                if (read(reactor.wakeFD, &wakeCount, sizeof(wakeCount)) < 0 && errno != EAGAIN) {
+                    SWARN("Failed to read command port reactor wake event: " << strerror(errno));
+                }
+                continue;
+            }
+
+            auto connectionIt = reactor.connections.find(fd);
+            if (connectionIt == reactor.connections.end()) {
+                continue;
+            }
+            shared_ptr<ReactorConnection> connection = connectionIt->second;
+            if (connection->commandInProgress) {
+                // While a command is running, we only listen for the client disconnecting. The connection isn't re-armed
+                // until the command completes.
+                SINFO("Socket disconnected with command running, aborting.");
+                lock_guard<mutex> lock(connection->commandMutex);
+                if (connection->commandShouldAbortFlag) {
+                    *connection->commandShouldAbortFlag = true;
+                }
+            } else if (!connection->socket.recv()) {
+                // If reading failed, then the socket was closed.
+                _closeReactorConnection(reactor, fd);
+            } else {
+                _dispatchReactorConnection(reactor, connection);
+            }
+        }
+
+        // Pick up anything handed to us by other threads.
+        list<shared_ptr<ReactorConnection>> newConnections;
+        list<int> completedConnections;
+        {
+            lock_guard<mutex> lock(reactor.pendingMutex);
+            newConnections.swap(reactor.newConnections);
+            completedConnections.swap(reactor.completedConnections);
+        }
+        for (auto& connection : newConnections) {
+            int fd = connection->socket.s;
+            reactor.connections.emplace(fd, connection);
+            epoll_event event{};
+            event.events = EPOLLIN | EPOLLRDHUP | EPOLLONESHOT;
+            event.data.fd = fd;
+            if (epoll_ctl(reactor.epollFD, EPOLL_CTL_ADD, fd, &event)) {
+                SWARN("Couldn't add socket to command port reactor: " << strerror(errno));
+                _closeReactorConnection(reactor, fd);
+            }
+        }
+        for (int fd : completedConnections) {
+            auto connectionIt = reactor.connections.find(fd);
+            if (connectionIt == reactor.connections.end()) {
+                SWARN("Command completed for unknown reactor connection " << fd);
+                continue;
+            }
+            shared_ptr<ReactorConnection> connection = connectionIt->second;
+            connection->commandInProgress = false;
+
+            // Handle any further requests the client has already sent us, or wait for more.
+            _dispatchReactorConnection(reactor, connection);
+        }
+
+        // When shutting down, close any idle connections, and abort commands that are past the shutdown timeout.
+        if (_shutdownState != RUNNING) {
+            auto shutdownTime = _shutdownTime.load();
+            bool pastShutdownTimeout = shutdownTime != chrono::time_point<chrono::steady_clock>{} && chrono::steady_clock::now() >= shutdownTime;
+            uint64_t now = STimeNow();
+            list<int> idleConnections;
+            for (auto& [fd, connection] : reactor.connections) {
+                if (connection->commandInProgress) {
+                    if (pastShutdownTimeout) {
+                        lock_guard<mutex> lock(connection->commandMutex);
+                        if (connection->commandShouldAbortFlag && !connection->commandShouldAbortFlag->load()) {
+                            SINFO("Aborting command past shutdown timeout limit.");
+                            *connection->commandShouldAbortFlag = true;
+                        }
+                    }
+                } else if (connection->socket.lastRecvTime + 1'000'000 < now) {
+                    idleConnections.push_back(fd);
+                }
+            }
+            for (int fd : idleConnections) {
+                SINFO("Closing idle reactor connection because shutting down.");
+                _closeReactorConnection(reactor, fd);
+            }
+        }
+    }
+
+    // Nothing should be left by the time we're told to exit, but make sure we clean up.
+    while (!reactor.connections.empty()) {
+        _closeReactorConnection(reactor, reactor.connections.begin()->first);
+    }
+    SINFO("[performance] Command port reactor complete");
+}
+
+void BedrockServer::_dispatchReactorConnection(CommandPortReactor& reactor, const shared_ptr<ReactorConnection>& connection) {
+    Socket& socket = connection->socket;
+
+    // This is the same handling as `handleSocket`, except that commands go to the worker pool, and rather than waiting
+    // for them, we return and get called again when they complete.
+    while (socket.state == STCPManager::Socket::CONNECTED && socket.recvBuffer.startsWithHTTPRequest()) {
+        SDataView view;
+        int requestSize = view.parse(socket.recvBuffer);
+        if (!requestSize) {
+            break;
+        }
+        SData request;
+        request.deserialize(view);
+        socket.recvBuffer.consumeFront(requestSize);
+
+        // If this socket was accepted from the public command port, and that's supposed to be closed now, set
+        // `Connection: close` so that we don't keep doing a bunch of activity on it.
+        if (connection->fromPublicCommandPort && _isCommandPortLikelyBlocked) {
+            request["Connection"] = "close";
+        }
+
+        unique_ptr<BedrockCommand> command = buildCommandFromRequest(move(request), socket, connection->fromPrivateCommandPort);
+        if (!command) {
+            SINFO("No command from request, closing socket.");
+            socket.shutdown(Socket::CLOSED);
+        } else if (!_handleIfStatusOrControlCommand(command)) {
+            if (!command->socket) {
+                // Fire and forget, already responded to in `buildCommandFromRequest`.
+                _commandQueue.push(move(command));
+                continue;
+            }
+
+            // We don't look at any further requests on this connection until this command is done, so that responses
+            // are delivered in order. Until then, we only wait to find out if the client disconnects.
+            connection->commandInProgress = true;
+            {
+                lock_guard<mutex> lock(connection->commandMutex);
+                connection->commandShouldAbortFlag = &command->shouldAbort;
+            }
+            command->destructionCallback = &connection->commandCompleteCallback;
+            epoll_event event{};
+            event.events = EPOLLRDHUP | EPOLLONESHOT;
+            event.data.fd = socket.s;
+            if (epoll_ctl(reactor.epollFD, EPOLL_CTL_MOD, socket.s, &event)) {
+                SWARN("Couldn't re-arm reactor connection: " << strerror(errno));
+            }
+            _commandQueue.push(move(command));
+            return;
+        }
+    }
+
+    if (socket.state == STCPManager::Socket::CONNECTED) {
+        // Wait for the next request.
+        epoll_event event{};
+        event.events = EPOLLIN | EPOLLRDHUP | EPOLLONESHOT;
+        event.data.fd = socket.s;
+        if (epoll_ctl(reactor.epollFD, EPOLL_CTL_MOD, socket.s, &event)) {
+            SWARN("Couldn't re-arm reactor connection: " << strerror(errno));
+            _closeReactorConnection(reactor, socket.s);
+        }
+    } else {
+        _closeReactorConnection(reactor, socket.s);
+    }
+}
+
+void BedrockServer::_closeReactorConnection(CommandPortReactor& reactor, int fd) {
+    epoll_ctl(reactor.epollFD, EPOLL_CTL_DEL, fd, nullptr);
+
+    // Destroying the connection closes the socket.
+    reactor.connections.erase(fd);
+    _outstandingReactorConnections--;
+    SINFO("[performance] Reactor connection closed (" << _outstandingReactorConnections << " remaining).");
+}
+
 void BedrockServer::notifyStateChangeToPlugins(SQLite& db, SQLiteNodeState newState) {
     for (auto plugin : plugins) {
         plugin.second->stateChanged(db, newState);
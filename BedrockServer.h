@@ -234,6 +234,46 @@ class BedrockServer : public SQLiteServer {
     // accepted on _controlPort, _commandPortPublic, or _commandPortPrivate.
     void handleSocket(Socket&& socket, bool fromControlPort, bool fromPublicCommandPort, bool fromPrivateCommandPort);
 
+    // State for a single connection accepted on the public or private command port when running in reactor mode
+    // (`-commandPortReactorThreads`). Instead of a dedicated socket thread, these connections are multiplexed on a
+    // small number of reactor threads, and their commands run on the worker pool. Only one command runs at a time for
+    // each connection so that responses are delivered in the order requests were received.
+    struct ReactorConnection {
+        ReactorConnection(Socket&& socket_, bool fromPublicCommandPort_, bool fromPrivateCommandPort_);
+        Socket socket;
+        const bool fromPublicCommandPort;
+        const bool fromPrivateCommandPort;
+
+        // True while a command from this connection is queued or running. Only accessed by the owning reactor thread.
+        bool commandInProgress;
+
+        // Points at the `shouldAbort` flag of the command in progress, so that the reactor thread can abort it if the
+        // client disconnects. This is cleared when the command is destroyed, and is protected by `commandMutex`.
+        atomic<bool>* commandShouldAbortFlag;
+        mutex commandMutex;
+
+        // Set as the `destructionCallback` of each command from this connection. Hands the connection back to its
+        // reactor thread.
+        function<void()> commandCompleteCallback;
+    };
+
+    // Each reactor thread owns an epoll instance and the set of connections registered with it.
+    struct CommandPortReactor {
+        int epollFD{-1};
+        int wakeFD{-1};
+
+        // All the connections owned by this reactor, by file descriptor. Only accessed by the reactor thread.
+        map<int, shared_ptr<ReactorConnection>> connections;
+
+        // Work handed to the reactor thread by other threads: newly accepted connections, and the file descriptors
+        // of connections whose commands have completed. Writing to `wakeFD` interrupts `epoll_wait`.
+        mutex pendingMutex;
+        list<shared_ptr<ReactorConnection>> newConnections;
+        list<int> completedConnections;
+
+        thread reactorThread;
+    };
+
     // This will run a command. It provides no feedback on whether or not the command it's running has finished. In the typical case, the command will be complete when this returns, but
     // that is not guaranteed. Because of the various retries and escalation paths that a command can go through, this function mat return having just queued this command to run somewhere
     // else. In the future, when all command queues are removed, this will not be the case, but right now, you can not rely on the command having completed when this returns.
@@ -246,11 +286,18 @@ class BedrockServer : public SQLiteServer {
     // The name of the sync thread.
     static constexpr auto _syncThreadName = "sync";
 
+    // The most multiplexed commands one connection can have in flight. Past this, we stop reading its requests until
+    // some of them finish.
+    static constexpr size_t MAX_MULTIPLEXED_IN_FLIGHT = 1'000;
+
     // Commands that aren't currently being processed are kept here.
     BedrockCommandQueue _commandQueue;
 
     BedrockConflictManager _conflictManager;
 
+    // Latency histograms of finished commands, by command name and stage.
+    BedrockMetrics _metrics;
+
     // These are commands that will be processed in a blacking fashion.
     BedrockBlockingCommandQueue _blockingCommandQueue;
 
@@ -322,6 +369,7 @@ class BedrockServer : public SQLiteServer {
     static constexpr auto STATUS_STATUS            = "Status";
     static constexpr auto STATUS_BLACKLIST         = "SetParallelCommandBlacklist";
     static constexpr auto STATUS_MULTIWRITE        = "EnableMultiWrite";
+    static constexpr auto STATUS_METRICS           = "GET /metrics HTTP/1.1";
 
     // This makes the sync node available to worker threads, so that they can write to it's sockets, and query it for
     // data (such as in the Status command). Because this is a shared pointer, the underlying object can't be deleted
@@ -341,6 +389,27 @@ class BedrockServer : public SQLiteServer {
     bool _isNonSecureControlCommand(const unique_ptr<BedrockCommand>& command);
     void _control(unique_ptr<BedrockCommand>& command);
 
+    // Runs an online backup of the database into `directory`: a full copy if `fromCommit` is 0, and otherwise only the
+    // commits since then. Each step copies `pagesPerStep` pages (or about that many pages' worth of commits), then
+    // waits `stepDelayUS`, so that the backup's I/O doesn't slow down commands.
+    void _runOnlineBackup(const string& directory, uint64_t fromCommit, int pagesPerStep, uint64_t stepDelayUS);
+
+    // Stops any online backup and waits for it to finish.
+    void _stopOnlineBackup();
+
+    // Hands a newly accepted command port socket to one of the reactor threads.
+    void _addReactorConnection(Socket&& socket, bool fromPublicCommandPort, bool fromPrivateCommandPort);
+
+    // Main loop for a command port reactor thread.
+    void _commandPortReactorLoop(CommandPortReactor& reactor, int threadId);
+
+    // Deserializes and queues the next request buffered on a reactor connection, handling status and control commands
+    // inline. Re-arms or closes the connection as appropriate.
+    void _dispatchReactorConnection(CommandPortReactor& reactor, const shared_ptr<ReactorConnection>& connection);
+
+    // Removes a connection from its reactor and closes its socket.
+    void _closeReactorConnection(CommandPortReactor& reactor, int fd);
+
     // Accepts any sockets pending on our listening ports. We do this both after `poll()`, and before shutting down
     // those ports.
     void _acceptSockets();
@@ -379,6 +448,14 @@ class BedrockServer : public SQLiteServer {
     bool _shouldBackup;
     atomic<bool> _detach;
 
+    // The online backup started by `BeginOnlineBackup`, which runs while the server keeps serving, and the commit count
+    // of the last one to finish, which the next incremental backup continues from.
+    mutex _onlineBackupMutex;
+    thread _onlineBackupThread;
+    atomic<bool> _onlineBackupRunning = false;
+    atomic<bool> _onlineBackupShouldStop = false;
+    atomic<uint64_t> _lastOnlineBackupCommit = 0;
+
     // Pointers to the ports on which we accept commands.
     mutex _portMutex;
 
@@ -432,6 +509,25 @@ class BedrockServer : public SQLiteServer {
     // Timestamp for the last time we promoted a command to QUORUM.
     atomic<uint64_t> _lastQuorumCommandTime;
 
+    // The most QUORUM commands the sync thread will commit together in a single replicated transaction. 1 commits each
+    // one on its own.
+    size_t _quorumGroupCommitSize;
+
+    // Called by the sync thread once a QUORUM command has been processed and is ready to commit. Processes further
+    // QUORUM commands from the front of `_syncNodeQueuedCommands` into the same transaction, each in its own savepoint
+    // so that a failure only undoes that command's work. Commands are added to `group` to be replied to once it's been
+    // committed, whether or not they need a commit themselves, as they may have read what the group wrote. Returns false
+    // if the transaction was lost entirely, in which case the commands in `group` need to be processed again.
+    bool _addQueuedCommandsToQuorumGroup(BedrockCore& core, SQLite& db, list<unique_ptr<BedrockCommand>>& group);
+
+    // Puts `command` and the commands grouped into its commit back at the front of `_syncNodeQueuedCommands`, in the
+    // order they were originally queued, to be processed again.
+    void _requeueQuorumGroup(unique_ptr<BedrockCommand>& command, list<unique_ptr<BedrockCommand>>& group);
+
+    // A grouped command that finished without needing a commit answered from the group's uncommitted writes. If those
+    // are thrown away, so is its response, and it runs again from scratch.
+    static void _resetGroupedCommand(unique_ptr<BedrockCommand>& command);
+
     // Whether or not all plugins are detached
     bool _pluginsDetached;
 
@@ -477,5 +573,14 @@ class BedrockServer : public SQLiteServer {
     SSynchronizedQueue<bool> _notifyDoneSync;
 
     atomic<size_t> _maxSocketThreads{3'000};
+
+    // Reactor threads handling command port connections, if `-commandPortReactorThreads` is set. If this is empty,
+    // every connection gets its own socket thread.
+    vector<unique_ptr<CommandPortReactor>> _commandPortReactors;
+    atomic<size_t> _nextCommandPortReactor{0};
+    atomic<bool> _commandPortReactorsShouldExit{false};
+
+    // Like `_outstandingSocketThreads` but for connections being handled by reactor threads.
+    atomic<uint64_t> _outstandingReactorConnections{0};
     atomic<size_t> _dbPoolSize{25'000};
 };
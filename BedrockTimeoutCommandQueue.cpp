@@ -31,6 +31,14 @@ void BedrockTimeoutCommandQueue::push(unique_ptr<BedrockCommand>&& rhs) {
     SASSERT(write(_pipeFD[1], "A", 1));
 }
 
+void BedrockTimeoutCommandQueue::pushFront(unique_ptr<BedrockCommand>&& rhs) {
+    lock_guard<decltype(_queueMutex)> lock(_queueMutex);
+    _queue.push_front(move(rhs));
+    _queue.front()->startTiming(BedrockCommand::QUEUE_SYNC);
+    _timeoutMap.insert(make_pair(_queue.front()->timeout(), _queue.begin()));
+    SASSERT(write(_pipeFD[1], "A", 1));
+}
+
 unique_ptr<BedrockCommand> BedrockTimeoutCommandQueue::pop() {
     lock_guard<decltype(_queueMutex)> lock(_queueMutex);
     if (_queue.empty()) {
@@ -11,6 +11,9 @@ class BedrockTimeoutCommandQueue : public SSynchronizedQueue<unique_ptr<BedrockC
     // Override the base class to account for timeouts.
     const unique_ptr<BedrockCommand>& front() const;
     void push(unique_ptr<BedrockCommand>&& rhs);
+
+    // Push a command back onto the front of the queue, ahead of everything else, such as after a failed commit.
+    void pushFront(unique_ptr<BedrockCommand>&& rhs);
     unique_ptr<BedrockCommand> pop();
 
   private:
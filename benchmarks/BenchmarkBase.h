@@ -61,18 +61,20 @@ protected:
      * @param inputs Test data to run the function on
      * @param iterations How many times to run each input
      * @param func The function to benchmark (takes input, returns anything)
+     * @param warmupIterations How many times to run each input before timing (lower this for slow functions)
      * @return Elapsed time in microseconds
      */
     template<typename InputType, typename Func>
     uint64_t runBench(const string& name,
                       const vector<InputType>& inputs,
                       int iterations, 
-                      Func func) {
+                      Func func,
+                      int warmupIterations = 100) {
         setup();
 
         // Warm-up: run a few times to get CPU caches ready
         volatile size_t guard = 0;
-        for (int i = 0; i < 100; i++) {
+        for (int i = 0; i < warmupIterations; i++) {
             for (const auto& input : inputs) {
                 auto result = func(input);
                 guard += sizeof(result); // Use the result somehow
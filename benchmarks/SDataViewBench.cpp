@@ -0,0 +1,68 @@
+#include <libstuff/SData.h>
+#include <libstuff/SDataView.h>
+#include "BenchmarkBase.h"
+
+using namespace std;
+
+// Compares parsing requests straight into an SData with parsing them as an SDataView first, both for requests that
+// have fully arrived and for ones still missing their last byte, which is what a socket thread sees over and over while
+// a large body arrives.
+struct SDataViewBench : tpunit::TestFixture, BenchmarkBase {
+    SDataViewBench() : tpunit::TestFixture(
+        "SDataViewBench",
+        BEFORE_CLASS(SDataViewBench::setupClass),
+        TEST(SDataViewBench::benchComplete),
+        TEST(SDataViewBench::benchIncomplete)
+    ), BenchmarkBase("SDataViewBench") {}
+
+    static const int ITERATIONS = 2000;
+
+    vector<string> messages;
+    vector<string> incompleteMessages;
+
+    void setupClass() {
+        string small = "Query\r\nquery: SELECT 1;\r\nformat: json\r\nrequestID: ABCDEF\r\n\r\n";
+
+        string manyHeaders = "UpdateAccount\r\n";
+        for (int i = 0; i < 50; i++) {
+            manyHeaders += "header" + to_string(i) + ": {\"value\":" + to_string(i) + "}\r\n";
+        }
+        manyHeaders += "Content-Length: 0\r\n\r\n";
+
+        string body(1'000'000, 'x');
+        string large = "Upload\r\nrequestID: ABCDEF\r\nContent-Length: " + to_string(body.size()) + "\r\n\r\n" + body;
+
+        messages = {small, manyHeaders, large};
+        incompleteMessages = {large.substr(0, large.size() - 1)};
+    }
+
+    void runAll(const string& name, const vector<string>& inputs) {
+        auto us = runBench(name + "Deserialize", inputs, ITERATIONS, [](const string& message) {
+            SData request;
+            return request.deserialize(message.c_str(), message.size());
+        });
+        ASSERT_GREATER_THAN(us, 0);
+        us = runBench(name + "View", inputs, ITERATIONS, [](const string& message) {
+            SDataView view;
+            return view.parse(message.c_str(), message.size());
+        });
+        ASSERT_GREATER_THAN(us, 0);
+        us = runBench(name + "ViewDeserialize", inputs, ITERATIONS, [](const string& message) {
+            SDataView view;
+            SData request;
+            if (view.parse(message.c_str(), message.size())) {
+                request.deserialize(view);
+            }
+            return request.nameValueMap.size();
+        });
+        ASSERT_GREATER_THAN(us, 0);
+    }
+
+    void benchComplete() {
+        runAll("Complete", messages);
+    }
+
+    void benchIncomplete() {
+        runAll("Incomplete", incompleteMessages);
+    }
+} __SDataViewBench;
@@ -0,0 +1,85 @@
+#include "BenchmarkBase.h"
+
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+// Measures what a single `SINFO` costs the thread calling it with each of the syslog functions `SSyslogFunc` can
+// point to. For `SSyslogAsync`, this is only the time to hand the line off; sending it happens on another thread.
+struct SLogBench : tpunit::TestFixture, BenchmarkBase {
+    SLogBench() : tpunit::TestFixture(
+        "SLogBench",
+        BEFORE_CLASS(SLogBench::setupClass),
+        AFTER_CLASS(SLogBench::teardownClass),
+        TEST(SLogBench::benchSyslog),
+        TEST(SLogBench::benchSocketDirect),
+        TEST(SLogBench::benchAsync)
+    ), BenchmarkBase("SLogBench") {}
+
+    const vector<string> lines = {
+        "Short line",
+        "A typical line about a command, requestID: ABCDEF, with a few details about what happened to it",
+        string(1000, 'x'),
+    };
+
+    static const int ITERATIONS = 2000;
+    static const int LINES_PER_THREAD = 2000;
+
+    void setupClass() {
+        SLogLevel(LOG_INFO);
+    }
+
+    void teardownClass() {
+        SSyslogFunc = &syslog;
+    }
+
+    // Logs from `threadCount` threads at once, to see how much they slow each other down.
+    size_t logFromThreads(int threadCount) {
+        vector<thread> threads;
+        for (int t = 0; t < threadCount; t++) {
+            threads.emplace_back([this]() {
+                for (int i = 0; i < LINES_PER_THREAD; i++) {
+                    SINFO(lines[1]);
+                }
+            });
+        }
+        for (auto& t : threads) {
+            t.join();
+        }
+        return threads.size();
+    }
+
+    void runAll(const string& name) {
+        auto us = runBench(name, lines, ITERATIONS, [](const string& line) {
+            SINFO(line);
+            return line.size();
+        });
+        ASSERT_GREATER_THAN(us, 0);
+        for (int threads : {1, 8, 32}) {
+            us = runBench(name + to_string(threads) + "Threads", vector<int>{threads}, 1, [this](int threadCount) {
+                return logFromThreads(threadCount);
+            });
+            ASSERT_GREATER_THAN(us, 0);
+        }
+    }
+
+    void benchSyslog() {
+        SSyslogFunc = &syslog;
+        runAll("Syslog");
+    }
+
+    void benchSocketDirect() {
+        SSyslogFunc = &SSyslogSocketDirect;
+        runAll("SocketDirect");
+    }
+
+    void benchAsync() {
+        SLogAsyncStart();
+        SSyslogFunc = &SSyslogAsync;
+        runAll("Async");
+        SSyslogFunc = &syslog;
+        SLogAsyncStop();
+        cout << "[SLogBench] Async dropped " << SLogAsyncDropped << " lines" << endl;
+    }
+} __SLogBench;
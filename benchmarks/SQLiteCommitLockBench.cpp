@@ -0,0 +1,98 @@
+#include <cstring>
+#include <thread>
+#include <unistd.h>
+
+#include <sqlitecluster/SQLite.h>
+#include "BenchmarkBase.h"
+
+using namespace std;
+
+// How long a commit holds the commit lock, which every other commit on the node waits on, as its query grows: alone,
+// where its hash is always worked out before taking the lock, and with another handle committing small transactions
+// as fast as it can, where that hash is sometimes stale by the time it gets the lock. Also the raw speed of SHA1, which
+// is what makes large commits slow.
+struct SQLiteCommitLockBench : tpunit::TestFixture, BenchmarkBase {
+    SQLiteCommitLockBench() : tpunit::TestFixture(
+        "SQLiteCommitLockBench",
+        BEFORE_CLASS(SQLiteCommitLockBench::setupClass),
+        AFTER_CLASS(SQLiteCommitLockBench::teardownClass),
+        TEST(SQLiteCommitLockBench::benchSHA1),
+        TEST(SQLiteCommitLockBench::benchCommit),
+        TEST(SQLiteCommitLockBench::benchCommitContended)
+    ), BenchmarkBase("SQLiteCommitLockBench") {}
+
+    string filename;
+    SQLite* db = nullptr;
+
+    void setupClass() {
+        char filenameTemplate[] = "br_commit_lock_benchXXXXXX";
+        close(mkstemp(filenameTemplate));
+        filename = filenameTemplate;
+        db = new SQLite(filename, 100'000, 100, 1);
+        SQuery(db->getDBHandle(), "benchmark", "PRAGMA synchronous = OFF;");
+        commit(*db, "CREATE TABLE test (id INTEGER PRIMARY KEY, value TEXT);");
+        commit(*db, "CREATE TABLE other (id INTEGER PRIMARY KEY, value TEXT);");
+    }
+
+    void teardownClass() {
+        delete db;
+        for (const char* suffix : {"", "-wal", "-shm", "-wal2"}) {
+            unlink((filename + suffix).c_str());
+        }
+    }
+
+    static bool commit(SQLite& db, const string& query) {
+        db.beginTransaction();
+        db.write(query);
+        db.prepare();
+        if (db.commit() != SQLITE_OK) {
+            // Conflicted with the other writer.
+            db.rollback();
+            return false;
+        }
+        return true;
+    }
+
+    // Commits queries of each size, and reports the average time each held the commit lock.
+    void runCommits(const string& name) {
+        for (size_t size : {1'000, 100'000, 1'000'000}) {
+            const string query = "INSERT INTO test VALUES (NULL, " + SQ(string(size, 'a')) + ");";
+            const int iterations = size < 1'000'000 ? 200 : 50;
+            uint64_t lockTime = 0;
+            int commits = 0;
+            auto us = runBench(name + SToStr(size / 1000) + "KB", vector<string>{query}, iterations, [&](const string& input) {
+                bool committed = commit(*db, input);
+                lockTime += db->getLastCommitLockTime();
+                commits++;
+                return committed;
+            }, 5);
+            ASSERT_GREATER_THAN(us, 0);
+            cout << "[SQLiteCommitLockBench] " << name << SToStr(size / 1000) << "KB: lock_us_per_commit=" << (lockTime / commits) << endl;
+        }
+    }
+
+    void benchSHA1() {
+        const vector<string> inputs = {string(1'000, 'a'), string(100'000, 'a'), string(1'000'000, 'a')};
+        auto us = runBench("SHA1", inputs, 200, [](const string& buffer) {
+            return SHashSHA1(buffer);
+        }, 10);
+        ASSERT_GREATER_THAN(us, 0);
+    }
+
+    void benchCommit() {
+        runCommits("Commit");
+    }
+
+    void benchCommitContended() {
+        atomic<bool> done = false;
+        thread writer([&]() {
+            SQLite writerDB(*db);
+            while (!done) {
+                commit(writerDB, "INSERT INTO other VALUES (NULL, 'small');");
+            }
+        });
+        runCommits("CommitContended");
+        done = true;
+        writer.join();
+    }
+} __SQLiteCommitLockBench;
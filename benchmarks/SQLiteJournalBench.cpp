@@ -0,0 +1,96 @@
+#include <cstring>
+#include <unistd.h>
+
+#include <libstuff/SQResult.h>
+#include <libstuff/SRandom.h>
+#include <sqlitecluster/SQLite.h>
+#include "BenchmarkBase.h"
+
+using namespace std;
+
+// Compares the usual journal, which deletes old commits from a table on every commit, with a ring journal, which
+// replaces them in place: the cost of a commit once the journal is full, of looking up single commits, and of reading
+// ranges of them as synchronizing peers do.
+struct SQLiteJournalBench : tpunit::TestFixture, BenchmarkBase {
+    SQLiteJournalBench() : tpunit::TestFixture(
+        "SQLiteJournalBench",
+        BEFORE_CLASS(SQLiteJournalBench::setupClass),
+        AFTER_CLASS(SQLiteJournalBench::teardownClass),
+        TEST(SQLiteJournalBench::benchCommit),
+        TEST(SQLiteJournalBench::benchGetCommit),
+        TEST(SQLiteJournalBench::benchGetCommits)
+    ), BenchmarkBase("SQLiteJournalBench") {}
+
+    static const int MAX_JOURNAL_SIZE = 10'000;
+    static const int JOURNAL_TABLES = 8;
+
+    vector<string> filenames;
+    vector<SQLite*> dbs;
+
+    void setupClass() {
+        for (bool ringJournal : {false, true}) {
+            char filename[] = "br_journal_benchXXXXXX";
+            close(mkstemp(filename));
+            filenames.push_back(filename);
+            dbs.push_back(new SQLite(filename, 100'000, MAX_JOURNAL_SIZE, JOURNAL_TABLES - 2, 0, false, "PASSIVE", ringJournal));
+            SQuery(dbs.back()->getDBHandle(), "benchmark", "PRAGMA synchronous = OFF;");
+
+            // Read commits from the journal, not the commit cache.
+            dbs.back()->setCommitCacheSize(0);
+
+            // Fill the journal twice over, so that every commit from here on has to make room.
+            commit(*dbs.back(), "CREATE TABLE test (id INTEGER PRIMARY KEY, value TEXT);");
+            for (int i = 0; i < MAX_JOURNAL_SIZE * 2; i++) {
+                commit(*dbs.back(), "INSERT INTO test VALUES (NULL, " + SQ(string(100, 'a')) + ");");
+            }
+        }
+    }
+
+    void teardownClass() {
+        for (size_t i = 0; i < dbs.size(); i++) {
+            delete dbs[i];
+            for (const char* suffix : {"", "-wal", "-shm", "-wal2"}) {
+                unlink((filenames[i] + suffix).c_str());
+            }
+        }
+    }
+
+    static bool commit(SQLite& db, const string& query) {
+        db.beginTransaction(SQLite::TRANSACTION_TYPE::EXCLUSIVE);
+        db.write(query);
+        db.prepare();
+        return db.commit() == SQLITE_OK;
+    }
+
+    void runBoth(const string& name, int iterations, const function<size_t(SQLite&)>& func) {
+        const vector<string> names = {"Classic", "Ring"};
+        for (size_t i = 0; i < dbs.size(); i++) {
+            auto us = runBench(name + names[i], vector<int>{0}, iterations, [&](int) {
+                return func(*dbs[i]);
+            }, 10);
+            ASSERT_GREATER_THAN(us, 0);
+        }
+    }
+
+    void benchCommit() {
+        runBoth("Commit", 5000, [](SQLite& db) {
+            return (size_t)commit(db, "INSERT INTO test VALUES (NULL, " + SQ(string(100, 'a')) + ");");
+        });
+    }
+
+    void benchGetCommit() {
+        runBoth("GetCommit", 20000, [](SQLite& db) {
+            string query, hash;
+            db.getCommit(db.getCommitCount() - SRandom::rand64() % (MAX_JOURNAL_SIZE / 2), query, hash);
+            return hash.size();
+        });
+    }
+
+    void benchGetCommits() {
+        runBoth("GetCommits", 200, [](SQLite& db) {
+            SQResult result;
+            db.getCommits(db.getCommitCount() - 999, db.getCommitCount(), result);
+            return result.size();
+        });
+    }
+} __SQLiteJournalBench;
@@ -0,0 +1,64 @@
+#include <libstuff/SQColumnarResult.h>
+#include <libstuff/SQResult.h>
+#include <libstuff/SQResultFormatter.h>
+#include <libstuff/sqlite3.h>
+#include "BenchmarkBase.h"
+
+using namespace std;
+
+// Compares filling (and formatting) a million-row result as an SQResult and as an SQColumnarResult.
+struct SQResultBench : tpunit::TestFixture, BenchmarkBase {
+    SQResultBench() : tpunit::TestFixture(
+        "SQResultBench",
+        BEFORE_CLASS(SQResultBench::setupClass),
+        AFTER_CLASS(SQResultBench::teardownClass),
+        TEST(SQResultBench::benchFill),
+        TEST(SQResultBench::benchFillJSON)
+    ), BenchmarkBase("SQResultBench") {}
+
+    static const int ROW_COUNT = 1'000'000;
+    const string query = "SELECT id, name, amount, created FROM rows;";
+
+    sqlite3* db = nullptr;
+
+    void setupClass() {
+        sqlite3_open(":memory:", &db);
+        SQuery(db, "creating rows", "CREATE TABLE rows (id INTEGER PRIMARY KEY, name TEXT, amount REAL, created TEXT);");
+        SQuery(db, "creating rows", "WITH RECURSIVE n(i) AS (SELECT 1 UNION ALL SELECT i + 1 FROM n WHERE i < " + to_string(ROW_COUNT) + ") "
+                                    "INSERT INTO rows SELECT i, 'name' || i, i / 7.0, '2024-01-01 00:00:00' FROM n;");
+    }
+
+    void teardownClass() {
+        sqlite3_close(db);
+    }
+
+    void benchFill() {
+        auto us = runBench("SQResult", vector<int>{ROW_COUNT}, 1, [this](int) {
+            SQResult result;
+            SQuery(db, "benchmark", query, result);
+            return result.size();
+        }, 1);
+        ASSERT_GREATER_THAN(us, 0);
+        us = runBench("SQColumnarResult", vector<int>{ROW_COUNT}, 1, [this](int) {
+            SQColumnarResult result;
+            SQuery(db, "benchmark", query, {}, result);
+            return result.size();
+        }, 1);
+        ASSERT_GREATER_THAN(us, 0);
+    }
+
+    void benchFillJSON() {
+        auto us = runBench("SQResultJSON", vector<int>{ROW_COUNT}, 1, [this](int) {
+            SQResult result;
+            SQuery(db, "benchmark", query, result);
+            return SQResultFormatter::format(result, SQResultFormatter::FORMAT::JSON).size();
+        }, 1);
+        ASSERT_GREATER_THAN(us, 0);
+        us = runBench("SQColumnarResultJSON", vector<int>{ROW_COUNT}, 1, [this](int) {
+            SQColumnarResult result;
+            SQuery(db, "benchmark", query, {}, result);
+            return SQResultFormatter::format(result, SQResultFormatter::FORMAT::JSON).size();
+        }, 1);
+        ASSERT_GREATER_THAN(us, 0);
+    }
+} __SQResultBench;
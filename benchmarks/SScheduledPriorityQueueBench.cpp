@@ -0,0 +1,51 @@
+#include <libstuff/SScheduledPriorityQueue.h>
+#include "BenchmarkBase.h"
+
+#include <memory>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+struct SScheduledPriorityQueueBench : tpunit::TestFixture, BenchmarkBase {
+    SScheduledPriorityQueueBench() : tpunit::TestFixture(
+        "SScheduledPriorityQueue",
+        TEST(SScheduledPriorityQueueBench::benchPushGet)
+    ), BenchmarkBase("SScheduledPriorityQueue") {}
+
+    // Total items pushed and popped per run, split across however many threads we're testing with.
+    static const int ITEMS_PER_RUN = 20000;
+
+    // The priorities BedrockCommand uses.
+    const vector<int> priorities = {0, 250, 500, 750, 1000};
+
+    // Each thread pushes its share of items across all the priorities and then gets the same number back out, like
+    // a worker thread that queues its own follow-up work.
+    size_t pushGet(int threadCount) {
+        SScheduledPriorityQueue<unique_ptr<int>> queue;
+        const int itemsPerThread = ITEMS_PER_RUN / threadCount;
+        vector<thread> threads;
+        for (int t = 0; t < threadCount; t++) {
+            threads.emplace_back([&, t]() {
+                for (int i = 0; i < itemsPerThread; i++) {
+                    queue.push(make_unique<int>(i), priorities[(t + i) % priorities.size()], 0, numeric_limits<uint64_t>::max() - 1);
+                    queue.get(1'000'000);
+                }
+            });
+        }
+        for (auto& t : threads) {
+            t.join();
+        }
+        return queue.size();
+    }
+
+    void benchPushGet()
+    {
+        for (int threads : {1, 2, 4, 8, 16, 32, 64}) {
+            auto us = runBench("PushGet" + to_string(threads) + "Threads", vector<int>{threads}, 5, [this](int threadCount) {
+                return pushGet(threadCount);
+            });
+            ASSERT_GREATER_THAN(us, 0);
+        }
+    }
+} __SScheduledPriorityQueueBench;
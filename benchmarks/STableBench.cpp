@@ -0,0 +1,87 @@
+#include <libstuff/SData.h>
+#include "BenchmarkBase.h"
+
+using namespace std;
+
+// Measures parsing and serializing requests with typical numbers of headers, which is mostly building and walking
+// their STables, and compares looking up headers in an STable with the `map<string, SString, STableComp>` it replaced.
+// Run with `--baseline` against a commit from before STable was replaced to compare parsing and serializing.
+struct STableBench : tpunit::TestFixture, BenchmarkBase {
+    STableBench() : tpunit::TestFixture(
+        "STableBench",
+        BEFORE_CLASS(STableBench::setupClass),
+        TEST(STableBench::benchParse),
+        TEST(STableBench::benchSerialize),
+        TEST(STableBench::benchLookup)
+    ), BenchmarkBase("STableBench") {}
+
+    static const int ITERATIONS = 20000;
+
+    vector<string> messages;
+    vector<SData> requests;
+    vector<size_t> indexes;
+
+    void setupClass() {
+        const vector<string> names = {"requestID", "Content-Length", "authToken", "accountID", "email", "format",
+                                      "query", "Connection", "lastIP", "Host", "User-Agent", "priority", "timeout",
+                                      "writeConsistency", "idempotent", "jobs", "jobID", "name", "data", "nextRun",
+                                      "repeat", "parentJobID", "retryAfter", "mockRequest", "debugLevel", "value",
+                                      "peekID", "policyID", "reportID", "transactionID"};
+        for (size_t headerCount : {5, 15, 30}) {
+            SData request("Query");
+            for (size_t i = 0; i < headerCount; i++) {
+                request[names[i]] = "value of " + names[i];
+            }
+            request.content = "{}";
+            messages.push_back(request.serialize());
+            requests.push_back(request);
+            indexes.push_back(indexes.size());
+        }
+    }
+
+    void benchParse() {
+        auto us = runBench("Parse", messages, ITERATIONS, [](const string& message) {
+            SData request;
+            return request.deserialize(message);
+        });
+        ASSERT_GREATER_THAN(us, 0);
+    }
+
+    void benchSerialize() {
+        auto us = runBench("Serialize", indexes, ITERATIONS, [this](size_t i) {
+            return requests[i].serialize().size();
+        });
+        ASSERT_GREATER_THAN(us, 0);
+    }
+
+    void benchLookup() {
+        // Each request's headers, looked up by name in a different case than they were set in.
+        vector<STable> tables;
+        vector<map<string, SString, STableComp>> maps;
+        vector<vector<string>> lookups;
+        for (const SData& request : requests) {
+            tables.push_back(request.nameValueMap);
+            maps.emplace_back(request.nameValueMap.begin(), request.nameValueMap.end());
+            lookups.emplace_back();
+            for (const auto& [name, value] : request.nameValueMap) {
+                lookups.back().push_back(SToLower(name));
+            }
+        }
+        auto us = runBench("LookupSTable", indexes, ITERATIONS, [&](size_t i) {
+            size_t found = 0;
+            for (const string& name : lookups[i]) {
+                found += tables[i].find(name) != tables[i].end();
+            }
+            return found;
+        });
+        ASSERT_GREATER_THAN(us, 0);
+        us = runBench("LookupMap", indexes, ITERATIONS, [&](size_t i) {
+            size_t found = 0;
+            for (const string& name : lookups[i]) {
+                found += maps[i].find(name) != maps[i].end();
+            }
+            return found;
+        });
+        ASSERT_GREATER_THAN(us, 0);
+    }
+} __STableBench;
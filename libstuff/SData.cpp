@@ -1,5 +1,6 @@
 #include "SData.h"
 
+#include <libstuff/SDataView.h>
 #include <libstuff/SFastBuffer.h>
 
 const string SData::placeholder;
@@ -106,21 +107,47 @@ int SData::deserialize(const string& fromString) {
     return deserialize(fromString.c_str(), fromString.size());
 }
 
-int SData::deserialize(const char* buffer, size_t length) {
-    auto result = SParseHTTP(buffer, length, methodLine, nameValueMap, content);
-
-    // Why do this? It's to enable these values to be parsed quickly with simdjson, which requires up to 32 bytes of
-    // space at the end of the string so that it can run on chunks bigger than a single character, while guaranteeing
-    // not to go out-of-bounds on memory.
+// Why do this? It's to enable these values to be parsed quickly with simdjson, which requires up to 32 bytes of
+// space at the end of the string so that it can run on chunks bigger than a single character, while guaranteeing
+// not to go out-of-bounds on memory.
+static void reserveForSimdjson(STable& nameValueMap) {
     for (auto& p: nameValueMap) {
         if (p.second[0] == '{' || p.second[0] == '[') {
             p.second.reserve(p.second.size() + 32);
         }
     }
+}
 
+int SData::deserialize(const char* buffer, size_t length) {
+    auto result = SParseHTTP(buffer, length, methodLine, nameValueMap, content);
+    reserveForSimdjson(nameValueMap);
     return result;
 }
 
+int SData::deserialize(const SDataView& view) {
+    if (view._copied) {
+        *this = view._copy;
+    } else {
+        clear();
+        methodLine = view.methodLine();
+        for (const SDataView::Header& header : view.headers()) {
+            // As in SParseHTTP, later values replace earlier ones, except for Set-Cookie, which are all kept, separated
+            // by 0xFF (see SComposeHTTP).
+            string name(header.name);
+            auto it = nameValueMap.find(name);
+            if (it == nameValueMap.end() || !SIEquals(name, "Set-Cookie")) {
+                nameValueMap[name] = SDataView::unescape(header.value);
+            } else {
+                it->second += '\xFF';
+                it->second += header.value;
+            }
+        }
+        content = view.content();
+    }
+    reserveForSimdjson(nameValueMap);
+    return view.size();
+}
+
 SData SData::create(const string& fromString) {
     SData data;
     int header = data.deserialize(fromString);
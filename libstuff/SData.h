@@ -5,6 +5,8 @@
 
 using namespace std;
 
+class SDataView;
+
 // --------------------------------------------------------------------------
 // A very simple HTTP-like structure consisting of a method line, a table,
 // and a content body.
@@ -108,6 +110,9 @@ struct SData {
     // Deserializes from an SFastBuffer.
     int deserialize(const SFastBuffer& buf);
 
+    // Deserializes from a parsed view, copying out what it points to.
+    int deserialize(const SDataView& view);
+
     // Initializes a new SData from a string. If there is no content provided,
     // then use whatever data remains in the string as the content
     // **DEPRECATED** Use the constructor that handles this instead.
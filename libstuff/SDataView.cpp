@@ -0,0 +1,174 @@
+#include "SDataView.h"
+
+#include <cstring>
+#include <libstuff/libstuff.h>
+#include <libstuff/SFastBuffer.h>
+
+// Returns [start, end) without leading or trailing spaces, as SParseHTTP trims names and values.
+static string_view trimSpaces(const char* start, const char* end) {
+    while (start < end && *start == ' ') {
+        ++start;
+    }
+    while (end > start && *(end - 1) == ' ') {
+        --end;
+    }
+    return string_view(start, end - start);
+}
+
+size_t SDataView::parse(const SFastBuffer& buffer) {
+    return parse(buffer.c_str(), buffer.size());
+}
+
+size_t SDataView::parse(const char* buffer, size_t length) {
+    _size = 0;
+    _methodLine = {};
+    _headers.clear();
+    _content = {};
+    _copied = false;
+    _copy.clear();
+
+    // This follows SParseHTTP line by line, but records where things are rather than copying them.
+    const char* lineStart = buffer;
+    const char* inputEnd = buffer + length;
+    while (lineStart < inputEnd) {
+        // Find the end of the line
+        const char* lineEnd = lineStart;
+        while (lineEnd < inputEnd && *lineEnd != '\r' && *lineEnd != '\n') {
+            ++lineEnd;
+        }
+        if (lineEnd >= inputEnd) {
+            // Couldn't find end of line; couldn't complete parsing.
+            break;
+        }
+
+        if (lineEnd == lineStart) {
+            // Blank line -- if we have at least the method, then the headers are done. Otherwise, ignore.
+            if (!_methodLine.empty()) {
+                // Consume up to 2 EOL characters to find the start of the content.
+                const char* contentStart = lineEnd;
+                int numEOLs = 2;
+                while (contentStart < inputEnd && (*contentStart == '\r' || *contentStart == '\n') && numEOLs--) {
+                    ++contentStart;
+                }
+
+                // A chunked body is spread across the buffer between chunk sizes, so can't be viewed in place.
+                if (isSet("Transfer-Encoding") && SIEquals(unescape((*this)["Transfer-Encoding"]), "chunked")) {
+                    return _parseCopy(buffer, length);
+                }
+
+                // Without a Content-Length, the content is everything that's left.
+                if (!isSet("Content-Length")) {
+                    _content = string_view(contentStart, inputEnd - contentStart);
+                    _size = length;
+                    return _size;
+                }
+
+                // Otherwise, it's that much, if we have it all.
+                const int headerLength = contentStart - buffer;
+                const int contentLength = stoll(unescape((*this)["Content-Length"]));
+                if (contentLength < 0) {
+                    // Let SParseHTTP decide what to do with this.
+                    return _parseCopy(buffer, length);
+                }
+                if ((int)(length - headerLength) < contentLength) {
+                    break;
+                }
+                _content = string_view(contentStart, contentLength);
+                _size = headerLength + contentLength;
+                return _size;
+            }
+        } else if (_methodLine.empty()) {
+            // Everything in the line is the method
+            _methodLine = trimSpaces(lineStart, lineEnd);
+        } else if (isspace((unsigned char)*lineStart)) {
+            // This continues the last line, and the two can only be joined in a copy.
+            return _parseCopy(buffer, length);
+        } else {
+            // A name/value pair. The name is everything up to the ':', and the value everything after it.
+            const char* colon = static_cast<const char*>(memchr(lineStart, ':', lineEnd - lineStart));
+            string_view name = trimSpaces(lineStart, colon ? colon : lineEnd);
+            if (!name.empty()) {
+                _headers.push_back({name, colon ? trimSpaces(colon + 1, lineEnd) : string_view()});
+            } else if (!_headers.empty()) {
+                // SParseHTTP gives a value with no name to the header before it, so leave that to it.
+                return _parseCopy(buffer, length);
+            }
+        }
+
+        // Consume the end of the line -- accept \r\n, \n\r, \r, or \n.  But *not* \n\n (that's two endings)
+        lineStart = lineEnd;
+        if (inputEnd - lineStart >= 2 && ((lineStart[0] == '\r' && lineStart[1] == '\n') || (lineStart[0] == '\n' && lineStart[1] == '\r'))) {
+            lineStart += 2;
+        } else {
+            ++lineStart;
+        }
+    }
+
+    // Reached the end of the input and haven't finished parsing the message.
+    _methodLine = {};
+    _headers.clear();
+    return 0;
+}
+
+size_t SDataView::_parseCopy(const char* buffer, size_t length) {
+    _headers.clear();
+    _copied = true;
+    int size = SParseHTTP(buffer, length, _copy.methodLine, _copy.nameValueMap, _copy.content);
+    if (!size) {
+        _methodLine = {};
+        return 0;
+    }
+    _size = size;
+    _methodLine = _copy.methodLine;
+    _content = _copy.content;
+    for (const auto& [name, value] : _copy.nameValueMap) {
+        _headers.push_back({name, value});
+    }
+    return _size;
+}
+
+string SDataView::unescape(string_view value) {
+    // SUnescape stops at a null byte, and is only needed at all if there's an escape.
+    if (value.find_first_of(string_view("\\\0", 2)) == string_view::npos) {
+        return string(value);
+    }
+    return SUnescape(string(value));
+}
+
+bool SDataView::empty() const {
+    return !_size;
+}
+
+size_t SDataView::size() const {
+    return _size;
+}
+
+string_view SDataView::methodLine() const {
+    return _methodLine;
+}
+
+string_view SDataView::content() const {
+    return _content;
+}
+
+const vector<SDataView::Header>& SDataView::headers() const {
+    return _headers;
+}
+
+string_view SDataView::operator[](string_view name) const {
+    for (auto header = _headers.rbegin(); header != _headers.rend(); ++header) {
+        if (header->name.size() == name.size() && !strncasecmp(header->name.data(), name.data(), name.size())) {
+            return header->value;
+        }
+    }
+    return {};
+}
+
+bool SDataView::isSet(string_view name) const {
+    for (const Header& header : _headers) {
+        if (header.name.size() == name.size() && !strncasecmp(header.name.data(), name.data(), name.size())) {
+            return true;
+        }
+    }
+    return false;
+}
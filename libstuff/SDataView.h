@@ -0,0 +1,66 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <libstuff/SData.h>
+
+using namespace std;
+
+class SFastBuffer;
+
+// A read-only view of an HTTP-like message (see SData) at the start of a buffer, such as a socket's receive buffer.
+// Parsing one only finds where the method line, each header, and the content are, without copying any of them, so a
+// message that turns out to be incomplete costs nothing but the scan, and one that's complete can be looked at before
+// it's copied into an SData (with `SData::deserialize(const SDataView&)`) for a command to keep.
+// The views point into the buffer, so they're only valid until it next changes.
+class SDataView {
+  public:
+    struct Header {
+        string_view name;
+        string_view value;
+    };
+
+    // Parses the message at the start of `buffer`. Returns its length, or 0 (leaving this empty) if the buffer doesn't
+    // hold all of it yet. Any message SParseHTTP accepts is parsed the same way. The few that can't be viewed in place
+    // (those with a chunked body, or a header continued onto another line or without a name) are parsed by SParseHTTP
+    // into a copy kept here, which the views then point into instead.
+    size_t parse(const char* buffer, size_t length);
+    size_t parse(const SFastBuffer& buffer);
+
+    // Accessors
+    bool empty() const;
+
+    // The length of the message in the buffer.
+    size_t size() const;
+
+    string_view methodLine() const;
+    string_view content() const;
+
+    // Each header, in the order they were sent. Values are as sent, without the unescaping (see `SUnescape`) that
+    // deserializing into an SData does, except for a copied message (see `parse`), where it's already been done and
+    // they're in the order of the SData's table.
+    const vector<Header>& headers() const;
+
+    // Returns the value of the last header called `name` (compared without case), or an empty view if there's none.
+    string_view operator[](string_view name) const;
+    bool isSet(string_view name) const;
+
+    // Returns a header value as SData would hold it.
+    static string unescape(string_view value);
+
+  private:
+    friend struct SData;
+
+    // Parses the message with SParseHTTP into `_copy`, and points the views at it.
+    size_t _parseCopy(const char* buffer, size_t length);
+
+    size_t _size = 0;
+    string_view _methodLine;
+    vector<Header> _headers;
+    string_view _content;
+
+    // Set if the message had to be copied (see `parse`).
+    bool _copied = false;
+    SData _copy;
+};
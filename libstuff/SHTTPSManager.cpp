@@ -7,7 +7,26 @@
 #include <libstuff/libstuff.h>
 #include <sqlitecluster/SQLiteNode.h>
 
+#include <sys/eventfd.h>
+#include <unistd.h>
+
 const string SStandaloneHTTPSManager::proxyAddressHTTPS = initProxyAddressHTTPS();
+atomic<uint64_t> SStandaloneHTTPSManager::keepAliveTimeout(0);
+atomic<uint64_t> SStandaloneHTTPSManager::reactorIdleTimeoutMS(5 * 60 * 1000);
+shared_mutex SStandaloneHTTPSManager::_reactorMutex;
+vector<unique_ptr<SStandaloneHTTPSManager::ReactorThread>> SStandaloneHTTPSManager::_reactorThreads;
+atomic<size_t> SStandaloneHTTPSManager::_nextReactorThread(0);
+atomic<bool> SStandaloneHTTPSManager::_reactorShouldExit(false);
+mutex SStandaloneHTTPSManager::_keepAliveMutex;
+map<string, list<pair<uint64_t, unique_ptr<STCPManager::Socket>>>> SStandaloneHTTPSManager::_keepAliveSockets;
+
+// Interrupts a reactor thread's `poll` so that it picks up new watches.
+static void wakeHTTPSReactor(int wakeFD) {
+    uint64_t one = 1;
+    if (write(wakeFD, &one, sizeof(one)) < 0) {
+        SWARN("Failed to wake HTTPS reactor: " << strerror(errno));
+    }
+}
 
 string SStandaloneHTTPSManager::initProxyAddressHTTPS() {
     const char* proxyString = getenv("HTTPS_PROXY");
@@ -120,9 +139,11 @@ void SStandaloneHTTPSManager::postPoll(fd_map& fdm, SStandaloneHTTPSManager::Tra
             transaction.response = 500;
         }
 
-        // Finished with the socket, free it up.
-        delete transaction.s;
-        transaction.s = nullptr;
+        // Finished with the socket, free it up, or keep it for the next request to this host. We can only reuse it if
+        // we know exactly where this response ended, and the server didn't say it was closing the connection.
+        bool reusable = hasContentLength && transaction.s->recvBuffer.empty() && !SStartsWith(transaction.fullResponse.methodLine, "HTTP/1.0") &&
+                        !SIEquals(transaction.fullResponse["Connection"], "close");
+        _releaseSocket(transaction, reusable);
     } else {
         // If we don't have a response, we need to check for a timeout, or a disconnection.
         // The disconnection check is straightforward, we just check the socket state.
@@ -197,7 +218,20 @@ SStandaloneHTTPSManager::Transaction* SStandaloneHTTPSManager::_httpsSend(const
             SINFO("Proxying " << url << " through " << proxyHost);
             s = new SHTTPSProxySocket(proxyHost, host);
         } else {
-            s = new Socket(host, isHttps);
+            // Requests that ask for the connection to be closed can't share one.
+            if (keepAliveTimeout && !SIEquals(request["Connection"], "close")) {
+                transaction->keepAliveKey = (isHttps ? "https://" : "http://") + host;
+
+                // The pool is shared by every manager, so a connection made with one manager's certificate mustn't be
+                // handed to another that uses a different one.
+                if (_pem.size() || _srvCrt.size() || _caCrt.size()) {
+                    transaction->keepAliveKey += "#" + SToHex(SHashSHA1(_pem + _srvCrt + _caCrt));
+                }
+                s = _takeKeepAliveSocket(transaction->keepAliveKey);
+            }
+            if (!s) {
+                s = new Socket(host, isHttps);
+            }
         }
     } catch (const SException& exception) {
         delete transaction;
@@ -219,3 +253,185 @@ bool SStandaloneHTTPSManager::_onRecv(Transaction* transaction)
     transaction->response = getHTTPResponseCode(transaction->fullResponse.methodLine);
     return false;
 }
+
+void SStandaloneHTTPSManager::_releaseSocket(Transaction& transaction, bool reusable) {
+    unique_ptr<Socket> s(transaction.s);
+    transaction.s = nullptr;
+    const uint64_t timeout = keepAliveTimeout;
+    if (!timeout || !reusable || transaction.keepAliveKey.empty() || s->state.load() != Socket::CONNECTED || !s->sendBufferEmpty()) {
+        return;
+    }
+
+    // Any connections that have sat too long get dropped as we go.
+    uint64_t now = STimeNow();
+    lock_guard<mutex> lock(_keepAliveMutex);
+    for (auto hostIt = _keepAliveSockets.begin(); hostIt != _keepAliveSockets.end();) {
+        auto& sockets = hostIt->second;
+        while (!sockets.empty() && sockets.front().first + timeout < now) {
+            sockets.pop_front();
+        }
+        hostIt = sockets.empty() ? _keepAliveSockets.erase(hostIt) : next(hostIt);
+    }
+    _keepAliveSockets[transaction.keepAliveKey].emplace_back(now, move(s));
+}
+
+STCPManager::Socket* SStandaloneHTTPSManager::_takeKeepAliveSocket(const string& keepAliveKey) {
+    lock_guard<mutex> lock(_keepAliveMutex);
+    auto hostIt = _keepAliveSockets.find(keepAliveKey);
+    if (hostIt == _keepAliveSockets.end()) {
+        return nullptr;
+    }
+
+    // Take the most recently used connection first, it's the least likely to have been closed by the server.
+    uint64_t now = STimeNow();
+    auto& sockets = hostIt->second;
+    Socket* s = nullptr;
+    while (!s && !sockets.empty()) {
+        auto [lastUsed, candidate] = move(sockets.back());
+        sockets.pop_back();
+        if (lastUsed + keepAliveTimeout < now) {
+            continue;
+        }
+
+        // An idle connection shouldn't have anything to read. If it does, the server has closed it (or sent us
+        // something we don't expect), so we don't use it.
+        pollfd fdspec = {candidate->s, POLLIN, 0};
+        if (poll(&fdspec, 1, 0)) {
+            continue;
+        }
+        s = candidate.release();
+    }
+    if (sockets.empty()) {
+        _keepAliveSockets.erase(hostIt);
+    }
+    if (s) {
+        SINFO("Reusing connection to " << keepAliveKey << ".");
+    }
+    return s;
+}
+
+void SStandaloneHTTPSManager::startReactor(size_t threadCount) {
+    unique_lock<shared_mutex> lock(_reactorMutex);
+    if (!_reactorThreads.empty() || !threadCount) {
+        return;
+    }
+    _reactorShouldExit = false;
+    for (size_t i = 0; i < threadCount; i++) {
+        auto reactor = make_unique<ReactorThread>();
+        reactor->wakeFD = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (reactor->wakeFD < 0) {
+            SERROR("Couldn't create HTTPS reactor: " << strerror(errno));
+        }
+        _reactorThreads.push_back(move(reactor));
+    }
+    for (size_t i = 0; i < _reactorThreads.size(); i++) {
+        _reactorThreads[i]->reactorThread = thread(&SStandaloneHTTPSManager::_reactorLoop, ref(*_reactorThreads[i]), i);
+    }
+}
+
+void SStandaloneHTTPSManager::stopReactor() {
+    unique_lock<shared_mutex> lock(_reactorMutex);
+    _reactorShouldExit = true;
+    for (auto& reactor : _reactorThreads) {
+        wakeHTTPSReactor(reactor->wakeFD);
+        reactor->reactorThread.join();
+        close(reactor->wakeFD);
+    }
+    _reactorThreads.clear();
+}
+
+bool SStandaloneHTTPSManager::isReactorRunning() {
+    shared_lock<shared_mutex> lock(_reactorMutex);
+    return !_reactorThreads.empty();
+}
+
+void SStandaloneHTTPSManager::watchTransactions(list<Transaction*>&& transactions, uint64_t timeout, function<void()>&& onComplete) {
+    {
+        shared_lock<shared_mutex> lock(_reactorMutex);
+        if (!_reactorThreads.empty()) {
+            ReactorThread& reactor = *_reactorThreads[_nextReactorThread++ % _reactorThreads.size()];
+            {
+                lock_guard<mutex> watchLock(reactor.newWatchesMutex);
+                reactor.newWatches.push_back({move(transactions), timeout, move(onComplete)});
+            }
+            wakeHTTPSReactor(reactor.wakeFD);
+            return;
+        }
+    }
+
+    // Nothing is going to poll these, so give up on them.
+    SWARN("HTTPS reactor isn't running, failing " << transactions.size() << " transactions.");
+    for (auto transaction : transactions) {
+        if (!transaction->response) {
+            transaction->response = 500;
+        }
+    }
+    onComplete();
+}
+
+void SStandaloneHTTPSManager::_reactorLoop(ReactorThread& reactor, size_t threadID) {
+    SInitialize("httpsReactor" + to_string(threadID));
+    SINFO("[performance] HTTPS reactor starting");
+
+    list<Watch> watches;
+    while (true) {
+        // Check this first: once it's set, nothing more can be added, so we're sure to pick up everything below.
+        const bool exiting = _reactorShouldExit;
+        {
+            lock_guard<mutex> lock(reactor.newWatchesMutex);
+            watches.splice(watches.end(), reactor.newWatches);
+        }
+        if (exiting && watches.empty()) {
+            break;
+        }
+
+        fd_map fdm;
+        SFDset(fdm, reactor.wakeFD, POLLIN);
+        uint64_t now = STimeNow();
+
+        // As when a command polls its own transactions, we never wait more than a second: transactions can have their
+        // socket attached some time after they're created, and we want to notice that.
+        uint64_t maxWaitUS = 1'000'000;
+        for (auto& watch : watches) {
+            maxWaitUS = min(maxWaitUS, watch.timeout > now ? watch.timeout - now : 0);
+            for (auto transaction : watch.transactions) {
+                transaction->manager.prePoll(fdm, *transaction);
+            }
+        }
+        if (!exiting) {
+            S_poll(fdm, maxWaitUS);
+        }
+        if (SFDAnySet(fdm, reactor.wakeFD, POLLIN)) {
+            uint64_t wakeCount;
+            if (read(reactor.wakeFD, &wakeCount, sizeof(wakeCount)) < 0 && errno != EAGAIN) {
+                SWARN("Failed to read HTTPS reactor wake event: " << strerror(errno));
+            }
+        }
+
+        now = STimeNow();
+        for (auto watchIt = watches.begin(); watchIt != watches.end();) {
+            Watch& watch = *watchIt;
+            for (auto transactionIt = watch.transactions.begin(); transactionIt != watch.transactions.end();) {
+                Transaction* transaction = *transactionIt;
+                if (!transaction->timeoutAt) {
+                    transaction->timeoutAt = watch.timeout;
+                }
+                uint64_t ignore{0};
+                transaction->manager.postPoll(fdm, *transaction, ignore, reactorIdleTimeoutMS);
+                if (!transaction->response && (exiting || now >= watch.timeout)) {
+                    transaction->response = 500;
+                }
+                transactionIt = transaction->response ? watch.transactions.erase(transactionIt) : next(transactionIt);
+            }
+
+            if (watch.transactions.empty()) {
+                watch.onComplete();
+                watchIt = watches.erase(watchIt);
+            } else {
+                watchIt++;
+            }
+        }
+    }
+
+    SINFO("[performance] HTTPS reactor complete");
+}
@@ -1,5 +1,8 @@
 #pragma once
 
+#include <shared_mutex>
+#include <thread>
+
 #include <libstuff/SData.h>
 #include <libstuff/STCPManager.h>
 
@@ -23,10 +26,33 @@ class SStandaloneHTTPSManager : public STCPManager {
         SStandaloneHTTPSManager& manager;
         uint64_t sentTime;
         const string requestID;
+
+        // Identifies the host, scheme, and client certificate this transaction's connection can be reused for once it
+        // completes, or empty if it can't be reused.
+        string keepAliveKey;
     };
 
     static const string proxyAddressHTTPS;
 
+    // If set, connections are kept open for up to this many microseconds after their transaction completes, and are
+    // reused by the next transaction to the same host.
+    static atomic<uint64_t> keepAliveTimeout;
+
+    // A shared event loop for outstanding transactions. While it's running, callers can hand their transactions to it
+    // rather than each polling them on a thread of their own, and are told when they're all complete.
+    static void startReactor(size_t threadCount);
+    static void stopReactor();
+    static bool isReactorRunning();
+
+    // Hands `transactions` to the reactor, which calls `onComplete` from one of its threads once each one has a
+    // response. Any still outstanding at `timeout` (a timestamp) get a 500. If the reactor isn't running, this
+    // happens immediately.
+    static void watchTransactions(list<Transaction*>&& transactions, uint64_t timeout, function<void()>&& onComplete);
+
+    // The reactor kills connections that have been idle for this many milliseconds. This is shortened at shutdown so
+    // that stuck requests don't hold the server up.
+    static atomic<uint64_t> reactorIdleTimeoutMS;
+
     // Constructor/Destructor
     SStandaloneHTTPSManager();
     SStandaloneHTTPSManager(const string& pem, const string& srvCrt, const string& caCrt);
@@ -57,6 +83,41 @@ class SStandaloneHTTPSManager : public STCPManager {
     virtual bool _onRecv(Transaction* transaction);
 
     static string initProxyAddressHTTPS();
+
+  private:
+    // A set of transactions handed to the reactor together, and who to tell when they're done.
+    struct Watch {
+        list<Transaction*> transactions;
+        uint64_t timeout;
+        function<void()> onComplete;
+    };
+
+    // Each reactor thread polls the transactions of the watches it's been given. Writing to `wakeFD` interrupts it
+    // so it picks up new watches.
+    struct ReactorThread {
+        int wakeFD{-1};
+        mutex newWatchesMutex;
+        list<Watch> newWatches;
+        thread reactorThread;
+    };
+
+    static void _reactorLoop(ReactorThread& reactor, size_t threadID);
+
+    // Returns an idle connection for `keepAliveKey` that still looks usable, or nullptr.
+    static STCPManager::Socket* _takeKeepAliveSocket(const string& keepAliveKey);
+
+    // Frees the socket of a completed transaction, or keeps it for reuse if `reusable` and keep-alive is enabled.
+    static void _releaseSocket(Transaction& transaction, bool reusable);
+
+    // Protects `_reactorThreads`, which is empty when the reactor isn't running.
+    static shared_mutex _reactorMutex;
+    static vector<unique_ptr<ReactorThread>> _reactorThreads;
+    static atomic<size_t> _nextReactorThread;
+    static atomic<bool> _reactorShouldExit;
+
+    // Idle connections by `keepAliveKey`, with the time each was last used.
+    static mutex _keepAliveMutex;
+    static map<string, list<pair<uint64_t, unique_ptr<STCPManager::Socket>>>> _keepAliveSockets;
 };
 
 class SHTTPSManager : public SStandaloneHTTPSManager {
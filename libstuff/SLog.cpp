@@ -6,8 +6,10 @@ atomic<int> _g_SLogMask(LOG_INFO);
 atomic<bool> GLOBAL_IS_LIVE{true};
 
 void SLogStackTrace(int level) {
-    // If the level isn't set in the log mask, nothing more to do
+    // If the level isn't set in the log mask, nothing more to do, except make sure what's already been logged gets
+    // sent, as we're usually about to abort.
     if (!(_g_SLogMask & (1 << level))) {
+        SLogAsyncFlush();
         return;
     }
     // Output the symbols to the log
@@ -38,6 +40,7 @@ void SLogStackTrace(int level) {
             break;
         }
     }
+    SLogAsyncFlush();
 }
 
 // If the param name is not in this whitelist, we will log <REDACTED> in addLogParams.
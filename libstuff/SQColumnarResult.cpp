@@ -0,0 +1,213 @@
+#include "SQColumnarResult.h"
+#include <bit>
+#include <cstring>
+#include <libstuff/libstuff.h>
+#include <libstuff/SQResult.h>
+#include <libstuff/sqlite3.h>
+
+size_t SQColumnarResult::Row::size() const {
+    return _result->columnCount();
+}
+
+bool SQColumnarResult::Row::empty() const {
+    return !size();
+}
+
+string SQColumnarResult::Row::operator[](size_t column) const {
+    return _result->getString(_index, column);
+}
+
+string SQColumnarResult::Row::operator[](const string& name) const {
+    for (size_t i = 0; i < _result->headers.size() && i < size(); i++) {
+        if (_result->headers[i] == name) {
+            return (*this)[i];
+        }
+    }
+    STHROW_STACK("No column named " + name);
+}
+
+SQColumnarResult::Row::operator vector<string>() const {
+    vector<string> out(size());
+    for (size_t i = 0; i < out.size(); i++) {
+        out[i] = (*this)[i];
+    }
+    return out;
+}
+
+bool SQColumnarResult::empty() const {
+    return !_rowCount;
+}
+
+size_t SQColumnarResult::size() const {
+    return _rowCount;
+}
+
+size_t SQColumnarResult::columnCount() const {
+    return _columns.size();
+}
+
+size_t SQColumnarResult::byteSize() const {
+    return _text.size() + _rowCount * _columns.size() * (sizeof(SQValue::TYPE) + sizeof(int64_t) + sizeof(uint32_t));
+}
+
+void SQColumnarResult::clear() {
+    headers.clear();
+    _columns.clear();
+    _rowCount = 0;
+    _text.clear();
+}
+
+void SQColumnarResult::appendRow(sqlite3_stmt* statement) {
+    size_t statementColumns = sqlite3_column_count(statement);
+    if (statementColumns > _columns.size()) {
+        size_t previousColumns = _columns.size();
+        _columns.resize(statementColumns);
+        for (size_t i = previousColumns; i < statementColumns; i++) {
+            _columns[i].types.resize(_rowCount, SQValue::TYPE::NONE);
+            _columns[i].values.resize(_rowCount, 0);
+            _columns[i].sizes.resize(_rowCount, 0);
+        }
+    }
+
+    for (size_t i = 0; i < _columns.size(); i++) {
+        Column& column = _columns[i];
+        int type = i < statementColumns ? sqlite3_column_type(statement, i) : SQLITE_NULL;
+        switch (type) {
+            case SQLITE_INTEGER:
+                column.types.push_back(SQValue::TYPE::INTEGER);
+                column.values.push_back(sqlite3_column_int64(statement, i));
+                column.sizes.push_back(0);
+                break;
+            case SQLITE_FLOAT:
+                column.types.push_back(SQValue::TYPE::REAL);
+                column.values.push_back(bit_cast<int64_t>(sqlite3_column_double(statement, i)));
+                column.sizes.push_back(0);
+                break;
+            case SQLITE_TEXT:
+            case SQLITE_BLOB: {
+                // As with SQResult, TEXT stops at the first null byte.
+                const char* data;
+                size_t size;
+                if (type == SQLITE_TEXT) {
+                    data = reinterpret_cast<const char*>(sqlite3_column_text(statement, i));
+                    size = data ? strlen(data) : 0;
+                } else {
+                    data = static_cast<const char*>(sqlite3_column_blob(statement, i));
+                    size = sqlite3_column_bytes(statement, i);
+                }
+                column.types.push_back(type == SQLITE_TEXT ? SQValue::TYPE::TEXT : SQValue::TYPE::BLOB);
+                column.values.push_back(_text.size());
+                column.sizes.push_back(size);
+                _text.append(data ? data : "", size);
+                break;
+            }
+            default:
+                column.types.push_back(SQValue::TYPE::NONE);
+                column.values.push_back(0);
+                column.sizes.push_back(0);
+                break;
+        }
+    }
+    _rowCount++;
+}
+
+const SQColumnarResult::Column& SQColumnarResult::_getColumn(size_t row, size_t column) const {
+    if (row >= _rowCount || column >= _columns.size()) {
+        SINFO("SQColumnarResult out of range", {{"rowNum", to_string(row)}});
+        STHROW_STACK("Out of range");
+    }
+    return _columns[column];
+}
+
+SQValue::TYPE SQColumnarResult::getType(size_t row, size_t column) const {
+    return _getColumn(row, column).types[row];
+}
+
+int64_t SQColumnarResult::getInt64(size_t row, size_t column) const {
+    const Column& c = _getColumn(row, column);
+    return c.types[row] == SQValue::TYPE::INTEGER ? c.values[row] : 0;
+}
+
+double SQColumnarResult::getDouble(size_t row, size_t column) const {
+    const Column& c = _getColumn(row, column);
+    return c.types[row] == SQValue::TYPE::REAL ? bit_cast<double>(c.values[row]) : 0.0;
+}
+
+string_view SQColumnarResult::getText(size_t row, size_t column) const {
+    const Column& c = _getColumn(row, column);
+    if (c.types[row] != SQValue::TYPE::TEXT && c.types[row] != SQValue::TYPE::BLOB) {
+        return {};
+    }
+    return string_view(_text.data() + c.values[row], c.sizes[row]);
+}
+
+void SQColumnarResult::appendString(string& output, size_t row, size_t column) const {
+    const Column& c = _getColumn(row, column);
+    switch (c.types[row]) {
+        case SQValue::TYPE::INTEGER:
+            output += to_string(c.values[row]);
+            break;
+        case SQValue::TYPE::REAL: {
+            // This matches SQValue, which matches the sqlite3 shell.
+            char buf[64];
+            sqlite3_snprintf(sizeof(buf), buf, "%!.15g", bit_cast<double>(c.values[row]));
+            output += buf;
+            break;
+        }
+        case SQValue::TYPE::TEXT:
+        case SQValue::TYPE::BLOB:
+            output.append(_text, c.values[row], c.sizes[row]);
+            break;
+        case SQValue::TYPE::NONE:
+            break;
+    }
+}
+
+string SQColumnarResult::getString(size_t row, size_t column) const {
+    string output;
+    appendString(output, row, column);
+    return output;
+}
+
+SQColumnarResult::Row SQColumnarResult::operator[](size_t rowNum) const {
+    if (rowNum >= _rowCount) {
+        SINFO("SQColumnarResult::operator[] out of range", {{"rowNum", to_string(rowNum)}});
+        STHROW_STACK("Out of range");
+    }
+    return Row(*this, rowNum);
+}
+
+SQResult SQColumnarResult::toSQResult() const {
+    SQResult result;
+    result.headers = headers;
+    for (size_t row = 0; row < _rowCount; row++) {
+        SQResultRow resultRow(result, _columns.size());
+        for (size_t column = 0; column < _columns.size(); column++) {
+            const Column& c = _columns[column];
+            switch (c.types[row]) {
+                case SQValue::TYPE::INTEGER:
+                    resultRow.get(column) = c.values[row];
+                    break;
+                case SQValue::TYPE::REAL:
+                    resultRow.get(column) = bit_cast<double>(c.values[row]);
+                    break;
+                case SQValue::TYPE::TEXT:
+                case SQValue::TYPE::BLOB:
+                    resultRow.get(column) = SQValue(c.types[row], _text.substr(c.values[row], c.sizes[row]));
+                    break;
+                case SQValue::TYPE::NONE:
+                    break;
+            }
+        }
+        result.emplace_back(move(resultRow));
+    }
+    return result;
+}
+
+SQColumnarResult::RowIterator SQColumnarResult::begin() const {
+    return RowIterator(*this, 0);
+}
+
+SQColumnarResult::RowIterator SQColumnarResult::end() const {
+    return RowIterator(*this, _rowCount);
+}
@@ -0,0 +1,99 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include <libstuff/SQValue.h>
+using namespace std;
+
+class SQResult;
+struct sqlite3_stmt;
+
+// A compact alternative to SQResult for large results. Values are stored by column, as a flat array of types and a
+// flat array of numbers each, and all TEXT and BLOB values share a single string. Filling one is a few appends per
+// value, rather than an SQValue (and often a string allocation) each, and values can be read in place with the typed
+// accessors rather than copied out as strings.
+class SQColumnarResult {
+  public:
+    // A single row, for code written against SQResultRow. Only valid as long as the result it came from is unchanged.
+    class Row {
+      public:
+        Row(const SQColumnarResult& result, size_t index) : _result(&result), _index(index) { }
+        size_t size() const;
+        bool empty() const;
+        string operator[](size_t column) const;
+        string operator[](const string& name) const;
+        operator vector<string>() const;
+
+      private:
+        const SQColumnarResult* _result;
+        size_t _index;
+    };
+
+    class RowIterator {
+      public:
+        RowIterator(const SQColumnarResult& result, size_t index) : _result(&result), _index(index) { }
+        Row operator*() const { return Row(*_result, _index); }
+        RowIterator& operator++() { _index++; return *this; }
+        bool operator!=(const RowIterator& other) const { return _index != other._index; }
+
+      private:
+        const SQColumnarResult* _result;
+        size_t _index;
+    };
+
+    vector<string> headers;
+
+    // Accessors
+    bool empty() const;
+    size_t size() const;
+    size_t columnCount() const;
+
+    // Roughly how much memory the values take up, for callers that want to limit it.
+    size_t byteSize() const;
+
+    // Mutators
+    void clear();
+
+    // Appends the row `statement` is on, copying TEXT and BLOB values straight from SQLite into the shared string.
+    // A statement with more columns than previous rows adds columns, which are NULL for those rows.
+    void appendRow(sqlite3_stmt* statement);
+
+    // Typed accessors, which throw if `row` or `column` is out of range. `getInt64` and `getDouble` return 0 for
+    // values of other types, and `getText` returns an empty view for values that aren't TEXT or BLOB. The view returned
+    // by `getText` points into this result, and is only valid until it's next changed.
+    SQValue::TYPE getType(size_t row, size_t column) const;
+    int64_t getInt64(size_t row, size_t column) const;
+    double getDouble(size_t row, size_t column) const;
+    string_view getText(size_t row, size_t column) const;
+
+    // Returns a value as a string, formatted the same as converting the equivalent SQValue to a string would.
+    // `appendString` appends it to `output` instead, to avoid a temporary string.
+    string getString(size_t row, size_t column) const;
+    void appendString(string& output, size_t row, size_t column) const;
+
+    // Operators
+    Row operator[](size_t rowNum) const;
+
+    // Copies this into a row-based SQResult, for code that needs one.
+    SQResult toSQResult() const;
+
+    // Iterator support for range-based for loops
+    RowIterator begin() const;
+    RowIterator end() const;
+
+  private:
+    struct Column {
+        // One entry per row in each. `values` holds INTEGERs, the bits of REALs, or the offset in `_text` of TEXT and
+        // BLOB values, and `sizes` holds the size of TEXT and BLOB values.
+        vector<SQValue::TYPE> types;
+        vector<int64_t> values;
+        vector<uint32_t> sizes;
+    };
+
+    // Throws if `row` or `column` is out of range.
+    const Column& _getColumn(size_t row, size_t column) const;
+
+    vector<Column> _columns;
+    size_t _rowCount = 0;
+    string _text;
+};
@@ -4,6 +4,15 @@
 SQResultFormatter::FORMAT_OPTIONS SQResultFormatter::defaultOptions{};
 
 string SQResultFormatter::format(const SQResult& result, SQResultFormatter::FORMAT format, const SQResultFormatter::FORMAT_OPTIONS& options) {
+    return formatResult(result, format, options);
+}
+
+string SQResultFormatter::format(const SQColumnarResult& result, SQResultFormatter::FORMAT format, const SQResultFormatter::FORMAT_OPTIONS& options) {
+    return formatResult(result, format, options);
+}
+
+template <typename RESULT>
+string SQResultFormatter::formatResult(const RESULT& result, SQResultFormatter::FORMAT format, const SQResultFormatter::FORMAT_OPTIONS& options) {
     switch (format) {
         case FORMAT::COLUMN:
             return formatColumn(result, options);
@@ -35,7 +44,81 @@ string SQResultFormatter::formatJSON(const SQResult& result, const FORMAT_OPTION
     return SComposeJSONObject(output);
 }
 
-string SQResultFormatter::formatColumn(const SQResult& result, const FORMAT_OPTIONS& options) {
+string SQResultFormatter::formatJSON(const SQColumnarResult& result, const FORMAT_OPTIONS& options) {
+    // This builds the same output as above directly, rather than composing (and re-parsing) each row separately.
+    // Integers are output as they are, which is what `SToJSON` would do with them anyway.
+    string output = "{";
+    if (options.header) {
+        output += "\"headers\":" + SComposeJSONArray(result.headers) + ",";
+    }
+    output += "\"rows\":[";
+    appendJSONRows(result, false, output);
+    output += "]}";
+    return output;
+}
+
+void SQResultFormatter::appendJSONRows(const SQColumnarResult& result, bool continuing, string& output) {
+    string value;
+    for (size_t row = 0; row < result.size(); row++) {
+        output += (row || continuing) ? ",[" : "[";
+        for (size_t column = 0; column < result.columnCount(); column++) {
+            if (column) {
+                output += ",";
+            }
+            if (result.getType(row, column) == SQValue::TYPE::INTEGER) {
+                output += to_string(result.getInt64(row, column));
+            } else {
+                value.clear();
+                result.appendString(value, row, column);
+                output += SToJSON(value);
+            }
+        }
+        output += "]";
+    }
+}
+
+bool SQResultFormatter::Stream::canStream(FORMAT format) {
+    return format != FORMAT::COLUMN;
+}
+
+SQResultFormatter::Stream::Stream(FORMAT format, const FORMAT_OPTIONS& options) : _format(format), _options(options) {
+    SASSERT(canStream(format));
+}
+
+void SQResultFormatter::Stream::start(const vector<string>& headers, string& output) {
+    if (_format == FORMAT::JSON) {
+        output += "{";
+        if (_options.header) {
+            output += "\"headers\":" + SComposeJSONArray(headers) + ",";
+        }
+        output += "\"rows\":[";
+    } else if (_options.header) {
+        // The other formats start with just the header line, which is what they give for a result with no rows.
+        SQColumnarResult empty;
+        empty.headers = headers;
+        output += formatResult(empty, _format, _options);
+    }
+}
+
+void SQResultFormatter::Stream::append(const SQColumnarResult& rows, string& output) {
+    if (_format == FORMAT::JSON) {
+        appendJSONRows(rows, _rowCount > 0, output);
+    } else {
+        FORMAT_OPTIONS rowOptions = _options;
+        rowOptions.header = false;
+        output += formatResult(rows, _format, rowOptions);
+    }
+    _rowCount += rows.size();
+}
+
+void SQResultFormatter::Stream::finish(string& output) {
+    if (_format == FORMAT::JSON) {
+        output += "]}";
+    }
+}
+
+template <typename RESULT>
+string SQResultFormatter::formatColumn(const RESULT& result, const FORMAT_OPTIONS& options) {
     // Match the native format of sqlite3 and handle embedded newlines by
     // splitting cells into physical lines and aligning continuation lines
     // under their respective columns.
@@ -280,7 +363,8 @@ string SQResultFormatter::formatColumn(const SQResult& result, const FORMAT_OPTI
     return output;
 }
 
-string SQResultFormatter::formatQuote(const SQResult& result, const FORMAT_OPTIONS& options) {
+template <typename RESULT>
+string SQResultFormatter::formatQuote(const RESULT& result, const FORMAT_OPTIONS& options) {
     auto isNumeric = [](const string& input) -> bool {
         if (input.empty()) {
             return false;
@@ -381,7 +465,8 @@ string SQResultFormatter::formatQuote(const SQResult& result, const FORMAT_OPTIO
     return output;
 }
 
-string SQResultFormatter::formatCSV(const SQResult& result, const FORMAT_OPTIONS& options) {
+template <typename RESULT>
+string SQResultFormatter::formatCSV(const RESULT& result, const FORMAT_OPTIONS& options) {
     // Standard CSV + sqlite3 shell defaults:
     //  - Separator: comma
     //  - Quote a field if it contains comma, double-quote, CR, LF, any ASCII whitespace/control, or any non-ASCII byte
@@ -460,7 +545,8 @@ string SQResultFormatter::formatCSV(const SQResult& result, const FORMAT_OPTIONS
     return output;
 }
 
-string SQResultFormatter::formatTabs(const SQResult& result, const FORMAT_OPTIONS& options) {
+template <typename RESULT>
+string SQResultFormatter::formatTabs(const RESULT& result, const FORMAT_OPTIONS& options) {
     // Mimic sqlite3 shell `.mode tabs`:
     //  - Separator is a single TAB character
     //  - No field quoting/escaping; fields are written verbatim
@@ -505,7 +591,8 @@ string SQResultFormatter::formatTabs(const SQResult& result, const FORMAT_OPTION
     return output;
 }
 
-string SQResultFormatter::formatList(const SQResult& result, const FORMAT_OPTIONS& options) {
+template <typename RESULT>
+string SQResultFormatter::formatList(const RESULT& result, const FORMAT_OPTIONS& options) {
     // Mimic sqlite3 shell `.mode list`:
     //  - Columns separated by a pipe ("|")
     //  - Each row on a single line
@@ -1,4 +1,5 @@
 #pragma once
+#include "SQColumnarResult.h"
 #include "SQResult.h"
 class SQResultFormatter {
 public:
@@ -24,12 +25,46 @@ public:
     static FORMAT_OPTIONS defaultOptions;
 
     static string format(const SQResult& result, FORMAT format, const FORMAT_OPTIONS& options = defaultOptions);
+    static string format(const SQColumnarResult& result, FORMAT format, const FORMAT_OPTIONS& options = defaultOptions);
+
+    // Formats a result a batch of rows at a time, for results too big to hold all at once. The output of `start`, then
+    // `append` for each batch, then `finish`, is the same as `format` on all of the rows together. COLUMN can't be
+    // formatted this way, as its column widths depend on every row.
+    class Stream {
+      public:
+        static bool canStream(FORMAT format);
+
+        Stream(FORMAT format, const FORMAT_OPTIONS& options = defaultOptions);
+
+        // Each of these appends its part of the output to `output`.
+        void start(const vector<string>& headers, string& output);
+        void append(const SQColumnarResult& rows, string& output);
+        void finish(string& output);
+
+      private:
+        const FORMAT _format;
+        const FORMAT_OPTIONS _options;
+        size_t _rowCount = 0;
+    };
 
 private:
-    static string formatColumn(const SQResult& result, const FORMAT_OPTIONS& options);
-    static string formatCSV(const SQResult& result, const FORMAT_OPTIONS& options);
-    static string formatTabs(const SQResult& result, const FORMAT_OPTIONS& options);
-    static string formatQuote(const SQResult& result, const FORMAT_OPTIONS& options);
+    // These work the same on an SQResult or an SQColumnarResult.
+    template <typename RESULT>
+    static string formatResult(const RESULT& result, FORMAT format, const FORMAT_OPTIONS& options);
+    template <typename RESULT>
+    static string formatColumn(const RESULT& result, const FORMAT_OPTIONS& options);
+    template <typename RESULT>
+    static string formatCSV(const RESULT& result, const FORMAT_OPTIONS& options);
+    template <typename RESULT>
+    static string formatTabs(const RESULT& result, const FORMAT_OPTIONS& options);
+    template <typename RESULT>
+    static string formatQuote(const RESULT& result, const FORMAT_OPTIONS& options);
+    template <typename RESULT>
+    static string formatList(const RESULT& result, const FORMAT_OPTIONS& options);
+
     static string formatJSON(const SQResult& result, const FORMAT_OPTIONS& options);
-    static string formatList(const SQResult& result, const FORMAT_OPTIONS& options);
+    static string formatJSON(const SQColumnarResult& result, const FORMAT_OPTIONS& options);
+
+    // Appends `result`'s rows as JSON arrays, separated by commas, with a leading comma if `continuing` is set.
+    static void appendJSONRows(const SQColumnarResult& result, bool continuing, string& output);
 };
@@ -0,0 +1,67 @@
+#include <libstuff/libstuff.h>
+#include "SQStatementCache.h"
+
+atomic<uint64_t> SQStatementCache::hits(0);
+atomic<uint64_t> SQStatementCache::misses(0);
+atomic<uint64_t> SQStatementCache::prepareTimeUS(0);
+
+SQStatementCache::SQStatementCache(size_t maxEntries) : _maxEntries(maxEntries)
+{ }
+
+SQStatementCache::~SQStatementCache() {
+    clear();
+}
+
+SQStatementCache::Entry* SQStatementCache::get(const string& sql) {
+    // Don't count queries we'd never cache as misses.
+    if (!_maxEntries || sql.size() > MAX_SQL_SIZE) {
+        return nullptr;
+    }
+
+    auto it = _index.find(sql);
+    if (it == _index.end()) {
+        misses++;
+        _onMiss();
+        return nullptr;
+    }
+
+    // Move this entry to the front of the list.
+    _entries.splice(_entries.begin(), _entries, it->second);
+    hits++;
+    _onHit(*it->second);
+    return &(*it->second);
+}
+
+bool SQStatementCache::put(const string& sql, sqlite3_stmt* statement) {
+    if (!_maxEntries || sql.size() > MAX_SQL_SIZE || _index.count(sql)) {
+        return false;
+    }
+
+    Entry entry{sql, statement, {}};
+    if (!_shouldCache(entry)) {
+        return false;
+    }
+
+    // Make room if we need to.
+    if (_entries.size() >= _maxEntries) {
+        sqlite3_finalize(_entries.back().statement);
+        _index.erase(_entries.back().sql);
+        _entries.pop_back();
+    }
+
+    _entries.push_front(move(entry));
+    _index.emplace(sql, _entries.begin());
+    return true;
+}
+
+void SQStatementCache::clear() {
+    for (auto& entry : _entries) {
+        sqlite3_finalize(entry.statement);
+    }
+    _entries.clear();
+    _index.clear();
+}
+
+size_t SQStatementCache::size() const {
+    return _entries.size();
+}
@@ -0,0 +1,69 @@
+#pragma once
+#include <atomic>
+#include <list>
+#include <set>
+#include <string>
+#include <unordered_map>
+
+#include <libstuff/sqlite3.h>
+
+using namespace std;
+
+// An LRU cache of prepared statements for a single sqlite3 handle, keyed by the full SQL text of the query. Passing
+// one of these to `SQuery` lets hot queries skip parsing and planning entirely. Like the handle it belongs to, this is
+// not thread-safe.
+//
+// Only queries that consist of a single statement are cached, as that's the unit `sqlite3_prepare_v2` gives us back.
+class SQStatementCache {
+  public:
+    struct Entry {
+        string sql;
+        sqlite3_stmt* statement;
+
+        // Cached statements aren't re-authorized when they're re-run, so anything the owner learned from the
+        // authorizer when the statement was prepared (namely, which tables it touches) is saved here.
+        set<string> tablesUsed;
+    };
+
+    // Queries longer than this are never cached. These are almost always one-off bulk writes, and keeping their
+    // statements around would only waste memory.
+    static constexpr size_t MAX_SQL_SIZE = 10'000;
+
+    SQStatementCache(size_t maxEntries);
+    virtual ~SQStatementCache();
+
+    // Returns the entry for `sql`, marking it as most recently used, or nullptr if it's not cached.
+    Entry* get(const string& sql);
+
+    // Offers a freshly prepared statement that covers the entirety of `sql` to the cache. Returns true if the cache
+    // took ownership of the statement, otherwise the caller is still responsible for finalizing it.
+    bool put(const string& sql, sqlite3_stmt* statement);
+
+    // Finalizes every cached statement. This must be called before the owning handle is closed, and should be called
+    // when the schema changes.
+    void clear();
+
+    size_t size() const;
+
+    // Totals across every cache in the process, for reporting in `Status`.
+    static atomic<uint64_t> hits;
+    static atomic<uint64_t> misses;
+    static atomic<uint64_t> prepareTimeUS;
+
+  protected:
+    // Called whenever `get` misses, before the query is prepared.
+    virtual void _onMiss() {}
+
+    // Called with each new entry before it's cached. Returning false prevents caching it.
+    virtual bool _shouldCache(Entry& entry) { return true; }
+
+    // Called each time `get` returns an entry.
+    virtual void _onHit(const Entry& entry) {}
+
+  private:
+    const size_t _maxEntries;
+
+    // Most recently used entries are at the front.
+    list<Entry> _entries;
+    unordered_map<string, list<Entry>::iterator> _index;
+};
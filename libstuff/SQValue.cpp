@@ -4,11 +4,14 @@
 
 // All of our constructor bodies are empty, we just use member initializer lists.
 SQValue::SQValue() : type(SQValue::TYPE::NONE) {}
+SQValue::SQValue(int val) : type(SQValue::TYPE::INTEGER), integer(val) {}
 SQValue::SQValue(int64_t val) : type(SQValue::TYPE::INTEGER), integer(val) {}
 SQValue::SQValue(double val) : type(SQValue::TYPE::REAL), real(val) {}
 SQValue::SQValue(const char* val) : type(SQValue::TYPE::TEXT), text(val ? val : "") {}
 SQValue::SQValue(const string& val) : type(SQValue::TYPE::TEXT), text(val) {}
+SQValue::SQValue(string&& val) : type(SQValue::TYPE::TEXT), text(move(val)) {}
 SQValue::SQValue(TYPE t, const string& val) : type(t), text(val) {}
+SQValue::SQValue(TYPE t, string&& val) : type(t), text(move(val)) {}
 
 SQValue::operator string() const {
     switch (type) {
@@ -125,3 +128,81 @@ ostream& operator<<(ostream& os, const SQValue& v) {
     os << static_cast<string>(v);
     return os;
 }
+
+int SQValue::bind(sqlite3_stmt* statement, int index) const {
+    switch (type) {
+        case TYPE::INTEGER:
+            return sqlite3_bind_int64(statement, index, integer);
+        case TYPE::REAL:
+            return sqlite3_bind_double(statement, index, real);
+        case TYPE::TEXT:
+            return sqlite3_bind_text(statement, index, text.data(), text.size(), SQLITE_STATIC);
+        case TYPE::BLOB:
+            return sqlite3_bind_blob(statement, index, text.data(), text.size(), SQLITE_STATIC);
+        case TYPE::NONE:
+        default:
+            return sqlite3_bind_null(statement, index);
+    }
+}
+
+string SQValue::toSQLLiteral() const {
+    switch (type) {
+        case TYPE::INTEGER:
+            return std::to_string(integer);
+        case TYPE::REAL:
+        {
+            // SQLite stores NaN as NULL, and overflows out-of-range literals to infinity.
+            if (isnan(real)) {
+                return "NULL";
+            }
+            if (isinf(real)) {
+                return real > 0 ? "9e999" : "-9e999";
+            }
+
+            // 17 significant digits is enough to round-trip any double exactly. Make sure integral values still parse
+            // as REAL.
+            char buf[64];
+            snprintf(buf, sizeof(buf), "%.17g", real);
+            string literal = buf;
+            if (literal.find_first_of(".eE") == string::npos) {
+                literal += ".0";
+            }
+            return literal;
+        }
+        case TYPE::TEXT:
+        {
+            // A quoted literal ends at the first null byte when the query is parsed, so text containing one is written
+            // as its bytes instead, converted back to TEXT.
+            if (text.find('\0') != string::npos) {
+                return "CAST(" + SQValue(TYPE::BLOB, text).toSQLLiteral() + " AS TEXT)";
+            }
+            string literal;
+            literal.reserve(text.size() + 2);
+            literal += '\'';
+            for (char c : text) {
+                if (c == '\'') {
+                    literal += '\'';
+                }
+                literal += c;
+            }
+            literal += '\'';
+            return literal;
+        }
+        case TYPE::BLOB:
+        {
+            static const char* hexDigits = "0123456789ABCDEF";
+            string literal;
+            literal.reserve(text.size() * 2 + 3);
+            literal += "X'";
+            for (unsigned char c : text) {
+                literal += hexDigits[c >> 4];
+                literal += hexDigits[c & 0xF];
+            }
+            literal += '\'';
+            return literal;
+        }
+        case TYPE::NONE:
+        default:
+            return "NULL";
+    }
+}
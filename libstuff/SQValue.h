@@ -1,13 +1,17 @@
 
 #pragma once
+#include <cstdint>
 #include <string>
 using namespace std;
 
+struct sqlite3_stmt;
+
 class SQValue {
 public:
 
-    // Each value is typed to one of SQLite's types.
-    enum class TYPE {
+    // Each value is typed to one of SQLite's types. These are a single byte, so arrays of them (as in
+    // SQColumnarResult) stay small.
+    enum class TYPE : uint8_t {
         NONE, // because NULL is overloaded.
         INTEGER,
         REAL,
@@ -19,11 +23,14 @@ public:
     // TEXT and BLOB are treated internally the same, so if you construct from a plain
     // string object, you get TEXT. If you want BLOB, you need to pass the type BLOB.
     SQValue();
+    SQValue(int val);
     SQValue(int64_t val);
     SQValue(double val);
     SQValue(const char* val);
     explicit SQValue(const string& val);
+    explicit SQValue(string&& val);
     explicit SQValue(TYPE t, const string& val);
+    explicit SQValue(TYPE t, string&& val);
 
     // We have a *whole bunch* of string utility functions for conferting typed data
     // back to strings. All existing code expects strings and so we allow this to work as a string everywhere.
@@ -55,6 +62,15 @@ public:
     // Allow serialization as as string.
     friend ostream& operator<<(ostream& os, const SQValue& v);
 
+    // Binds this value to the parameter at `index` (1-based) in `statement`. TEXT and BLOB values are bound without
+    // copying, so this object must outlive the execution of the statement. Returns an SQLite result code.
+    int bind(sqlite3_stmt* statement, int index) const;
+
+    // Returns this value as an SQL literal that evaluates to exactly the same value, such that a query with this
+    // literal substituted for a bound parameter will have identical results. Used to journal queries that were run
+    // with bound parameters.
+    string toSQLLiteral() const;
+
 private:
 
     // Type of data currently stored. There's no mechanism to change this once created aside from the assignment operator.
@@ -1,6 +1,10 @@
 #pragma once
 #include <libstuff/libstuff.h>
+#include <atomic>
 #include <condition_variable>
+#include <limits>
+#include <memory>
+#include <shared_mutex>
 
 // A scheduled priority queue does the following:
 // Enqueues items with a scheduled time, a priority, and a timeout.
@@ -22,6 +26,11 @@
 // If two items have the same priority, the one with the older scheduled timestamp is returned.
 //
 // Items scheduled in the future are never returned (unless they've timed out).
+//
+// Every worker thread calls `get` on the same queue, so it's built to keep them from contending with each other: items
+// are kept in a separate bucket for each priority, each with its own lock, and each bucket publishes the earliest
+// scheduled time and timeout in it as atomics, so `get` can find the bucket to take from without locking the others.
+// Callers only share a lock when there's nothing to take and they need to wait, and `push` only wakes one of them.
 template<typename T>
 class SScheduledPriorityQueue {
   public:
@@ -74,19 +83,56 @@ class SScheduledPriorityQueue {
         Timeout timeout;
     };
 
+    // Used for `nextScheduled` and `nextTimeout` when a bucket is empty.
+    static constexpr uint64_t NONE = numeric_limits<uint64_t>::max();
+
+    // All the items queued at a single priority.
+    struct Bucket {
+        // Items sorted by their scheduled time, and each item's timeout, so we can find the one that times out first.
+        multimap<Scheduled, ItemTimeoutPair> items;
+        multimap<Timeout, Scheduled> timeouts;
+
+        // The earliest scheduled time and timeout in this bucket, readable without `bucketMutex`.
+        atomic<Scheduled> nextScheduled{NONE};
+        atomic<Timeout> nextTimeout{NONE};
+
+        mutex bucketMutex;
+
+        // Updates `nextScheduled` and `nextTimeout`. Call with `bucketMutex` held after changing anything.
+        void updateNext() {
+            nextScheduled = items.empty() ? NONE : items.begin()->first;
+            nextTimeout = timeouts.empty() ? NONE : timeouts.begin()->first;
+        }
+    };
+
     // Removes an item from the queue and returns it, if a suitable item is available (see the comment at the top of
-    // this file for what counts as a suitable item). Throws `out_of_range` otherwise.
+    // this file for what counts as a suitable item). Throws `out_of_range` otherwise. Call with `_bucketsMutex` held
+    // (shared is fine).
     T _dequeue();
 
-    // Synchronization primitives for managing access to the queue.
-    mutex _queueMutex;
-    condition_variable _queueCondition;
+    // Removes the item at `it` from `bucket` and returns it. Call with the bucket's `bucketMutex` held.
+    T _remove(Bucket& bucket, typename multimap<Scheduled, ItemTimeoutPair>::iterator it);
+
+    // Calls `function` on every queued item.
+    void _forEachItem(function<void(const T&)> function);
+
+    // Discards every item scheduled at or after `scheduled` (without calling the end function), and returns how many
+    // were discarded.
+    size_t _eraseScheduledFrom(Scheduled scheduled);
 
-    // The main queue is a map of priorities to the items queued at that priority, sorted by their scheduled time.
-    map<Priority, multimap<Scheduled, ItemTimeoutPair>> _queue;
+    // The buckets, by priority. Buckets are only ever added (with `_bucketsMutex` held exclusively), never removed, so
+    // once a bucket exists anyone holding `_bucketsMutex` shared can use it.
+    shared_mutex _bucketsMutex;
+    map<Priority, unique_ptr<Bucket>> _buckets;
 
-    // A map of timeouts back into the respective priority queue to find the item with the given timeout.
-    multimap<Timeout, pair<Priority, Scheduled>> _lookupByTimeout;
+    // Total number of items across all buckets.
+    atomic<size_t> _size{0};
+
+    // Callers of `get` that found nothing to take wait on `_waitCondition`, and count themselves in `_waiters` first,
+    // so `push` can skip notifying anyone when nobody's waiting.
+    mutex _waitMutex;
+    condition_variable _waitCondition;
+    atomic<size_t> _waiters{0};
 
     // Functions to call on each item when inserting or removing from the queue.
     function<void(T&)> _startFunction;
@@ -95,31 +141,40 @@ class SScheduledPriorityQueue {
 
 template<typename T>
 void SScheduledPriorityQueue<T>::clear()  {
-    lock_guard<decltype(_queueMutex)> lock(_queueMutex);
-    _queue.clear();
-    _lookupByTimeout.clear();
+    unique_lock<decltype(_bucketsMutex)> lock(_bucketsMutex);
+    for (auto& bucket : _buckets) {
+        bucket.second->items.clear();
+        bucket.second->timeouts.clear();
+        bucket.second->updateNext();
+    }
+    _size = 0;
 }
 
 template<typename T>
 bool SScheduledPriorityQueue<T>::empty()  {
-    lock_guard<decltype(_queueMutex)> lock(_queueMutex);
-    return _queue.empty();
+    return _size == 0;
 }
 
 template<typename T>
 size_t SScheduledPriorityQueue<T>::size()  {
-    lock_guard<decltype(_queueMutex)> lock(_queueMutex);
-    size_t size = 0;
-    for (const auto& queue : _queue) {
-        size += queue.second.size();
-    }
-    return size;
+    return _size;
 }
 
 template<typename T>
 T SScheduledPriorityQueue<T>::get(uint64_t waitUS, bool loggingEnabled) {
-    unique_lock<mutex> queueLock(_queueMutex);
+    // If there's already work in the queue, just return some.
+    {
+        shared_lock<decltype(_bucketsMutex)> bucketsLock(_bucketsMutex);
+        try {
+            return _dequeue();
+        } catch (const out_of_range& e) {
+            // Nothing available.
+        }
+    }
 
+    // Otherwise, we'll wait for some. We count ourselves as waiting *before* checking again, so anything pushed after
+    // that check is guaranteed to see us and wake someone up.
+    //
     // NOTE:
     // Possible future improvement: Say there's work in the queue, but it's not ready yet (i.e., it's scheduled in the
     // future). Someone calls `get(1000000)`, and nothing gets added to the queue during that second (which would wake
@@ -129,197 +184,163 @@ T SScheduledPriorityQueue<T>::get(uint64_t waitUS, bool loggingEnabled) {
     // (03-2017) use case, where we interrupt every second and only really use scheduling at 1-second granularity.
     //
     // What we could do, is truncate the timeout to not be farther in the future than the next timestamp in the list.
+    unique_lock<mutex> waitLock(_waitMutex);
+    _waiters++;
+    auto timeout = chrono::steady_clock::now() + chrono::microseconds(waitUS);
+    while (true) {
+        // If we got any work, return it.
+        try {
+            shared_lock<decltype(_bucketsMutex)> bucketsLock(_bucketsMutex);
+            T item = _dequeue();
+            _waiters--;
+            return item;
+        } catch (const out_of_range& e) {
+            // Still nothing available.
+        }
 
-    // If there's already work in the queue, just return some.
-    try {
-        return _dequeue();
-    } catch (const out_of_range& e) {
-        // Nothing available.
-    }
-
-    // Otherwise, we'll wait for some.
-    if (waitUS) {
-        auto timeout = chrono::steady_clock::now() + chrono::microseconds(waitUS);
-        while (true) {
-            if (loggingEnabled) {
-                SINFO("[performance] Waiting for internal notify or timeout.");
-            }
-            // Wait until we hit our timeout, or someone gives us some work.
-            _queueCondition.wait_until(queueLock, timeout);
-            if (loggingEnabled) {
-                SINFO("[performance] Notified or timed out, trying to return work.");
-            }
-            // If we got any work, return it.
-            try {
-                return _dequeue();
-            } catch (const out_of_range& e) {
-                // Still nothing available.
-            }
-
-            // Did we go past our timeout? If so, we give up. Otherwise, we awoke spuriously, and will retry.
+        if (waitUS) {
+            // Did we go past our timeout? If so, we give up. Otherwise, we either just started waiting, or awoke
+            // spuriously, and will wait again.
             if (chrono::steady_clock::now() > timeout) {
                 if (loggingEnabled) {
                     SINFO("[performance] Timed out and there was no work to be done.");
                 }
+                _waiters--;
                 throw timeout_error();
             }
             if (loggingEnabled) {
-                SINFO("[performance] Returned work from the queue, relooping.");
+                SINFO("[performance] Waiting for internal notify or timeout.");
             }
-        }
-    } else {
-        // Wait indefinitely.
-        while (true) {
-            _queueCondition.wait(queueLock);
-            try {
-                return _dequeue();
-            } catch (const out_of_range& e) {
-                // Nothing yet, loop again.
+
+            // Wait until we hit our timeout, or someone gives us some work.
+            _waitCondition.wait_until(waitLock, timeout);
+            if (loggingEnabled) {
+                SINFO("[performance] Notified or timed out, trying to return work.");
             }
+        } else {
+            // Wait indefinitely.
+            _waitCondition.wait(waitLock);
         }
     }
 }
 
 template<typename T>
 void SScheduledPriorityQueue<T>::push(T&& item, Priority priority, Scheduled scheduled, Timeout timeout) {
-    lock_guard<decltype(_queueMutex)> lock(_queueMutex);
-    auto& queue = _queue[priority];
     _startFunction(item);
-    _lookupByTimeout.insert(make_pair(timeout, make_pair(priority, scheduled)));
-    queue.emplace(scheduled, ItemTimeoutPair(move(item), timeout));
-    _queueCondition.notify_one();
+    {
+        shared_lock<decltype(_bucketsMutex)> bucketsLock(_bucketsMutex);
+        auto bucketIt = _buckets.find(priority);
+        if (bucketIt == _buckets.end()) {
+            // First item ever at this priority, we need to add a bucket for it.
+            bucketsLock.unlock();
+            {
+                unique_lock<decltype(_bucketsMutex)> createLock(_bucketsMutex);
+                _buckets.try_emplace(priority, make_unique<Bucket>());
+            }
+            bucketsLock.lock();
+            bucketIt = _buckets.find(priority);
+        }
+        Bucket& bucket = *bucketIt->second;
+        lock_guard<mutex> bucketLock(bucket.bucketMutex);
+        bucket.timeouts.emplace(timeout, scheduled);
+        bucket.items.emplace(scheduled, ItemTimeoutPair(move(item), timeout));
+        bucket.updateNext();
+        _size++;
+    }
+
+    // Only bother with the lock if someone's waiting.
+    if (_waiters) {
+        lock_guard<mutex> waitLock(_waitMutex);
+        _waitCondition.notify_one();
+    }
 }
 
 template<typename T>
-T SScheduledPriorityQueue<T>::_dequeue() {
-    // NOTE: We don't grab a mutex here on purpose - we use a non-recursive mutex to work with condition_variable, so
-    // we need to only lock it once, which we've already done in whichever function is calling this one (since this is
-    // private).
+T SScheduledPriorityQueue<T>::_remove(Bucket& bucket, typename multimap<Scheduled, ItemTimeoutPair>::iterator it) {
+    const Scheduled itemScheduled = it->first;
+    const Timeout itemTimeout = it->second.timeout;
+    T item = move(it->second.item);
+    bucket.items.erase(it);
+
+    // Remove it from the timeout map, as well.
+    bool foundTimeout = false;
+    auto matchingTimeoutIterators = bucket.timeouts.equal_range(itemTimeout);
+    for (auto timeoutIt = matchingTimeoutIterators.first; timeoutIt != matchingTimeoutIterators.second; timeoutIt++) {
+        if (timeoutIt->second == itemScheduled) {
+            bucket.timeouts.erase(timeoutIt);
+            foundTimeout = true;
+            break;
+        }
+    }
+    if (!foundTimeout) {
+        // We should always find one, some timeout should match.
+        SWARN("Did not find a matching timeout (" << itemTimeout << ") to remove for item scheduled at " << itemScheduled);
+    }
+
+    bucket.updateNext();
+    _size--;
+    _endFunction(item);
+    return item;
+}
 
+template<typename T>
+T SScheduledPriorityQueue<T>::_dequeue() {
     // We need to know what time it is, so that we can compare to scheduled times.
     uint64_t now = STimeNow();
 
-    // If anything has timed out, pull that out of the queue, and return that first.
-    if (_lookupByTimeout.size()) {
-
-        // Get the first item in the timeout map (they're in order).
-        auto timeoutIt = _lookupByTimeout.begin();
-
-        // Convenience names for legibility.
-        const Timeout& itemTimeout = timeoutIt->first;
-        const Priority& itemPriority = timeoutIt->second.first;
-        const Scheduled& itemScheduled = timeoutIt->second.second;
-
-        // Has this timed out? If so, this is the item we'll return (regardless of which priority it had).
-        if (itemTimeout <= now) {
-
-            // Find the correct priority queue for this item.
-            auto priorityQueueIt = _queue.find(itemPriority);
-            if (priorityQueueIt != _queue.end()) {
-
-                // Find all the items in this priority queue scheduled at this particular moment.
-                auto matchingItemIterators = priorityQueueIt->second.equal_range(itemScheduled);
-
-                // Iterate across the matching section of items.
-                size_t itemsChecked = 0;
-                for (auto it = matchingItemIterators.first; it != matchingItemIterators.second; it++) {
-                    itemsChecked++;
-
-                    // Convenience names for legibility.
-                    ItemTimeoutPair& thisItemTimeoutPair = it->second;
-
-                    // Is this the one that timed out?
-                    if (thisItemTimeoutPair.timeout == itemTimeout) {
-
-                        // Yep, this one timed out. Pull it out of the queue.
-                        T item = move(thisItemTimeoutPair.item);
-
-                        // Erase this item from the main queue.
-                        priorityQueueIt->second.erase(it);
-
-                        // If this priority queue is empty, erase the whole thing.
-                        if (priorityQueueIt->second.empty()) {
-                            _queue.erase(priorityQueueIt);
-                        }
-
-                        // And erase it from the timeout map, too.
-                        _lookupByTimeout.erase(timeoutIt);
-
-                        // Call the end function and return the item.
-                        _endFunction(item);
-                        return item;
-                    }
-                }
-                if (!itemsChecked) {
-                    SWARN("No items found scheduled at requested time: " << itemScheduled);
-                } else {
-                    SWARN("Checked " << itemsChecked << " items scheduled at " << itemScheduled << " but none had timeout " << itemTimeout);
-                }
-            } else {
-                SWARN("No queue found with priority: " << itemPriority);
+    // If anything has timed out, pull that out of the queue, and return that first. We find the bucket with the oldest
+    // timeout without locking anything, and then lock just that bucket to take it. If someone else took it first,
+    // we look again.
+    while (true) {
+        Bucket* timedOutBucket = nullptr;
+        Timeout oldestTimeout = NONE;
+        for (auto& bucket : _buckets) {
+            Timeout bucketTimeout = bucket.second->nextTimeout;
+            if (bucketTimeout < oldestTimeout) {
+                oldestTimeout = bucketTimeout;
+                timedOutBucket = bucket.second.get();
             }
-
-            // This isn't supposed to be possible.
-            SWARN("Timeout (" << itemTimeout << ") before now, but couldn't find a item for it?");
-            _lookupByTimeout.erase(timeoutIt);
         }
-    }
-
-    // Ok, if we got here nothing has timed out, so we'll just look at each queue, in priority order, to see if any
-    // items are ready to return.
-    for (auto queueIt = _queue.rbegin(); queueIt != _queue.rend(); ++queueIt) {
-
-        // Record the priority of the queue we're currently looking at.
-        Priority queuePriority = queueIt->first;
-
-        // And look at the first item in this particular priority queue.
-        auto itemIt = queueIt->second.begin();
-
-        // Convenience names for legibility.
-        const Scheduled thisItemScheduled = itemIt->first;
-        ItemTimeoutPair& thisItemTimeoutPair = itemIt->second;
-        const Timeout thisItemTimeout = thisItemTimeoutPair.timeout;
-
-        // If the item is scheduled before now, we can return it. Otherwise, since these are in scheduled order, there
-        // are no usable items in this queue, and we can go on to the next one.
-        if (thisItemScheduled <= now) {
-
-            // Pull out the item we want to return.
-            T item = move(thisItemTimeoutPair.item);
+        if (!timedOutBucket || oldestTimeout > now) {
+            break;
+        }
 
-            // Delete the entry in this queue.
-            queueIt->second.erase(itemIt);
+        lock_guard<mutex> bucketLock(timedOutBucket->bucketMutex);
+        if (timedOutBucket->timeouts.empty() || timedOutBucket->timeouts.begin()->first > now) {
+            continue;
+        }
 
-            // If the whole queue is empty, delete that too.
-            if (queueIt->second.empty()) {
-                // The odd syntax in the argument converts a reverse to forward iterator.
-                _queue.erase(next(queueIt).base());
+        // Find the item with this timeout among the items scheduled at its scheduled time.
+        auto timeoutIt = timedOutBucket->timeouts.begin();
+        auto matchingItemIterators = timedOutBucket->items.equal_range(timeoutIt->second);
+        for (auto it = matchingItemIterators.first; it != matchingItemIterators.second; it++) {
+            if (it->second.timeout == timeoutIt->first) {
+                return _remove(*timedOutBucket, it);
             }
+        }
 
-            // Remove from the timeout map, as well.
-            auto matchingTimeoutIterators = _lookupByTimeout.equal_range(thisItemTimeout);
-            for (auto it = matchingTimeoutIterators.first; it != matchingTimeoutIterators.second; it++) {
-
-                // Convenience names for legibility.
-                auto& timeoutPair = it->second;
-                Priority& thisTimeoutPriority = timeoutPair.first;
-                Scheduled& thisTimeoutScheduled = timeoutPair.second;
+        // This isn't supposed to be possible.
+        SWARN("Timeout (" << timeoutIt->first << ") before now, but couldn't find a item for it?");
+        timedOutBucket->timeouts.erase(timeoutIt);
+        timedOutBucket->updateNext();
+    }
 
-                // If this timeout entry has the same queue that we're in, and the same scheduled time, we can remove
-                // it.
-                if (thisTimeoutPriority == queuePriority && thisTimeoutScheduled == thisItemScheduled) {
-                    _lookupByTimeout.erase(it);
-                    break;
-                }
+    // Ok, if we got here nothing has timed out, so we'll just look at each bucket, in priority order, to see if any
+    // items are ready to return.
+    for (auto bucketIt = _buckets.rbegin(); bucketIt != _buckets.rend(); ++bucketIt) {
+        Bucket& bucket = *bucketIt->second;
 
-                // We should always break before we get here, some timeout should match.
-                SWARN("Did not find a matching timeout (" << thisItemTimeout << ") to remove for command: " << item->request.methodLine);
-            }
+        // Items are in scheduled order, so if the first one isn't ready, nothing in this bucket is.
+        if (bucket.nextScheduled > now) {
+            continue;
+        }
 
-            // Call the end function and return!
-            _endFunction(item);
-            return item;
+        // Make sure it's still there now that we hold the lock.
+        lock_guard<mutex> bucketLock(bucket.bucketMutex);
+        if (bucket.items.empty() || bucket.items.begin()->first > now) {
+            continue;
         }
+        return _remove(bucket, bucket.items.begin());
     }
 
     // No item suitable to return.
@@ -328,20 +349,56 @@ T SScheduledPriorityQueue<T>::_dequeue() {
 
 template<typename T>
 list<T> SScheduledPriorityQueue<T>::getAll() {
-    lock_guard<decltype(_queueMutex)> lock(_queueMutex);
+    unique_lock<decltype(_bucketsMutex)> lock(_bucketsMutex);
     list<T> items;
 
-    // Iterate across each map in each queue and pull out all the items.
-    for (auto& queue: _queue) {
-        for (auto& p : queue.second) {
+    // Iterate across each item in each bucket and pull them all out.
+    for (auto& bucket : _buckets) {
+        for (auto& p : bucket.second->items) {
             _endFunction(p.second.item);
             items.emplace_back(move(p.second.item));
         }
+        bucket.second->items.clear();
+        bucket.second->timeouts.clear();
+        bucket.second->updateNext();
     }
-
-    // Call the same thing that `clear()` does, but without locking recursively.
-    _queue.clear();
-    _lookupByTimeout.clear();
+    _size = 0;
 
     return items;
 }
+
+template<typename T>
+void SScheduledPriorityQueue<T>::_forEachItem(function<void(const T&)> function) {
+    shared_lock<decltype(_bucketsMutex)> lock(_bucketsMutex);
+    for (auto& bucket : _buckets) {
+        lock_guard<mutex> bucketLock(bucket.second->bucketMutex);
+        for (auto& p : bucket.second->items) {
+            function(p.second.item);
+        }
+    }
+}
+
+template<typename T>
+size_t SScheduledPriorityQueue<T>::_eraseScheduledFrom(Scheduled scheduled) {
+    shared_lock<decltype(_bucketsMutex)> lock(_bucketsMutex);
+    size_t erased = 0;
+    for (auto& bucket : _buckets) {
+        lock_guard<mutex> bucketLock(bucket.second->bucketMutex);
+        auto& items = bucket.second->items;
+        auto& timeouts = bucket.second->timeouts;
+        for (auto it = items.lower_bound(scheduled); it != items.end(); ) {
+            auto matchingTimeoutIterators = timeouts.equal_range(it->second.timeout);
+            for (auto timeoutIt = matchingTimeoutIterators.first; timeoutIt != matchingTimeoutIterators.second; timeoutIt++) {
+                if (timeoutIt->second == it->first) {
+                    timeouts.erase(timeoutIt);
+                    break;
+                }
+            }
+            it = items.erase(it);
+            erased++;
+        }
+        bucket.second->updateNext();
+    }
+    _size -= erased;
+    return erased;
+}
@@ -274,9 +274,11 @@ void _SSignal_StackTrace(int signum, siginfo_t *info, void *ucontext) {
         // If we weren't already in ABORT, we'll call that. The second call will skip the above callstack generation.
         if (signum != SIGABRT) {
             SWARN("Aborting.");
+            SLogAsyncFlush();
             abort();
         } else {
             SWARN("Already in ABORT.");
+            SLogAsyncFlush();
         }
     } else {
         SALERT("Non-signal thread got signal " << strsignal(signum) << "(" << signum << "), which wasn't expected");
@@ -12,6 +12,7 @@
 #include <cxxabi.h>
 #include <sys/ioctl.h>
 #include <cmath>
+#include <condition_variable>
 #include <iostream>
 
 #include <thread>
@@ -25,9 +26,16 @@
 #include <mbedtls/sha1.h>
 #include <mbedtls/sha256.h>
 
+#if defined(__x86_64__)
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+
+#include <libstuff/SQColumnarResult.h>
 #include <libstuff/SQResult.h>
 #include <libstuff/SData.h>
 #include <libstuff/SFastBuffer.h>
+#include <libstuff/SQStatementCache.h>
 #include <libstuff/sqlite3.h>
 
 // Additional headers
@@ -103,7 +111,7 @@ atomic<size_t> SLogSocketCurrentOffset(0);
 struct sockaddr_un SLogSocketAddr;
 atomic_flag SLogSocketsInitialized = ATOMIC_FLAG_INIT;
 
-// Set to `syslog` or `SSyslogSocketDirect`.
+// Set to `syslog`, `SSyslogSocketDirect` or `SSyslogAsync`.
 atomic<void (*)(int priority, const char *format, ...)> SSyslogFunc = &syslog;
 
 void SInitialize(const string& threadName, const char* processName) {
@@ -268,6 +276,312 @@ void SSyslogSocketDirect(int priority, const char *format, ...) {
     }
 }
 
+// Each line `SSyslogAsync` buffers is stored as one of these, followed by the datagram to send.
+struct SLogAsyncLineHeader {
+    uint32_t size;
+    uint16_t priority;
+
+    // Where the message starts after the "<priority>process: " prefix, so we can fall back to syslog with it.
+    uint16_t messageOffset;
+};
+
+// A ring of buffered lines with a single producer, the thread that owns it, and a single consumer, the async log
+// thread, so neither side ever takes a lock.
+struct SLogAsyncBuffer {
+    SLogAsyncBuffer(size_t capacity) : data(new char[capacity]), capacity(capacity) { }
+
+    // Copy `size` bytes to or from the ring at `position`, wrapping around the end.
+    void write(uint64_t position, const char* source, size_t size) {
+        size_t offset = position % capacity;
+        size_t first = min(size, capacity - offset);
+        memcpy(data.get() + offset, source, first);
+        memcpy(data.get(), source + first, size - first);
+    }
+    void read(uint64_t position, char* destination, size_t size) const {
+        size_t offset = position % capacity;
+        size_t first = min(size, capacity - offset);
+        memcpy(destination, data.get() + offset, first);
+        memcpy(destination + first, data.get(), size - first);
+    }
+
+    unique_ptr<char[]> data;
+    const size_t capacity;
+
+    // Total bytes ever written and read. Only the owning thread moves `head`, and only the async log thread moves
+    // `tail`.
+    atomic<uint64_t> head{0};
+    atomic<uint64_t> tail{0};
+
+    // Set when the owning thread exits, so the async log thread can discard this once it's drained.
+    atomic<bool> orphaned{false};
+};
+
+// Holds the calling thread's buffer, and marks it orphaned when the thread exits.
+struct SLogAsyncBufferOwner {
+    ~SLogAsyncBufferOwner() {
+        if (buffer) {
+            buffer->orphaned = true;
+        }
+    }
+    shared_ptr<SLogAsyncBuffer> buffer;
+    uint64_t generation = 0;
+};
+
+// `SLogAsyncMutex` protects the list of buffers, and the thread and its settings while starting and stopping.
+// `SLogAsyncDrainMutex` is held by whichever thread is reading lines out of the buffers and sending them, so that
+// only one does at a time, and lines are sent in the order they were read.
+mutex SLogAsyncMutex;
+timed_mutex SLogAsyncDrainMutex;
+condition_variable SLogAsyncCV;
+list<shared_ptr<SLogAsyncBuffer>> SLogAsyncBuffers;
+thread SLogAsyncThread;
+bool SLogAsyncExiting = false;
+size_t SLogAsyncBufferSize = 0;
+struct sockaddr_un SLogAsyncAddr;
+atomic<bool> SLogAsyncRunning(false);
+atomic<uint64_t> SLogAsyncDropped(0);
+
+// Incremented each time we start, so threads don't keep writing to buffers from a previous run.
+atomic<uint64_t> SLogAsyncGeneration(0);
+
+static bool SLogAsyncSendNow(const char* line, const SLogAsyncLineHeader& header);
+
+void SSyslogAsync(int priority, const char *format, ...) {
+    static const size_t MAX_MESSAGE_SIZE = 8 * 1024;
+    thread_local char messageBuffer[MAX_MESSAGE_SIZE];
+    int headerSize = snprintf(messageBuffer, MAX_MESSAGE_SIZE, "<%i>%s: ", 8 + priority, SProcessName.c_str());
+    va_list argptr;
+    va_start(argptr, format);
+    int messageSize = vsnprintf(messageBuffer + headerSize, MAX_MESSAGE_SIZE - headerSize, format, argptr);
+    va_end(argptr);
+    messageSize = min(messageSize, (int)(MAX_MESSAGE_SIZE - headerSize - 1));
+
+    if (!SLogAsyncRunning.load(memory_order_acquire)) {
+        syslog(priority, "%s", messageBuffer + headerSize);
+        return;
+    }
+    if (priority <= LOG_ERR) {
+        // Send this now, in case we're about to abort, but after everything logged before it.
+        SLogAsyncLineHeader header = {(uint32_t)(headerSize + messageSize), (uint16_t)priority, (uint16_t)headerSize};
+        if (!SLogAsyncSendNow(messageBuffer, header)) {
+            SSyslogSocketDirect(priority, "%s", messageBuffer + headerSize);
+        }
+        return;
+    }
+
+    thread_local SLogAsyncBufferOwner owner;
+    const uint64_t generation = SLogAsyncGeneration.load();
+    if (owner.generation != generation) {
+        if (owner.buffer) {
+            owner.buffer->orphaned = true;
+        }
+        owner.buffer = make_shared<SLogAsyncBuffer>(SLogAsyncBufferSize);
+        owner.generation = generation;
+        lock_guard<mutex> lock(SLogAsyncMutex);
+        SLogAsyncBuffers.push_back(owner.buffer);
+    }
+
+    // If there's no room, drop the line rather than wait for the async log thread to catch up.
+    SLogAsyncBuffer& buffer = *owner.buffer;
+    SLogAsyncLineHeader header = {(uint32_t)(headerSize + messageSize), (uint16_t)priority, (uint16_t)headerSize};
+    const size_t lineSize = sizeof(header) + header.size;
+    const uint64_t head = buffer.head.load(memory_order_relaxed);
+    const uint64_t used = head - buffer.tail.load(memory_order_acquire);
+    if (buffer.capacity - used < lineSize) {
+        SLogAsyncDropped++;
+        return;
+    }
+    buffer.write(head, (const char*)&header, sizeof(header));
+    buffer.write(head + sizeof(header), messageBuffer, header.size);
+    buffer.head.store(head + lineSize, memory_order_release);
+
+    // Once we're half full, wake the async log thread rather than wait for its next pass.
+    if (used + lineSize > buffer.capacity / 2) {
+        SLogAsyncCV.notify_one();
+    }
+}
+
+// Sends `lines` (offsets into `batch` and their headers) to the syslog socket, as many per system call as we can.
+static void SLogAsyncSend(int socketFD, const vector<char>& batch, const vector<pair<size_t, SLogAsyncLineHeader>>& lines) {
+    static const size_t MAX_BATCH_LINES = 64;
+    struct mmsghdr messages[MAX_BATCH_LINES];
+    struct iovec iovecs[MAX_BATCH_LINES];
+    size_t sent = 0;
+    while (sent < lines.size()) {
+        size_t count = min(MAX_BATCH_LINES, lines.size() - sent);
+        for (size_t i = 0; i < count; i++) {
+            iovecs[i].iov_base = (void*)(batch.data() + lines[sent + i].first);
+            iovecs[i].iov_len = lines[sent + i].second.size;
+            messages[i] = {};
+            messages[i].msg_hdr.msg_name = (void*)&SLogAsyncAddr;
+            messages[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_un);
+            messages[i].msg_hdr.msg_iov = &iovecs[i];
+            messages[i].msg_hdr.msg_iovlen = 1;
+        }
+        int result = socketFD == -1 ? -1 : sendmmsg(socketFD, messages, count, 0);
+        if (result > 0) {
+            sent += result;
+            continue;
+        }
+        if (result == -1 && errno == EINTR) {
+            continue;
+        }
+
+        // Same as `SSyslogSocketDirect`, if we can't use the socket, fall back to the syslog syscall.
+        int socketError = socketFD == -1 ? EBADF : errno;
+        syslog(LOG_WARNING, "Could not use async logging socket (error: %i, %s), falling back to syslog syscall.", socketError, strerror(socketError));
+        for (; sent < lines.size(); sent++) {
+            const SLogAsyncLineHeader& header = lines[sent].second;
+            syslog(header.priority, "%.*s", (int)(header.size - header.messageOffset), batch.data() + lines[sent].first + header.messageOffset);
+        }
+    }
+}
+
+// Copies every line in `buffers` into `batch`, and gives each thread its space back. The caller must hold
+// `SLogAsyncDrainMutex`.
+static void SLogAsyncCollect(const list<shared_ptr<SLogAsyncBuffer>>& buffers, vector<char>& batch, vector<pair<size_t, SLogAsyncLineHeader>>& lines) {
+    for (auto& buffer : buffers) {
+        uint64_t tail = buffer->tail.load(memory_order_relaxed);
+        const uint64_t head = buffer->head.load(memory_order_acquire);
+        while (tail < head) {
+            SLogAsyncLineHeader header;
+            buffer->read(tail, (char*)&header, sizeof(header));
+            lines.emplace_back(batch.size(), header);
+            batch.resize(batch.size() + header.size);
+            buffer->read(tail + sizeof(header), batch.data() + lines.back().first, header.size);
+            tail += sizeof(header) + header.size;
+        }
+        buffer->tail.store(tail, memory_order_release);
+    }
+}
+
+// Sends everything every thread has buffered, followed by `line` if it's set, from the calling thread rather than
+// waiting for the async log thread. Returns false if we couldn't.
+static bool SLogAsyncSendNow(const char* line, const SLogAsyncLineHeader& header) {
+    // This is called when we're about to crash, possibly from a signal handler that interrupted a thread holding one of
+    // these locks, so we give up after a second rather than risk never getting to abort.
+    unique_lock<timed_mutex> drainLock(SLogAsyncDrainMutex, chrono::seconds(1));
+    if (!drainLock.owns_lock()) {
+        return false;
+    }
+    list<shared_ptr<SLogAsyncBuffer>> buffers;
+    {
+        unique_lock<mutex> lock(SLogAsyncMutex, defer_lock);
+        for (int i = 0; i < 1000 && !lock.try_lock(); i++) {
+            this_thread::sleep_for(chrono::milliseconds(1));
+        }
+        if (!lock.owns_lock()) {
+            return false;
+        }
+        buffers = SLogAsyncBuffers;
+    }
+
+    vector<char> batch;
+    vector<pair<size_t, SLogAsyncLineHeader>> lines;
+    SLogAsyncCollect(buffers, batch, lines);
+    if (line) {
+        lines.emplace_back(batch.size(), header);
+        batch.insert(batch.end(), line, line + header.size);
+    }
+    int socketFD = socket(AF_UNIX, SOCK_DGRAM, 0);
+    SLogAsyncSend(socketFD, batch, lines);
+    if (socketFD != -1) {
+        close(socketFD);
+    }
+    return true;
+}
+
+void SLogAsyncFlush() {
+    if (SLogAsyncRunning.load(memory_order_acquire)) {
+        SLogAsyncSendNow(nullptr, {});
+    }
+}
+
+static void SLogAsyncLoop() {
+    SInitialize("asyncLog");
+    int socketFD = socket(AF_UNIX, SOCK_DGRAM, 0);
+    vector<char> batch;
+    vector<pair<size_t, SLogAsyncLineHeader>> lines;
+    uint64_t droppedReported = SLogAsyncDropped;
+    while (true) {
+        // Check whether we're exiting before draining, so the last pass picks up everything logged before we were
+        // stopped.
+        bool exiting;
+        list<shared_ptr<SLogAsyncBuffer>> buffers;
+        {
+            unique_lock<mutex> lock(SLogAsyncMutex);
+            if (!SLogAsyncExiting) {
+                SLogAsyncCV.wait_for(lock, chrono::milliseconds(10));
+            }
+            exiting = SLogAsyncExiting;
+
+            // Nothing more can be written to orphaned buffers, so once they're empty we're done with them.
+            for (auto it = SLogAsyncBuffers.begin(); it != SLogAsyncBuffers.end();) {
+                if ((*it)->orphaned && (*it)->head == (*it)->tail) {
+                    it = SLogAsyncBuffers.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+            buffers = SLogAsyncBuffers;
+        }
+
+        // Copy everything out first, so each thread gets its space back without waiting on the socket.
+        {
+            lock_guard<timed_mutex> drainLock(SLogAsyncDrainMutex);
+            batch.clear();
+            lines.clear();
+            SLogAsyncCollect(buffers, batch, lines);
+            SLogAsyncSend(socketFD, batch, lines);
+        }
+
+        uint64_t dropped = SLogAsyncDropped;
+        if (dropped != droppedReported) {
+            syslog(LOG_WARNING, "Dropped %lu log lines because logging threads' buffers were full.", dropped - droppedReported);
+            droppedReported = dropped;
+        }
+        if (exiting) {
+            break;
+        }
+    }
+    if (socketFD != -1) {
+        close(socketFD);
+    }
+}
+
+void SLogAsyncStart(size_t bufferSize, const string& socketPath) {
+    lock_guard<mutex> lock(SLogAsyncMutex);
+    if (SLogAsyncThread.joinable()) {
+        return;
+    }
+    SLogAsyncBufferSize = max(bufferSize, (size_t)16 * 1024);
+    SLogAsyncAddr = {};
+    SLogAsyncAddr.sun_family = AF_UNIX;
+    strncpy(SLogAsyncAddr.sun_path, socketPath.c_str(), sizeof(SLogAsyncAddr.sun_path) - 1);
+    SLogAsyncGeneration++;
+    SLogAsyncThread = thread(SLogAsyncLoop);
+    SLogAsyncRunning.store(true, memory_order_release);
+}
+
+void SLogAsyncStop() {
+    {
+        lock_guard<mutex> lock(SLogAsyncMutex);
+        if (!SLogAsyncThread.joinable()) {
+            return;
+        }
+
+        // New lines go straight to syslog from here on.
+        SLogAsyncRunning = false;
+        SLogAsyncExiting = true;
+    }
+    SLogAsyncCV.notify_all();
+    SLogAsyncThread.join();
+
+    lock_guard<mutex> lock(SLogAsyncMutex);
+    SLogAsyncBuffers.clear();
+    SLogAsyncExiting = false;
+}
+
 /////////////////////////////////////////////////////////////////////////////
 // Math stuff
 /////////////////////////////////////////////////////////////////////////////
@@ -1664,7 +1978,7 @@ list<string> SParseJSONArray(const string& array) {
 }
 
 // --------------------------------------------------------------------------
-string SGZip(const string& content) {
+string SGZip(const string& content, int level) {
     z_stream stream;
 
     stream.zalloc = Z_NULL;
@@ -1682,7 +1996,7 @@ string SGZip(const string& content) {
     stream.avail_out = bufferSize;
     stream.next_out = outBuffer;
 
-    int status = deflateInit2(&stream, Z_BEST_COMPRESSION, Z_DEFLATED, MAX_WBITS | GZIP_ENCODING, MAX_MEM_LEVEL,
+    int status = deflateInit2(&stream, level, Z_DEFLATED, MAX_WBITS | GZIP_ENCODING, MAX_MEM_LEVEL,
                               Z_DEFAULT_STRATEGY);
 
     if (status != Z_OK) {
@@ -2411,9 +2725,86 @@ uint64_t SFileSize(const string& path) {
 // Cryptography stuff
 /////////////////////////////////////////////////////////////////////////////
 
+#if defined(__x86_64__)
+// Runs the SHA1 compression function over `blocks` 64-byte blocks of `data` with the SHA instructions, which do four
+// rounds per instruction. This is the bulk of the work of hashing a large buffer, like the query for a commit.
+// Each group of four rounds takes its message words from the previous four groups, and every fifth group switches to
+// the next round function.
+#define SHA1_NI_ROUNDS(G)                                                                                              \
+    if constexpr (G < 4) {                                                                                             \
+        msg[G % 4] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(data + 16 * G)), byteSwap);                     \
+    } else {                                                                                                           \
+        msg[G % 4] = _mm_sha1msg2_epu32(_mm_xor_si128(_mm_sha1msg1_epu32(msg[G % 4], msg[(G + 1) % 4]),               \
+                                                      msg[(G + 2) % 4]), msg[(G + 3) % 4]);                            \
+    }                                                                                                                  \
+    e = G ? _mm_sha1nexte_epu32(previousABCD, msg[G % 4]) : _mm_add_epi32(e, msg[0]);                                  \
+    previousABCD = abcd;                                                                                               \
+    abcd = _mm_sha1rnds4_epu32(abcd, e, G / 5);
+
+__attribute__((target("sha,sse4.1")))
+static void SHashSHA1Blocks(uint32_t state[5], const unsigned char* data, size_t blocks) {
+    const __m128i byteSwap = _mm_set_epi64x(0x0001020304050607ULL, 0x08090a0b0c0d0e0fULL);
+    __m128i abcd = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)state), 0x1B);
+    __m128i e = _mm_set_epi32(state[4], 0, 0, 0);
+    for (; blocks; blocks--, data += 64) {
+        const __m128i abcdStart = abcd;
+        const __m128i eStart = e;
+        __m128i msg[4];
+        __m128i previousABCD = abcd;
+        SHA1_NI_ROUNDS(0)  SHA1_NI_ROUNDS(1)  SHA1_NI_ROUNDS(2)  SHA1_NI_ROUNDS(3)  SHA1_NI_ROUNDS(4)
+        SHA1_NI_ROUNDS(5)  SHA1_NI_ROUNDS(6)  SHA1_NI_ROUNDS(7)  SHA1_NI_ROUNDS(8)  SHA1_NI_ROUNDS(9)
+        SHA1_NI_ROUNDS(10) SHA1_NI_ROUNDS(11) SHA1_NI_ROUNDS(12) SHA1_NI_ROUNDS(13) SHA1_NI_ROUNDS(14)
+        SHA1_NI_ROUNDS(15) SHA1_NI_ROUNDS(16) SHA1_NI_ROUNDS(17) SHA1_NI_ROUNDS(18) SHA1_NI_ROUNDS(19)
+        e = _mm_sha1nexte_epu32(previousABCD, eStart);
+        abcd = _mm_add_epi32(abcd, abcdStart);
+    }
+    _mm_storeu_si128((__m128i*)state, _mm_shuffle_epi32(abcd, 0x1B));
+    state[4] = _mm_extract_epi32(e, 3);
+}
+#undef SHA1_NI_ROUNDS
+
+static bool SHashSHA1HasSHAInstructions() {
+    unsigned int eax, ebx, ecx, edx;
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx) || !(ecx & bit_SSE4_1)) {
+        return false;
+    }
+    return __get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx) && (ebx & bit_SHA);
+}
+#endif
+
 string SHashSHA1(const string& buffer) {
     string result;
     result.resize(20);
+#if defined(__x86_64__)
+    // Where the CPU has the SHA instructions, we use them, as they're several times faster than mbedtls, which matters
+    // when hashing large commits. The result is the same either way.
+    static const bool hasSHAInstructions = SHashSHA1HasSHAInstructions();
+    if (hasSHAInstructions) {
+        uint32_t state[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+        const unsigned char* data = (const unsigned char*)buffer.data();
+        const size_t fullBlocks = buffer.size() / 64;
+        SHashSHA1Blocks(state, data, fullBlocks);
+
+        // Pad what's left with a 1 bit, zeros, and the length in bits, which may spill into a second block.
+        unsigned char tail[128] = {0};
+        const size_t remaining = buffer.size() % 64;
+        memcpy(tail, data + fullBlocks * 64, remaining);
+        tail[remaining] = 0x80;
+        const size_t tailSize = remaining < 56 ? 64 : 128;
+        const uint64_t bits = (uint64_t)buffer.size() * 8;
+        for (int i = 0; i < 8; i++) {
+            tail[tailSize - 1 - i] = (unsigned char)(bits >> (8 * i));
+        }
+        SHashSHA1Blocks(state, tail, tailSize / 64);
+        for (int i = 0; i < 5; i++) {
+            result[4 * i] = (char)(state[i] >> 24);
+            result[4 * i + 1] = (char)(state[i] >> 16);
+            result[4 * i + 2] = (char)(state[i] >> 8);
+            result[4 * i + 3] = (char)state[i];
+        }
+        return result;
+    }
+#endif
     mbedtls_sha1((unsigned char*)buffer.c_str(), buffer.size(), (unsigned char*)&result[0]);
     return result;
 }
@@ -2563,8 +2954,80 @@ void SQueryLogClose() {
 }
 
 // --------------------------------------------------------------------------
+// Collects rows for the batched version of SQuery, handing them off each time they reach `batchBytes`.
+struct SQueryBatch {
+    SQueryBatch(size_t batchBytes_, const function<bool(SQColumnarResult&)>& onRows_)
+      : headers(result.headers), batchBytes(batchBytes_), onRows(onRows_) { }
+
+    void clear() {
+        result.clear();
+    }
+
+    // Hands the rows collected so far to `onRows`, and empties the result for the next batch, keeping the headers.
+    bool flush() {
+        handedOff = true;
+        if (!onRows(result)) {
+            return false;
+        }
+        vector<string> currentHeaders = move(result.headers);
+        result.clear();
+        result.headers = move(currentHeaders);
+        return true;
+    }
+
+    SQColumnarResult result;
+    vector<string>& headers;
+    const size_t batchBytes;
+    const function<bool(SQColumnarResult&)>& onRows;
+    bool handedOff = false;
+};
+
+// Appends the row `statement` is on to `result`. Returns false if the query should stop.
+static bool SQueryAppendRow(SQResult& result, sqlite3_stmt* preparedStatement, int numColumns) {
+    SQResultRow row(result, numColumns);
+    for (int i = 0; i < numColumns; i++) {
+        int colType = sqlite3_column_type(preparedStatement, i);
+        switch (colType) {
+            case SQLITE_INTEGER:
+                row.get(i) = (int64_t)sqlite3_column_int64(preparedStatement, i);
+                break;
+            case SQLITE_FLOAT:
+                row.get(i) = sqlite3_column_double(preparedStatement, i);
+                break;
+            case SQLITE_TEXT:
+                row.get(i) = SQValue(SQValue::TYPE::TEXT, string(reinterpret_cast<const char*>(sqlite3_column_text(preparedStatement, i))));
+                break;
+            case SQLITE_BLOB:
+                row.get(i) = SQValue(SQValue::TYPE::BLOB, string(static_cast<const char*>(sqlite3_column_blob(preparedStatement, i)), sqlite3_column_bytes(preparedStatement, i)));
+                break;
+            case SQLITE_NULL:
+                row.get(i) = SQValue();
+                break;
+        }
+    }
+    result.emplace_back(move(row));
+    return true;
+}
+
+static bool SQueryAppendRow(SQColumnarResult& result, sqlite3_stmt* preparedStatement, int numColumns) {
+    result.appendRow(preparedStatement);
+    return true;
+}
+
+static bool SQueryAppendRow(SQueryBatch& batch, sqlite3_stmt* preparedStatement, int numColumns) {
+    batch.result.appendRow(preparedStatement);
+    return batch.result.byteSize() < batch.batchBytes || batch.flush();
+}
+
 // Executes a SQLite query
-int SQuery(sqlite3* db, const char* e, const string& sql, SQResult& result, int64_t warnThreshold, bool skipInfoWarn) {
+int SQuery(sqlite3* db, const char* e, const string& sql, SQResult& result, int64_t warnThreshold, bool skipInfoWarn, SQStatementCache* statementCache) {
+    static const vector<SQValue> noBindings;
+    return SQuery(db, e, sql, noBindings, result, warnThreshold, skipInfoWarn, statementCache);
+}
+
+// Every kind of result is filled the same way, aside from how each row is appended.
+template <typename RESULT>
+static int SQueryInto(sqlite3* db, const char* e, const string& sql, const vector<SQValue>& bindings, RESULT& result, int64_t warnThreshold, bool skipInfoWarn, SQStatementCache* statementCache) {
 #define MAX_TRIES 3
     // Execute the query and get the results
     uint64_t startTime = STimeNow();
@@ -2585,8 +3048,24 @@ int SQuery(sqlite3* db, const char* e, const string& sql, SQResult& result, int6
         do {
             numLoops++;
             sqlite3_stmt *preparedStatement = nullptr;
+
+            // Cached statements are reset rather than finalized when we're done with them.
+            bool isCachedStatement = false;
+
+            // Set if this statement is the entirety of `sql`, rather than one of several statements.
+            bool isWholeQuery = false;
+            if (statementCache && statementRemainder == sql.c_str()) {
+                SQStatementCache::Entry* entry = statementCache->get(sql);
+                if (entry) {
+                    preparedStatement = entry->statement;
+                    statementRemainder = sql.c_str() + sql.size();
+                    isCachedStatement = true;
+                    isWholeQuery = true;
+                }
+            }
+
             size_t beforePrepare = 0;
-            if (isSyncThread) {
+            if (isSyncThread || statementCache) {
                 beforePrepare = STimeNow();
             }
 
@@ -2604,10 +3083,30 @@ int SQuery(sqlite3* db, const char* e, const string& sql, SQResult& result, int6
             //
             // Calling strlen() or any function that iterates across the whole string here is a giant performance problem, and all the operations chosen here have
             // been picked specifically to avoid that.
-            size_t maxLength = sql.size() - (statementRemainder - sql.c_str()) + 1;
-            error = sqlite3_prepare_v2(db, statementRemainder, (int)maxLength, &preparedStatement, &statementRemainder);
-            if (isSyncThread) {
-                prepareTimeUS += STimeNow() - beforePrepare;
+            if (!isCachedStatement) {
+                const char* statementStart = statementRemainder;
+                size_t maxLength = sql.size() - (statementRemainder - sql.c_str()) + 1;
+                error = sqlite3_prepare_v2(db, statementRemainder, (int)maxLength, &preparedStatement, &statementRemainder);
+                if (isSyncThread || statementCache) {
+                    size_t elapsed = STimeNow() - beforePrepare;
+                    prepareTimeUS += elapsed;
+                    if (statementCache) {
+                        SQStatementCache::prepareTimeUS += elapsed;
+                    }
+                }
+
+                // Is this statement the entire query (ignoring trailing whitespace)? If so, offer it to the cache.
+                if (!error && preparedStatement && statementStart == sql.c_str()) {
+                    const char* end = sql.c_str() + sql.size();
+                    const char* trailing = statementRemainder;
+                    while (trailing < end && isspace(*trailing)) {
+                        trailing++;
+                    }
+                    isWholeQuery = trailing == end;
+                }
+                if (statementCache && isWholeQuery) {
+                    isCachedStatement = statementCache->put(sql, preparedStatement);
+                }
             }
             if (error) {
                 // Delete our statement.
@@ -2620,8 +3119,41 @@ int SQuery(sqlite3* db, const char* e, const string& sql, SQResult& result, int6
                 error = SQLITE_OK;
                 break;
             }
+
+            // Bind any parameters. We only support anonymous `?` parameters in single-statement queries, as that's what
+            // `SQExpandBindings` can reproduce for the journal.
+            if (!bindings.empty()) {
+                if (!isWholeQuery) {
+                    SWARN("'" << e << "', bound parameters are only supported for single-statement queries.");
+                    error = SQLITE_MISUSE;
+                } else if (sqlite3_bind_parameter_count(preparedStatement) != (int)bindings.size()) {
+                    SWARN("'" << e << "', query has " << sqlite3_bind_parameter_count(preparedStatement) << " parameters but "
+                          << bindings.size() << " values were supplied.");
+                    error = SQLITE_RANGE;
+                } else {
+                    for (size_t i = 0; i < bindings.size() && !error; i++) {
+                        if (sqlite3_bind_parameter_name(preparedStatement, i + 1)) {
+                            SWARN("'" << e << "', only anonymous '?' parameters are supported.");
+                            error = SQLITE_MISUSE;
+                        } else {
+                            error = bindings[i].bind(preparedStatement, i + 1);
+                        }
+                    }
+                }
+                if (error) {
+                    if (isCachedStatement) {
+                        sqlite3_clear_bindings(preparedStatement);
+                    } else {
+                        sqlite3_finalize(preparedStatement);
+                    }
+                    break;
+                }
+            }
             int numColumns = sqlite3_column_count(preparedStatement);
             result.headers.resize(numColumns);
+            for (int i = 0; i < numColumns; i++) {
+                result.headers[i] = sqlite3_column_name(preparedStatement, i);
+            }
 
             while (true) {
                 size_t beforeStep = 0;
@@ -2638,33 +3170,12 @@ int SQuery(sqlite3* db, const char* e, const string& sql, SQResult& result, int6
                     stepTimeUS += stepTime;
                 }
 
-                for (int i = 0; i < numColumns; i++) {
-                    result.headers[i] = sqlite3_column_name(preparedStatement, i);
-                }
-
                 if (error == SQLITE_ROW) {
-                    SQResultRow row(result, numColumns);
-                    for (int i = 0; i < numColumns; i++) {
-                        int colType = sqlite3_column_type(preparedStatement, i);
-                        switch (colType) {
-                            case SQLITE_INTEGER:
-                                row.get(i) = (int64_t)sqlite3_column_int64(preparedStatement, i);
-                                break;
-                            case SQLITE_FLOAT:
-                                row.get(i) = sqlite3_column_double(preparedStatement, i);
-                                break;
-                            case SQLITE_TEXT:
-                                row.get(i) = SQValue(SQValue::TYPE::TEXT, string(reinterpret_cast<const char*>(sqlite3_column_text(preparedStatement, i))));
-                                break;
-                            case SQLITE_BLOB:
-                                row.get(i) = SQValue(SQValue::TYPE::BLOB, string(static_cast<const char*>(sqlite3_column_blob(preparedStatement, i)), sqlite3_column_bytes(preparedStatement, i)));
-                                break;
-                            case SQLITE_NULL:
-                                row.get(i) = SQValue();
-                                break;
-                        }
+                    if (!SQueryAppendRow(result, preparedStatement, numColumns)) {
+                        // The caller asked us to stop.
+                        error = SQLITE_INTERRUPT;
+                        break;
                     }
-                    result.emplace_back(move(row));
                 } else {
                     if (error == SQLITE_DONE) {
                         // Treat "done" as just not-an-error.
@@ -2673,13 +3184,28 @@ int SQuery(sqlite3* db, const char* e, const string& sql, SQResult& result, int6
                     break;
                 }
             }
-            sqlite3_finalize(preparedStatement);
+            if (isCachedStatement) {
+                sqlite3_reset(preparedStatement);
+
+                // We bind without copying, so don't leave pointers to the caller's values in the cached statement.
+                if (!bindings.empty()) {
+                    sqlite3_clear_bindings(preparedStatement);
+                }
+            } else {
+                sqlite3_finalize(preparedStatement);
+            }
         } while (*statementRemainder != 0 && error == SQLITE_OK);
 
         extErr = sqlite3_extended_errcode(db);
         if (error != SQLITE_BUSY || extErr == SQLITE_BUSY_SNAPSHOT) {
             break;
         }
+        if constexpr (is_same_v<RESULT, SQueryBatch>) {
+            if (result.handedOff) {
+                SWARN("sqlite3 returned SQLITE_BUSY after rows were handed off, can't retry.");
+                break;
+            }
+        }
         SWARN("sqlite3 returned SQLITE_BUSY on try #"
               << (tries + 1) << " of " << MAX_TRIES << ". "
               << "Extended error code: " << sqlite3_extended_errcode(db) << ". "
@@ -2691,6 +3217,13 @@ int SQuery(sqlite3* db, const char* e, const string& sql, SQResult& result, int6
         }
     }
 
+    // A batched query hands off whatever rows are left over at the end.
+    if constexpr (is_same_v<RESULT, SQueryBatch>) {
+        if (error == SQLITE_OK && !result.flush()) {
+            error = SQLITE_INTERRUPT;
+        }
+    }
+
     if (error == SQLITE_CORRUPT) {
         if (extErr == SQLITE_CORRUPT_INDEX) {
             // Avoid logging queries so long that we need dozens of lines to log them.
@@ -2761,6 +3294,19 @@ int SQuery(sqlite3* db, const char* e, const string& sql, SQResult& result, int6
     return error;
 }
 
+int SQuery(sqlite3* db, const char* e, const string& sql, const vector<SQValue>& bindings, SQResult& result, int64_t warnThreshold, bool skipInfoWarn, SQStatementCache* statementCache) {
+    return SQueryInto(db, e, sql, bindings, result, warnThreshold, skipInfoWarn, statementCache);
+}
+
+int SQuery(sqlite3* db, const char* e, const string& sql, const vector<SQValue>& bindings, SQColumnarResult& result, int64_t warnThreshold, bool skipInfoWarn, SQStatementCache* statementCache) {
+    return SQueryInto(db, e, sql, bindings, result, warnThreshold, skipInfoWarn, statementCache);
+}
+
+int SQuery(sqlite3* db, const char* e, const string& sql, const vector<SQValue>& bindings, size_t batchBytes, const function<bool(SQColumnarResult&)>& onRows, int64_t warnThreshold, bool skipInfoWarn, SQStatementCache* statementCache) {
+    SQueryBatch batch(batchBytes, onRows);
+    return SQueryInto(db, e, sql, bindings, batch, warnThreshold, skipInfoWarn, statementCache);
+}
+
 // --------------------------------------------------------------------------
 // Creates a table, if not there, or verifies it's defined correctly
 bool SQVerifyTable(sqlite3* db, const string& tableName, const string& sql) {
@@ -3195,6 +3741,74 @@ int SQuery(sqlite3* db, const char* e, const string& sql, int64_t warnThreshold,
     return SQuery(db, e, sql, ignore, warnThreshold, skipInfoWarn);
 }
 
+// Calls `onParameter` with the position of each `?` parameter in `sql`, in order.
+static void SQForEachParameter(const string& sql, const function<void(size_t)>& onParameter) {
+    for (size_t i = 0; i < sql.size(); i++) {
+        // Skip over anything a `?` could appear in without being a parameter: quoted strings and identifiers, and
+        // comments. Escaped quotes inside strings (i.e., '') just look like two adjacent strings here, which is fine.
+        size_t end = string::npos;
+        switch (sql[i]) {
+            case '\'':
+            case '"':
+            case '`':
+                end = sql.find(sql[i], i + 1);
+                break;
+            case '[':
+                end = sql.find(']', i + 1);
+                break;
+            case '-':
+                if (i + 1 < sql.size() && sql[i + 1] == '-') {
+                    end = sql.find('\n', i + 2);
+                }
+                break;
+            case '/':
+                if (i + 1 < sql.size() && sql[i + 1] == '*') {
+                    end = sql.find("*/", i + 2);
+                    if (end != string::npos) {
+                        end++;
+                    }
+                }
+                break;
+            case '?':
+                onParameter(i);
+                continue;
+            default:
+                continue;
+        }
+
+        // If we started something we never finished, the rest of the query is part of it.
+        if (end == string::npos) {
+            break;
+        }
+        i = end;
+    }
+}
+
+string SQExpandBindings(const string& sql, const vector<SQValue>& bindings) {
+    string expanded;
+    expanded.reserve(sql.size());
+    size_t nextBinding = 0;
+    size_t copyFrom = 0;
+    SQForEachParameter(sql, [&](size_t i) {
+        if (nextBinding >= bindings.size()) {
+            STHROW("500 Not enough bindings for query");
+        }
+        expanded.append(sql, copyFrom, i - copyFrom);
+        expanded += bindings[nextBinding++].toSQLLiteral();
+        copyFrom = i + 1;
+    });
+    expanded.append(sql, copyFrom, string::npos);
+    return expanded;
+}
+
+size_t SQCountBindings(const string& sql) {
+    size_t count = 0;
+    SQForEachParameter(sql, [&count](size_t) {
+        count++;
+    });
+    return count;
+}
+
 string SUNQUOTED_TIMESTAMP(uint64_t when) {
     return SComposeTime("%Y-%m-%d %H:%M:%S", when);
 }
@@ -3219,6 +3833,291 @@ bool STableComp::nocase_compare::operator()(const unsigned char& c1, const unsig
     return tolower(c1) < tolower(c2);
 }
 
+STable::STable(const STable& other) {
+    *this = other;
+}
+
+STable::STable(STable&& other) noexcept {
+    swap(other);
+}
+
+STable& STable::operator=(const STable& other) {
+    // The copied index would point at the other table's entries, so this builds its own, already in order.
+    if (this != &other) {
+        clear();
+        reserve(other.size());
+        for (const value_type* entry : other._entries) {
+            _storage.push_back(*entry);
+            _entries.push_back(&_storage.back());
+        }
+        _prefixes = other._prefixes;
+    }
+    return *this;
+}
+
+STable& STable::operator=(STable&& other) noexcept {
+    if (this != &other) {
+        clear();
+        swap(other);
+    }
+    return *this;
+}
+
+STable::STable(initializer_list<value_type> values) {
+    reserve(values.size());
+    insert(values.begin(), values.end());
+}
+
+// Bedrock never sets a locale, so this is what `tolower` does, without the call.
+static inline unsigned char STableFold(unsigned char c) {
+    return (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+}
+
+uint64_t STable::_prefix(const string& name) {
+    uint64_t prefix = 0;
+    for (size_t i = 0; i < 8; i++) {
+        prefix <<= 8;
+        if (i < name.size()) {
+            prefix |= STableFold(name[i]);
+        }
+    }
+    return prefix;
+}
+
+// Compares two names with the same prefix. Either both are at least 8 bytes long, and only what follows needs to be
+// compared, or one is shorter, and it's the start of the other.
+static int STableCompareAfterPrefix(const string& lhs, const string& rhs) {
+    for (size_t i = 8; i < lhs.size() && i < rhs.size(); i++) {
+        unsigned char l = STableFold(lhs[i]);
+        unsigned char r = STableFold(rhs[i]);
+        if (l != r) {
+            return l < r ? -1 : 1;
+        }
+    }
+    return lhs.size() < rhs.size() ? -1 : (lhs.size() > rhs.size() ? 1 : 0);
+}
+
+size_t STable::_lowerBound(const string& name, uint64_t prefix) const {
+    size_t low = 0;
+    size_t high = _prefixes.size();
+    while (low < high) {
+        size_t middle = low + (high - low) / 2;
+        if (_prefixes[middle] < prefix || (_prefixes[middle] == prefix && STableCompareAfterPrefix(_entries[middle]->first, name) < 0)) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return low;
+}
+
+bool STable::_isAt(size_t index, uint64_t prefix, const string& name) const {
+    // `index` is from `_lowerBound`, so the entry there isn't before `name`, and if it isn't after it either, it's it.
+    return index < _entries.size() && _prefixes[index] == prefix && !STableCompareAfterPrefix(_entries[index]->first, name);
+}
+
+size_t STable::_find(const string& name) const {
+    uint64_t prefix = _prefix(name);
+    size_t index = _lowerBound(name, prefix);
+    return _isAt(index, prefix, name) ? index : _entries.size();
+}
+
+STable::iterator STable::_insert(size_t index, uint64_t prefix, value_type&& value) {
+    value_type* entry;
+    if (_freeEntries.empty()) {
+        _storage.push_back(move(value));
+        entry = &_storage.back();
+    } else {
+        entry = _freeEntries.back();
+        _freeEntries.pop_back();
+        *entry = move(value);
+    }
+    _prefixes.insert(_prefixes.begin() + index, prefix);
+    return _entries.insert(_entries.begin() + index, entry);
+}
+
+SString& STable::operator[](const string& name) {
+    uint64_t prefix = _prefix(name);
+    size_t index = _lowerBound(name, prefix);
+    if (_isAt(index, prefix, name)) {
+        return _entries[index]->second;
+    }
+    return _insert(index, prefix, value_type(name, SString()))->second;
+}
+
+SString& STable::at(const string& name) {
+    size_t index = _find(name);
+    if (index == _entries.size()) {
+        throw out_of_range("STable::at");
+    }
+    return _entries[index]->second;
+}
+
+const SString& STable::at(const string& name) const {
+    size_t index = _find(name);
+    if (index == _entries.size()) {
+        throw out_of_range("STable::at");
+    }
+    return _entries[index]->second;
+}
+
+STable::iterator STable::find(const string& name) {
+    return begin() + _find(name);
+}
+
+STable::const_iterator STable::find(const string& name) const {
+    return begin() + _find(name);
+}
+
+size_t STable::count(const string& name) const {
+    return _find(name) != _entries.size();
+}
+
+bool STable::contains(const string& name) const {
+    return _find(name) != _entries.size();
+}
+
+STable::iterator STable::lower_bound(const string& name) {
+    return begin() + _lowerBound(name, _prefix(name));
+}
+
+STable::const_iterator STable::lower_bound(const string& name) const {
+    return begin() + _lowerBound(name, _prefix(name));
+}
+
+STable::iterator STable::upper_bound(const string& name) {
+    return begin() + (static_cast<const STable&>(*this).upper_bound(name) - cbegin());
+}
+
+STable::const_iterator STable::upper_bound(const string& name) const {
+    uint64_t prefix = _prefix(name);
+    size_t index = _lowerBound(name, prefix);
+    return begin() + (_isAt(index, prefix, name) ? index + 1 : index);
+}
+
+pair<STable::iterator, bool> STable::insert(const value_type& value) {
+    return insert(value_type(value));
+}
+
+pair<STable::iterator, bool> STable::insert(value_type&& value) {
+    uint64_t prefix = _prefix(value.first);
+    size_t index = _lowerBound(value.first, prefix);
+    if (_isAt(index, prefix, value.first)) {
+        return make_pair(begin() + index, false);
+    }
+    return make_pair(_insert(index, prefix, move(value)), true);
+}
+
+STable::iterator STable::insert(const_iterator hint, const value_type& value) {
+    return insert(value).first;
+}
+
+STable::iterator STable::erase(const_iterator position) {
+    return erase(position, position + 1);
+}
+
+STable::iterator STable::erase(const_iterator first, const_iterator last) {
+    const size_t firstIndex = first - cbegin();
+    const size_t lastIndex = last - cbegin();
+
+    // Release what the erased entries hold now, rather than whenever their space is re-used.
+    for (size_t i = firstIndex; i < lastIndex; i++) {
+        *_entries[i] = value_type();
+        _freeEntries.push_back(_entries[i]);
+    }
+    _prefixes.erase(_prefixes.begin() + firstIndex, _prefixes.begin() + lastIndex);
+    return _entries.erase(_entries.begin() + firstIndex, _entries.begin() + lastIndex);
+}
+
+size_t STable::erase(const string& name) {
+    size_t index = _find(name);
+    if (index == _entries.size()) {
+        return 0;
+    }
+    erase(cbegin() + index);
+    return 1;
+}
+
+void STable::clear() {
+    _storage.clear();
+    _freeEntries.clear();
+    _entries.clear();
+    _prefixes.clear();
+}
+
+void STable::reserve(size_t size) {
+    _entries.reserve(size);
+    _prefixes.reserve(size);
+}
+
+void STable::swap(STable& other) {
+    // Swapping deques swaps the blocks they own, so every entry stays where the index expects it.
+    _storage.swap(other._storage);
+    _freeEntries.swap(other._freeEntries);
+    _entries.swap(other._entries);
+    _prefixes.swap(other._prefixes);
+}
+
+bool STable::empty() const {
+    return _entries.empty();
+}
+
+size_t STable::size() const {
+    return _entries.size();
+}
+
+STable::iterator STable::begin() {
+    return iterator(_entries.begin());
+}
+
+STable::iterator STable::end() {
+    return iterator(_entries.end());
+}
+
+STable::const_iterator STable::begin() const {
+    return const_iterator(_entries.begin());
+}
+
+STable::const_iterator STable::end() const {
+    return const_iterator(_entries.end());
+}
+
+STable::const_iterator STable::cbegin() const {
+    return begin();
+}
+
+STable::const_iterator STable::cend() const {
+    return end();
+}
+
+STable::reverse_iterator STable::rbegin() {
+    return reverse_iterator(end());
+}
+
+STable::reverse_iterator STable::rend() {
+    return reverse_iterator(begin());
+}
+
+STable::const_reverse_iterator STable::rbegin() const {
+    return const_reverse_iterator(end());
+}
+
+STable::const_reverse_iterator STable::rend() const {
+    return const_reverse_iterator(begin());
+}
+
+STable::key_compare STable::key_comp() const {
+    return STableComp();
+}
+
+bool STable::operator==(const STable& other) const {
+    return equal(begin(), end(), other.begin(), other.end());
+}
+
+bool STable::operator<(const STable& other) const {
+    return lexicographical_compare(begin(), end(), other.begin(), other.end());
+}
+
 SString::SString() {
 }
 
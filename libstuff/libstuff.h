@@ -8,6 +8,7 @@
 #include <algorithm>
 #include <atomic>
 #include <cctype>
+#include <deque>
 #include <functional>
 #include <iomanip>
 #include <list>
@@ -22,7 +23,10 @@
 struct sockaddr_in;
 struct pollfd;
 struct sqlite3;
+class SQColumnarResult;
 class SQResult;
+class SQStatementCache;
+class SQValue;
 class SFastBuffer;
 struct SData;
 
@@ -117,7 +121,167 @@ class SString : public string {
     SString& operator=(const bool from);
 };
 
-typedef map<string, SString, STableComp> STable;
+// A table of names and values, with names compared without case. It works like a `map<string, SString, STableComp>`,
+// and is kept in the same order, but rather than a tree, it keeps a sorted vector of its entries, so that the small
+// tables of headers in every request and response are searched in adjacent memory. Alongside each entry in that vector
+// is its name's first 8 bytes, lowercased and packed into an integer, which is all most comparisons need to look at.
+// The entries themselves are stored in blocks, and stay where they are until they're erased, so as with a map, adding
+// or erasing an entry doesn't invalidate references to the others. It does invalidate iterators, though, and the
+// names of entries must not be changed through an iterator.
+class STable {
+  public:
+    typedef string key_type;
+    typedef SString mapped_type;
+    typedef pair<string, SString> value_type;
+    typedef STableComp key_compare;
+    typedef size_t size_type;
+
+    // Walks the sorted vector, and so the entries in order.
+    template <typename Value, typename IndexIterator>
+    class Iterator {
+      public:
+        typedef random_access_iterator_tag iterator_category;
+        typedef STable::value_type value_type;
+        typedef ptrdiff_t difference_type;
+        typedef Value* pointer;
+        typedef Value& reference;
+
+        Iterator() = default;
+        Iterator(IndexIterator position) : _position(position) {}
+        template <typename OtherValue, typename OtherIndexIterator>
+        Iterator(const Iterator<OtherValue, OtherIndexIterator>& other) : _position(other._position) {}
+
+        reference operator*() const { return **_position; }
+        pointer operator->() const { return *_position; }
+        reference operator[](difference_type n) const { return *_position[n]; }
+        Iterator& operator++() { ++_position; return *this; }
+        Iterator operator++(int) { return Iterator(_position++); }
+        Iterator& operator--() { --_position; return *this; }
+        Iterator operator--(int) { return Iterator(_position--); }
+        Iterator& operator+=(difference_type n) { _position += n; return *this; }
+        Iterator& operator-=(difference_type n) { _position -= n; return *this; }
+        Iterator operator+(difference_type n) const { return Iterator(_position + n); }
+        Iterator operator-(difference_type n) const { return Iterator(_position - n); }
+        template <typename V, typename I> difference_type operator-(const Iterator<V, I>& other) const { return _position - other._position; }
+        template <typename V, typename I> bool operator==(const Iterator<V, I>& other) const { return _position == other._position; }
+        template <typename V, typename I> bool operator!=(const Iterator<V, I>& other) const { return _position != other._position; }
+        template <typename V, typename I> bool operator<(const Iterator<V, I>& other) const { return _position < other._position; }
+        template <typename V, typename I> bool operator>(const Iterator<V, I>& other) const { return _position > other._position; }
+        template <typename V, typename I> bool operator<=(const Iterator<V, I>& other) const { return _position <= other._position; }
+        template <typename V, typename I> bool operator>=(const Iterator<V, I>& other) const { return _position >= other._position; }
+
+      private:
+        template <typename V, typename I> friend class Iterator;
+        friend class STable;
+        IndexIterator _position;
+    };
+    typedef Iterator<value_type, vector<value_type*>::iterator> iterator;
+    typedef Iterator<const value_type, vector<value_type*>::const_iterator> const_iterator;
+    typedef std::reverse_iterator<iterator> reverse_iterator;
+    typedef std::reverse_iterator<const_iterator> const_reverse_iterator;
+
+    STable() = default;
+    STable(const STable& other);
+    STable(STable&& other) noexcept;
+    STable& operator=(const STable& other);
+    STable& operator=(STable&& other) noexcept;
+    STable(initializer_list<value_type> values);
+    template <typename InputIterator>
+    STable(InputIterator first, InputIterator last) {
+        insert(first, last);
+    }
+
+    // Returns the value for `name`, adding an empty one if there's none.
+    SString& operator[](const string& name);
+
+    // Returns the value for `name`, throwing `out_of_range` if there's none.
+    SString& at(const string& name);
+    const SString& at(const string& name) const;
+
+    iterator find(const string& name);
+    const_iterator find(const string& name) const;
+    size_t count(const string& name) const;
+    bool contains(const string& name) const;
+
+    // The first entry not before `name`, and the first after it.
+    iterator lower_bound(const string& name);
+    const_iterator lower_bound(const string& name) const;
+    iterator upper_bound(const string& name);
+    const_iterator upper_bound(const string& name) const;
+
+    // These add an entry only if there isn't one with the same name, and return it, and whether it was added.
+    pair<iterator, bool> insert(const value_type& value);
+    pair<iterator, bool> insert(value_type&& value);
+    template <typename P, typename = typename enable_if<is_constructible<value_type, P&&>::value>::type>
+    pair<iterator, bool> insert(P&& value) {
+        return insert(value_type(forward<P>(value)));
+    }
+    iterator insert(const_iterator hint, const value_type& value);
+    template <typename InputIterator>
+    void insert(InputIterator first, InputIterator last) {
+        for (; first != last; ++first) {
+            insert(value_type(*first));
+        }
+    }
+    template <typename... Args>
+    pair<iterator, bool> emplace(Args&&... args) {
+        return insert(value_type(forward<Args>(args)...));
+    }
+
+    iterator erase(const_iterator position);
+    iterator erase(const_iterator first, const_iterator last);
+    size_t erase(const string& name);
+
+    void clear();
+    void reserve(size_t size);
+    void swap(STable& other);
+
+    bool empty() const;
+    size_t size() const;
+
+    iterator begin();
+    iterator end();
+    const_iterator begin() const;
+    const_iterator end() const;
+    const_iterator cbegin() const;
+    const_iterator cend() const;
+    reverse_iterator rbegin();
+    reverse_iterator rend();
+    const_reverse_iterator rbegin() const;
+    const_reverse_iterator rend() const;
+
+    key_compare key_comp() const;
+
+    // As for a map, these compare names (with case) and values, in order.
+    bool operator==(const STable& other) const;
+    bool operator<(const STable& other) const;
+
+  private:
+    // Returns the first 8 bytes of `name`, lowercased, as a big-endian integer, so that comparing two of these orders
+    // the names as STableComp does, unless they're equal.
+    static uint64_t _prefix(const string& name);
+
+    // Returns the index of the first entry not before `name`.
+    size_t _lowerBound(const string& name, uint64_t prefix) const;
+
+    // Returns whether the entry at `index`, as returned by `_lowerBound`, is called `name`.
+    bool _isAt(size_t index, uint64_t prefix, const string& name) const;
+
+    // Returns the index of the entry called `name`, or `size()` if there's none.
+    size_t _find(const string& name) const;
+
+    // Adds `value` at `index`, which must be where it belongs.
+    iterator _insert(size_t index, uint64_t prefix, value_type&& value);
+
+    // Every entry, in the order they were added. Erased entries are kept in `_freeEntries` for re-use, so that
+    // nothing else ever moves.
+    deque<value_type> _storage;
+    vector<value_type*> _freeEntries;
+
+    // The entries, and their prefixes, sorted by name.
+    vector<value_type*> _entries;
+    vector<uint64_t> _prefixes;
+};
 
 // An SException is an exception class that can represent an HTTP-like response, with a method line, headers, and a
 // body. The STHROW and STHROW_STACK macros will create an SException that logs it's file, line of creation, and
@@ -243,7 +407,28 @@ void SWhitelistLogParams(const set<string>& params);
 // This is a drop-in replacement for syslog that directly logs to `/run/systemd/journal/syslog` bypassing journald.
 void SSyslogSocketDirect(int priority, const char* format, ...);
 
-// Atomic pointer to the syslog function that we'll actually use. Easy to change to `syslog` or `SSyslogSocketDirect`.
+// A drop-in replacement for syslog that copies the line into a buffer belonging to the calling thread and returns,
+// leaving a background thread to send it to `/run/systemd/journal/syslog` in batches. If that buffer is full, the line
+// is dropped and counted in `SLogAsyncDropped` rather than making the caller wait. Lines at LOG_ERR and above are
+// still sent synchronously, after everything buffered by every thread, so that neither they nor what led up to them
+// are lost if we abort right after. Falls back to `syslog` when `SLogAsyncStart` hasn't been called.
+void SSyslogAsync(int priority, const char* format, ...);
+
+// Starts the thread that sends the lines logged by `SSyslogAsync`. Each thread that logs gets a buffer of
+// `bufferSize` bytes (at least 16KB).
+void SLogAsyncStart(size_t bufferSize = 64 * 1024, const string& socketPath = "/run/systemd/journal/syslog");
+
+// Sends everything `SSyslogAsync` has buffered and stops the thread.
+void SLogAsyncStop();
+
+// Sends everything `SSyslogAsync` has buffered, from every thread, before returning. Called before aborting.
+void SLogAsyncFlush();
+
+// The number of lines `SSyslogAsync` has dropped because a thread's buffer was full.
+extern atomic<uint64_t> SLogAsyncDropped;
+
+// Atomic pointer to the syslog function that we'll actually use. Easy to change to `syslog`, `SSyslogSocketDirect`
+// or `SSyslogAsync`.
 extern atomic<void (*)(int priority, const char *format, ...)> SSyslogFunc;
 
 string addLogParams(string&& message, const STable& params = {});
@@ -624,8 +809,31 @@ void SQueryLogOpen(const string& logFilename);
 void SQueryLogClose();
 
 // Returns an SQLite result code.
-int SQuery(sqlite3* db, const char* e, const string& sql, SQResult& result, int64_t warnThreshold = 2000 * STIME_US_PER_MS, bool skipInfoWarn = false);
+// If `statementCache` is passed, single-statement queries are looked up in and added to it rather than being prepared
+// and finalized on every call.
+int SQuery(sqlite3* db, const char* e, const string& sql, SQResult& result, int64_t warnThreshold = 2000 * STIME_US_PER_MS, bool skipInfoWarn = false, SQStatementCache* statementCache = nullptr);
 int SQuery(sqlite3* db, const char* e, const string& sql, int64_t warnThreshold = 2000 * STIME_US_PER_MS, bool skipInfoWarn = false);
+
+// Like SQuery, but binds `bindings` to the anonymous `?` parameters in `sql`, in order, rather than requiring values
+// to be escaped into the query text. `sql` must be a single statement.
+int SQuery(sqlite3* db, const char* e, const string& sql, const vector<SQValue>& bindings, SQResult& result, int64_t warnThreshold = 2000 * STIME_US_PER_MS, bool skipInfoWarn = false, SQStatementCache* statementCache = nullptr);
+
+// Like SQuery, but fills the compact, column-major SQColumnarResult rather than an SQResult.
+int SQuery(sqlite3* db, const char* e, const string& sql, const vector<SQValue>& bindings, SQColumnarResult& result, int64_t warnThreshold = 2000 * STIME_US_PER_MS, bool skipInfoWarn = false, SQStatementCache* statementCache = nullptr);
+
+// Like SQuery, but rather than collecting every row, hands them to `onRows` in batches, each time they take up about
+// `batchBytes` (see `SQColumnarResult::byteSize`), and once more at the end with whatever's left, even if that's none.
+// The result is emptied after each batch, so memory use is bounded however many rows there are. If `onRows` returns
+// false, the query stops and this returns SQLITE_INTERRUPT. Rows can't be taken back once handed off, so a query that
+// has done so isn't retried on SQLITE_BUSY.
+int SQuery(sqlite3* db, const char* e, const string& sql, const vector<SQValue>& bindings, size_t batchBytes, const function<bool(SQColumnarResult&)>& onRows, int64_t warnThreshold = 2000 * STIME_US_PER_MS, bool skipInfoWarn = false, SQStatementCache* statementCache = nullptr);
+
+// Returns `sql` with each `?` parameter replaced by the SQL literal for the corresponding binding. Running the
+// returned query has exactly the same effect as running `sql` with `bindings`.
+string SQExpandBindings(const string& sql, const vector<SQValue>& bindings);
+
+// Returns the number of `?` parameters in `sql`, as bindings for it are matched to them by `SQExpandBindings`.
+size_t SQCountBindings(const string& sql);
 bool SQVerifyTable(sqlite3* db, const string& tableName, const string& sql);
 bool SQVerifyTableExists(sqlite3* db, const string& tableName);
 
@@ -640,8 +848,8 @@ string STIMESTAMP_MS(uint64_t time);
 // --------------------------------------------------------------------------
 // Miscellaneous stuff
 // --------------------------------------------------------------------------
-// Compression
-string SGZip(const string& content);
+// Compression. `level` is a zlib compression level, from 1 (fastest) to 9 (smallest).
+string SGZip(const string& content, int level = 9);
 string SGUnzip(const string& content);
 
 // Command-line helpers
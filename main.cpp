@@ -233,11 +233,30 @@ int main(int argc, char* argv[]) {
         cout << "-plugins        <list>      Enable these plugins (defaults to 'db,jobs,cache,mysql')" << endl;
         cout << "-cacheSize      <kb>        number of KB to allocate for a page cache (defaults to 1GB)" << endl;
         cout << "-workerThreads  <#>         Number of worker threads to start (min 1, defaults to # of cores)" << endl;
+        cout << "-commandPortReactorThreads <#> Handle command port connections on # epoll threads instead of a thread per socket" << endl;
+        cout << "-statementCacheSize <#>     Number of prepared statements to cache per DB handle (default 100, 0 disables)" << endl;
+        cout << "-quorumGroupCommitSize <#>  Commit up to # queued QUORUM commands in a single replicated transaction (default 1)" << endl;
+        cout << "-replicationThreads <#>     Number of threads a follower uses to apply replicated transactions in parallel (default 1)" << endl;
+        cout << "-synchronizeBatchSize <#>   Number of commits to request and apply per transaction while synchronizing (default 100)" << endl;
+        cout << "-binaryPeerProtocol         Use binary framing for messages to peers that also support it" << endl;
+        cout << "-peerCompression            Compress large messages (transactions, synchronization) to peers that also support it" << endl;
+        cout << "-dbPoolWarmHandles <#>      Number of DB handles to open at startup and keep open (default 0)" << endl;
+        cout << "-dbPoolIdleTimeout <s>      Close other DB handles once they've been unused for this many seconds (default 0, never)" << endl;
+        cout << "-dbPoolCacheBudget <kb>     Total KB of page cache to share across all DB handles, instead of -cacheSize each" << endl;
+        cout << "-httpsReactorThreads <#>    Drive commands' outbound HTTPS requests from # shared threads rather than each command's own" << endl;
+        cout << "-httpsKeepAliveTimeout <s>  Keep outbound HTTPS connections open for reuse for up to this many idle seconds (default 0, off)" << endl;
+        cout << "-escalationConnections <#>  Pipeline commands escalated to other nodes over # connections to each, rather than one connection per command (default 0, off)" << endl;
+        cout << "-logAsync                   Buffer log lines and send them to syslog in batches from a background thread" << endl;
+        cout << "-logAsyncBufferKB <kb>      Size of each thread's log buffer with -logAsync, beyond which lines are dropped (default 64)" << endl;
         cout << "-queryLog       <filename>  Set the query log filename (default 'queryLog.csv', SIGUSR2/SIGQUIT to "
                 "enable/disable)"
              << endl;
         cout << "-maxJournalSize <#commits>  Number of commits to retain in the historical journal (default 1000000)"
              << endl;
+        cout << "-commitCacheSize <#commits> Number of recent commits to keep in memory to serve to synchronizing peers (default 10000, 0 for none)" << endl;
+        cout << "-commitCacheMB <MB>         Most memory, in MB, that those commits' queries can use before the oldest are dropped (default 256)" << endl;
+        cout << "-readCacheSize <#queries>   Number of read results to share between peeks until their tables are written (default 0, off)" << endl;
+        cout << "-newDBsUseRingJournal       Keep a new database's journal in fixed-size tables whose rows are reused, rather than trimmed on every commit" << endl;
         cout << "-checkpointMode <mode>      Accepts PASSIVE|FULL|RESTART|TRUNCATE, which is the value passed to https://www.sqlite.org/c3ref/wal_checkpoint_v2.html" << endl;
         cout << endl;
         cout << "Quick Start Tips:" << endl;
@@ -412,5 +431,8 @@ int main(int argc, char* argv[]) {
     // All done
     SINFO("Graceful process shutdown complete");
 
+    // Send anything still buffered with `-logAsync`.
+    SLogAsyncStop();
+
     return 0;
 }
@@ -10,6 +10,40 @@
 #undef SLOGPREFIX
 #define SLOGPREFIX "{" << getName() << "} "
 
+// Sends a query result as the command's HTTP response, formatted exactly as it would be all at once, a batch of rows
+// per chunk.
+class DBHTTPResultStream : public BedrockResultStream {
+  public:
+    DBHTTPResultStream(BedrockCommand& command, uint64_t commitCount, SQResultFormatter::FORMAT format, const SQResultFormatter::FORMAT_OPTIONS& formatOptions)
+      : _command(command), _commitCount(commitCount), _formatter(format, formatOptions) { }
+
+    bool send(const SQColumnarResult& rows) override {
+        _chunk.clear();
+        if (_command.streamState == BedrockCommand::STREAM_STATE::NONE) {
+            _command.response.methodLine = "200 OK";
+            _command.response["commitCount"] = to_string(_commitCount);
+            if (!_command.startChunkedResponse()) {
+                return false;
+            }
+            _formatter.start(rows.headers, _chunk);
+        }
+        _formatter.append(rows, _chunk);
+        return _command.sendResponseChunk(_chunk);
+    }
+
+    bool finish() override {
+        _chunk.clear();
+        _formatter.finish(_chunk);
+        return _command.sendResponseChunk(_chunk) && _command.finishChunkedResponse();
+    }
+
+  private:
+    BedrockCommand& _command;
+    uint64_t _commitCount;
+    SQResultFormatter::Stream _formatter;
+    string _chunk;
+};
+
 const string BedrockPlugin_DB::name("DB");
 const string& BedrockPlugin_DB::getName() const {
     return name;
@@ -90,6 +124,7 @@ bool BedrockDBCommand::peek(SQLite& db) {
     // Get a list of prepared statements from the database.
     list<sqlite3_stmt*> statements;
     int prepareResult = db.getPreparedStatements(query, statements);
+    const size_t statementCount = statements.size();
 
     // Check each one to see if it's a write, and then release it.
     bool write = false;
@@ -115,8 +150,18 @@ bool BedrockDBCommand::peek(SQLite& db) {
     // it prevents sqlite from checkpointing and if we accumulate a lot of things to checkpoint, things become slow
     ((SQLite&) db).rollback();
 
-    // Attempt the read-only query
-    SQResult result;
+    // If asked, send the result as it's read rather than building it all up first, so a large one doesn't have to fit
+    // in memory. This works for a single statement.
+    if (request.test("Stream") && statementCount == 1) {
+        unique_ptr<BedrockResultStream> stream = _getResultStream(db, format, formatOptions);
+        if (stream) {
+            _streamQuery(db, *stream);
+            return true;
+        }
+    }
+
+    // Attempt the read-only query. These can return a lot of rows, so use the compact result.
+    SQColumnarResult result;
     if (!db.read(query, result)) {
         response["error"] = db.getLastError();
         STHROW("402 Bad query");
@@ -128,6 +173,42 @@ bool BedrockDBCommand::peek(SQLite& db) {
     return true;
 }
 
+unique_ptr<BedrockResultStream> BedrockDBCommand::_getResultStream(SQLite& db, SQResultFormatter::FORMAT format, const SQResultFormatter::FORMAT_OPTIONS& formatOptions) {
+    const string& pluginName = request["plugin"];
+    if (!pluginName.empty()) {
+        auto plugin = _plugin->server.plugins.find(pluginName);
+        if (!socket || plugin == _plugin->server.plugins.end()) {
+            return nullptr;
+        }
+        return plugin->second->getResultStream(*this);
+    }
+
+    // Only formats whose output doesn't depend on every row can be sent as they're read.
+    if (!SQResultFormatter::Stream::canStream(format) || !canStreamResponse()) {
+        return nullptr;
+    }
+    return make_unique<DBHTTPResultStream>(*this, db.getCommitCount(), format, formatOptions);
+}
+
+void BedrockDBCommand::_streamQuery(SQLite& db, BedrockResultStream& stream) {
+    auto sendRows = [&stream](SQColumnarResult& rows) {
+        return stream.send(rows);
+    };
+
+    if (!db.read(query, {}, STREAM_BATCH_BYTES, sendRows)) {
+        // Nothing is sent until the first rows are read, so a query that fails straight away gets a normal error.
+        if (streamState == STREAM_STATE::NONE) {
+            response["error"] = db.getLastError();
+            STHROW("402 Bad query");
+        }
+        STHROW("500 Streaming query failed");
+    }
+
+    if (!stream.finish()) {
+        STHROW("500 Streaming query failed");
+    }
+}
+
 void BedrockDBCommand::process(SQLite& db) {
     if (db.getUpdateNoopMode()) {
         SINFO("Query run in mocked request, just ignoring.");
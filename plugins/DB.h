@@ -1,5 +1,6 @@
 #pragma once
 #include <libstuff/libstuff.h>
+#include <libstuff/SQResultFormatter.h>
 #include "../BedrockPlugin.h"
 
 class BedrockPlugin_DB : public BedrockPlugin {
@@ -17,5 +18,16 @@ class BedrockDBCommand : public BedrockCommand {
     virtual void process(SQLite& db);
 
   private:
+    // Returns a stream to send the result of this command's query to its client as it's read: either in chunks of an
+    // HTTP response (see `BedrockCommand::startChunkedResponse`), or, for a command from a plugin's port, however that
+    // plugin sends them. Returns null if the result can't be streamed to this client.
+    unique_ptr<BedrockResultStream> _getResultStream(SQLite& db, SQResultFormatter::FORMAT format, const SQResultFormatter::FORMAT_OPTIONS& formatOptions);
+
+    // Runs the query, sending the rows to `stream` as they're read.
+    void _streamQuery(SQLite& db, BedrockResultStream& stream);
+
+    // How much of a streamed result we read before formatting and sending it.
+    static constexpr size_t STREAM_BATCH_BYTES = 256 * 1024;
+
     const string query;
 };
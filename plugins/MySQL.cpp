@@ -1,10 +1,12 @@
 #include "MySQL.h"
 
 #include <bedrockVersion.h>
+#include <libstuff/SQColumnarResult.h>
 #include <libstuff/SQResult.h>
 #include <BedrockServer.h>
 
 #include <cstring>
+#include <optional>
 
 #undef SLOGPREFIX
 #define SLOGPREFIX "{" << getName() << "} "
@@ -228,81 +230,389 @@ string MySQLPacket::serializeHandshake() {
     return handshake.serialize();
 }
 
-string MySQLPacket::serializeQueryResponse(int sequenceID, const SQResult& result) {
-    // Add the response
-    string sendBuffer;
+// Appends the definition of a column called `name`. Everything is described as a string, as SQLite columns have no
+// fixed type, so each value is sent as text in the text protocol, and as a length-encoded string in the binary one.
+static void appendColumnDefinition(string& output, uint8_t& sequenceID, const string& name) {
+    MySQLPacket column;
+    column.sequenceID = ++sequenceID;
+    column.payload += MySQLPacket::lenEncStr("def");     // catalog (lenenc_str) -- catalog (always "def")
+    column.payload += MySQLPacket::lenEncStr("unknown"); // schema (lenenc_str) -- schema-name
+    column.payload += MySQLPacket::lenEncStr("unknown"); // table (lenenc_str) -- virtual table-name
+    column.payload += MySQLPacket::lenEncStr("unknown"); // org_table (lenenc_str) -- physical table-name
+    column.payload += MySQLPacket::lenEncStr(name);      // name (lenenc_str) -- virtual column name
+    column.payload += MySQLPacket::lenEncStr(name);      // org_name (lenenc_str) -- physical column name
 
-    // First the column count
-    MySQLPacket columnCount;
-    columnCount.sequenceID = ++sequenceID;
-    columnCount.payload = lenEncInt(result.headers.size());
-    sendBuffer += columnCount.serialize();
+    uint8_t next_length = 0x0c;
+    SAppend(column.payload, &next_length, 1); // next_length (lenenc_int) -- length of the following fields (always 0x0c)
 
-    // Add all the columns
-    for (const auto& header : result.headers) {
-        // Now a column description
-        MySQLPacket column;
-        column.sequenceID = ++sequenceID;
-        column.payload += lenEncStr("def");     // catalog (lenenc_str) -- catalog (always "def")
-        column.payload += lenEncStr("unknown"); // schema (lenenc_str) -- schema-name
-        column.payload += lenEncStr("unknown"); // table (lenenc_str) -- virtual table-name
-        column.payload += lenEncStr("unknown"); // org_table (lenenc_str) -- physical table-name
-        column.payload += lenEncStr(header);    // name (lenenc_str) -- virtual column name
-        column.payload += lenEncStr(header);    // org_name (lenenc_str) -- physical column name
+    uint16_t latin1_swedish_ci = 0x08;
+    SAppend(column.payload, &latin1_swedish_ci, 2); // character_set (2) -- is the column character set and is defined in Protocol::CharacterSet.
+
+    uint32_t colLength = 1024;
+    SAppend(column.payload, &colLength, 4); // column_length (4) -- maximum length of the field
 
-        uint8_t next_length = 0x0c;
-        SAppend(column.payload, &next_length, 1); // next_length (lenenc_int) -- length of the following fields (always 0x0c)
+    uint8_t colType = MySQLPacket::MYSQL_TYPE_STRING;
+    SAppend(column.payload, &colType, 1); // column_type (1) -- type of the column as defined in Column Type
 
-        uint16_t latin1_swedish_ci = 0x08;
-        SAppend(column.payload, &latin1_swedish_ci, 2); // character_set (2) -- is the column character set and is defined in Protocol::CharacterSet.
+    uint16_t flags = 0;
+    SAppend(column.payload, &flags, 2); // flags (2) -- flags
 
-        uint32_t colLength = 1024;
-        SAppend(column.payload, &colLength, 4); // column_length (4) -- maximum length of the field
+    uint8_t decimals = 0;
+    SAppend(column.payload, &decimals, 1); // decimals (1) -- max shown decimal digits, 0x00 for integers and static strings
 
-        //uint8_t colType = 0; // Decimal;
-        uint8_t colType = 254; // string.
-        SAppend(column.payload, &colType, 1); // column_type (1) -- type of the column as defined in Column Type
+    uint16_t filler = 0;
+    SAppend(column.payload, &filler, 2); // filler (to pad to 0x0c)
+
+    output += column.serialize();
+}
 
-        uint16_t flags = 0;
-        SAppend(column.payload, &flags, 2); // flags (2) -- flags
+// The largest payload a single packet can carry, as its length is 3 bytes.
+static const size_t MAX_PACKET_PAYLOAD = 0xFFFFFF;
+
+// Appends a row packet of `columnCount` values, which `getValue` returns by column, or `nullopt` for NULL. The packet is
+// built in place in `output`, and its header filled in once its length is known.
+template <typename GET_VALUE>
+static void appendRowPacket(string& output, uint8_t& sequenceID, size_t columnCount, bool binary, GET_VALUE&& getValue) {
+    const size_t start = output.size();
+    output.append(4, '\0');
+    size_t nullBitmap = 0;
+    if (binary) {
+        // A binary row starts with a 0x00 header and a bitmap of which values are NULL, offset by two bits.
+        output += '\0';
+        nullBitmap = output.size();
+        output.append((columnCount + 7 + 2) / 8, '\0');
+    }
+    for (size_t column = 0; column < columnCount; column++) {
+        optional<string_view> value = getValue(column);
+        if (!value) {
+            if (binary) {
+                output[nullBitmap + (column + 2) / 8] |= 1 << ((column + 2) % 8);
+            } else {
+                output += '\xFB';
+            }
+            continue;
+        }
+        output += MySQLPacket::lenEncInt(value->size());
+        output += *value;
+    }
+    const size_t payloadLength = output.size() - start - 4;
+    if (payloadLength < MAX_PACKET_PAYLOAD) {
+        memcpy(&output[start], &payloadLength, 3);
+        output[start + 3] = ++sequenceID;
+        return;
+    }
 
-        uint8_t decimals = 0;
-        SAppend(column.payload, &decimals, 1); // decimals (1) -- max shown decimal digits, 0x00 for integers and static strings
+    // A payload of 16MB or more doesn't fit the 3-byte length, so it's split into packets of the maximum size, ending
+    // with a shorter one (which is empty if the payload is an exact multiple of it) to tell the client it's complete.
+    const string payload = output.substr(start + 4);
+    output.resize(start);
+    for (size_t offset = 0; offset <= payload.size(); offset += MAX_PACKET_PAYLOAD) {
+        const uint32_t length = min(payload.size() - offset, MAX_PACKET_PAYLOAD);
+        SAppend(output, &length, 3);
+        output += (char)++sequenceID;
+        output.append(payload, offset, length);
+    }
+}
 
-        uint16_t filler = 0;
-        SAppend(column.payload, &filler, 2); // filler (to pad to 0x0c)
+void MySQLPacket::appendColumns(string& output, uint8_t& sequenceID, const vector<string>& headers) {
+    // First the column count
+    MySQLPacket columnCount;
+    columnCount.sequenceID = ++sequenceID;
+    columnCount.payload = lenEncInt(headers.size());
+    output += columnCount.serialize();
 
-        sendBuffer += column.serialize();
+    // Add all the columns
+    for (const auto& header : headers) {
+        appendColumnDefinition(output, sequenceID, header);
     }
 
     // EOF packet to signal no more columns
+    appendEOF(output, sequenceID);
+}
+
+void MySQLPacket::appendRows(string& output, uint8_t& sequenceID, const SQColumnarResult& rows, bool binary) {
+    string number;
+    for (size_t row = 0; row < rows.size(); row++) {
+        appendRowPacket(output, sequenceID, rows.columnCount(), binary, [&](size_t column) -> optional<string_view> {
+            switch (rows.getType(row, column)) {
+                case SQValue::TYPE::NONE:
+                    return nullopt;
+                case SQValue::TYPE::TEXT:
+                case SQValue::TYPE::BLOB:
+                    return rows.getText(row, column);
+                default:
+                    number.clear();
+                    rows.appendString(number, row, column);
+                    return number;
+            }
+        });
+    }
+}
+
+void MySQLPacket::appendEOF(string& output, uint8_t& sequenceID) {
     MySQLPacket eofPacket;
     eofPacket.sequenceID = ++sequenceID;
     SAppend(eofPacket.payload, "\xFE", 1); // EOF
     uint32_t zero = 0;
     SAppend(eofPacket.payload, &zero, 4); // EOF
-    sendBuffer += eofPacket.serialize();
+    output += eofPacket.serialize();
+}
+
+string MySQLPacket::serializeQueryResponse(int sequenceID, const SQResult& result, bool binary) {
+    // Add the response
+    string sendBuffer;
+    uint8_t packetSequenceID = sequenceID;
+    appendColumns(sendBuffer, packetSequenceID, result.headers);
 
     // Add all the rows
+    string cell;
     for (const auto& row : result) {
-        // Now the row
-        MySQLPacket rowPacket;
-        rowPacket.sequenceID = ++sequenceID;
-        for (const auto& cell : row) {
-            rowPacket.payload += lenEncStr(cell);
-        }
-        SAppend(rowPacket.payload, "\xFE", 1); // EOF
-        sendBuffer += rowPacket.serialize();
+        appendRowPacket(sendBuffer, packetSequenceID, row.size(), binary, [&](size_t column) {
+            cell = row[column];
+            return optional<string_view>(cell);
+        });
     }
 
     // Finish with another EOF packet
-    eofPacket.sequenceID = ++sequenceID;
-    sendBuffer += eofPacket.serialize();
+    appendEOF(sendBuffer, packetSequenceID);
 
     // Done!
     return sendBuffer;
 }
 
+string MySQLPacket::serializePrepareOK(int sequenceID, uint32_t statementID, uint16_t paramCount) {
+    MySQLPacket ok;
+    ok.sequenceID = sequenceID + 1;
+    ok.payload += lenEncInt(0);                  // OK
+    SAppend(ok.payload, &statementID, 4);        // statement_id
+    uint16_t columnCount = 0;
+    SAppend(ok.payload, &columnCount, 2);        // num_columns
+    SAppend(ok.payload, &paramCount, 2);         // num_params
+    ok.payload += lenEncInt(0);                  // reserved
+    uint16_t WARNING_COUNT = 0x0;
+    SAppend(ok.payload, &WARNING_COUNT, 2);      // warning_count
+    string sendBuffer = ok.serialize();
+
+    // Then a definition of each parameter.
+    if (paramCount) {
+        uint8_t packetSequenceID = ok.sequenceID;
+        for (uint16_t i = 0; i < paramCount; i++) {
+            appendColumnDefinition(sendBuffer, packetSequenceID, "?");
+        }
+        appendEOF(sendBuffer, packetSequenceID);
+    }
+    return sendBuffer;
+}
+
+// Reads `size` bytes from `payload` at `offset` into `out`, and moves `offset` past them.
+static bool readBytes(const string& payload, size_t& offset, void* out, size_t size) {
+    if (offset > payload.size() || payload.size() - offset < size) {
+        return false;
+    }
+    memcpy(out, payload.data() + offset, size);
+    offset += size;
+    return true;
+}
+
+// Reads a length-encoded integer, as written by `lenEncInt`.
+static bool readLenEncInt(const string& payload, size_t& offset, uint64_t& value) {
+    uint8_t first;
+    if (!readBytes(payload, offset, &first, 1)) {
+        return false;
+    }
+    value = 0;
+    switch (first) {
+        case 0xFC:
+            return readBytes(payload, offset, &value, 2);
+        case 0xFD:
+            return readBytes(payload, offset, &value, 3);
+        case 0xFE:
+            return readBytes(payload, offset, &value, 8);
+        default:
+            // 0xFB (NULL) and 0xFF (an error) aren't lengths.
+            value = first;
+            return first < 0xFB;
+    }
+}
+
+// Returns whether a parameter of `type` is sent as binary data rather than text.
+static bool isBlobType(uint16_t type) {
+    switch (type & 0xFF) {
+        case MySQLPacket::MYSQL_TYPE_BIT:
+        case MySQLPacket::MYSQL_TYPE_TINY_BLOB:
+        case MySQLPacket::MYSQL_TYPE_MEDIUM_BLOB:
+        case MySQLPacket::MYSQL_TYPE_LONG_BLOB:
+        case MySQLPacket::MYSQL_TYPE_BLOB:
+        case MySQLPacket::MYSQL_TYPE_GEOMETRY:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// Reads a parameter value of `type` in the binary protocol. Integers and floating point numbers become the same in
+// SQLite, dates and times become text in the format SQLite's date functions use, and everything else is sent as a
+// length-encoded string, which becomes TEXT or a BLOB.
+static bool readBinaryValue(const string& payload, size_t& offset, uint16_t type, SQValue& value) {
+    // The high bit of the second byte of the type is set for unsigned integers.
+    const bool isUnsigned = type & 0x8000;
+    auto readInteger = [&](size_t size) {
+        uint64_t bits = 0;
+        if (!readBytes(payload, offset, &bits, size)) {
+            return false;
+        }
+        if (isUnsigned) {
+            // Like SQLite does with integer literals, treat any too large to fit as REAL.
+            value = bits > INT64_MAX ? SQValue((double)bits) : SQValue((int64_t)bits);
+        } else {
+            const int shift = 64 - size * 8;
+            value = SQValue((int64_t)(bits << shift) >> shift);
+        }
+        return true;
+    };
+
+    switch (type & 0xFF) {
+        case MySQLPacket::MYSQL_TYPE_NULL:
+            value = SQValue();
+            return true;
+        case MySQLPacket::MYSQL_TYPE_TINY:
+            return readInteger(1);
+        case MySQLPacket::MYSQL_TYPE_SHORT:
+        case MySQLPacket::MYSQL_TYPE_YEAR:
+            return readInteger(2);
+        case MySQLPacket::MYSQL_TYPE_LONG:
+        case MySQLPacket::MYSQL_TYPE_INT24:
+            return readInteger(4);
+        case MySQLPacket::MYSQL_TYPE_LONGLONG:
+            return readInteger(8);
+        case MySQLPacket::MYSQL_TYPE_FLOAT: {
+            float number;
+            if (!readBytes(payload, offset, &number, 4)) {
+                return false;
+            }
+            value = SQValue((double)number);
+            return true;
+        }
+        case MySQLPacket::MYSQL_TYPE_DOUBLE: {
+            double number;
+            if (!readBytes(payload, offset, &number, 8)) {
+                return false;
+            }
+            value = SQValue(number);
+            return true;
+        }
+        case MySQLPacket::MYSQL_TYPE_DATE:
+        case MySQLPacket::MYSQL_TYPE_DATETIME:
+        case MySQLPacket::MYSQL_TYPE_TIMESTAMP: {
+            // The length is 0, 4 (just the date), 7 (and the time) or 11 (and microseconds).
+            uint8_t length;
+            uint16_t year = 0;
+            uint8_t month = 0, day = 0, hour = 0, minute = 0, second = 0;
+            uint32_t microseconds = 0;
+            if (!readBytes(payload, offset, &length, 1) || (length != 0 && length != 4 && length != 7 && length != 11)) {
+                return false;
+            }
+            if (length >= 4 && !(readBytes(payload, offset, &year, 2) && readBytes(payload, offset, &month, 1) && readBytes(payload, offset, &day, 1))) {
+                return false;
+            }
+            if (length >= 7 && !(readBytes(payload, offset, &hour, 1) && readBytes(payload, offset, &minute, 1) && readBytes(payload, offset, &second, 1))) {
+                return false;
+            }
+            if (length >= 11 && !readBytes(payload, offset, &microseconds, 4)) {
+                return false;
+            }
+            char buffer[32];
+            int size = snprintf(buffer, sizeof(buffer), "%04u-%02u-%02u", year, month, day);
+            if ((type & 0xFF) != MySQLPacket::MYSQL_TYPE_DATE) {
+                size += snprintf(buffer + size, sizeof(buffer) - size, " %02u:%02u:%02u", hour, minute, second);
+                if (microseconds) {
+                    size += snprintf(buffer + size, sizeof(buffer) - size, ".%06u", microseconds);
+                }
+            }
+            value = SQValue(string(buffer, size));
+            return true;
+        }
+        case MySQLPacket::MYSQL_TYPE_TIME: {
+            // The length is 0, 8 (without microseconds) or 12.
+            uint8_t length;
+            uint8_t negative = 0, hour = 0, minute = 0, second = 0;
+            uint32_t days = 0, microseconds = 0;
+            if (!readBytes(payload, offset, &length, 1) || (length != 0 && length != 8 && length != 12)) {
+                return false;
+            }
+            if (length >= 8 && !(readBytes(payload, offset, &negative, 1) && readBytes(payload, offset, &days, 4) &&
+                                 readBytes(payload, offset, &hour, 1) && readBytes(payload, offset, &minute, 1) &&
+                                 readBytes(payload, offset, &second, 1))) {
+                return false;
+            }
+            if (length >= 12 && !readBytes(payload, offset, &microseconds, 4)) {
+                return false;
+            }
+            char buffer[32];
+            int size = snprintf(buffer, sizeof(buffer), "%s%02u:%02u:%02u", negative ? "-" : "", days * 24 + hour, minute, second);
+            if (microseconds) {
+                size += snprintf(buffer + size, sizeof(buffer) - size, ".%06u", microseconds);
+            }
+            value = SQValue(string(buffer, size));
+            return true;
+        }
+        default: {
+            uint64_t length;
+            if (!readLenEncInt(payload, offset, length) || payload.size() - offset < length) {
+                return false;
+            }
+            value = SQValue(isBlobType(type) ? SQValue::TYPE::BLOB : SQValue::TYPE::TEXT, payload.substr(offset, length));
+            offset += length;
+            return true;
+        }
+    }
+}
+
+bool MySQLPacket::deserializeExecute(const string& payload, MySQLPreparedStatement& statement, vector<SQValue>& params) {
+    // The command, statement ID (4), flags (1) and iteration count (4) come before the parameters.
+    size_t offset = 10;
+    if (payload.size() < offset) {
+        return false;
+    }
+    params.clear();
+    if (!statement.paramCount) {
+        return true;
+    }
+
+    // Next is a bitmap of which parameters are NULL, and whether their types follow. If not, they're the same as last
+    // time.
+    const size_t nullBitmap = offset;
+    offset += (statement.paramCount + 7) / 8;
+    uint8_t newParamsBound;
+    if (!readBytes(payload, offset, &newParamsBound, 1)) {
+        return false;
+    }
+    if (newParamsBound == 1) {
+        statement.paramTypes.resize(statement.paramCount);
+        if (!readBytes(payload, offset, statement.paramTypes.data(), statement.paramCount * 2)) {
+            return false;
+        }
+    }
+    if (statement.paramTypes.size() != statement.paramCount) {
+        return false;
+    }
+
+    // Then the value of each parameter that isn't NULL, or wasn't sent beforehand with COM_STMT_SEND_LONG_DATA.
+    params.resize(statement.paramCount);
+    for (uint16_t i = 0; i < statement.paramCount; i++) {
+        auto longData = statement.longData.find(i);
+        if (longData != statement.longData.end()) {
+            params[i] = SQValue(isBlobType(statement.paramTypes[i]) ? SQValue::TYPE::BLOB : SQValue::TYPE::TEXT, move(longData->second));
+        } else if (!(payload[nullBitmap + i / 8] & (1 << (i % 8)))) {
+            if (!readBinaryValue(payload, offset, statement.paramTypes[i], params[i])) {
+                return false;
+            }
+        }
+    }
+    statement.longData.clear();
+    return true;
+}
+
 string MySQLPacket::serializeOK(int sequenceID) {
     // Just fill out the packet
     MySQLPacket ok;
@@ -330,6 +640,77 @@ string MySQLPacket::serializeERR(int sequenceID, uint16_t code, const string& me
     return err.serialize();
 }
 
+// Sends a query result to a MySQL client a batch of rows at a time, as it's read, rather than waiting for
+// `onPortRequestComplete` with all of it.
+class MySQLResultStream : public BedrockResultStream {
+  public:
+    MySQLResultStream(BedrockCommand& command)
+      : _command(command), _sequenceID(command.request.calc("sequenceID")), _binary(command.request.test("binaryProtocol")) { }
+
+    bool send(const SQColumnarResult& rows) override {
+        _buffer.clear();
+        if (_command.streamState == BedrockCommand::STREAM_STATE::NONE) {
+            _command.streamState = BedrockCommand::STREAM_STATE::STARTED;
+
+            // A statement with no columns has no result set, just an OK.
+            _noColumns = rows.headers.empty();
+            if (_noColumns) {
+                return true;
+            }
+            MySQLPacket::appendColumns(_buffer, _sequenceID, rows.headers);
+        }
+        MySQLPacket::appendRows(_buffer, _sequenceID, rows, _binary);
+        return _command.sendResponseData(_buffer);
+    }
+
+    bool finish() override {
+        if (_noColumns) {
+            _buffer = MySQLPacket::serializeOK(_sequenceID);
+        } else {
+            _buffer.clear();
+            MySQLPacket::appendEOF(_buffer, _sequenceID);
+        }
+        if (!_command.sendResponseData(_buffer)) {
+            return false;
+        }
+        _command.streamState = BedrockCommand::STREAM_STATE::FINISHED;
+        return true;
+    }
+
+  private:
+    BedrockCommand& _command;
+    uint8_t _sequenceID;
+    bool _binary;
+    bool _noColumns = false;
+    string _buffer;
+};
+
+// Returns `query` (from COM_QUERY or COM_STMT_PREPARE) as a query we can pass to `DB`.
+static string normalizeQuery(const string& payloadQuery) {
+    string query = STrim(payloadQuery);
+    if (!SEndsWith(query, ";")) {
+        // We translate our query to one we can pass to `DB`, for which this is mandatory.
+        query += ";";
+    }
+    // JDBC Does this.
+    if (SStartsWith(query, "/*")) {
+        auto index = query.find("*/");
+        if (index != query.npos) {
+            query = query.substr(index + 2);
+        }
+    }
+    return query;
+}
+
+// Returns the statement ID that follows the command in a COM_STMT_* packet, or 0 (which is never used) if there isn't one.
+static uint32_t statementIDFromPayload(const string& payload) {
+    uint32_t statementID = 0;
+    if (payload.size() >= 5) {
+        memcpy(&statementID, &payload[1], 4);
+    }
+    return statementID;
+}
+
 BedrockPlugin_MySQL::BedrockPlugin_MySQL(BedrockServer& s) : BedrockPlugin(s)
 {
 }
@@ -358,21 +739,95 @@ void BedrockPlugin_MySQL::onPortRecv(STCPManager::Socket* s, SData& request) {
         SDEBUG("Received command #" << packet.payload[0] << ", sequenceID #" << (int)packet.sequenceID << " : '" << SToHex(packet.serialize()) << "'");
         s->recvBuffer.consumeFront(packetSize);
         SDEBUG("Packet payload " + packet.payload);
+        bool binary = false;
         switch (packet.payload[0]) {
-        case 3: { // COM_QUERY
-            // Decode the query
-            string query = STrim(packet.payload.substr(1, packet.payload.size() - 1));
-            if (!SEndsWith(query, ";")) {
-                // We translate our query to one we can pass to `DB`, for which this is mandatory.
-                query += ";";
+        case 0x16: { // COM_STMT_PREPARE
+            // Just remember the query. Its parameters are filled in when it's executed, and then it's run like any other.
+            string query = normalizeQuery(packet.payload.substr(1));
+            const size_t bindingCount = SQCountBindings(query);
+            if (bindingCount > UINT16_MAX) {
+                // The count is only 2 bytes in COM_STMT_PREPARE_OK and COM_STMT_EXECUTE, so it can't be described.
+                SINFO("Refusing to prepare '" << query << "' with " << bindingCount << " parameters");
+                s->send(MySQLPacket::serializeERR(packet.sequenceID, 1390, "Prepared statement contains too many placeholders"));
+                break;
+            }
+            uint16_t paramCount = bindingCount;
+            uint32_t statementID;
+            {
+                lock_guard<mutex> lock(_connectionsMutex);
+                Connection& connection = _connections[s->id];
+                statementID = ++connection.lastStatementID;
+                MySQLPreparedStatement& statement = connection.statements[statementID];
+                statement.query = query;
+                statement.paramCount = paramCount;
+            }
+            SINFO("Prepared statement #" << statementID << " '" << query << "' with " << paramCount << " parameters");
+            s->send(MySQLPacket::serializePrepareOK(packet.sequenceID, statementID, paramCount));
+            break;
+        }
+
+        case 0x18: { // COM_STMT_SEND_LONG_DATA
+            // Part of a parameter's value for the next execution. There's no response.
+            if (packet.payload.size() < 7) {
+                break;
+            }
+            uint16_t paramID;
+            memcpy(&paramID, &packet.payload[5], 2);
+            lock_guard<mutex> lock(_connectionsMutex);
+            MySQLPreparedStatement* statement = _getStatement(s, packet.payload);
+            if (statement && paramID < statement->paramCount) {
+                statement->longData[paramID].append(packet.payload, 7);
+            }
+            break;
+        }
+
+        case 0x19: { // COM_STMT_CLOSE
+            // There's no response.
+            lock_guard<mutex> lock(_connectionsMutex);
+            auto connection = _connections.find(s->id);
+            if (connection != _connections.end()) {
+                connection->second.statements.erase(statementIDFromPayload(packet.payload));
             }
-            // JDBC Does this.
-            if (SStartsWith(query, "/*")) {
-                auto index = query.find("*/");
-                if (index != query.npos) {
-                    query = query.substr(index + 2);
+            break;
+        }
+
+        case 0x1a: { // COM_STMT_RESET
+            lock_guard<mutex> lock(_connectionsMutex);
+            MySQLPreparedStatement* statement = _getStatement(s, packet.payload);
+            if (statement) {
+                statement->longData.clear();
+                s->send(MySQLPacket::serializeOK(packet.sequenceID));
+            } else {
+                s->send(MySQLPacket::serializeERR(packet.sequenceID, 1243, "Unknown prepared statement handler"));
+            }
+            break;
+        }
+
+        case 0x17: { // COM_STMT_EXECUTE
+            // Fill in the parameters, and then handle it as a COM_QUERY, except that results use the binary protocol.
+            string query;
+            {
+                lock_guard<mutex> lock(_connectionsMutex);
+                MySQLPreparedStatement* statement = _getStatement(s, packet.payload);
+                vector<SQValue> params;
+                if (!statement) {
+                    s->send(MySQLPacket::serializeERR(packet.sequenceID, 1243, "Unknown prepared statement handler"));
+                    break;
+                }
+                if (!MySQLPacket::deserializeExecute(packet.payload, *statement, params)) {
+                    s->send(MySQLPacket::serializeERR(packet.sequenceID, 1210, "Incorrect arguments to mysqld_stmt_execute"));
+                    break;
                 }
+                query = SQExpandBindings(statement->query, params);
             }
+            packet.payload = "\x03" + query;
+            binary = true;
+            [[fallthrough]];
+        }
+
+        case 3: { // COM_QUERY
+            // Decode the query
+            string query = normalizeQuery(packet.payload.substr(1));
             SINFO("Processing query '" << query << "'");
 
             // See if it's asking for a global variable
@@ -397,7 +852,7 @@ void BedrockPlugin_MySQL::onPortRecv(STCPManager::Socket* s, SData& request) {
                 }
                 vector<string> headers = {varName};
                 SQResult result(move(rows), move(headers));
-                s->send(MySQLPacket::serializeQueryResponse(packet.sequenceID, result));
+                s->send(MySQLPacket::serializeQueryResponse(packet.sequenceID, result, binary));
             } else if (SIEquals(query, "SHOW VARIABLES;")) {
                 // Return the variable list
                 SINFO("Responding with fake variable list");
@@ -410,7 +865,7 @@ void BedrockPlugin_MySQL::onPortRecv(STCPManager::Socket* s, SData& request) {
                 }
                 vector<string> headers = {"Variable Name", "Value"};
                 SQResult result(move(rows), move(headers));
-                s->send(MySQLPacket::serializeQueryResponse(packet.sequenceID, result));
+                s->send(MySQLPacket::serializeQueryResponse(packet.sequenceID, result, binary));
             } else if (SIEquals(query, "SHOW DATABASES;") ||
                        SIEquals(SToUpper(query), "SELECT DATABASE();") ||
                        SIEquals(SToUpper(query), "SELECT * FROM (SELECT DATABASE() AS DATABASE_NAME) A WHERE A.DATABASE_NAME IS NOT NULL;")) {
@@ -421,7 +876,7 @@ void BedrockPlugin_MySQL::onPortRecv(STCPManager::Socket* s, SData& request) {
                 vector<SQResultRow> rows = {row};
                 vector<string> headers = {"Database"};
                 SQResult result(move(rows), move(headers));
-                s->send(MySQLPacket::serializeQueryResponse(packet.sequenceID, result));
+                s->send(MySQLPacket::serializeQueryResponse(packet.sequenceID, result, binary));
             } else if (SIEquals(SToUpper(query), "SHOW /*!50002 FULL*/ TABLES;") ||
                        SIEquals(SToUpper(query), "SHOW FULL TABLES;")) {
                 SINFO("Getting table list");
@@ -525,7 +980,7 @@ void BedrockPlugin_MySQL::onPortRecv(STCPManager::Socket* s, SData& request) {
                 // Return an empty set for other information_schema queries
                 SINFO("Responding with empty result for information_schema query");
                 SQResult result;
-                s->send(MySQLPacket::serializeQueryResponse(packet.sequenceID, result));
+                s->send(MySQLPacket::serializeQueryResponse(packet.sequenceID, result, binary));
             } else if (SStartsWith(SToUpper(query), "SET ") || SStartsWith(SToUpper(query), "USE ") ||
                        SIEquals(query, "ROLLBACK;")) {
                 // Ignore
@@ -551,7 +1006,7 @@ void BedrockPlugin_MySQL::onPortRecv(STCPManager::Socket* s, SData& request) {
                 
                 vector<string> headers = {columnName};
                 SQResult result(move(rows), move(headers));
-                s->send(MySQLPacket::serializeQueryResponse(packet.sequenceID, result));
+                s->send(MySQLPacket::serializeQueryResponse(packet.sequenceID, result, binary));
             } else if (MySQLUtils::parseConnectionIdQuery(query, matches)) {
                 // Return connection ID - handles SELECT connection_id(); and SELECT connection_id() AS alias;
                 SINFO("Responding with connection ID");
@@ -567,7 +1022,7 @@ void BedrockPlugin_MySQL::onPortRecv(STCPManager::Socket* s, SData& request) {
                 
                 vector<string> headers = {columnName};
                 SQResult result(move(rows), move(headers));
-                s->send(MySQLPacket::serializeQueryResponse(packet.sequenceID, result));
+                s->send(MySQLPacket::serializeQueryResponse(packet.sequenceID, result, binary));
             } else if (MySQLUtils::isShowKeysQuery(query)) {
                 // Handle SHOW KEYS FROM table queries
                 SINFO("Processing SHOW KEYS query for table indexes");
@@ -657,6 +1112,14 @@ void BedrockPlugin_MySQL::onPortRecv(STCPManager::Socket* s, SData& request) {
             break;
         }
         }
+
+        // If we made a query, send its result as it's read (see `getResultStream`), in the protocol it was asked for.
+        if (!request.methodLine.empty()) {
+            request["Stream"] = "true";
+            if (binary) {
+                request["binaryProtocol"] = "true";
+            }
+        }
     }
 }
 
@@ -673,7 +1136,7 @@ void BedrockPlugin_MySQL::onPortRequestComplete(const BedrockCommand& command, S
             // Convert the JSON response from Bedrock::DB into MySQL protocol
             SQResult result;
             SASSERT(command.response.content.empty() || result.deserialize(command.response.content));
-            s->send(MySQLPacket::serializeQueryResponse(command.request.calc("sequenceID"), result));
+            s->send(MySQLPacket::serializeQueryResponse(command.request.calc("sequenceID"), result, command.request.test("binaryProtocol")));
         }
     } else {
         // Failure -- pass along the message
@@ -684,6 +1147,24 @@ void BedrockPlugin_MySQL::onPortRequestComplete(const BedrockCommand& command, S
     }
 }
 
+unique_ptr<BedrockResultStream> BedrockPlugin_MySQL::getResultStream(BedrockCommand& command) {
+    return make_unique<MySQLResultStream>(command);
+}
+
+void BedrockPlugin_MySQL::onPortClose(STCPManager::Socket* s) {
+    lock_guard<mutex> lock(_connectionsMutex);
+    _connections.erase(s->id);
+}
+
+MySQLPreparedStatement* BedrockPlugin_MySQL::_getStatement(STCPManager::Socket* s, const string& payload) {
+    auto connection = _connections.find(s->id);
+    if (connection == _connections.end()) {
+        return nullptr;
+    }
+    auto statement = connection->second.statements.find(statementIDFromPayload(payload));
+    return statement == connection->second.statements.end() ? nullptr : &statement->second;
+}
+
 // Define the global variable list to pretend to be MySQL
 const char* g_MySQLVariables[MYSQL_NUM_VARIABLES][2] = {
     {"auto_increment_increment", "1"},
@@ -3,7 +3,9 @@
 #include <BedrockPlugin.h>
 
 // Forward declarations
+class SQColumnarResult;
 class SQResult;
+class SQValue;
 class BedrockServer;
 class BedrockCommand;
 class SQLiteCommand;
@@ -88,6 +90,21 @@ namespace MySQLUtils {
     string extractTableNameFromForeignKeyQuery(const string& query);
 }
 
+/**
+ * A statement prepared with COM_STMT_PREPARE, kept for its connection until COM_STMT_CLOSE
+ */
+struct MySQLPreparedStatement {
+    string query;
+    uint16_t paramCount = 0;
+
+    // The type of each parameter, as sent with the last COM_STMT_EXECUTE that included them. Later executions of the
+    // same statement can leave them out.
+    vector<uint16_t> paramTypes;
+
+    // Values sent with COM_STMT_SEND_LONG_DATA since the last execution, by parameter.
+    map<uint16_t, string> longData;
+};
+
 /**
  * MySQL protocol packet handler
  */
@@ -95,6 +112,34 @@ class MySQLPacket {
 public:
     MySQLPacket();
 
+    // Column and parameter types, as sent in column definitions and COM_STMT_EXECUTE
+    enum COLUMN_TYPE : uint8_t {
+        MYSQL_TYPE_DECIMAL = 0x00,
+        MYSQL_TYPE_TINY = 0x01,
+        MYSQL_TYPE_SHORT = 0x02,
+        MYSQL_TYPE_LONG = 0x03,
+        MYSQL_TYPE_FLOAT = 0x04,
+        MYSQL_TYPE_DOUBLE = 0x05,
+        MYSQL_TYPE_NULL = 0x06,
+        MYSQL_TYPE_TIMESTAMP = 0x07,
+        MYSQL_TYPE_LONGLONG = 0x08,
+        MYSQL_TYPE_INT24 = 0x09,
+        MYSQL_TYPE_DATE = 0x0a,
+        MYSQL_TYPE_TIME = 0x0b,
+        MYSQL_TYPE_DATETIME = 0x0c,
+        MYSQL_TYPE_YEAR = 0x0d,
+        MYSQL_TYPE_VARCHAR = 0x0f,
+        MYSQL_TYPE_BIT = 0x10,
+        MYSQL_TYPE_NEWDECIMAL = 0xf6,
+        MYSQL_TYPE_TINY_BLOB = 0xf9,
+        MYSQL_TYPE_MEDIUM_BLOB = 0xfa,
+        MYSQL_TYPE_LONG_BLOB = 0xfb,
+        MYSQL_TYPE_BLOB = 0xfc,
+        MYSQL_TYPE_VAR_STRING = 0xfd,
+        MYSQL_TYPE_STRING = 0xfe,
+        MYSQL_TYPE_GEOMETRY = 0xff,
+    };
+
     // Attributes
     uint8_t sequenceID;
     string payload;
@@ -107,9 +152,36 @@ public:
     static string lenEncInt(uint64_t val);
     static string lenEncStr(const string& str);
     static string serializeHandshake();
-    static string serializeQueryResponse(int sequenceID, const SQResult& result);
+    static string serializeQueryResponse(int sequenceID, const SQResult& result, bool binary = false);
     static string serializeOK(int sequenceID);
     static string serializeERR(int sequenceID, uint16_t code, const string& message);
+
+    /**
+     * The pieces of a result set, for sending one a few rows at a time. Each appends its packets to `output`, numbering
+     * them on from `sequenceID`, which is left as the last one used.
+     * appendColumns: the column count, a definition of each column, and the EOF that ends them
+     * appendRows: a packet per row, in the text protocol (COM_QUERY) or the binary one (COM_STMT_EXECUTE)
+     * appendEOF: the EOF that ends the rows
+     */
+    static void appendColumns(string& output, uint8_t& sequenceID, const vector<string>& headers);
+    static void appendRows(string& output, uint8_t& sequenceID, const SQColumnarResult& rows, bool binary);
+    static void appendEOF(string& output, uint8_t& sequenceID);
+
+    /**
+     * Serializes the response to COM_STMT_PREPARE. The statement's columns aren't known until it's run, so they're
+     * left out here and described with each result instead.
+     */
+    static string serializePrepareOK(int sequenceID, uint32_t statementID, uint16_t paramCount);
+
+    /**
+     * Parses the parameters of a COM_STMT_EXECUTE packet for `statement`, saving the parameter types (if sent) and
+     * using up any long data in it.
+     * @param payload The whole packet payload, starting with the command byte
+     * @param statement The statement being executed
+     * @param params [out] The parameter values
+     * @return false if the packet is malformed
+     */
+    static bool deserializeExecute(const string& payload, MySQLPreparedStatement& statement, vector<SQValue>& params);
 };
 
 /**
@@ -126,6 +198,21 @@ public:
     virtual void onPortAccept(STCPManager::Socket* s);
     virtual void onPortRecv(STCPManager::Socket* s, SData& request);
     virtual void onPortRequestComplete(const BedrockCommand& command, STCPManager::Socket* s);
+    virtual unique_ptr<BedrockResultStream> getResultStream(BedrockCommand& command);
+    virtual void onPortClose(STCPManager::Socket* s);
+
+private:
+    // Returns the statement named by a COM_STMT_* packet on `s`, or null if it has none by that ID. `_connectionsMutex`
+    // must be locked.
+    MySQLPreparedStatement* _getStatement(STCPManager::Socket* s, const string& payload);
+
+    // The statements each connection has prepared, by socket ID.
+    struct Connection {
+        uint32_t lastStatementID = 0;
+        map<uint32_t, MySQLPreparedStatement> statements;
+    };
+    map<uint64_t, Connection> _connections;
+    mutex _connectionsMutex;
 };
 
 // MySQL variables
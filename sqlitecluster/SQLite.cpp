@@ -12,6 +12,8 @@
 // Tracing can only be enabled or disabled globally, not per object.
 atomic<bool> SQLite::enableTrace(false);
 
+atomic<size_t> SQLite::statementCacheSize(100);
+
 sqlite3* SQLite::getDBHandle() {
     return _db;
 }
@@ -48,7 +50,35 @@ const set<string>& SQLite::getTablesUsed() const {
     return _tablesUsed;
 }
 
-SQLite::SharedData& SQLite::initializeSharedData(sqlite3* db, const string& filename, const vector<string>& journalNames, bool hctree) {
+SQLite::StatementCache::StatementCache(SQLite& db, size_t maxEntries) : SQStatementCache(maxEntries), _db(db)
+{ }
+
+void SQLite::StatementCache::_onMiss() {
+    _db._preparingTablesUsed.clear();
+    _db._preparingIsCacheable = true;
+}
+
+bool SQLite::StatementCache::_shouldCache(Entry& entry) {
+    if (!_db._preparingIsCacheable) {
+        return false;
+    }
+    entry.tablesUsed = _db._preparingTablesUsed;
+    return true;
+}
+
+void SQLite::StatementCache::_onHit(const Entry& entry) {
+    _db._tablesUsed.insert(entry.tablesUsed.begin(), entry.tablesUsed.end());
+    _db._queryTablesUsed.insert(entry.tablesUsed.begin(), entry.tablesUsed.end());
+}
+
+SQStatementCache* SQLite::_getStatementCache() const {
+    if (whitelist || _enableRewrite) {
+        return nullptr;
+    }
+    return _statementCache.get();
+}
+
+SQLite::SharedData& SQLite::initializeSharedData(sqlite3* db, const string& filename, const vector<string>& journalNames, uint64_t journalRingSlots, bool hctree) {
     static struct SharedDataLookupMapType {
         map<string, SharedData*> m;
         ~SharedDataLookupMapType() {
@@ -77,14 +107,19 @@ SQLite::SharedData& SQLite::initializeSharedData(sqlite3* db, const string& file
         }
 
         // Read the highest commit count from the database, and store it in commitCount.
-        string query = "SELECT MAX(maxIDs) FROM (" + _getJournalQuery(journalNames, {"SELECT MAX(id) as maxIDs FROM"}, true) + ")";
-        SASSERT(!SQuery(db, "getting commit count", query, result));
-        uint64_t commitCount = result.empty() ? 0 : SToUInt64(result[0][0]);
+        uint64_t commitCount = 0;
+        if (journalRingSlots) {
+            commitCount = getJournalRingCommitCount(db, journalNames);
+        } else {
+            string query = "SELECT MAX(maxIDs) FROM (" + _getJournalQuery(journalNames, {"SELECT MAX(id) as maxIDs FROM"}, true) + ")";
+            SASSERT(!SQuery(db, "getting commit count", query, result));
+            commitCount = result.empty() ? 0 : SToUInt64(result[0][0]);
+        }
         sharedData->commitCount = commitCount;
 
         // And then read the hash for that transaction.
         string lastCommittedHash, ignore;
-        getCommit(db, journalNames, commitCount, ignore, lastCommittedHash);
+        getCommit(db, journalNames, journalRingSlots, commitCount, ignore, lastCommittedHash);
         sharedData->lastCommittedHash.store(lastCommittedHash);
 
         // If we have a commit count, we should have a hash as well.
@@ -158,10 +193,56 @@ sqlite3* SQLite::initializeDB(const string& filename, int64_t mmapSizeGB, bool h
     return db;
 }
 
-vector<string> SQLite::initializeJournal(sqlite3* db, int minJournalTables) {
+// Returns the name of the `index`th table of a ring journal.
+static string journalRingTableName(size_t index) {
+    char tableName[27] = {0};
+    snprintf(tableName, 27, "journalRing%04zu", index);
+    return tableName;
+}
+
+// Returns which table (by index) and row of a ring journal commit `id` goes in.
+static size_t journalRingTable(size_t tableCount, uint64_t id) {
+    return id % tableCount;
+}
+static uint64_t journalRingSlot(size_t tableCount, uint64_t slots, uint64_t id) {
+    return (id / tableCount) % slots;
+}
+
+vector<string> SQLite::initializeJournal(sqlite3* db, int minJournalTables, uint64_t maxJournalSize, bool ringJournal) {
     // Make sure we don't try and create more journals than we can name.
     SASSERT(minJournalTables < 10'000);
 
+    // A ring journal is only created for a database that has no journal yet.
+    if (ringJournal && minJournalTables >= -1 && !SQVerifyTableExists(db, "ringJournalConfig")) {
+        if (SQVerifyTableExists(db, "journal")) {
+            SWARN("Not creating a ring journal, as this database already has a journal.");
+        } else {
+            const size_t tableCount = minJournalTables + 2;
+            const uint64_t slots = max<uint64_t>((maxJournalSize + tableCount - 1) / tableCount, 1);
+            SASSERT(!SQuery(db, "creating ring journal", "BEGIN"));
+            SASSERT(!SQuery(db, "creating ring journal", "CREATE TABLE ringJournalConfig ( tables INTEGER, slots INTEGER )"));
+            SASSERT(!SQuery(db, "creating ring journal", "INSERT INTO ringJournalConfig VALUES (" + SQ(tableCount) + ", " + SQ(slots) + ")"));
+            for (size_t i = 0; i < tableCount; i++) {
+                SASSERT(!SQuery(db, "creating ring journal", "CREATE TABLE " + journalRingTableName(i) + " ( slot INTEGER PRIMARY KEY, id INTEGER, query TEXT, hash TEXT )"));
+            }
+            SASSERT(!SQuery(db, "creating ring journal", "COMMIT"));
+            SHMMM("Created ring journal of " << tableCount << " tables of " << slots << " commits.");
+        }
+    }
+
+    // A ring journal has exactly the tables it was created with.
+    SQResult config;
+    if (SQVerifyTableExists(db, "ringJournalConfig")) {
+        SASSERT(!SQuery(db, "reading ring journal config", "SELECT tables FROM ringJournalConfig", config));
+        SASSERT(!config.empty());
+        vector<string> journalNames;
+        for (size_t i = 0; i < SToUInt64(config[0][0]); i++) {
+            journalNames.push_back(journalRingTableName(i));
+            SASSERT(SQVerifyTableExists(db, journalNames.back()));
+        }
+        return journalNames;
+    }
+
     // First, we create all of the tables through `minJournalTables` if they don't exist.
     for (int currentJounalTable = -1; currentJounalTable <= minJournalTables; currentJounalTable++) {
         char tableName[27] = {0};
@@ -199,6 +280,53 @@ vector<string> SQLite::initializeJournal(sqlite3* db, int minJournalTables) {
     return journalNames;
 }
 
+uint64_t SQLite::initializeJournalRingSlots(sqlite3* db) {
+    SQResult config;
+    if (!SQVerifyTableExists(db, "ringJournalConfig")) {
+        return 0;
+    }
+    SASSERT(!SQuery(db, "reading ring journal config", "SELECT slots FROM ringJournalConfig", config));
+    SASSERT(!config.empty());
+    return SToUInt64(config[0][0]);
+}
+
+// Returns the highest commit ID in ring journal table `tableName`. In order of `slot`, its rows are the commits of the
+// latest lap around the ring followed by those of the lap before, so the highest is the last row with an ID at least
+// that of the first row, which a binary search finds with a few lookups by `slot` rather than reading every row.
+static uint64_t getJournalRingMaxID(sqlite3* db, const string& tableName) {
+    SQResult result;
+    SASSERT(!SQuery(db, "getting commit count", "SELECT MIN(slot), MAX(slot) FROM " + tableName, result));
+    if (result.empty() || result[0][0].empty()) {
+        return 0;
+    }
+    auto idAt = [&](uint64_t slot) {
+        SQResult idResult;
+        SASSERT(!SQuery(db, "getting commit count", "SELECT id FROM " + tableName + " WHERE slot = " + SQ(slot), idResult));
+        SASSERT(!idResult.empty());
+        return SToUInt64(idResult[0][0]);
+    };
+    uint64_t low = SToUInt64(result[0][0]);
+    uint64_t high = SToUInt64(result[0][1]);
+    const uint64_t firstID = idAt(low);
+    while (low < high) {
+        const uint64_t middle = low + (high - low + 1) / 2;
+        if (idAt(middle) >= firstID) {
+            low = middle;
+        } else {
+            high = middle - 1;
+        }
+    }
+    return idAt(low);
+}
+
+uint64_t SQLite::getJournalRingCommitCount(sqlite3* db, const vector<string>& journalNames) {
+    uint64_t commitCount = 0;
+    for (const string& tableName : journalNames) {
+        commitCount = max(commitCount, getJournalRingMaxID(db, tableName));
+    }
+    return commitCount;
+}
+
 void SQLite::commonConstructorInitialization(bool hctree) {
     // Perform sanity checks.
     SASSERT(!_filename.empty());
@@ -225,6 +353,9 @@ void SQLite::commonConstructorInitialization(bool hctree) {
     // Register the authorizer callback which allows callers to whitelist particular data in the DB.
     sqlite3_set_authorizer(_db, _sqliteAuthorizerCallback, this);
 
+    _statementCache = make_unique<StatementCache>(*this, statementCacheSize);
+    _statementCacheSchemaChangeCount = _sharedData.schemaChangeCount;
+
     // Register application-defined deburr function.
     SDeburr::registerSQLite(_db);
 
@@ -243,13 +374,14 @@ void SQLite::commonConstructorInitialization(bool hctree) {
 }
 
 SQLite::SQLite(const string& filename, int cacheSize, int maxJournalSize,
-               int minJournalTables, int64_t mmapSizeGB, bool hctree, const string& checkpointMode) :
+               int minJournalTables, int64_t mmapSizeGB, bool hctree, const string& checkpointMode, bool ringJournal) :
     _filename(initializeFilename(filename)),
     _maxJournalSize(maxJournalSize),
     _hctree(validateDBFormat(_filename, hctree)),
     _db(initializeDB(_filename, mmapSizeGB, _hctree)),
-    _journalNames(initializeJournal(_db, minJournalTables)),
-    _sharedData(initializeSharedData(_db, _filename, _journalNames, _hctree)),
+    _journalNames(initializeJournal(_db, minJournalTables, _maxJournalSize, ringJournal)),
+    _journalRingSlots(initializeJournalRingSlots(_db)),
+    _sharedData(initializeSharedData(_db, _filename, _journalNames, _journalRingSlots, _hctree)),
     _cacheSize(cacheSize),
     _mmapSizeGB(mmapSizeGB),
     _checkpointMode(getCheckpointModeFromString(checkpointMode))
@@ -263,6 +395,7 @@ SQLite::SQLite(const SQLite& from) :
     _hctree(from._hctree),
     _db(initializeDB(_filename, from._mmapSizeGB, false)), // Create a *new* DB handle from the same filename, don't copy the existing handle.
     _journalNames(from._journalNames),
+    _journalRingSlots(from._journalRingSlots),
     _sharedData(from._sharedData),
     _cacheSize(from._cacheSize),
     _mmapSizeGB(from._mmapSizeGB),
@@ -349,6 +482,59 @@ string SQLite::_getJournalQuery(const vector<string>& journalNames, const list<s
     return query;
 }
 
+string SQLite::_getJournalRangeQuery(const string& columns, uint64_t fromID, uint64_t toID) {
+    if (!_journalRingSlots) {
+        return _getJournalQuery({"SELECT " + columns + " FROM", "WHERE id >= " + SQ(fromID) + (toID ? " AND id <= " + SQ(toID) : "")});
+    }
+
+    // Nothing newer than the commit after the last one we know of can have been committed yet.
+    if (!toID) {
+        toID = _sharedData.commitCount + 1;
+    }
+
+    // The commits in the range that go in each table are in a range of its rows, which may wrap around past the end of
+    // the table. These are all distinct, so there's no need for UNION to remove duplicates.
+    list<string> queries;
+    const size_t tableCount = _journalNames.size();
+    const string idRange = "id >= " + SQ(fromID) + " AND id <= " + SQ(toID);
+    for (size_t table = 0; table < tableCount; table++) {
+        // The first and last commits in the range that go in this table.
+        const uint64_t first = fromID + (table + tableCount - journalRingTable(tableCount, fromID)) % tableCount;
+        if (first > toID) {
+            continue;
+        }
+        const uint64_t last = toID - (journalRingTable(tableCount, toID) + tableCount - table) % tableCount;
+        const string select = "SELECT " + columns + " FROM " + _journalNames[table] + " WHERE " + idRange;
+        if ((last - first) / tableCount + 1 >= _journalRingSlots) {
+            queries.push_back(select);
+            continue;
+        }
+        const uint64_t firstSlot = journalRingSlot(tableCount, _journalRingSlots, first);
+        const uint64_t lastSlot = journalRingSlot(tableCount, _journalRingSlots, last);
+        if (firstSlot <= lastSlot) {
+            queries.push_back(select + " AND slot >= " + SQ(firstSlot) + " AND slot <= " + SQ(lastSlot));
+        } else {
+            queries.push_back(select + " AND slot >= " + SQ(firstSlot));
+            queries.push_back(select + " AND slot <= " + SQ(lastSlot));
+        }
+    }
+    if (queries.empty()) {
+        return "SELECT " + columns + " FROM " + _journalNames.front() + " WHERE 0";
+    }
+    return SComposeList(queries, " UNION ALL ");
+}
+
+string SQLite::_getJournalInsertQuery(uint64_t id, const string& query, const string& hash) {
+    if (!_journalRingSlots) {
+        return "INSERT INTO " + _journalName + " VALUES (" + SQ(id) + ", " + SQ(query) + ", " + SQ(hash) + " )";
+    }
+
+    // Overwrite whatever's in this commit's row in place, rather than deleting it and inserting a new one.
+    return "INSERT INTO " + _journalName + " VALUES (" + SQ(journalRingSlot(_journalNames.size(), _journalRingSlots, id)) + ", " +
+           SQ(id) + ", " + SQ(query) + ", " + SQ(hash) + " ) " +
+           "ON CONFLICT (slot) DO UPDATE SET id = excluded.id, query = excluded.query, hash = excluded.hash";
+}
+
 SQLite::~SQLite() {
     // First, rollback any incomplete transaction.
     if (!_uncommittedQuery.empty()) {
@@ -357,6 +543,9 @@ SQLite::~SQLite() {
         SINFO("Rollback in destructor complete.");
     }
 
+    // Any cached statements need to be finalized before the DB can be closed.
+    _statementCache->clear();
+
     // Finally, Close the DB.
     DBINFO("Closing database '" << _filename << ".");
     SASSERTWARN(_uncommittedQuery.empty());
@@ -401,6 +590,12 @@ SQLite::TRANSACTION_TYPE SQLite::getLastTransactionType() {
 }
 
 bool SQLite::beginTransaction(SQLite::TRANSACTION_TYPE type) {
+    // The enclosing transaction (and the commit lock, if it's exclusive) was already taken when the savepoint was
+    // opened.
+    if (_insideSavepoint) {
+        return true;
+    }
+
     _lastTransactionType = type;
     if (type == TRANSACTION_TYPE::EXCLUSIVE) {
         if (isSyncThread) {
@@ -413,6 +608,7 @@ bool SQLite::beginTransaction(SQLite::TRANSACTION_TYPE type) {
             _sharedData.commitLock.lock();
         }
         _sharedData._commitLockTimer.start("EXCLUSIVE");
+        _commitLockStart = STimeNow();
         _mutexLocked = true;
     }
 
@@ -452,6 +648,16 @@ bool SQLite::beginTransaction(SQLite::TRANSACTION_TYPE type) {
     _dbCountAtStart = getCommitCount();
     _queryCache.clear();
     _tablesUsed.clear();
+    _tablesWritten.clear();
+    _usedReadCache = false;
+    _readCacheCommitCount = _dbCountAtStart;
+
+    // If any handle has changed the schema since we last looked, drop our cached statements.
+    uint64_t schemaChangeCount = _sharedData.schemaChangeCount;
+    if (schemaChangeCount != _statementCacheSchemaChangeCount) {
+        _statementCache->clear();
+        _statementCacheSchemaChangeCount = schemaChangeCount;
+    }
     _readQueryCount = 0;
     _writeQueryCount = 0;
     _cacheHits = 0;
@@ -547,19 +753,49 @@ string SQLite::read(const string& query) const {
 }
 
 bool SQLite::read(const string& query, SQResult& result, bool skipInfoWarn) const {
+    return read(query, {}, result, skipInfoWarn);
+}
+
+string SQLite::read(const string& query, const vector<SQValue>& bindings) const {
+    SQResult result;
+    if (!read(query, bindings, result)) {
+        return "";
+    }
+    if (result.empty() || result[0].empty()) {
+        return "";
+    }
+    return result[0][0];
+}
+
+bool SQLite::read(const string& query, const vector<SQValue>& bindings, SQResult& result, bool skipInfoWarn) const {
     uint64_t before = STimeNow();
     bool queryResult = false;
     _readQueryCount++;
-    auto foundQuery = _queryCache.find(query);
+
+    // The query text alone doesn't identify the results of a query with bindings, so those aren't cached.
+    auto foundQuery = bindings.empty() ? _queryCache.find(query) : _queryCache.end();
+    const bool canUseReadCache = _canUseReadCache(bindings);
+    set<string> readCacheTablesUsed;
     if (foundQuery != _queryCache.end()) {
         result = foundQuery->second;
         _cacheHits++;
         queryResult = true;
+    } else if (canUseReadCache && _sharedData.getCachedRead(query, _readCacheCommitCount, result, readCacheTablesUsed)) {
+        _tablesUsed.insert(readCacheTablesUsed.begin(), readCacheTablesUsed.end());
+        _usedReadCache = true;
+        _queryCache.emplace(make_pair(query, result));
+        _cacheHits++;
+        queryResult = true;
     } else {
         _isDeterministicQuery = true;
-        queryResult = !SQuery(_db, "read only query", query, result, 2000 * STIME_US_PER_MS, skipInfoWarn);
-        if (_isDeterministicQuery && queryResult && insideTransaction()) {
+        _queryTablesUsed.clear();
+        _queryIsShareable = true;
+        queryResult = !SQuery(_db, "read only query", query, bindings, result, 2000 * STIME_US_PER_MS, skipInfoWarn, _getStatementCache());
+        if (bindings.empty() && _isDeterministicQuery && queryResult && insideTransaction()) {
             _queryCache.emplace(make_pair(query, result));
+            if (canUseReadCache && _queryIsShareable && !_queryTablesUsed.empty() && result.size() <= MAX_READ_CACHE_ROWS) {
+                _sharedData.cacheRead(query, _queryTablesUsed, _readCacheCommitCount, result);
+            }
         }
     }
     _checkInterruptErrors("SQLite::read"s);
@@ -567,6 +803,45 @@ bool SQLite::read(const string& query, SQResult& result, bool skipInfoWarn) cons
     return queryResult;
 }
 
+bool SQLite::_canUseReadCache(const vector<SQValue>& bindings) const {
+    // Only query-only transactions, which won't commit, can use it. Whitelisted and re-written queries depend on the
+    // authorizer seeing every query, and once this transaction has written anything, it needs to see its own writes.
+    if (!bindings.empty() || !_insideTransaction || !_queryOnly || _writeQueryCount || whitelist || _enableRewrite || !_sharedData.isReadCacheEnabled()) {
+        return false;
+    }
+
+    // Nothing in this transaction may have started its snapshot yet, and that needs to happen before we look anything
+    // up, or a result we return could be older than what sqlite would give us once it does. Every commit counted
+    // before it starts is in it, and a commit that lands in between only makes entries look older than they are.
+    if (sqlite3_txn_state(_db, "main") == SQLITE_TXN_NONE) {
+        _readCacheCommitCount = getCommitCount();
+        SASSERT(!SQuery(_db, "starting read snapshot", "PRAGMA schema_version;"));
+    }
+    return true;
+}
+
+bool SQLite::read(const string& query, SQColumnarResult& result, bool skipInfoWarn) const {
+    return read(query, {}, result, skipInfoWarn);
+}
+
+bool SQLite::read(const string& query, const vector<SQValue>& bindings, SQColumnarResult& result, bool skipInfoWarn) const {
+    uint64_t before = STimeNow();
+    _readQueryCount++;
+    bool queryResult = !SQuery(_db, "read only query", query, bindings, result, 2000 * STIME_US_PER_MS, skipInfoWarn, _getStatementCache());
+    _checkInterruptErrors("SQLite::read"s);
+    _readElapsed += STimeNow() - before;
+    return queryResult;
+}
+
+bool SQLite::read(const string& query, const vector<SQValue>& bindings, size_t batchBytes, const function<bool(SQColumnarResult&)>& onRows, bool skipInfoWarn) const {
+    uint64_t before = STimeNow();
+    _readQueryCount++;
+    bool queryResult = !SQuery(_db, "read only query", query, bindings, batchBytes, onRows, 2000 * STIME_US_PER_MS, skipInfoWarn, _getStatementCache());
+    _checkInterruptErrors("SQLite::read"s);
+    _readElapsed += STimeNow() - before;
+    return queryResult;
+}
+
 void SQLite::_checkInterruptErrors(const string& error) const {
 
     // Local error code.
@@ -600,41 +875,53 @@ void SQLite::_checkInterruptErrors(const string& error) const {
 }
 
 bool SQLite::write(const string& query) {
-    if (_noopUpdateMode) {
-        SALERT("Non-idempotent write in _noopUpdateMode. Query: " << query);
-        return true;
-    }
-
-    // This is literally identical to the idempotent version except for the check for _noopUpdateMode.
     SQResult ignore;
-    return _writeIdempotent(query, ignore);
+    return write(query, {}, ignore);
 }
 
 bool SQLite::write(const string& query, SQResult& result) {
+    return write(query, {}, result);
+}
+
+bool SQLite::write(const string& query, const vector<SQValue>& bindings) {
+    SQResult ignore;
+    return write(query, bindings, ignore);
+}
+
+bool SQLite::write(const string& query, const vector<SQValue>& bindings, SQResult& result) {
     if (_noopUpdateMode) {
         SALERT("Non-idempotent write in _noopUpdateMode. Query: " << query);
         return true;
     }
 
     // This is literally identical to the idempotent version except for the check for _noopUpdateMode.
-    return _writeIdempotent(query, result);
+    return _writeIdempotent(query, bindings, result);
 }
 
 bool SQLite::writeIdempotent(const string& query) {
     SQResult ignore;
-    return _writeIdempotent(query, ignore);
+    return _writeIdempotent(query, {}, ignore);
 }
 
 bool SQLite::writeIdempotent(const string& query, SQResult& result) {
-    return _writeIdempotent(query, result);
+    return _writeIdempotent(query, {}, result);
+}
+
+bool SQLite::writeIdempotent(const string& query, const vector<SQValue>& bindings) {
+    SQResult ignore;
+    return _writeIdempotent(query, bindings, ignore);
+}
+
+bool SQLite::writeIdempotent(const string& query, const vector<SQValue>& bindings, SQResult& result) {
+    return _writeIdempotent(query, bindings, result);
 }
 
 bool SQLite::writeUnmodified(const string& query) {
     SQResult ignore;
-    return _writeIdempotent(query, ignore, true);
+    return _writeIdempotent(query, {}, ignore, true);
 }
 
-bool SQLite::_writeIdempotent(const string& query, SQResult& result, bool alwaysKeepQueries) {
+bool SQLite::_writeIdempotent(const string& query, const vector<SQValue>& bindings, SQResult& result, bool alwaysKeepQueries) {
     if (!_insideTransaction) {
         STHROW("500 Attempted to write outside of transaction");
     }
@@ -657,11 +944,16 @@ bool SQLite::_writeIdempotent(const string& query, SQResult& result, bool always
     uint64_t before = STimeNow();
     bool usedRewrittenQuery = false;
     int resultCode = 0;
+    _queryTablesUsed.clear();
     {
         shared_lock<shared_mutex> lock(_sharedData.writeLock);
         if (_enableRewrite) {
-            resultCode = SQuery(_db, "read/write transaction", query, result, 2'000'000, true);
-            if (resultCode == SQLITE_AUTH) {
+            resultCode = SQuery(_db, "read/write transaction", query, bindings, result, 2'000'000, true);
+            if (resultCode == SQLITE_AUTH && !bindings.empty()) {
+                // The rewrite handler only sees the action and table, so what it writes can't use the values bound to
+                // the original query. Rather than run something that silently drops them, fail the write.
+                SWARN("Refusing to rewrite query with bindings: " << query);
+            } else if (resultCode == SQLITE_AUTH) {
                 // Run re-written query.
                 _currentlyRunningRewritten = true;
                 SASSERT(SEndsWith(_rewrittenQuery, ";"));
@@ -670,10 +962,13 @@ bool SQLite::_writeIdempotent(const string& query, SQResult& result, bool always
                 _currentlyRunningRewritten = false;
             }
         } else {
-            resultCode = SQuery(_db, "read/write transaction", query, result);
+            resultCode = SQuery(_db, "read/write transaction", query, bindings, result, 2000 * STIME_US_PER_MS, false, _getStatementCache());
         }
     }
 
+    // Even a failed query may have changed some of these, if it had several statements.
+    _tablesWritten.insert(_queryTablesUsed.begin(), _queryTablesUsed.end());
+
     // If we got a constraints error, throw that.
     if (resultCode == SQLITE_CONSTRAINT) {
         _currentlyWriting = false;
@@ -693,31 +988,69 @@ bool SQLite::_writeIdempotent(const string& query, SQResult& result, bool always
     uint64_t schemaAfter = SToUInt64(results[0][0]);
     uint64_t changesAfter = sqlite3_total_changes(_db);
 
+    // Statements prepared against the old schema may no longer be valid, and nor may anything in the read cache.
+    if (schemaAfter != schemaBefore) {
+        _statementCache->clear();
+        _statementCacheSchemaChangeCount = ++_sharedData.schemaChangeCount;
+        _tablesWritten.insert("sqlite_master");
+    }
+
     // If something changed, or we're always keeping queries, then save this.
     if (alwaysKeepQueries || (schemaAfter > schemaBefore) || (changesAfter > changesBefore)) {
-        _uncommittedQuery += usedRewrittenQuery ? _rewrittenQuery : query;
+        if (usedRewrittenQuery) {
+            _uncommittedQuery += _rewrittenQuery;
+        } else if (bindings.empty()) {
+            _uncommittedQuery += query;
+        } else {
+            // Peers replay the journaled query text, so it needs the values spelled out.
+            _uncommittedQuery += SQExpandBindings(query, bindings);
+        }
     }
 
     _currentlyWriting = false;
     return true;
 }
 
-bool SQLite::prepare(uint64_t* transactionID, string* transactionhash) {
-    SASSERT(_insideTransaction);
+int64_t SQLite::_prepareJournal() {
+    // A ring journal never needs truncating, and the table each commit goes in depends on its ID, which we don't know
+    // until we hold the commit lock.
+    int64_t journalID = 0;
+    if (!_journalRingSlots) {
+        // Pick a journal for this transaction.
+        journalID = _sharedData.nextJournalCount++;
+        _journalName = _journalNames[journalID % _journalNames.size()];
 
-    // Pick a journal for this transaction.
-    const int64_t journalID = _sharedData.nextJournalCount++;
-    _journalName = _journalNames[journalID % _journalNames.size()];
+        // Note that this can change before we hold the lock on _sharedData.commitLock, but it doesn't matter yet, as we're only
+        // using it to truncate the journal. We'll reset this value once we acquire that lock.
+        _trimJournal(_sharedData.commitCount);
+    }
 
+    // We lock this here, so that we can guarantee the order in which commits show up in the database.
+    if (!_mutexLocked) {
+        auto start = STimeNow();
+        _sharedData.commitLock.lock();
+        auto end = STimeNow();
+        if (end - start > 5'000) {
+            SINFO("Waited " << (end - start) << "us for commit lock.");
+        }
+        _sharedData._commitLockTimer.start("SHARED");
+        _commitLockStart = STimeNow();
+        _mutexLocked = true;
+    }
+
+    if (_journalRingSlots) {
+        journalID = _sharedData.commitCount + 1;
+        _journalName = _journalNames[journalRingTable(_journalNames.size(), journalID)];
+    }
+    return journalID;
+}
+
+void SQLite::_trimJournal(uint64_t commitCount) {
     // Look up the oldest commit in our chosen journal, and compute the oldest commit we intend to keep.
     SQResult journalLookupResult;
     SASSERT(!SQuery(_db, "getting commit min", "SELECT MIN(id) FROM " + _journalName, journalLookupResult));
     uint64_t minJournalEntry = journalLookupResult.size() ? SToUInt64(journalLookupResult[0][0]) : 0;
 
-    // Note that this can change before we hold the lock on _sharedData.commitLock, but it doesn't matter yet, as we're only
-    // using it to truncate the journal. We'll reset this value once we acquire that lock.
-    uint64_t commitCount = _sharedData.commitCount;
-
     // If the commitCount is less than the max journal size, keep everything. Otherwise, keep everything from
     // commitCount - _maxJournalSize forward. We can't just do the last subtraction part because it overflows our unsigned
     // int.
@@ -731,18 +1064,24 @@ bool SQLite::prepare(uint64_t* transactionID, string* transactionhash) {
         string query = "DELETE FROM " + _journalName + " WHERE id < " + SQ(oldestCommitToKeep) + " LIMIT " + SQ(deleteLimit);
         SASSERT(!SQuery(_db, "Deleting oldest journal rows", query));
     }
+}
 
-    // We lock this here, so that we can guarantee the order in which commits show up in the database.
+bool SQLite::prepare(uint64_t* transactionID, string* transactionhash) {
+    SASSERT(_insideTransaction);
+    SASSERT(!_insideSavepoint);
+    SASSERT(_batchedHashes.empty());
+
+    // Hashing a large query is slow, and every commit on the node waits for us while we hold the commit lock, so we
+    // hash before taking it, chaining off whatever was committed last. If nobody commits before we get the lock (and
+    // nothing is added to the query on prepare), that's the hash we need. If we already hold the lock, there's no point.
+    string speculativeParentHash;
+    string speculativeHash;
+    const size_t speculativeQuerySize = _uncommittedQuery.size();
     if (!_mutexLocked) {
-        auto start = STimeNow();
-        _sharedData.commitLock.lock();
-        auto end = STimeNow();
-        if (end - start > 5'000) {
-            SINFO("Waited " << (end - start) << "us for commit lock.");
-        }
-        _sharedData._commitLockTimer.start("SHARED");
-        _mutexLocked = true;
+        speculativeParentHash = getCommittedHash();
+        speculativeHash = SToHex(SHashSHA1(speculativeParentHash + _uncommittedQuery));
     }
+    const int64_t journalID = _prepareJournal();
 
     // We pass the journal number selected to the handler so that a caller can utilize the
     // same method bedrock does for accessing 1 table per thread, in order to attempt to
@@ -753,11 +1092,15 @@ bool SQLite::prepare(uint64_t* transactionID, string* transactionhash) {
 
     // Now that we've locked anybody else from committing, look up the state of the database. We don't need to lock the
     // SharedData object to get these values as we know it can't currently change.
-    commitCount = _sharedData.commitCount;
+    uint64_t commitCount = _sharedData.commitCount;
 
     // Queue up the journal entry
     string lastCommittedHash = getCommittedHash(); // This is why we need the lock.
-    _uncommittedHash = SToHex(SHashSHA1(lastCommittedHash + _uncommittedQuery));
+    if (!speculativeHash.empty() && lastCommittedHash == speculativeParentHash && _uncommittedQuery.size() == speculativeQuerySize) {
+        _uncommittedHash = move(speculativeHash);
+    } else {
+        _uncommittedHash = SToHex(SHashSHA1(lastCommittedHash + _uncommittedQuery));
+    }
     uint64_t before = STimeNow();
 
     // Update the passed-in reference values
@@ -769,7 +1112,8 @@ bool SQLite::prepare(uint64_t* transactionID, string* transactionhash) {
     }
 
     // Create our query.
-    string query = "INSERT INTO " + _journalName + " VALUES (" + SQ(commitCount + 1) + ", " + SQ(_uncommittedQuery) + ", " + SQ(_uncommittedHash) + " )";
+    string query = _getJournalInsertQuery(commitCount + 1, _uncommittedQuery, _uncommittedHash);
+    _tablesWritten.insert(_journalName);
 
     // These are the values we're currently operating on, until we either commit or rollback.
     _sharedData.prepareTransactionInfo(commitCount + 1, _uncommittedQuery, _uncommittedHash, _dbCountAtStart);
@@ -793,6 +1137,51 @@ bool SQLite::prepare(uint64_t* transactionID, string* transactionhash) {
     return true;
 }
 
+bool SQLite::prepareBatched(const string& expectedHash) {
+    SASSERT(_insideTransaction);
+    SASSERT(!_insideSavepoint);
+
+    // The first commit in the batch picks the journal and takes the commit lock for the whole batch, so nobody else can
+    // commit between the commits we're stacking up here.
+    if (_batchedHashes.empty()) {
+        _prepareJournal();
+    }
+
+    // Each commit chains off the previous one in the batch, rather than the last thing actually committed.
+    const uint64_t commitID = _sharedData.commitCount + _batchedHashes.size() + 1;
+    const string lastHash = _batchedHashes.empty() ? getCommittedHash() : _batchedHashes.back();
+    const string hash = SToHex(SHashSHA1(lastHash + _uncommittedQuery));
+    if (hash != expectedHash) {
+        SWARN("Hash mismatch preparing batched commit " << commitID << ", expected " << expectedHash << " but got " << hash);
+        return false;
+    }
+
+    // In a ring journal, each commit in the batch goes in its own table. Otherwise they all go in the table the first
+    // one picked, so each trims it as an unbatched commit would, or it would grow by the size of every batch.
+    if (_journalRingSlots) {
+        _journalName = _journalNames[journalRingTable(_journalNames.size(), commitID)];
+    } else if (_batchedHashes.size()) {
+        _trimJournal(commitID - 1);
+    }
+
+    uint64_t before = STimeNow();
+    string query = _getJournalInsertQuery(commitID, _uncommittedQuery, hash);
+    _tablesWritten.insert(_journalName);
+    _sharedData.prepareTransactionInfo(commitID, _uncommittedQuery, hash, _dbCountAtStart);
+    int result = SQuery(_db, "updating journal", query);
+    _prepareElapsed += STimeNow() - before;
+    if (result) {
+        SWARN("Unable to prepare batched commit " << commitID << ", got result: " << result);
+        return false;
+    }
+
+    // The next commit in the batch starts with an empty query.
+    _batchedHashes.push_back(hash);
+    _uncommittedHash = hash;
+    _uncommittedQuery.clear();
+    return true;
+}
+
 int SQLite::commit(const string& description, function<void()>* preCheckpointCallback) {
     // If commits have been disabled, return an error without attempting the commit.
     if (!_sharedData._commitEnabled) {
@@ -803,6 +1192,9 @@ int SQLite::commit(const string& description, function<void()>* preCheckpointCal
     SASSERT(!_uncommittedHash.empty()); // Must prepare first
     int result = 0;
 
+    // Anything that reads these tables from the read cache needs to know they're changing before anyone can see it.
+    _sharedData.markTablesWritten(_tablesWritten, _sharedData.commitCount + max<size_t>(_batchedHashes.size(), 1));
+
     // Make sure one is ready to commit
     SDEBUG("Committing transaction");
 
@@ -855,12 +1247,20 @@ int SQLite::commit(const string& description, function<void()>* preCheckpointCal
         }
 
         _commitElapsed += STimeNow() - before;
-        _sharedData.incrementCommit(_uncommittedHash);
+        if (_batchedHashes.empty()) {
+            _sharedData.incrementCommit(_uncommittedHash);
+        } else {
+            for (const string& hash : _batchedHashes) {
+                _sharedData.incrementCommit(hash);
+            }
+            _batchedHashes.clear();
+        }
         _insideTransaction = false;
         _uncommittedHash.clear();
         _uncommittedQuery.clear();
         _sharedData._commitLockTimer.stop();
         _sharedData.commitLock.unlock();
+        _commitLockElapsed = STimeNow() - _commitLockStart;
         _mutexLocked = false;
         _queryCache.clear();
 
@@ -875,9 +1275,10 @@ int SQLite::commit(const string& description, function<void()>* preCheckpointCal
             if (_sharedData.outstandingFramesToCheckpoint) {
                 auto start = STimeNow();
                 int framesCheckpointed = 0;
-                sqlite3_wal_checkpoint_v2(_db, 0, _checkpointMode, NULL, &framesCheckpointed);
+                const int checkpointMode = _sharedData.backupsInProgress ? SQLITE_CHECKPOINT_PASSIVE : _checkpointMode;
+                sqlite3_wal_checkpoint_v2(_db, 0, checkpointMode, NULL, &framesCheckpointed);
                 auto end = STimeNow();
-                SINFO("Checkpoint with type=" << _checkpointMode << " complete with " << framesCheckpointed << " frames checkpointed of " << _sharedData.outstandingFramesToCheckpoint << " frames outstanding in " << (end - start) << "us.");
+                SINFO("Checkpoint with type=" << checkpointMode << " complete with " << framesCheckpointed << " frames checkpointed of " << _sharedData.outstandingFramesToCheckpoint << " frames outstanding in " << (end - start) << "us.");
 
                 // It might not actually be 0, but we'll just let sqlite tell us what it is next time _walHookCallback runs.
                 _sharedData.outstandingFramesToCheckpoint = 0;
@@ -922,7 +1323,71 @@ map<uint64_t, tuple<string, string, uint64_t>> SQLite::popCommittedTransactions(
     return _sharedData.popCommittedTransactions();
 }
 
+void SQLite::setCommitCacheSize(size_t size) {
+    _sharedData.setCommitCacheSize(size);
+}
+
+void SQLite::setCommitCacheBytes(size_t bytes) {
+    _sharedData.setCommitCacheBytes(bytes);
+}
+
+STable SQLite::getCommitCacheStats() {
+    return {
+        {"commitCacheCount", to_string(_sharedData.getCommitCacheCount())},
+        {"commitCacheBytes", to_string(_sharedData.getCommitCacheBytes())},
+        {"commitCacheHits", to_string(_sharedData.commitCacheHits)},
+        {"commitCacheMisses", to_string(_sharedData.commitCacheMisses)},
+    };
+}
+
+void SQLite::setReadCacheSize(size_t size) {
+    _sharedData.setReadCacheSize(size);
+}
+
+bool SQLite::usedReadCache() const {
+    return _usedReadCache;
+}
+
+STable SQLite::getReadCacheStats() {
+    return {
+        {"readCacheCount", to_string(_sharedData.getReadCacheCount())},
+        {"readCacheHits", to_string(_sharedData.readCacheHits)},
+        {"readCacheMisses", to_string(_sharedData.readCacheMisses)},
+    };
+}
+
+void SQLite::beginSavepoint() {
+    SASSERT(_insideTransaction);
+    SASSERT(!_insideSavepoint);
+    SASSERT(!SQuery(_db, "opening savepoint", "SAVEPOINT bedrock_savepoint"));
+    _insideSavepoint = true;
+    _savepointQuerySize = _uncommittedQuery.size();
+}
+
+void SQLite::releaseSavepoint() {
+    SASSERT(_insideSavepoint);
+    SASSERT(!SQuery(_db, "releasing savepoint", "RELEASE bedrock_savepoint"));
+    _insideSavepoint = false;
+    _savepointQuerySize = 0;
+}
+
 void SQLite::rollback() {
+    // If sqlite already threw away the whole transaction, there's no savepoint left to roll back to, so we fall
+    // through and clean up the transaction as a whole.
+    if (_insideSavepoint && !_autoRolledBack) {
+        if (_uncommittedQuery.size() > _savepointQuerySize) {
+            SINFO("Rolling back to savepoint: " << _uncommittedQuery.substr(_savepointQuerySize, 100));
+        }
+        uint64_t before = STimeNow();
+        SASSERT(!SQuery(_db, "rolling back to savepoint", "ROLLBACK TO bedrock_savepoint"));
+        _rollbackElapsed += STimeNow() - before;
+        _uncommittedQuery.resize(_savepointQuerySize);
+        _queryCache.clear();
+        return;
+    }
+    _insideSavepoint = false;
+    _savepointQuerySize = 0;
+
     // Make sure we're actually inside a transaction
     if (_insideTransaction) {
         // Cancel this transaction
@@ -944,6 +1409,7 @@ void SQLite::rollback() {
         _insideTransaction = false;
         _uncommittedHash.clear();
         _uncommittedQuery.clear();
+        _batchedHashes.clear();
 
         // Only unlock the mutex if we've previously locked it. We can call `rollback` to cancel a transaction without
         // ever having called `prepare`, which would have locked our mutex.
@@ -951,6 +1417,7 @@ void SQLite::rollback() {
             _mutexLocked = false;
             _sharedData._commitLockTimer.stop();
             _sharedData.commitLock.unlock();
+            _commitLockElapsed = STimeNow() - _commitLockStart;
         }
     } else {
         SINFO("Rolling back but not inside transaction, ignoring.");
@@ -961,6 +1428,7 @@ void SQLite::rollback() {
     _writeQueryCount = 0;
     _cacheHits = 0;
     _dbCountAtStart = 0;
+    _usedReadCache = false;
 }
 
 uint64_t SQLite::getLastTransactionTiming(uint64_t& begin, uint64_t& read, uint64_t& write, uint64_t& prepare,
@@ -976,14 +1444,24 @@ uint64_t SQLite::getLastTransactionTiming(uint64_t& begin, uint64_t& read, uint6
 }
 
 bool SQLite::getCommit(uint64_t id, string& query, string& hash) {
-    return getCommit(_db, _journalNames, id, query, hash);
+    if (_sharedData.getCachedCommit(id, query, hash)) {
+        return true;
+    }
+    return getCommit(_db, _journalNames, _journalRingSlots, id, query, hash);
 }
 
-bool SQLite::getCommit(sqlite3* db, const vector<string>& journalNames, uint64_t id, string& query, string& hash) {
+bool SQLite::getCommit(sqlite3* db, const vector<string>& journalNames, uint64_t journalRingSlots, uint64_t id, string& query, string& hash) {
     // TODO: This can fail if called after `BEGIN TRANSACTION`, if the id we want to look up was committed by another
     // thread. We may or may never need to handle this case.
-    // Look up the query and hash for the given commit
-    string internalQuery = _getJournalQuery(journalNames, {"SELECT query, hash FROM", "WHERE id = " + SQ(id)});
+    // Look up the query and hash for the given commit. In a ring journal there's only one place it can be, though
+    // it may since have been replaced by a later commit.
+    string internalQuery;
+    if (journalRingSlots) {
+        internalQuery = "SELECT query, hash FROM " + journalNames[journalRingTable(journalNames.size(), id)] +
+                        " WHERE slot = " + SQ(journalRingSlot(journalNames.size(), journalRingSlots, id)) + " AND id = " + SQ(id);
+    } else {
+        internalQuery = _getJournalQuery(journalNames, {"SELECT query, hash FROM", "WHERE id = " + SQ(id)});
+    }
     SQResult result;
     SASSERT(!SQuery(db, "getting commit", internalQuery, result));
     if (!result.empty()) {
@@ -1009,8 +1487,10 @@ string SQLite::getCommittedHash() {
 int SQLite::getCommits(uint64_t fromIndex, uint64_t toIndex, SQResult& result, uint64_t timeoutLimitUS) {
     // Look up all the queries within that range
     SASSERTWARN(SWITHIN(1, fromIndex, toIndex));
-    string query = _getJournalQuery({"SELECT id, hash, query FROM", "WHERE id >= " + SQ(fromIndex) +
-                                    (toIndex ? " AND id <= " + SQ(toIndex) : "")});
+    if (_sharedData.getCachedCommits(fromIndex, toIndex, result)) {
+        return SQLITE_OK;
+    }
+    string query = _getJournalRangeQuery("id, hash, query", fromIndex, toIndex);
     SDEBUG("Getting commits #" << fromIndex << "-" << toIndex);
     query = "SELECT hash, query FROM (" + query  + ") ORDER BY id";
     if (timeoutLimitUS) {
@@ -1021,6 +1501,110 @@ int SQLite::getCommits(uint64_t fromIndex, uint64_t toIndex, SQResult& result, u
     return queryResult;
 }
 
+bool SQLite::_beginBackupSnapshot(uint64_t& commitCount) {
+    // Nothing can commit while we hold the commit lock, so the snapshot started by the first read is at the commit count
+    // we read alongside it, without having to look for the highest ID in the journal.
+    lock_guard<decltype(_sharedData.commitLock)> lock(_sharedData.commitLock);
+    if (SQuery(_db, "starting backup", "BEGIN")) {
+        return false;
+    }
+    if (SQuery(_db, "starting backup", "PRAGMA schema_version;")) {
+        SQuery(_db, "ending backup", "ROLLBACK");
+        return false;
+    }
+    commitCount = getCommitCount();
+    return true;
+}
+
+uint64_t SQLite::backup(const string& path, int pagesPerStep, const function<bool(int remaining, int pageCount)>& betweenSteps) {
+    SASSERT(!_insideTransaction);
+    uint64_t commitCount = 0;
+    _sharedData.backupsInProgress++;
+    if (!_beginBackupSnapshot(commitCount)) {
+        _sharedData.backupsInProgress--;
+        SWARN("Couldn't start backup of " << _filename << ": " << sqlite3_errmsg(_db));
+        return 0;
+    }
+
+    // The backup API only ends its read transaction on the source if it started it, so each step reads from ours, and
+    // writes by other handles don't cause it to start over.
+    SINFO("Starting backup of " << _filename << " at commit " << commitCount << " to " << path);
+    sqlite3* destination = nullptr;
+    int result = sqlite3_open(path.c_str(), &destination);
+    sqlite3_backup* backup = result == SQLITE_OK ? sqlite3_backup_init(destination, "main", _db, "main") : nullptr;
+    bool stopped = false;
+    if (backup) {
+        do {
+            result = sqlite3_backup_step(backup, pagesPerStep);
+            if (result == SQLITE_OK && !betweenSteps(sqlite3_backup_remaining(backup), sqlite3_backup_pagecount(backup))) {
+                stopped = true;
+            }
+        } while (result == SQLITE_OK && !stopped);
+        sqlite3_backup_finish(backup);
+    }
+    string error = destination ? sqlite3_errmsg(destination) : "out of memory";
+    sqlite3_close(destination);
+    SQuery(_db, "ending backup", "ROLLBACK");
+    _sharedData.backupsInProgress--;
+
+    if (stopped) {
+        SINFO("Stopped backup of " << _filename << " to " << path);
+        return 0;
+    }
+    if (result != SQLITE_DONE) {
+        SWARN("Backup of " << _filename << " to " << path << " failed: " << error);
+        return 0;
+    }
+    SINFO("Finished backup of " << _filename << " at commit " << commitCount << " to " << path);
+    return commitCount;
+}
+
+uint64_t SQLite::backupCommits(const string& path, uint64_t fromCommit, size_t batchBytes, const function<bool()>& betweenSteps) {
+    SASSERT(!_insideTransaction);
+    uint64_t commitCount = 0;
+    _sharedData.backupsInProgress++;
+    if (!_beginBackupSnapshot(commitCount)) {
+        _sharedData.backupsInProgress--;
+        SWARN("Couldn't start backup of commits to " << _filename << ": " << sqlite3_errmsg(_db));
+        return 0;
+    }
+
+    sqlite3* destination = nullptr;
+    bool succeeded = sqlite3_open(path.c_str(), &destination) == SQLITE_OK &&
+                     !SQuery(destination, "creating journal", "CREATE TABLE journal (id INTEGER PRIMARY KEY, query TEXT, hash TEXT);") &&
+                     !SQuery(destination, "writing journal", "BEGIN");
+    uint64_t lastCommit = fromCommit;
+    if (succeeded) {
+        string query = "SELECT id, query, hash FROM (" + _getJournalRangeQuery("id, query, hash", fromCommit + 1, commitCount) + ") ORDER BY id";
+        succeeded = !SQuery(_db, "reading commits", query, {}, batchBytes, [&](SQColumnarResult& batch) {
+            for (size_t i = 0; i < batch.size(); i++) {
+                // If the journal has already been truncated past the commits we need, this can't be done.
+                uint64_t id = batch.getInt64(i, 0);
+                if (id != lastCommit + 1) {
+                    SWARN("Can't back up commits after " << fromCommit << " from " << _filename << ", next commit in journal is " << id);
+                    return false;
+                }
+                if (SQuery(destination, "writing journal", "INSERT INTO journal VALUES (" + SQ(id) + ", " + SQ(string(batch.getText(i, 1))) + ", " + SQ(string(batch.getText(i, 2))) + ");")) {
+                    return false;
+                }
+                lastCommit = id;
+            }
+            return betweenSteps();
+        });
+        succeeded = succeeded && lastCommit == commitCount && !SQuery(destination, "writing journal", "COMMIT");
+    }
+    sqlite3_close(destination);
+    SQuery(_db, "ending backup", "ROLLBACK");
+    _sharedData.backupsInProgress--;
+
+    if (!succeeded) {
+        SWARN("Backup of commits " << fromCommit + 1 << "-" << commitCount << " to " << path << " failed or was stopped.");
+        return 0;
+    }
+    SINFO("Backed up commits " << fromCommit + 1 << "-" << commitCount << " of " << _filename << " to " << path);
+    return commitCount;
+}
+
 int64_t SQLite::getLastInsertRowID() {
     // Make sure it *does* happen after an INSERT, but not with a IGNORE
     SASSERTWARN(SContains(_uncommittedQuery, "INSERT") || SContains(_uncommittedQuery, "REPLACE"));
@@ -1075,6 +1659,21 @@ int SQLite::_authorize(int actionCode, const char* detail1, const char* detail2,
     // Record all tables touched.
     if (set<int>{SQLITE_INSERT, SQLITE_DELETE, SQLITE_READ, SQLITE_UPDATE}.count(actionCode)) {
         _tablesUsed.insert(detail1);
+        _preparingTablesUsed.insert(detail1);
+        _queryTablesUsed.insert(detail1);
+
+        // Temp tables are private to each handle, and writes to attached databases aren't tracked, so results that
+        // use them can't be shared. As statements aren't re-authorized when re-used, they can't be cached either.
+        if (detail3 && strcmp(detail3, "main")) {
+            _queryIsShareable = false;
+            _preparingIsCacheable = false;
+        }
+    }
+
+    // Pragmas can return anything, whatever tables they look at.
+    if (actionCode == SQLITE_PRAGMA) {
+        _queryIsShareable = false;
+        _preparingIsCacheable = false;
     }
 
     // Here's where we can check for non-deterministic functions for the cache.
@@ -1090,6 +1689,7 @@ int SQLite::_authorize(int actionCode, const char* detail1, const char* detail2,
             !strcmp(detail2, "sqlite_version")
         ) {
             _isDeterministicQuery = false;
+            _preparingIsCacheable = false;
         }
 
         // Prevent using certain non-deterministic functions in writes which could cause synchronization with followers to
@@ -1101,6 +1701,8 @@ int SQLite::_authorize(int actionCode, const char* detail1, const char* detail2,
             !strcmp(detail2, "last_insert_rowid") ||
             !strcmp(detail2, "changes") ||
             !strcmp(detail2, "sqlite_version")) {
+            // Whether these are allowed depends on whether we're writing, so the statement can't be re-used.
+            _preparingIsCacheable = false;
             if (_currentlyWriting) {
                 return SQLITE_DENY;
             }
@@ -1258,11 +1860,24 @@ int SQLite::getPreparedStatements(const string& query, list<sqlite3_stmt*>& stat
 }
 
 void SQLite::setQueryOnly(bool enabled) {
+    _queryOnly = enabled;
     SQResult result;
     string query = "PRAGMA query_only = "s + (enabled ? "true" : "false") + ";";
     SQuery(_db, "set query_only", query, result);
 }
 
+void SQLite::setCacheSize(int cacheSizeKB) {
+    if (cacheSizeKB == _cacheSize) {
+        return;
+    }
+    _cacheSize = cacheSizeKB;
+    SQuery(_db, "setting cache size", "PRAGMA cache_size = -" + SQ(_cacheSize) + ";");
+}
+
+int SQLite::getCacheSize() const {
+    return _cacheSize;
+}
+
 int64_t SQLite::getLastConflictPage() const {
     return _lastConflictPage;
 }
@@ -1305,7 +1920,180 @@ void SQLite::SharedData::prepareTransactionInfo(uint64_t commitID, const string&
 
 void SQLite::SharedData::commitTransactionInfo(uint64_t commitID) {
     lock_guard<decltype(_internalStateMutex)> lock(_internalStateMutex);
-    _committedTransactions.insert(_preparedTransactions.extract(commitID));
+    auto transaction = _preparedTransactions.extract(commitID);
+    if (transaction) {
+        _cacheCommit(commitID, get<0>(transaction.mapped()), get<1>(transaction.mapped()));
+    }
+    _committedTransactions.insert(move(transaction));
+}
+
+void SQLite::SharedData::setCommitCacheSize(size_t size) {
+    lock_guard<mutex> lock(_commitCacheMutex);
+    _commitCacheMaxSize = size;
+    _trimCommitCache();
+}
+
+void SQLite::SharedData::setCommitCacheBytes(size_t bytes) {
+    lock_guard<mutex> lock(_commitCacheMutex);
+    _commitCacheMaxBytes = bytes;
+    _trimCommitCache();
+}
+
+void SQLite::SharedData::_trimCommitCache() {
+    while (!_commitCache.empty() && (_commitCache.size() > _commitCacheMaxSize || _commitCacheBytes > _commitCacheMaxBytes)) {
+        _commitCacheBytes -= _commitCache.front().first.size() + _commitCache.front().second.size();
+        _commitCache.pop_front();
+        _commitCacheFirstID++;
+    }
+}
+
+void SQLite::SharedData::_cacheCommit(uint64_t id, const string& query, const string& hash) {
+    lock_guard<mutex> lock(_commitCacheMutex);
+    if (!_commitCacheMaxSize) {
+        return;
+    }
+
+    // The cache only holds a consecutive run of commits, so if we've somehow missed one, start again from here.
+    if (_commitCache.empty() || id != _commitCacheFirstID + _commitCache.size()) {
+        _commitCache.clear();
+        _commitCacheBytes = 0;
+        _commitCacheFirstID = id;
+    }
+    _commitCache.emplace_back(query, hash);
+    _commitCacheBytes += query.size() + hash.size();
+    _trimCommitCache();
+}
+
+bool SQLite::SharedData::getCachedCommit(uint64_t id, string& query, string& hash) {
+    lock_guard<mutex> lock(_commitCacheMutex);
+    if (_commitCache.empty() || id < _commitCacheFirstID || id >= _commitCacheFirstID + _commitCache.size()) {
+        commitCacheMisses++;
+        return false;
+    }
+    tie(query, hash) = _commitCache[id - _commitCacheFirstID];
+    commitCacheHits++;
+    return true;
+}
+
+bool SQLite::SharedData::getCachedCommits(uint64_t fromID, uint64_t toID, SQResult& result) {
+    lock_guard<mutex> lock(_commitCacheMutex);
+    const uint64_t lastID = _commitCacheFirstID + _commitCache.size() - 1;
+    if (!toID) {
+        toID = lastID;
+    }
+    if (_commitCache.empty() || fromID < _commitCacheFirstID || toID > lastID || fromID > toID) {
+        commitCacheMisses++;
+        return false;
+    }
+    result.clear();
+    result.headers = {"hash", "query"};
+    for (uint64_t id = fromID; id <= toID; id++) {
+        const auto& [query, hash] = _commitCache[id - _commitCacheFirstID];
+        SQResultRow row(result);
+        row.push_back(hash);
+        row.push_back(query);
+        result.emplace_back(move(row));
+    }
+    commitCacheHits++;
+    return true;
+}
+
+size_t SQLite::SharedData::getCommitCacheCount() {
+    lock_guard<mutex> lock(_commitCacheMutex);
+    return _commitCache.size();
+}
+
+size_t SQLite::SharedData::getCommitCacheBytes() {
+    lock_guard<mutex> lock(_commitCacheMutex);
+    return _commitCacheBytes;
+}
+
+void SQLite::SharedData::setReadCacheSize(size_t size) {
+    lock_guard<mutex> lock(_readCacheMutex);
+    _readCacheMaxSize = size;
+    while (_readCache.size() > _readCacheMaxSize) {
+        _readCacheIndex.erase(_readCache.back().query);
+        _readCache.pop_back();
+    }
+}
+
+bool SQLite::SharedData::_isReadCacheEntryValid(const ReadCacheEntry& entry, uint64_t commitCount) {
+    // Both snapshots include every commit up to the lower of the two counts, so if none of the tables (or the schema)
+    // have been written since then, they both see the same thing.
+    const uint64_t lastSharedCommit = min(entry.commitCount, commitCount);
+    auto schemaWrite = _tableLastWrites.find("sqlite_master");
+    if (schemaWrite != _tableLastWrites.end() && schemaWrite->second > lastSharedCommit) {
+        return false;
+    }
+    for (const string& table : entry.tablesUsed) {
+        auto lastWrite = _tableLastWrites.find(table);
+        if (lastWrite != _tableLastWrites.end() && lastWrite->second > lastSharedCommit) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool SQLite::SharedData::getCachedRead(const string& query, uint64_t commitCount, SQResult& result, set<string>& tablesUsed) {
+    lock_guard<mutex> lock(_readCacheMutex);
+    auto it = _readCacheIndex.find(query);
+    if (it == _readCacheIndex.end()) {
+        readCacheMisses++;
+        return false;
+    }
+    if (!_isReadCacheEntryValid(*it->second, commitCount)) {
+        // If it's no good even for a snapshot as old as its own, it never will be again.
+        if (!_isReadCacheEntryValid(*it->second, it->second->commitCount)) {
+            _readCache.erase(it->second);
+            _readCacheIndex.erase(it);
+        }
+        readCacheMisses++;
+        return false;
+    }
+    _readCache.splice(_readCache.begin(), _readCache, it->second);
+    result = it->second->result;
+    tablesUsed = it->second->tablesUsed;
+    readCacheHits++;
+    return true;
+}
+
+void SQLite::SharedData::cacheRead(const string& query, const set<string>& tablesUsed, uint64_t commitCount, const SQResult& result) {
+    lock_guard<mutex> lock(_readCacheMutex);
+    if (!_readCacheMaxSize) {
+        return;
+    }
+    ReadCacheEntry entry = {query, result, tablesUsed, commitCount};
+    if (!_isReadCacheEntryValid(entry, commitCount)) {
+        return;
+    }
+
+    // Keep whichever entry was read at the newer commit, as it's valid for more snapshots.
+    auto it = _readCacheIndex.find(query);
+    if (it != _readCacheIndex.end()) {
+        if (it->second->commitCount >= commitCount) {
+            return;
+        }
+        _readCache.erase(it->second);
+        _readCacheIndex.erase(it);
+    }
+    _readCache.push_front(move(entry));
+    _readCacheIndex.emplace(query, _readCache.begin());
+    if (_readCache.size() > _readCacheMaxSize) {
+        _readCacheIndex.erase(_readCache.back().query);
+        _readCache.pop_back();
+    }
+}
+
+void SQLite::SharedData::markTablesWritten(const set<string>& tables, uint64_t commitID) {
+    lock_guard<mutex> lock(_readCacheMutex);
+    for (const string& table : tables) {
+        _tableLastWrites[table] = commitID;
+    }
+}
+
+size_t SQLite::SharedData::getReadCacheCount() {
+    lock_guard<mutex> lock(_readCacheMutex);
+    return _readCache.size();
 }
 
 map<uint64_t, tuple<string, string, uint64_t>> SQLite::SharedData::popCommittedTransactions() {
@@ -1,9 +1,15 @@
 #pragma once
 #include <libstuff/sqlite3.h>
+#include <libstuff/SQColumnarResult.h>
 #include <libstuff/SQResult.h>
 #include <libstuff/SPerformanceTimer.h>
+#include <libstuff/SQStatementCache.h>
 
+#include <deque>
+#include <list>
+#include <memory>
 #include <shared_mutex>
+#include <unordered_map>
 
 class SQLite {
   public:
@@ -58,8 +64,12 @@ class SQLite {
     //                   passed, no tables are created.
     //
     // mmapSizeGB: address space to use for memory-mapped IO, in GB.
+    //
+    // ringJournal: If the database doesn't have a journal yet, creates a ring journal (see `_journalRingSlots`) with
+    //              the same number of tables as `minJournalTables` would, holding `maxJournalSize` commits between
+    //              them. A database that already has a journal keeps whichever kind it has.
     SQLite(const string& filename, int cacheSize, int maxJournalSize, int minJournalTables,
-           int64_t mmapSizeGB = 0, bool hctree = false, const string& checkpointMode = "PASSIVE");
+           int64_t mmapSizeGB = 0, bool hctree = false, const string& checkpointMode = "PASSIVE", bool ringJournal = false);
 
     // This constructor is not exactly a copy constructor. It creates an other SQLite object based on the first except
     // with a *different* journal table. This avoids a lot of locking around creating structures that we know already
@@ -79,6 +89,21 @@ class SQLite {
     // Performs a read-only query (eg, SELECT) that returns a single value.
     string read(const string& query) const;
 
+    // These are the same as the above, but bind `bindings` to the `?` parameters in `query` rather than requiring the
+    // values be escaped into it. This avoids copying large values into the query text. `query` must be a single
+    // statement.
+    bool read(const string& query, const vector<SQValue>& bindings, SQResult& result, bool skipInfoWarn = false) const;
+    string read(const string& query, const vector<SQValue>& bindings) const;
+
+    // These fill the compact, column-major SQColumnarResult instead, for queries that may return a lot of rows. These
+    // results aren't cached for the rest of the transaction.
+    bool read(const string& query, SQColumnarResult& result, bool skipInfoWarn = false) const;
+    bool read(const string& query, const vector<SQValue>& bindings, SQColumnarResult& result, bool skipInfoWarn = false) const;
+
+    // This hands the rows to `onRows` in batches of about `batchBytes` as they're read, rather than collecting them all,
+    // so that a result of any size can be handled in bounded memory. See the batched version of `SQuery`.
+    bool read(const string& query, const vector<SQValue>& bindings, size_t batchBytes, const function<bool(SQColumnarResult&)>& onRows, bool skipInfoWarn = false) const;
+
     // Types of transactions that we can begin.
     enum class TRANSACTION_TYPE {
         SHARED,
@@ -111,6 +136,11 @@ class SQLite {
     // Designed for use with queries that include a RETURNING clause
     bool write(const string& query, SQResult& result);
 
+    // These are the same as the above, but bind `bindings` to the `?` parameters in `query`. The query is recorded in
+    // the journal with the bound values expanded as SQL literals, so it replays identically on peers.
+    bool write(const string& query, const vector<SQValue>& bindings);
+    bool write(const string& query, const vector<SQValue>& bindings, SQResult& result);
+
     // This is the same as `write` except it runs successfully without any warnings or errors in noop-update mode.
     // It's intended to be used for `mockRequest` enabled commands, such that we only run a version of them that's
     // known to be repeatable. What counts as repeatable is up to the individual command.
@@ -120,6 +150,10 @@ class SQLite {
     // Designed for use with queries that include a RETURNING clause
     bool writeIdempotent(const string& query, SQResult& result);
 
+    // Versions of the above that bind `bindings` to the `?` parameters in `query`.
+    bool writeIdempotent(const string& query, const vector<SQValue>& bindings);
+    bool writeIdempotent(const string& query, const vector<SQValue>& bindings, SQResult& result);
+
     // This runs a query completely unchanged, always adding it to the uncommitted query, such that it will be recorded
     // in the journal even if it had no effect on the database. This lets replicated or synchronized queries be added
     // to the journal *even if they have no effect* on the rest of the database.
@@ -137,6 +171,13 @@ class SQLite {
     // Note that if this transaction fails to commit, these will not ultimately be accurate.
     bool prepare(uint64_t* transactionID = nullptr, string* transactionHash = nullptr);
 
+    // Like `prepare`, but for applying a run of commits that some other node has already committed (i.e., while
+    // synchronizing) as a single transaction. Each call journals the queries written since the previous call as the
+    // next commit, and verifies that it produces `expectedHash`, so the hash chain is checked for every commit even
+    // though they all share one `commit` call at the end. Returns false if the hash doesn't match; the caller should
+    // roll back. Writes are allowed between calls.
+    bool prepareBatched(const string& expectedHash);
+
     // This enables or disables automatic re-writing. This feature is to support mocked requests and load testing. This
     // overloads set_authorizer to allow a plugin to deny certain queries from running (currently based only on the
     // action being taken and the table being operated on) and instead, run a different query in their place. For
@@ -149,6 +190,8 @@ class SQLite {
     //    was passed (see setRewriteHandler() below).
     // 3. If the rewriteHandler returns true, the initial query will fail with SQLITE_AUTH (warnings for this failure
     //    are suppressed) and the new replacement query will be run in it's place.
+    // A query written with bindings can't be re-written, as the replacement has no way to use their values, so `write`
+    // returns false for it instead.
     void enableRewrite(bool enable);
 
     // Update the rewrite handler.
@@ -181,9 +224,19 @@ class SQLite {
     // The main purpose of this is to allow replications in SQLiteNode to notify other waiting threads that the commit has finished even before the checkpoint is done.
     int commit(const string& description = "UNSPECIFIED", function<void()>* preCheckpointCallback = nullptr);
 
-    // Cancels the current transaction and rolls it back.
+    // Cancels the current transaction and rolls it back. If a savepoint is open, only the work done since the savepoint
+    // is rolled back, and the savepoint stays open.
     void rollback();
 
+    // Savepoints let several commands share a single transaction (and so a single commit) while still being able to
+    // fail independently. While a savepoint is open, the handle behaves as though the savepoint were the transaction:
+    // `beginTransaction` is a no-op, `rollback` discards only the work done since the savepoint, and
+    // `getUncommittedQuery` returns only the queries written since the savepoint. `releaseSavepoint` keeps that work
+    // as part of the enclosing transaction.
+    void beginSavepoint();
+    void releaseSavepoint();
+    bool insideSavepoint() const { return _insideSavepoint; }
+
     // Returns the total number of changes on this database
     int getChangeCount() { return sqlite3_total_changes(_db); }
 
@@ -191,6 +244,10 @@ class SQLite {
     uint64_t getLastTransactionTiming(uint64_t& begin, uint64_t& read, uint64_t& write, uint64_t& prepare,
                                       uint64_t& commit, uint64_t& rollback);
 
+    // Returns how long, in microseconds, the last transaction to finish on this handle held the commit lock, from
+    // taking it in `prepare` (or `beginTransaction`, for an exclusive transaction) to releasing it on commit or rollback.
+    uint64_t getLastCommitLockTime() const { return _commitLockElapsed; }
+
     TRANSACTION_TYPE getLastTransactionType();
 
     // Returns the number of changes that were performed in the last query.
@@ -211,7 +268,7 @@ class SQLite {
 
     // Returns a concatenated string containing all the 'write' queries executed within the current, uncommitted
     // transaction.
-    string getUncommittedQuery() { return _uncommittedQuery; }
+    string getUncommittedQuery() { return _insideSavepoint ? _uncommittedQuery.substr(_savepointQuerySize) : _uncommittedQuery; }
 
     // Gets the ROWID of the last insertion (for auto-increment indexes)
     int64_t getLastInsertRowID();
@@ -230,11 +287,28 @@ class SQLite {
     bool getCommit(uint64_t index, string& query, string& hash);
 
     // A static version of the above that can be used in initializers.
-    static bool getCommit(sqlite3* db, const vector<string>& journalNames, uint64_t index, string& query, string& hash);
+    static bool getCommit(sqlite3* db, const vector<string>& journalNames, uint64_t journalRingSlots, uint64_t index, string& query, string& hash);
 
     // Looks up a range of commits.
     int getCommits(uint64_t fromIndex, uint64_t toIndex, SQResult& result, uint64_t timeoutLimitUS = 0);
 
+    // Copies the database to a new file at `path` with sqlite's online backup API, while other handles keep reading
+    // and writing it. The copy is of a single snapshot, which is held for as long as the copy takes, so nothing newer
+    // can be checkpointed until it's done, and checkpoints are passive until then. After each `pagesPerStep` pages, calls `betweenSteps` with the number of
+    // pages left and the total, which can sleep to throttle the copy, or return false to stop it.
+    // Returns the commit count of the snapshot copied, or 0 if the copy failed or was stopped (in which case `path` may
+    // hold part of a copy). Must be called outside of a transaction.
+    uint64_t backup(const string& path, int pagesPerStep, const function<bool(int remaining, int pageCount)>& betweenSteps);
+
+    // Copies the commits after `fromCommit` to a new database at `path`, with a table `journal (id, query, hash)`.
+    // Running each `query` in order of `id` on a backup taken at `fromCommit` brings it up to the last of them, at
+    // which point the backup's hash matches that commit's `hash`. Calls `betweenSteps` after each `batchBytes` or so of
+    // commits, to throttle or stop the copy as with `backup`.
+    // Returns the last commit copied (which is `fromCommit` if there were none), or 0 if the copy failed or was
+    // stopped, including if the journal no longer has every commit after `fromCommit`. Must be called outside of a
+    // transaction.
+    uint64_t backupCommits(const string& path, uint64_t fromCommit, size_t batchBytes, const function<bool()>& betweenSteps);
+
     // Set a time limit for this transaction, in US from the current time.
     void setTimeout(uint64_t timeLimitUS);
 
@@ -254,6 +328,40 @@ class SQLite {
     // transactions can be replicated out to peers.
     map<uint64_t, tuple<string,string, uint64_t>> popCommittedTransactions();
 
+    // Sets how many of the most recent commits are kept in memory (default `DEFAULT_COMMIT_CACHE_SIZE`, 0 to keep
+    // none) for `getCommit` and `getCommits` to return without reading the journal. This is shared by every handle
+    // to the database.
+    void setCommitCacheSize(size_t size);
+
+    // Sets how many bytes of queries and hashes that cache can hold (default `DEFAULT_COMMIT_CACHE_BYTES`), after
+    // which the oldest commits are dropped even if it has fewer than its size, so a run of large commits can't use
+    // an unbounded amount of memory.
+    void setCommitCacheBytes(size_t bytes);
+
+    // Returns the number and total size of the commits in that cache, and the number of lookups it has and hasn't been
+    // able to serve.
+    STable getCommitCacheStats();
+
+    static const size_t DEFAULT_COMMIT_CACHE_SIZE = 10'000;
+    static const size_t DEFAULT_COMMIT_CACHE_BYTES = 256 * 1024 * 1024;
+
+    // Sets how many read results are kept in memory (default 0, which turns this off) to be shared between
+    // transactions on every handle to the database. A deterministic query with no bindings, read inside a transaction
+    // while the handle is query-only (see `setQueryOnly`), as it is for a peek, is served from here until a commit
+    // writes to one of the tables it used. The transaction's snapshot is started before any lookup, so what it gets
+    // back is what sqlite would have returned. Sqlite can't check what's read from here for conflicts, so a
+    // transaction that has (see `usedReadCache`) must be rolled back rather than committed.
+    void setReadCacheSize(size_t size);
+
+    // True if the current transaction has read anything from the read cache.
+    bool usedReadCache() const;
+
+    // Returns the number of results in that cache, and the number of eligible reads it has and hasn't served.
+    STable getReadCacheStats();
+
+    // Results with more rows than this aren't kept in the read cache.
+    static const size_t MAX_READ_CACHE_ROWS = 100;
+
     // The whitelist is either nullptr, in which case the feature is disabled, or it's a map of table names to sets of
     // column names that are allowed for reading. Using whitelist at all put the database handle into a more
     // restrictive access mode that will deny access for write operations and other potentially risky operations, even
@@ -263,6 +371,10 @@ class SQLite {
     // Enable/disable SQL statement tracing.
     static atomic<bool> enableTrace;
 
+    // The number of prepared statements to cache per DB handle. Set to 0 to disable statement caching. This only
+    // affects DB handles created after it's set.
+    static atomic<size_t> statementCacheSize;
+
     // public read-only accessor for _dbCountAtStart.
     uint64_t getDBCountAtStart() const;
 
@@ -287,13 +399,34 @@ class SQLite {
     // This returns an sqlite error code. It will stop parsing multiple statements after the first error.
     int getPreparedStatements(const string& query, list<sqlite3_stmt*>& statements);
 
-    // Set this DB handle to be query-only to prevent accidental writes in places we don't expect them.
+    // Set this DB handle to be query-only to prevent accidental writes in places we don't expect them. Query-only
+    // transactions can read from the read cache.
     void setQueryOnly(bool enabled);
 
+    // Changes the page cache size for this handle, in KB. Shrinking it frees cached pages immediately. Must not be
+    // called in the middle of a transaction.
+    void setCacheSize(int cacheSizeKB);
+    int getCacheSize() const;
+
     void exclusiveLockDB();
     void exclusiveUnlockDB();
 
   private:
+    // Statement cache that records which tables each statement touches (since cached statements don't pass through the
+    // authorizer again) and refuses to cache statements using non-deterministic functions.
+    class StatementCache : public SQStatementCache {
+      public:
+        StatementCache(SQLite& db, size_t maxEntries);
+
+      protected:
+        void _onMiss() override;
+        bool _shouldCache(Entry& entry) override;
+        void _onHit(const Entry& entry) override;
+
+      private:
+        SQLite& _db;
+    };
+
     // This structure contains all of the data that's shared between a set of SQLite objects that share the same
     // underlying database file.
     class SharedData {
@@ -338,6 +471,31 @@ class SQLite {
         // If set to false, this prevents any thread from being able to commit to the DB.
         atomic<bool> _commitEnabled;
 
+        // The commit cache (see `SQLite::setCommitCacheSize`). `getCachedCommit` looks up one commit, and
+        // `getCachedCommits` appends commits `fromID` through `toID` (or the newest, if `toID` is 0) to `result` as
+        // rows of (hash, query), as `SQLite::getCommits` does. Both return false if the cache doesn't have all of them.
+        void setCommitCacheSize(size_t size);
+        void setCommitCacheBytes(size_t bytes);
+        bool getCachedCommit(uint64_t id, string& query, string& hash);
+        bool getCachedCommits(uint64_t fromID, uint64_t toID, SQResult& result);
+        size_t getCommitCacheCount();
+        size_t getCommitCacheBytes();
+        atomic<uint64_t> commitCacheHits = 0;
+        atomic<uint64_t> commitCacheMisses = 0;
+
+        // The read cache (see `SQLite::setReadCacheSize`). `getCachedRead` returns false unless none of the tables a
+        // result used have been written since both the commit it was read at and `commitCount`, the commit the
+        // caller's snapshot is known to include. `markTablesWritten` must be called with the ID of a commit before it
+        // can be seen by other handles.
+        void setReadCacheSize(size_t size);
+        bool isReadCacheEnabled() const { return _readCacheMaxSize; }
+        bool getCachedRead(const string& query, uint64_t commitCount, SQResult& result, set<string>& tablesUsed);
+        void cacheRead(const string& query, const set<string>& tablesUsed, uint64_t commitCount, const SQResult& result);
+        void markTablesWritten(const set<string>& tables, uint64_t commitID);
+        size_t getReadCacheCount();
+        atomic<uint64_t> readCacheHits = 0;
+        atomic<uint64_t> readCacheMisses = 0;
+
         // This variable is used to monitor the number of open transactions on the whole server.
         atomic<int64_t> openTransactionCount;
 
@@ -346,6 +504,11 @@ class SQLite {
         // We use this flag to prevent to threads running checkpoints t the same time.
         atomic_flag checkpointInProgress = ATOMIC_FLAG_INIT;
 
+        // The number of `backup` and `backupCommits` calls holding a snapshot open. While there are any, checkpoints
+        // are passive whatever `_checkpointMode` is, as any other mode would wait on the backup's snapshot, blocking the
+        // commit that started it (and, for RESTART and TRUNCATE, every other writer) until the backup finishes.
+        atomic<int> backupsInProgress = 0;
+
         // This records the most recent count of the number of frames to checkpoint. We may be able to remove this with
         // no ill effects, but currently we use it to set a floor on the number of frames we will try and checkpoint.
         atomic<size_t> outstandingFramesToCheckpoint = 0;
@@ -357,12 +520,50 @@ class SQLite {
         // This can be locked in exclusive mode to prevent all writes. This exists to support the `BlockWrites` command.
         shared_mutex writeLock;
 
+        // Incremented whenever any handle changes the schema, so that every handle knows to drop its cached statements.
+        atomic<uint64_t> schemaChangeCount = 0;
+
       private:
         // The data required to replicate transactions, in two lists, depending on whether this has only been prepared
         // or if it's been committed.
         map<uint64_t, tuple<string, string, uint64_t>> _preparedTransactions;
         map<uint64_t, tuple<string, string, uint64_t>> _committedTransactions;
 
+        // Adds a commit to the commit cache, dropping the oldest once it's full.
+        void _cacheCommit(uint64_t id, const string& query, const string& hash);
+
+        // Drops the oldest commits until the cache is within both its size and its bytes. Requires `_commitCacheMutex`.
+        void _trimCommitCache();
+
+        // The (query, hash) of each of a consecutive run of commits, the first of which is `_commitCacheFirstID`, and
+        // the total length of those strings.
+        mutex _commitCacheMutex;
+        size_t _commitCacheMaxSize = DEFAULT_COMMIT_CACHE_SIZE;
+        size_t _commitCacheMaxBytes = DEFAULT_COMMIT_CACHE_BYTES;
+        size_t _commitCacheBytes = 0;
+        uint64_t _commitCacheFirstID = 0;
+        deque<pair<string, string>> _commitCache;
+
+        // A cached read, the tables it used, and the commit count it was read at.
+        struct ReadCacheEntry {
+            string query;
+            SQResult result;
+            set<string> tablesUsed;
+            uint64_t commitCount;
+        };
+
+        // Returns whether `entry` still holds for a snapshot that includes `commitCount`.
+        bool _isReadCacheEntryValid(const ReadCacheEntry& entry, uint64_t commitCount);
+
+        // The read cache, most recently used first, and the ID of the last commit to write each table, for as long
+        // as this object has existed. A commit that changes the schema counts as writing `sqlite_master`, which
+        // every entry depends on.
+        mutex _readCacheMutex;
+        atomic<size_t> _readCacheMaxSize = 0;
+        list<ReadCacheEntry> _readCache;
+        unordered_map<string, list<ReadCacheEntry>::iterator> _readCacheIndex;
+        unordered_map<string, uint64_t> _tableLastWrites;
+
         // This mutex is locked when we need to change the state of the _shareData object. It is shared between a
         // variety of operations (i.e., updating _committedTransactions, etc).
         recursive_mutex _internalStateMutex;
@@ -370,10 +571,15 @@ class SQLite {
 
     // Initializers to support RAII-style allocation in constructors.
     static string initializeFilename(const string& filename);
-    static SharedData& initializeSharedData(sqlite3* db, const string& filename, const vector<string>& journalNames, bool hctree);
+    static SharedData& initializeSharedData(sqlite3* db, const string& filename, const vector<string>& journalNames, uint64_t journalRingSlots, bool hctree);
     static bool validateDBFormat(const string& filename, bool hctree);
     static sqlite3* initializeDB(const string& filename, int64_t mmapSizeGB, bool hctree);
-    static vector<string> initializeJournal(sqlite3* db, int minJournalTables);
+    static vector<string> initializeJournal(sqlite3* db, int minJournalTables, uint64_t maxJournalSize, bool ringJournal);
+    static uint64_t initializeJournalRingSlots(sqlite3* db);
+
+    // Returns the highest commit ID in a ring journal, with a binary search over the slots of each of its tables rather
+    // than reading all of them.
+    static uint64_t getJournalRingCommitCount(sqlite3* db, const vector<string>& journalNames);
     void commonConstructorInitialization(bool hctree = false);
     static int getCheckpointModeFromString(const string& checkpointModeString);
 
@@ -391,6 +597,14 @@ class SQLite {
     // Names of ALL journal tables for this database.
     const vector<string> _journalNames;
 
+    // If the journal is a ring, the number of rows in each of its tables, otherwise 0.
+    // A ring journal's tables (`journalRing0000` through `journalRingNNNN`) have a fixed number of rows each, keyed by
+    // `slot`. Commit `id` always goes in row `(id / tableCount) % _journalRingSlots` of table `id % tableCount`,
+    // replacing the commit that was there, so the journal never grows or needs truncating, and finding a commit is a
+    // single lookup rather than one in every table. The table count and rows per table are fixed when it's created,
+    // and stored in `ringJournalConfig`.
+    const uint64_t _journalRingSlots;
+
     // Pointer to our SharedData object, which is shared between all SQLite DB objects for the same file.
     SharedData& _sharedData;
 
@@ -403,11 +617,19 @@ class SQLite {
     // True when we have a transaction in progress.
     bool _insideTransaction = false;
 
+    // True when a savepoint is open inside the current transaction, and the size of `_uncommittedQuery` when it was
+    // opened, so rolling back to it can drop the queries written since.
+    bool _insideSavepoint = false;
+    size_t _savepointQuerySize = 0;
+
     // The new query and new hash to add to the journal for a transaction that's nearing completion, before we commit
     // it.
     string _uncommittedQuery;
     string _uncommittedHash;
 
+    // The hashes of each commit prepared so far with `prepareBatched`, in order. These all become committed together.
+    vector<string> _batchedHashes;
+
     // Returns the name of a journal table based on it's index.
     static string getJournalTableName(vector<string>& journalNames, int64_t journalTableID, bool create = false);
 
@@ -423,6 +645,8 @@ class SQLite {
     uint64_t _prepareElapsed = 0;
     uint64_t _commitElapsed = 0;
     uint64_t _rollbackElapsed = 0;
+    uint64_t _commitLockStart = 0;
+    uint64_t _commitLockElapsed = 0;
 
     // We keep track of whether we've locked the global mutex so that we know whether or not we need to unlock it when
     // we call `rollback`. Note that this indicates whether this object has locked the mutex, not whether the mutex is
@@ -434,7 +658,7 @@ class SQLite {
     static thread_local int64_t _conflictPage;
     static thread_local string _conflictLocation;
 
-    bool _writeIdempotent(const string& query, SQResult& result, bool alwaysKeepQueries = false);
+    bool _writeIdempotent(const string& query, const vector<SQValue>& bindings, SQResult& result, bool alwaysKeepQueries = false);
 
     // Constructs a UNION query from a list of 'query parts' over each of our journal tables.
     // Fore each table, queryParts will be joined with that table's name as a separator. I.e., if you have a tables
@@ -460,6 +684,17 @@ class SQLite {
     // Static version for initializers.
     static string _getJournalQuery(const vector<string>& journalNames, const list<string>& queryParts, bool append = false);
 
+    // Begins a read transaction on `_db` at the latest commit, for `backup` and `backupCommits`, and sets
+    // `commitCount` to that commit. Returns false (with no transaction) on failure.
+    bool _beginBackupSnapshot(uint64_t& commitCount);
+
+    // Returns a query for `columns` of the journal rows with IDs from `fromID` through `toID` (or all the rest, if
+    // `toID` is 0), in no particular order. In a ring journal, this only reads the rows those commits can be in.
+    string _getJournalRangeQuery(const string& columns, uint64_t fromID, uint64_t toID);
+
+    // Returns the query that adds a commit to the journal table `_journalName`.
+    string _getJournalInsertQuery(uint64_t id, const string& query, const string& hash);
+
     // Callback function that we'll register for authorizing queries in sqlite.
     static int _sqliteAuthorizerCallback(void*, int, const char*, const char*, const char*, const char*);
 
@@ -504,6 +739,13 @@ class SQLite {
     // We check them all together because we need to make sure we atomically pick a single one to handle.
     void _checkInterruptErrors(const string& error) const;
 
+    // Picks a journal table for the transaction being prepared, trims old rows from it, and takes the commit lock.
+    // Returns the ID of the chosen journal.
+    int64_t _prepareJournal();
+
+    // Deletes a few of the rows in `_journalName` older than the last `_maxJournalSize` commits before `commitCount`.
+    void _trimJournal(uint64_t commitCount);
+
     // Called internally by _sqliteAuthorizerCallback to authorize columns for a query.
     //
     // PRO-TIP: you can play with the authorizer using the `sqlite3` CLI tool, by running `.auth ON` then running
@@ -531,7 +773,7 @@ class SQLite {
     mutable map<string, SQResult> _queryCache;
 
     // List of table names used during this transaction.
-    set<string> _tablesUsed;
+    mutable set<string> _tablesUsed;
 
     // Number of queries that have been attempted in this transaction (for metrics only).
     mutable int64_t _readQueryCount = 0;
@@ -547,6 +789,39 @@ class SQLite {
     // Will be set to false while running a non-deterministic query to prevent it's result being cached.
     mutable bool _isDeterministicQuery = false;
 
+    // Returns the statement cache to use for the next query, or nullptr if statements shouldn't be cached right now.
+    // Whitelisted and re-written queries depend on the authorizer running for every query, so they're never cached.
+    SQStatementCache* _getStatementCache() const;
+
+    // Per-handle cache of prepared statements.
+    mutable unique_ptr<StatementCache> _statementCache;
+
+    // The value of `_sharedData.schemaChangeCount` when we last cleared `_statementCache`.
+    uint64_t _statementCacheSchemaChangeCount = 0;
+
+    // While a query missing the statement cache is prepared, the authorizer records the tables it uses here, and
+    // whether it used anything that prevents caching it.
+    set<string> _preparingTablesUsed;
+    bool _preparingIsCacheable = true;
+
+    // The tables used by the query currently running, and whether its result could be shared in the read cache.
+    mutable set<string> _queryTablesUsed;
+    mutable bool _queryIsShareable = true;
+
+    // The tables written by this transaction, which are marked as written in the read cache when it commits.
+    set<string> _tablesWritten;
+
+    // Whether `setQueryOnly` is on, and so the read cache can be used.
+    bool _queryOnly = false;
+
+    // Whether this transaction has read from the read cache, and the commit count its snapshot is known to include,
+    // which is read just before the snapshot starts, as commits that land after `BEGIN` are in it too.
+    mutable bool _usedReadCache = false;
+    mutable uint64_t _readCacheCommitCount = 0;
+
+    // Returns whether a read with these bindings can use the shared read cache right now.
+    bool _canUseReadCache(const vector<SQValue>& bindings) const;
+
     // Copies of parameters used to initialize the DB that we store if we make child objects based on this one.
     int _cacheSize;
     int64_t _mmapSizeGB;
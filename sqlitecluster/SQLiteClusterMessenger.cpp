@@ -6,6 +6,8 @@
 #include <unistd.h>
 #include <fcntl.h>
 
+atomic<size_t> SQLiteClusterMessenger::multiplexedConnections(0);
+
 SQLiteClusterMessenger::SQLiteClusterMessenger(const shared_ptr<const SQLiteNode>& node)
  : _node(node), _socketPool()
 { }
@@ -18,7 +20,7 @@ void SQLiteClusterMessenger::setErrorResponse(BedrockCommand& command) {
 }
 
 // Returns true on ready or false on error or timeout.
-SQLiteClusterMessenger::WaitForReadyResult SQLiteClusterMessenger::waitForReady(pollfd& fdspec, uint64_t timeoutTimestamp) const {
+SQLiteClusterMessenger::WaitForReadyResult SQLiteClusterMessenger::waitForReady(pollfd& fdspec, uint64_t timeoutTimestamp) {
     static const map <int, string> labels = {
         {POLLOUT, "send"},
         {POLLIN, "recv"},
@@ -91,27 +93,30 @@ vector<SData> SQLiteClusterMessenger::runOnAll(const SData& cmd) {
 }
 
 bool SQLiteClusterMessenger::runOnPeer(BedrockCommand& command, const string& peerName) {
-    unique_ptr<SHTTPSManager::Socket> s;
-
     const SQLitePeer* peer = _node->getPeerByName(peerName);
     if (!peer) {
         setErrorResponse(command);
         return false;
     }
 
-    s = _getSocketForAddress(peer->commandAddress);
-    if (!s) {
-        setErrorResponse(command);
-        return false;
+    const uint64_t start = STimeNow();
+    _escalationsInFlight++;
+    bool result = false;
+    if (_shouldMultiplex(command)) {
+        result = _runMultiplexed(command, peer->commandAddress);
+    } else {
+        // _sendCommandOnSocket doesn't always call setErrorResponse - if the
+        // command is intended for leader, we don't always want to set
+        // command.complete = true because that prevents it from being retried. If
+        // the command failed because leader was not available, but it will be
+        // again soon, let the command be retried. In this case, we will let the
+        // caller to runOnPeer determine how to handle the failed command.
+        unique_ptr<SHTTPSManager::Socket> s = _getSocketForAddress(peer->commandAddress);
+        result = s && _sendCommandOnSocket(*s, command);
     }
+    _escalationsInFlight--;
+    _recordEscalation(STimeNow() - start, result);
 
-    // _sendCommandOnSocket doesn't always call setErrorResponse - if the
-    // command is intended for leader, we don't always want to set
-    // command.complete = true because that prevents it from being retried. If
-    // the command failed because leader was not available, but it will be
-    // again soon, let the command be retried. In this case, we will let the
-    // caller to runOnPeer determine how to handle the failed command.
-    const bool result = _sendCommandOnSocket(*s, command);
     if (!result) {
         setErrorResponse(command);
     }
@@ -119,9 +124,7 @@ bool SQLiteClusterMessenger::runOnPeer(BedrockCommand& command, const string& pe
     return result;
 }
 
-bool SQLiteClusterMessenger::_sendCommandOnSocket(SHTTPSManager::Socket& socket, BedrockCommand& command) const {
-    bool sent = false;
-
+SData SQLiteClusterMessenger::_buildRequest(BedrockCommand& command) {
     // This is what we need to send.
     SData request = command.request;
 
@@ -136,17 +139,19 @@ bool SQLiteClusterMessenger::_sendCommandOnSocket(SHTTPSManager::Socket& socket,
     }
 
     request.nameValueMap["ID"] = command.id;
-    SFastBuffer buf(request.serialize());
+    return request;
+}
 
+bool SQLiteClusterMessenger::_sendBuffer(SHTTPSManager::Socket& socket, SFastBuffer& buffer, uint64_t timeoutTimestamp) {
     // We only have one FD to poll.
     pollfd fdspec = {socket.s, POLLOUT, 0};
     while (true) {
-        WaitForReadyResult result = waitForReady(fdspec, command.timeout());
+        WaitForReadyResult result = waitForReady(fdspec, timeoutTimestamp);
         if (result != WaitForReadyResult::OK) {
             return false;
         }
 
-        ssize_t bytesSent = send(socket.s, buf.c_str(), buf.size(), 0);
+        ssize_t bytesSent = send(socket.s, buffer.c_str(), buffer.size(), 0);
         if (bytesSent == -1) {
             switch (errno) {
                 case EAGAIN:
@@ -159,16 +164,18 @@ bool SQLiteClusterMessenger::_sendCommandOnSocket(SHTTPSManager::Socket& socket,
                     return false;
             }
         } else {
-            buf.consumeFront(bytesSent);
-            if (buf.empty()) {
+            buffer.consumeFront(bytesSent);
+            if (buffer.empty()) {
                 // Everything has sent, we're done with this loop.
-                sent = true;
-                break;
+                return true;
             }
         }
     }
+}
 
-    if (!sent) {
+bool SQLiteClusterMessenger::_sendCommandOnSocket(SHTTPSManager::Socket& socket, BedrockCommand& command) const {
+    SFastBuffer buf(_buildRequest(command).serialize());
+    if (!_sendBuffer(socket, buf, command.timeout())) {
         SINFO("[HTTPESC] Failed to send to leader after timeout establishing connnection.");
         return false;
     }
@@ -176,7 +183,7 @@ bool SQLiteClusterMessenger::_sendCommandOnSocket(SHTTPSManager::Socket& socket,
     // If we fail before here, we can try again. If we fail after here, we should return an error.
 
     // Ok, now we need to receive the response.
-    fdspec = {socket.s, POLLIN, 0};
+    pollfd fdspec = {socket.s, POLLIN, 0};
     string responseStr;
     char response[4096] = {0};
     while (true) {
@@ -266,16 +273,20 @@ bool SQLiteClusterMessenger::runOnPeer(BedrockCommand& command, bool runOnLeader
 
         // Start our escalation timing
         command.escalationTimeUS = STimeNow();
+        _escalationsInFlight++;
 
-        s = _getSocketForAddress(peerAddress);
-        if (!s) {
-            command.escalationTimeUS = STimeNow() - command.escalationTimeUS;
-            return false;
+        if (_shouldMultiplex(command)) {
+            sent = _runMultiplexed(command, peerAddress);
+        } else {
+            s = _getSocketForAddress(peerAddress);
+            sent = s && _sendCommandOnSocket(*s, command);
         }
 
-        sent = _sendCommandOnSocket(*s, command);
+        // Finish our escalation timing.
+        _escalationsInFlight--;
+        command.escalationTimeUS = STimeNow() - command.escalationTimeUS;
+        _recordEscalation(command.escalationTimeUS, sent);
         if (!sent) {
-            command.escalationTimeUS = STimeNow() - command.escalationTimeUS;
             return false;
         }
     }
@@ -295,11 +306,9 @@ bool SQLiteClusterMessenger::runOnPeer(BedrockCommand& command, bool runOnLeader
     // If we got here, the command is complete.
     command.escalated = true;
 
-    // Finish our escalation timing.
-    command.escalationTimeUS = STimeNow() - command.escalationTimeUS;
-
-    // Since everything went fine with this command, we can save its socket, unless it's being closed.
-    if (!commandWillCloseSocket(command)) {
+    // Since everything went fine with this command, we can save its socket, unless it's being closed. Multiplexed
+    // connections aren't checked out, so there's nothing to return for those.
+    if (s && !commandWillCloseSocket(command)) {
         _socketPool.returnSocket(move(s), peerAddress);
     }
 
@@ -319,3 +328,247 @@ bool SQLiteClusterMessenger::commandWillCloseSocket(BedrockCommand& command) {
 
     return false;
 }
+
+void SQLiteClusterMessenger::_recordEscalation(uint64_t elapsedUS, bool success) {
+    _escalationCount++;
+    if (!success) {
+        _escalationFailures++;
+    }
+    _escalationTotalUS += elapsedUS;
+    uint64_t previousMax = _escalationMaxUS.load();
+    while (elapsedUS > previousMax && !_escalationMaxUS.compare_exchange_weak(previousMax, elapsedUS));
+}
+
+STable SQLiteClusterMessenger::getStats() {
+    size_t openConnections = 0;
+    {
+        lock_guard<mutex> lock(_multiplexedConnectionsMutex);
+        for (const auto& [address, connections] : _multiplexedConnections) {
+            for (const auto& connection : connections) {
+                if (connection->isConnected()) {
+                    openConnections++;
+                }
+            }
+        }
+    }
+
+    const uint64_t count = _escalationCount;
+    return {
+        {"escalationCount", to_string(count)},
+        {"escalationFailures", to_string(_escalationFailures)},
+        {"escalationAverageUS", to_string(count ? _escalationTotalUS / count : 0)},
+        {"escalationMaxUS", to_string(_escalationMaxUS)},
+        {"escalationsInFlight", to_string(_escalationsInFlight)},
+        {"escalationMultiplexedConnections", to_string(openConnections)},
+    };
+}
+
+bool SQLiteClusterMessenger::_shouldMultiplex(const BedrockCommand& command) {
+    // The peer acknowledges `Connection: forget` and then closes the connection, so these get a connection of their own.
+    return multiplexedConnections && !SIEquals(command.request["Connection"], "forget");
+}
+
+bool SQLiteClusterMessenger::_runMultiplexed(BedrockCommand& command, const string& address) {
+    SData request = _buildRequest(command);
+
+    // The peer shuts down the socket after replying to `Connection: close`, which would take every other request in
+    // flight on the connection with it. This only describes the connection between us and the peer, so it's safe
+    // to drop.
+    if (SIEquals(request["Connection"], "close")) {
+        request.erase("Connection");
+    }
+
+    // If a connection fails before our request is sent, nothing was run, so we can try again on another.
+    for (int attempt = 0; attempt < 2; attempt++) {
+        shared_ptr<MultiplexedConnection> connection = _getMultiplexedConnection(address);
+        if (!connection) {
+            return false;
+        }
+
+        bool received = false;
+        if (!connection->run(request, command.response, command.timeout(), received)) {
+            SINFO("[HTTPESC] Multiplexed connection failed before sending, retrying.");
+            continue;
+        }
+        if (!received) {
+            SINFO("[HTTPESC] No response on multiplexed connection.");
+            setErrorResponse(command);
+            return false;
+        }
+
+        command.response.erase("MultiplexID");
+        command.complete = true;
+        return true;
+    }
+
+    return false;
+}
+
+shared_ptr<SQLiteClusterMessenger::MultiplexedConnection> SQLiteClusterMessenger::_getMultiplexedConnection(const string& address) {
+    lock_guard<mutex> lock(_multiplexedConnectionsMutex);
+    auto& connections = _multiplexedConnections[address];
+
+    // Forget any connections that have failed. Anyone still using one holds their own reference to it.
+    connections.erase(remove_if(connections.begin(), connections.end(), [](const shared_ptr<MultiplexedConnection>& connection) {
+        return !connection->isConnected();
+    }), connections.end());
+
+    // Open connections until we have as many as configured. If we can't, we use the ones we have.
+    while (connections.size() < multiplexedConnections) {
+        unique_ptr<SHTTPSManager::Socket> s = _getSocketForAddress(address);
+        if (!s) {
+            break;
+        }
+        connections.push_back(make_shared<MultiplexedConnection>(move(s)));
+    }
+
+    shared_ptr<MultiplexedConnection> leastBusy;
+    size_t leastInFlight = numeric_limits<size_t>::max();
+    for (auto& connection : connections) {
+        size_t inFlight = connection->inFlight();
+        if (inFlight < leastInFlight) {
+            leastBusy = connection;
+            leastInFlight = inFlight;
+        }
+    }
+    return leastBusy;
+}
+
+SQLiteClusterMessenger::MultiplexedConnection::MultiplexedConnection(unique_ptr<SHTTPSManager::Socket>&& socket)
+  : _socket(move(socket)), _readThread(&MultiplexedConnection::_readLoop, this)
+{ }
+
+SQLiteClusterMessenger::MultiplexedConnection::~MultiplexedConnection() {
+    _exit = true;
+    _readThread.join();
+}
+
+bool SQLiteClusterMessenger::MultiplexedConnection::isConnected() const {
+    return _connected;
+}
+
+size_t SQLiteClusterMessenger::MultiplexedConnection::inFlight() {
+    lock_guard<mutex> lock(_pendingMutex);
+    return _pending.size();
+}
+
+bool SQLiteClusterMessenger::MultiplexedConnection::run(SData& request, SData& response, uint64_t timeout, bool& received) {
+    PendingRequest pending;
+    uint64_t id;
+    {
+        lock_guard<mutex> lock(_pendingMutex);
+        if (!_connected) {
+            return false;
+        }
+        id = _nextID++;
+        _pending[id] = &pending;
+    }
+
+    request["MultiplexID"] = to_string(id);
+    SFastBuffer buffer(request.serialize());
+    bool sent;
+    {
+        lock_guard<mutex> lock(_sendMutex);
+        sent = _connected && _sendBuffer(*_socket, buffer, timeout);
+    }
+    if (!sent) {
+        // Part of the request may have been written, which leaves the connection unusable. The peer won't run an
+        // incomplete request, so it's still safe for the caller to retry.
+        {
+            lock_guard<mutex> lock(_pendingMutex);
+            _pending.erase(id);
+        }
+        _fail();
+        return false;
+    }
+
+    unique_lock<mutex> lock(_pendingMutex);
+    while (!pending.done) {
+        uint64_t now = STimeNow();
+        if (timeout && now >= timeout) {
+            SINFO("[HTTPESC] Timeout waiting for multiplexed response " << id << ".");
+            _pending.erase(id);
+            break;
+        }
+        pending.cv.wait_for(lock, timeout ? chrono::microseconds(timeout - now) : chrono::microseconds(100'000));
+    }
+
+    received = pending.received;
+    if (received) {
+        response = move(pending.response);
+    }
+    return true;
+}
+
+void SQLiteClusterMessenger::MultiplexedConnection::_readLoop() {
+    SInitialize("multiplexedEscalation");
+    SFastBuffer recvBuffer;
+    char chunk[4096];
+    while (!_exit) {
+        // We wake up periodically so that we notice when we're being destroyed.
+        pollfd fdspec = {_socket->s, POLLIN, 0};
+        int result = poll(&fdspec, 1, 100);
+        if (result == 0 || (result < 0 && (errno == EAGAIN || errno == EINTR))) {
+            continue;
+        } else if (result < 0 || fdspec.revents & (POLLERR | POLLNVAL)) {
+            SINFO("[HTTPESC] Multiplexed connection failed while polling.");
+            break;
+        }
+
+        ssize_t bytesRead = recv(_socket->s, chunk, sizeof(chunk), 0);
+        if (bytesRead == -1) {
+            if (errno == EAGAIN || errno == EINTR) {
+                continue;
+            }
+            SINFO("[HTTPESC] Got error (recv) on multiplexed connection: " << errno << ", fatal.");
+            break;
+        } else if (bytesRead == 0) {
+            SINFO("[HTTPESC] Multiplexed connection disconnected.");
+            break;
+        }
+        recvBuffer.append(chunk, bytesRead);
+
+        // Hand out every complete response we've got.
+        while (recvBuffer.startsWithHTTPRequest()) {
+            SData response;
+            int size = response.deserialize(recvBuffer);
+            if (!size) {
+                break;
+            }
+            recvBuffer.consumeFront(size);
+
+            // The peer is going to close the connection after this, so don't send anything else on it, but keep reading
+            // the responses that are still on their way.
+            if (SIEquals(response["Connection"], "close")) {
+                _connected = false;
+            }
+
+            uint64_t id = SToUInt64(response["MultiplexID"]);
+            lock_guard<mutex> lock(_pendingMutex);
+            auto pendingIt = _pending.find(id);
+            if (pendingIt == _pending.end()) {
+                // The caller timed out and stopped waiting for this one.
+                SINFO("[HTTPESC] Discarding multiplexed response " << id << " that nobody is waiting for.");
+                continue;
+            }
+            PendingRequest* pending = pendingIt->second;
+            _pending.erase(pendingIt);
+            pending->response = move(response);
+            pending->received = true;
+            pending->done = true;
+            pending->cv.notify_one();
+        }
+    }
+
+    _fail();
+}
+
+void SQLiteClusterMessenger::MultiplexedConnection::_fail() {
+    _connected = false;
+    lock_guard<mutex> lock(_pendingMutex);
+    for (auto& [id, pending] : _pending) {
+        pending->done = true;
+        pending->cv.notify_one();
+    }
+    _pending.clear();
+}
@@ -18,6 +18,11 @@ class SQLiteClusterMessenger {
         POLL_ERROR,
     };
 
+    // If set, commands escalated with `runOnPeer` are pipelined over this many persistent connections to each peer,
+    // with many commands in flight on each one at once, rather than checking out a connection for each command. The
+    // peer needs to understand the `MultiplexID` header, so this should only be enabled once the whole cluster does.
+    static atomic<size_t> multiplexedConnections;
+
     SQLiteClusterMessenger(const shared_ptr<const SQLiteNode>& node);
 
     // Attempts to make a TCP connection to a peer, that could be the leader or not, and run the given command there,
@@ -44,11 +49,72 @@ class SQLiteClusterMessenger {
     // to handle the failure.
     bool runOnPeer(BedrockCommand& command, const string& peerName);
 
+    // Returns counts and timing of escalations through `runOnPeer`, for `Status`.
+    STable getStats();
+
   private:
+    // A persistent connection to a peer's command port on which many escalated commands can be in flight at once.
+    // Each request is tagged with a `MultiplexID` header, which the peer echoes back on the response, so responses can
+    // arrive in any order. A thread for each connection reads the responses and hands them to the waiting callers.
+    class MultiplexedConnection {
+      public:
+        MultiplexedConnection(unique_ptr<SHTTPSManager::Socket>&& socket);
+        ~MultiplexedConnection();
+
+        // Sends `request` and waits until `timeout` (a timestamp) for its response. Returns false if the request
+        // couldn't be sent at all, in which case it's safe to retry. Otherwise, returns true, and sets `received` to
+        // whether the response arrived.
+        bool run(SData& request, SData& response, uint64_t timeout, bool& received);
+
+        // False once the connection has failed. Nothing more can be sent on it.
+        bool isConnected() const;
+
+        // The number of requests waiting for responses.
+        size_t inFlight();
+
+      private:
+        struct PendingRequest {
+            SData response;
+            bool done = false;
+            bool received = false;
+            condition_variable cv;
+        };
+
+        // Reads responses until the connection fails or we're destroyed.
+        void _readLoop();
+
+        // Marks the connection as failed and wakes up everything waiting on it.
+        void _fail();
+
+        unique_ptr<SHTTPSManager::Socket> _socket;
+
+        // Held for the whole time a request is being written, so that requests don't interleave.
+        mutex _sendMutex;
+
+        // Protects `_pending` and `_nextID`.
+        mutex _pendingMutex;
+        map<uint64_t, PendingRequest*> _pending;
+        uint64_t _nextID = 1;
+
+        atomic<bool> _connected = true;
+        atomic<bool> _exit = false;
+        thread _readThread;
+    };
+
     // This takes a pollfd with either POLLIN or POLLOUT set, and waits for the socket to be ready to read or write,
     // respectively. It returns true if ready, or false if error or timeout. The timeout is specified as a timestamp in
     // microseconds.
-    WaitForReadyResult waitForReady(pollfd& fdspec, uint64_t timeoutTimestamp) const;
+    static WaitForReadyResult waitForReady(pollfd& fdspec, uint64_t timeoutTimestamp);
+
+    // Writes all of `buffer` to `socket`, waiting until `timeoutTimestamp` for it to be writable. Returns false on
+    // error or timeout.
+    static bool _sendBuffer(SHTTPSManager::Socket& socket, SFastBuffer& buffer, uint64_t timeoutTimestamp);
+
+    // Adds an escalation that took `elapsedUS` to the statistics returned by `getStats`.
+    void _recordEscalation(uint64_t elapsedUS, bool success);
+
+    // Builds the request to send to a peer to run `command` there.
+    static SData _buildRequest(BedrockCommand& command);
 
     // This sets a command as a 500 and marks it as complete.
     static void setErrorResponse(BedrockCommand& command);
@@ -66,8 +132,30 @@ class SQLiteClusterMessenger {
     // there is an error.
     unique_ptr<SHTTPSManager::Socket> _getSocketForAddress(const string& address);
 
+    // True if `command` should be escalated over a multiplexed connection.
+    static bool _shouldMultiplex(const BedrockCommand& command);
+
+    // Runs `command` on the peer at `address` over a multiplexed connection. Returns the same as
+    // `_sendCommandOnSocket`.
+    bool _runMultiplexed(BedrockCommand& command, const string& address);
+
+    // Returns the least busy working multiplexed connection to `address`, opening or replacing connections as needed,
+    // or nullptr if none could be opened.
+    shared_ptr<MultiplexedConnection> _getMultiplexedConnection(const string& address);
+
     const shared_ptr<const SQLiteNode> _node;
 
     // For managing many connections to leader, we have a socket pool.
     SMultiHostSocketPool _socketPool;
+
+    // Multiplexed connections by peer address, when `multiplexedConnections` is set.
+    mutex _multiplexedConnectionsMutex;
+    map<string, vector<shared_ptr<MultiplexedConnection>>> _multiplexedConnections;
+
+    // Escalation statistics.
+    atomic<uint64_t> _escalationCount = 0;
+    atomic<uint64_t> _escalationFailures = 0;
+    atomic<uint64_t> _escalationTotalUS = 0;
+    atomic<uint64_t> _escalationMaxUS = 0;
+    atomic<uint64_t> _escalationsInFlight = 0;
 };
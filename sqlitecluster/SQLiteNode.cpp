@@ -72,6 +72,32 @@ const string SQLiteNode::CONSISTENCY_LEVEL_NAMES[] = {"ASYNC",
 
 const size_t SQLiteNode::MIN_APPROVE_FREQUENCY{10};
 
+atomic<size_t> SQLiteNode::replicationThreads{1};
+atomic<size_t> SQLiteNode::synchronizeBatchSize{100};
+atomic<bool> SQLiteNode::binaryPeerProtocol{false};
+atomic<bool> SQLiteNode::peerCompression{false};
+
+const array<uint64_t, 7> SQLiteNode::REPLICATION_LATENCY_BUCKETS_MS{1, 5, 10, 50, 100, 500, 1000};
+
+SQLiteNode::ReplicatedTransaction::ReplicatedTransaction(SQLitePeer* peer, const SData& message)
+  : peer(peer), message(message), receivedTime(STimeNow())
+{ }
+
+void SQLiteNode::ReplicatedTransaction::setOutcome(OUTCOME outcome, const string& hash) {
+    lock_guard<mutex> lock(_m);
+    _outcome = outcome;
+    commitHash = hash;
+    _cv.notify_all();
+}
+
+SQLiteNode::ReplicatedTransaction::OUTCOME SQLiteNode::ReplicatedTransaction::waitForOutcome() {
+    unique_lock<mutex> lock(_m);
+    while (_outcome == OUTCOME::PENDING) {
+        _cv.wait(lock);
+    }
+    return _outcome;
+}
+
 const vector<SQLitePeer*> SQLiteNode::_initPeers(const string& peerListString) {
     // Make the logging macro work in the static initializer.
     auto _name = "init";
@@ -162,69 +188,107 @@ SQLiteNode::~SQLiteNode() {
     }
 }
 
-void SQLiteNode::_replicate() {
-    SInitialize("replication");
+void SQLiteNode::_replicate(size_t threadID) {
+    SInitialize("replication" + to_string(threadID));
     // Allow the DB handle to be returned regardless of how this function exits.
     SQLiteScopedHandle dbScope(*_dbPool, _dbPool->getIndex(false));
     SQLite& db = dbScope.db();
 
-    SQLitePeer* peer = nullptr;
-    SData command;
     while (true) {
-        bool shouldExitWhenQueueEmpty = false;
-        bool isQueueEmpty = false;
-        uint64_t dequeueTime = 0;
+        shared_ptr<ReplicatedTransaction> transaction;
         {
             unique_lock<mutex> lock(_replicateMutex);
             while (!_shouldReplicateThreadExit && _replicateQueue.empty()) {
                 _replicateCV.wait(lock);
             }
 
-            shouldExitWhenQueueEmpty = _shouldReplicateThreadExit;
-            isQueueEmpty = _replicateQueue.empty();
-            if (!isQueueEmpty) {
-                peer = _replicateQueue.front().first;
-                command = move(_replicateQueue.front().second);
-                _replicateQueue.pop();
-                dequeueTime = STimeNow();
+            // If there's no work left, we must have been told to exit.
+            if (_replicateQueue.empty()) {
+                return;
             }
+            transaction = move(_replicateQueue.front());
+            _replicateQueue.pop();
         }
 
-        // If there was no work, we either wait again, or we can exit.
-        if (isQueueEmpty) {
-            // There are no commands to process.
-            if (shouldExitWhenQueueEmpty) {
-                if (db.insideTransaction()) {
-                    SINFO("Finished replication mid-transaction, missing COMMIT_TRANSACTION, rolling back.");
-                    db.rollback();
-                }
-
-                // Done with replication.
-                return;
+        try {
+            _applyReplicatedTransaction(db, *transaction);
+        } catch (const SException& e) {
+            db.rollback();
+            if (_shouldReplicateThreadExit) {
+                SINFO("Failed to apply transaction #" << transaction->message["NewCount"] << " while stopping FOLLOWING: " << e.what());
             } else {
-                // The queue is empty but we're not exiting so go back to the top and wait.
-                continue;
+                SALERT("Failed to apply transaction #" << transaction->message["NewCount"] << ": " << e.what());
+                _replicationFailed = true;
             }
+
+            // Nothing after this transaction can be committed now, so let any threads waiting on it give up.
+            _localCommitNotifier.cancel();
         }
+    }
+}
 
-        // At this point, we're guaranteed to have a message. Process it and then run again.
-        if (SIEquals(command.methodLine, "BEGIN_TRANSACTION")) {
-            auto start = chrono::steady_clock::now();
-            _handleBeginTransaction(db, peer, command);
-            _handlePrepareTransaction(db, peer, command, dequeueTime);
-            auto duration = chrono::steady_clock::now() - start;
-            SINFO("[performance] Wrote replicate transaction in " << chrono::duration_cast<chrono::microseconds>(duration).count() << "us.");
-        } else if (SIEquals(command.methodLine, "COMMIT_TRANSACTION")) {
-            int result = _handleCommitTransaction(db, peer, command.calcU64("NewCount"), command["NewHash"]);
-            if (result != SQLITE_OK) {
-                STHROW("commit failed");
-            }
-        } else if (SIEquals(command.methodLine, "ROLLBACK_TRANSACTION")) {
-            _handleRollbackTransaction(db, peer, command);
-        } else {
-            SWARN("Invalid command passed to _replicate: " << command.methodLine);
+void SQLiteNode::_applyReplicatedTransaction(SQLite& db, ReplicatedTransaction& transaction) {
+    const SData& message = transaction.message;
+    const uint64_t newCount = message.calcU64("NewCount");
+    const uint64_t dequeueTime = STimeNow();
+
+    // We can begin as soon as we've committed everything that leader had committed when it began this transaction.
+    // Anything leader committed after that didn't conflict with this transaction there, so we can apply them in
+    // parallel here. If they do conflict here, we'll find out when we commit.
+    if (_localCommitNotifier.waitFor(message.calcU64("dbCountAtStart")) == SQLiteSequentialNotifier::RESULT::CANCELED) {
+        SINFO("Replication canceled before beginning transaction #" << newCount << ".");
+        return;
+    }
+
+    bool responseSent = false;
+    while (true) {
+        auto start = chrono::steady_clock::now();
+        _handleBeginTransaction(db, transaction.peer, message);
+
+        // Transactions are prepared in commit order, as the hash of each one depends on the one before it.
+        if (_localCommitNotifier.waitFor(newCount - 1) == SQLiteSequentialNotifier::RESULT::CANCELED) {
+            SINFO("Replication canceled before preparing transaction #" << newCount << ", rolling back.");
+            db.rollback();
+            return;
         }
+        _handlePrepareTransaction(db, transaction.peer, message, dequeueTime, !responseSent);
+        responseSent = true;
+        auto duration = chrono::steady_clock::now() - start;
+        SINFO("[performance] Wrote replicate transaction in " << chrono::duration_cast<chrono::microseconds>(duration).count() << "us.");
+
+        ReplicatedTransaction::OUTCOME outcome = transaction.waitForOutcome();
+        if (outcome == ReplicatedTransaction::OUTCOME::ROLLBACK) {
+            SINFO("Rolling back transaction #" << newCount << " on leader's request.");
+            db.rollback();
+            return;
+        } else if (outcome == ReplicatedTransaction::OUTCOME::CANCELED) {
+            // Leader will never tell us to commit this now, so nothing after it can commit either.
+            SINFO("Stopped FOLLOWING with transaction #" << newCount << " uncommitted, rolling back.");
+            db.rollback();
+            _localCommitNotifier.cancel();
+            return;
+        }
+
+        int result = _handleCommitTransaction(db, transaction.peer, newCount, transaction.commitHash);
+        if (result == SQLITE_OK) {
+            break;
+        } else if (result != SQLITE_BUSY_SNAPSHOT) {
+            STHROW("commit failed");
+        }
+
+        // We conflicted with a transaction that committed after we began. Everything before us is committed now, so
+        // when we run it again there's nothing left to conflict with.
+        SINFO("[performance] Conflict committing replicated transaction #" << newCount << ", retrying.");
+        db.rollback();
     }
+    _localCommitNotifier.notifyThrough(newCount);
+
+    uint64_t latencyMS = (STimeNow() - transaction.receivedTime) / 1000;
+    size_t bucket = 0;
+    while (bucket < REPLICATION_LATENCY_BUCKETS_MS.size() && latencyMS >= REPLICATION_LATENCY_BUCKETS_MS[bucket]) {
+        bucket++;
+    }
+    _replicationApplyLatency[bucket]++;
 }
 
 void SQLiteNode::startCommit(ConsistencyLevel consistency) {
@@ -350,6 +414,30 @@ uint64_t SQLiteNode::getCommitCount() const {
     return _db.getCommitCount();
 }
 
+STable SQLiteNode::getReplicationInfo() const {
+    // Everything here is atomic, so there's no need to lock.
+    STable info;
+    uint64_t commitCount = _db.getCommitCount();
+    auto _leadPeerCopy = _leadPeer.load();
+    uint64_t leaderCommitCount = _leadPeerCopy ? _leadPeerCopy->commitCount.load() : commitCount;
+    info["replicationCommitsBehind"] = to_string(leaderCommitCount > commitCount ? leaderCommitCount - commitCount : 0);
+    list<string> buckets;
+    for (uint64_t bucket : REPLICATION_LATENCY_BUCKETS_MS) {
+        buckets.push_back(to_string(bucket));
+    }
+    list<string> counts;
+    for (auto& count : _replicationApplyLatency) {
+        counts.push_back(to_string(count.load()));
+    }
+    info["replicationApplyLatencyBucketsMS"] = SComposeJSONArray(buckets);
+    info["replicationApplyLatencyCounts"] = SComposeJSONArray(counts);
+    info["peerCompressionBytesIn"] = to_string(SQLitePeer::compressionBytesIn);
+    info["peerCompressionBytesOut"] = to_string(SQLitePeer::compressionBytesOut);
+    info["peerCompressionTimeUS"] = to_string(SQLitePeer::compressionTimeUS);
+    info["peerDecompressionTimeUS"] = to_string(SQLitePeer::decompressionTimeUS);
+    return info;
+}
+
 uint64_t SQLiteNode::getOutstandingFramesToCheckpoint() const {
     // Note: this can skip locking because it only accesses a single atomic variable, which makes it safe to call in
     // private methods.
@@ -587,7 +675,7 @@ bool SQLiteNode::update() {
         SASSERTWARN(!_syncPeer);
         _updateSyncPeer();
         if (_syncPeer) {
-            _sendToPeer(_syncPeer, SData("SYNCHRONIZE"));
+            _sendSynchronize(_syncPeer);
             _changeState(SQLiteNodeState::SYNCHRONIZING);
 
             // Run `update` again immediately.
@@ -1154,6 +1242,15 @@ bool SQLiteNode::update() {
             return false; // Don't update
         }
 
+        // If a replication thread couldn't apply a transaction, we can't apply anything after it either, so we start
+        // over and re-synchronize.
+        if (_replicationFailed) {
+            SWARN("Replication failed, reconnecting to leader and re-SEARCHING.");
+            _reconnectPeer(_leadPeer);
+            _changeState(SQLiteNodeState::SEARCHING);
+            return true; // Re-update
+        }
+
         // If the leader stops leading (or standing down), we'll go SEARCHING, which allows us to look for a new
         // leader. We don't want to go searching before that, because we won't know when leader is done sending its
         // final transactions.
@@ -1269,6 +1366,10 @@ void SQLiteNode::_onMESSAGE(SQLitePeer* peer, const SData& message) {
             peer->version = message["Version"];
             peer->state = stateFromName(message["State"]);
 
+            // Our own LOGIN has already gone out as text, so if we both support it, everything from here on can be binary.
+            peer->binaryProtocol = binaryPeerProtocol && message["BinaryProtocol"] == "true";
+            peer->compression = peerCompression && message["Compression"] == "gzip";
+
             // Is it on the same version as us?
             if (!_haveSeenPeerOnSameVersion && peer->version.load() == _version) {
                 _haveSeenPeerOnSameVersion = true;
@@ -1444,7 +1545,7 @@ void SQLiteNode::_onMESSAGE(SQLitePeer* peer, const SData& message) {
                     SQLiteScopedHandle dbScope(*_dbPool, _dbPool->getIndex());
                     SQLite& db = dbScope.db();
                     try {
-                        _queueSynchronize(this, peer, db, response, false);
+                        _queueSynchronize(this, peer, db, message, response, false);
 
                         // The following two lines are copied from `_sendToPeer`.
                         response["CommitCount"] = to_string(db.getCommitCount());
@@ -1494,7 +1595,7 @@ void SQLiteNode::_onMESSAGE(SQLitePeer* peer, const SData& message) {
             PINFO("Beginning synchronization");
             try {
                 // Received this synchronization response; are we done?
-                _recvSynchronize(peer, message);
+                bool pipelined = _recvSynchronize(peer, message);
                 uint64_t peerCommitCount = _syncPeer->commitCount;
                 if (_db.getCommitCount() == peerCommitCount) {
                     // All done
@@ -1514,12 +1615,17 @@ void SQLiteNode::_onMESSAGE(SQLitePeer* peer, const SData& message) {
                     SINFO("Synchronization underway, at commitCount #"
                           << _db.getCommitCount() << " (" << _db.getCommittedHash() << "), "
                           << peerCommitCount - _db.getCommitCount() << " to go.");
-                    _updateSyncPeer();
-                    if (_syncPeer) {
-                        _sendToPeer(_syncPeer, SData("SYNCHRONIZE"));
+                    if (pipelined) {
+                        // We already asked this peer for the next batch, so we stick with it until that arrives.
+                        SINFO("Next synchronization batch already requested from " << _syncPeer->name << ".");
                     } else {
-                        SWARN("No usable _syncPeer but syncing not finished. Going to SEARCHING.");
-                        _changeState(SQLiteNodeState::SEARCHING);
+                        _updateSyncPeer();
+                        if (_syncPeer) {
+                            _sendSynchronize(_syncPeer);
+                        } else {
+                            SWARN("No usable _syncPeer but syncing not finished. Going to SEARCHING.");
+                            _changeState(SQLiteNodeState::SEARCHING);
+                        }
                     }
 
                     // Also, extend our timeout so long as we're still alive
@@ -1548,7 +1654,7 @@ void SQLiteNode::_onMESSAGE(SQLitePeer* peer, const SData& message) {
             // We send every remaining commit that the node doesn't have, but we set a timeout on the query that gathers these to half the
             // maximum time limit that will cause this node to be disconnected from the cluster.
             uint64_t start = STimeNow();
-            _queueSynchronize(this, peer, _db, response, true, RECV_TIMEOUT / 2);
+            _queueSynchronize(this, peer, _db, message, response, true, RECV_TIMEOUT / 2);
             uint64_t end = STimeNow();
             SINFO("Final commits for SUBSCRIPTION_APPROVED queried in " << ((end - start) / 1000) << "ms.");
             _sendToPeer(peer, response);
@@ -1607,17 +1713,46 @@ void SQLiteNode::_onMESSAGE(SQLitePeer* peer, const SData& message) {
                 return;
             }
 
+            // COMMIT_TRANSACTION and ROLLBACK_TRANSACTION settle a transaction that's already been handed to a
+            // replication thread.
+            if (!SIEquals(message.methodLine, "BEGIN_TRANSACTION")) {
+                bool commit = SIEquals(message.methodLine, "COMMIT_TRANSACTION");
+                uint64_t id = commit ? message.calcU64("NewCount") : message.calcU64("ID");
+                auto it = _uncommittedReplicatedTransactions.find(id);
+                if (it == _uncommittedReplicatedTransactions.end()) {
+                    SINFO("Received " << message.methodLine << " with no outstanding transaction #" << id << ".");
+                    return;
+                }
+                it->second->setOutcome(commit ? ReplicatedTransaction::OUTCOME::COMMIT : ReplicatedTransaction::OUTCOME::ROLLBACK, message["NewHash"]);
+                _uncommittedReplicatedTransactions.erase(it);
+                return;
+            }
+
+            auto transaction = make_shared<ReplicatedTransaction>(peer, message);
             bool isReplicationRunning = false;
             {
                 lock_guard<mutex> lock(_replicateMutex);
                 if (!_shouldReplicateThreadExit) {
-                    _replicateQueue.push(make_pair(peer, message));
+                    _replicateQueue.push(transaction);
                     isReplicationRunning = true;
                 }
             }
             if (isReplicationRunning) {
-                if (!_replicateThread) {
-                    _replicateThread = new thread(&SQLiteNode::_replicate, this);
+                // A new BEGIN for a transaction we're already holding means leader gave up on the old one.
+                auto& slot = _uncommittedReplicatedTransactions[message.calcU64("NewCount")];
+                if (slot) {
+                    SWARN("Received BEGIN_TRANSACTION for #" << message["NewCount"] << " with one already outstanding, rolling back the old one.");
+                    slot->setOutcome(ReplicatedTransaction::OUTCOME::ROLLBACK);
+                }
+                slot = transaction;
+                if (_replicateThreads.empty()) {
+                    // Nothing else commits while we're following, so this is where the replication threads start from.
+                    _localCommitNotifier.reset(_db.getCommitCount());
+                    _replicationFailed = false;
+                    size_t threadCount = max(replicationThreads.load(), (size_t)1);
+                    for (size_t threadID = 0; threadID < threadCount; threadID++) {
+                        _replicateThreads.emplace_back(&SQLiteNode::_replicate, this, threadID);
+                    }
                 }
                 _replicateCV.notify_one();
             } else {
@@ -1719,6 +1854,12 @@ void SQLiteNode::_onConnect(SQLitePeer* peer) {
     login["State"] = stateName(_state);
     login["Version"] = _version;
     login["Permafollower"] = _originalPriority ? "false" : "true";
+    if (binaryPeerProtocol) {
+        login["BinaryProtocol"] = "true";
+    }
+    if (peerCompression) {
+        login["Compression"] = "gzip";
+    }
     PINFO("Sending " << login.serialize());
 
     // NOTE: the following call adds CommitCount, Hash, and commandAddress fields.
@@ -1836,6 +1977,12 @@ void SQLiteNode::_sendToPeer(SQLitePeer* peer, const SData& message) {
 void SQLiteNode::_sendToAllPeers(const SData& message, bool subscribedOnly) {
     const SData messageWithHeaders = _addPeerHeaders(message);
 
+    // For peers that want compressed messages, we compress once up front rather than separately for each of them. If
+    // that doesn't help, `compressMessage` returns it uncompressed, and we send that as-is rather than have each peer
+    // try again.
+    SData compressedMessage;
+    bool haveCompressedMessage = false;
+
     // Loop across all connected peers and send the message. _peerList is const so this is thread-safe.
     for (auto peer : _peerList) {
         if (peer->forked) {
@@ -1845,7 +1992,15 @@ void SQLiteNode::_sendToAllPeers(const SData& message, bool subscribedOnly) {
         // This check is strictly thread-safe, as SQLitePeer::subscribed is atomic, but there's still a race condition
         // around checking subscribed and then sending, as subscribed could technically change.
         if (!subscribedOnly || peer->subscribed) {
-            peer->sendMessage(messageWithHeaders);
+            if (peer->compression && messageWithHeaders.content.size() >= SQLitePeer::MIN_COMPRESSION_SIZE) {
+                if (!haveCompressedMessage) {
+                    compressedMessage = SQLitePeer::compressMessage(messageWithHeaders);
+                    haveCompressedMessage = true;
+                }
+                peer->sendMessage(compressedMessage, true);
+            } else {
+                peer->sendMessage(messageWithHeaders);
+            }
         }
     }
 }
@@ -1861,12 +2016,17 @@ void SQLiteNode::_changeState(SQLiteNodeState newState, uint64_t commitIDToCance
                 lock_guard<mutex> lock(_replicateMutex);
                 _shouldReplicateThreadExit = true;
             }
-            if (_replicateThread) {
-                _replicateCV.notify_one();
-                _replicateThread->join();
-                delete _replicateThread;
-                _replicateThread = nullptr;
+
+            // Anything leader already told us to commit still gets committed, but anything else is abandoned.
+            for (auto& transaction : _uncommittedReplicatedTransactions) {
+                transaction.second->setOutcome(ReplicatedTransaction::OUTCOME::CANCELED);
             }
+            _uncommittedReplicatedTransactions.clear();
+            _replicateCV.notify_all();
+            for (auto& replicateThread : _replicateThreads) {
+                replicateThread.join();
+            }
+            _replicateThreads.clear();
             if (_replicateQueue.size()) {
                 SWARN("Replicate queue contains " << _replicateQueue.size() << " messages at thread shutdown.");
             }
@@ -1979,7 +2139,7 @@ void SQLiteNode::_changeState(SQLiteNodeState newState, uint64_t commitIDToCance
     }
 }
 
-void SQLiteNode::_queueSynchronize(const SQLiteNode* const node, SQLitePeer* peer, SQLite& db, SData& response, bool sendAll, uint64_t timeoutAfterUS) {
+void SQLiteNode::_queueSynchronize(const SQLiteNode* const node, SQLitePeer* peer, SQLite& db, const SData& request, SData& response, bool sendAll, uint64_t timeoutAfterUS) {
     // We need this to check the state of the node, and we also need `name` to make the logging macros work in a static
     // function. However, if you pass a null pointer here, we can't set these, so we'll fail. We also can't log that,
     // so we are just going to rely on the signal handling for sigsegv to log that for you. Don't do that.
@@ -1988,7 +2148,12 @@ void SQLiteNode::_queueSynchronize(const SQLiteNode* const node, SQLitePeer* pee
 
     uint64_t peerCommitCount = 0;
     string peerHash;
-    peer->getCommit(peerCommitCount, peerHash);
+    if (request.isSet("SynchronizeFromCommitCount")) {
+        peerCommitCount = request.calcU64("SynchronizeFromCommitCount");
+        peerHash = request["SynchronizeFromHash"];
+    } else {
+        peer->getCommit(peerCommitCount, peerHash);
+    }
     if (peerCommitCount > db.getCommitCount())
         STHROW("you have more data than me");
     if (peerCommitCount) {
@@ -2031,7 +2196,9 @@ void SQLiteNode::_queueSynchronize(const SQLiteNode* const node, SQLitePeer* pee
         if (sendAll) {
             SINFO("Sending all commits with synchronize message, from " << fromIndex << " to " << toIndex);
         } else {
-            toIndex = min(toIndex, fromIndex + 100); // 100 transactions at a time
+            // Send as many as the peer asked for, or 100 if it didn't say.
+            uint64_t batchSize = request.isSet("SynchronizeBatchSize") ? max(request.calcU64("SynchronizeBatchSize"), (uint64_t)1) : 100;
+            toIndex = min(toIndex, fromIndex + batchSize - 1);
         }
         int resultCode = db.getCommits(fromIndex, toIndex, result, timeoutAfterUS);
         if (resultCode) {
@@ -2061,7 +2228,7 @@ void SQLiteNode::_queueSynchronize(const SQLiteNode* const node, SQLitePeer* pee
     }
 }
 
-void SQLiteNode::_recvSynchronize(SQLitePeer* peer, const SData& message) {
+bool SQLiteNode::_recvSynchronize(SQLitePeer* peer, const SData& message) {
     if (message.isSet("ShuttingDown")) {
         STHROW("Sync peer is shutting down");
     }
@@ -2069,15 +2236,13 @@ void SQLiteNode::_recvSynchronize(SQLitePeer* peer, const SData& message) {
         STHROW("missing NumCommits");
     }
 
-    // Walk across the content and commit in order
-    int commitsRemaining = message.calc("NumCommits");
-    SData commit;
+    // Walk across the content and validate each commit before we touch the database.
+    list<SData> commits;
     const char* content = message.content.c_str();
     int messageSize = 0;
     int remaining = (int)message.content.size();
+    SData commit;
     while ((messageSize = commit.deserialize(content, remaining))) {
-        // Consume this message and process
-        // **FIXME: This could be optimized to commit in one huge transaction
         content += messageSize;
         remaining -= messageSize;
         if (!SIEquals(commit.methodLine, "COMMIT")) {
@@ -2095,31 +2260,67 @@ void SQLiteNode::_recvSynchronize(SQLitePeer* peer, const SData& message) {
         if (commit.content.empty()) {
             SALERT("Synchronized blank query");
         }
-        if (commit.calcU64("CommitIndex") != _db.getCommitCount() + 1) {
+        if (commit.calcU64("CommitIndex") != _db.getCommitCount() + commits.size() + 1) {
             STHROW("commit index mismatch");
         }
-        if (!_db.beginTransaction()) {
-            STHROW("failed to begin transaction");
-        }
-        if (!_db.writeUnmodified(commit.content)) {
-            STHROW("failed to write transaction");
+        commits.push_back(move(commit));
+        commit = SData();
+    }
+
+    // Did we get all our commits?
+    if (commits.size() != (size_t)message.calc("NumCommits")) {
+        STHROW("commits remaining at end");
+    }
+    if (commits.empty()) {
+        return false;
+    }
+
+    // If we're synchronizing and the peer has more than this, ask for the next batch now, so it's building it while we
+    // apply this one. SUBSCRIPTION_APPROVED is always the last batch, so there's nothing to ask for in that case.
+    bool pipelined = false;
+    const uint64_t lastCommitIndex = commits.back().calcU64("CommitIndex");
+    if (_state == SQLiteNodeState::SYNCHRONIZING && message.isSet("CommitCount") && lastCommitIndex < message.calcU64("CommitCount")) {
+        _sendSynchronize(peer, lastCommitIndex, commits.back()["Hash"]);
+        pipelined = true;
+    }
+
+    // Apply the whole batch as one transaction, checking the hash of each commit as we go.
+    if (!_db.beginTransaction()) {
+        STHROW("failed to begin transaction");
+    }
+    try {
+        for (const SData& batchedCommit : commits) {
+            if (!_db.writeUnmodified(batchedCommit.content)) {
+                STHROW("failed to write transaction");
+            }
+            if (!_db.prepareBatched(batchedCommit["Hash"])) {
+                STHROW("potential hash mismatch");
+            }
         }
-        if (!_db.prepare()) {
-            STHROW("failed to prepare transaction");
+
+        SINFO("Committing " << commits.size() << " synchronized commits through #" << lastCommitIndex << " in one transaction.");
+        if (_db.commit(stateName(_state))) {
+            STHROW("failed to commit synchronized transactions");
         }
+    } catch (...) {
+        _db.rollback();
+        throw;
+    }
+    if (_db.getCommittedHash() != commits.back()["Hash"]) {
+        STHROW("potential hash mismatch");
+    }
 
-        // Transaction succeeded, commit and go to the next
-        SDEBUG("Committing current transaction because _recvSynchronize: " << _db.getUncommittedQuery());
-        _db.commit(stateName(_state));
+    return pipelined;
+}
 
-        if (_db.getCommittedHash() != commit["Hash"])
-            STHROW("potential hash mismatch");
-        --commitsRemaining;
+void SQLiteNode::_sendSynchronize(SQLitePeer* peer, uint64_t fromCommitCount, const string& fromHash) {
+    SData request("SYNCHRONIZE");
+    request["SynchronizeBatchSize"] = to_string(synchronizeBatchSize.load());
+    if (fromCommitCount) {
+        request["SynchronizeFromCommitCount"] = to_string(fromCommitCount);
+        request["SynchronizeFromHash"] = fromHash;
     }
-
-    // Did we get all our commits?
-    if (commitsRemaining)
-        STHROW("commits remaining at end");
+    _sendToPeer(peer, request);
 }
 
 void SQLiteNode::_updateSyncPeer()
@@ -2254,8 +2455,8 @@ void SQLiteNode::_handleBeginTransaction(SQLite& db, SQLitePeer* peer, const SDa
         STHROW("already in a transaction");
     }
 
-    // Shared with single-threaded replication because this is the only thread writing, and thus we can't get conflicts,
-    // and using SHARED prevents us from blocking or being blocked by readers.
+    // Using SHARED prevents us from blocking or being blocked by readers. Replication threads can conflict with each
+    // other, but that's caught (and retried) when they commit.
     if (!db.beginTransaction(SQLite::TRANSACTION_TYPE::SHARED)) {
         STHROW("failed to begin transaction");
     }
@@ -2266,7 +2467,7 @@ void SQLiteNode::_handleBeginTransaction(SQLite& db, SQLitePeer* peer, const SDa
     }
 }
 
-void SQLiteNode::_handlePrepareTransaction(SQLite& db, SQLitePeer* peer, const SData& message, uint64_t dequeueTime) {
+void SQLiteNode::_handlePrepareTransaction(SQLite& db, SQLitePeer* peer, const SData& message, uint64_t dequeueTime, bool sendResponse) {
     uint64_t prepareStartTime = STimeNow();
     // BEGIN_TRANSACTION: Sent by the LEADER to all subscribed followers to begin a new distributed transaction. Each
     // follower begins a local transaction with this query and responds APPROVE_TRANSACTION. If the follower cannot start
@@ -2294,7 +2495,9 @@ void SQLiteNode::_handlePrepareTransaction(SQLite& db, SQLitePeer* peer, const S
     }
 
     // Are we participating in quorum?
-    if (_priority) {
+    if (!sendResponse) {
+        PINFO("Re-prepared transaction #" << db.getCommitCount() + 1 << " (" << db.getUncommittedHash() << ") after conflict.");
+    } else if (_priority) {
         // If the ID is /ASYNC_\d+/, leader will keep going regardless, but we send every 10th response anyway, just so leader keeps relatively current with our commit count.
         string verb = success ? "APPROVE_TRANSACTION" : "DENY_TRANSACTION";
         uint64_t currentCommitCount = db.getCommitCount();
@@ -2378,21 +2581,6 @@ int SQLiteNode::_handleCommitTransaction(SQLite& db, SQLitePeer* peer, const uin
     return result;
 }
 
-void SQLiteNode::_handleRollbackTransaction(SQLite& db, SQLitePeer* peer, const SData& message) {
-    // ROLLBACK_TRANSACTION: Sent to all subscribed followers by the leader when it determines that the current
-    // outstanding transaction should be rolled back. This completes a given distributed transaction.
-    if (!message.isSet("ID")) {
-        STHROW("missing ID");
-    }
-    if (_state != SQLiteNodeState::FOLLOWING) {
-        STHROW("not following");
-    }
-    if (db.getUncommittedHash().empty()) {
-        SINFO("Received ROLLBACK_TRANSACTION with no outstanding transaction.");
-    }
-    db.rollback();
-}
-
 SQLiteNodeState SQLiteNode::leaderState() const {
     shared_lock<decltype(_stateMutex)> sharedLock(_stateMutex);
     if (_leadPeer) {
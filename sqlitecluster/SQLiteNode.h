@@ -1,10 +1,13 @@
 #pragma once
 #include <libstuff/libstuff.h>
+#include <libstuff/SData.h>
 #include <libstuff/SSynchronizedQueue.h>
 #include <libstuff/STCPManager.h>
 #include <sqlitecluster/SQLite.h>
 #include <sqlitecluster/SQLitePool.h>
+#include <sqlitecluster/SQLiteSequentialNotifier.h>
 
+#include <array>
 #include <mutex>
 #include <condition_variable>
 #include <queue>
@@ -96,6 +99,18 @@ class SQLiteNode : public STCPManager {
     // This is expressed as "every Nth message", where e.g., if MIN_APPROVE_FREQUENCY is 10, we will respond to at least every 10th BEGIN_TRANSACTION message.
     static const size_t MIN_APPROVE_FREQUENCY;
 
+    // The number of threads a follower uses to apply replicated transactions. Set before the node starts following.
+    static atomic<size_t> replicationThreads;
+
+    // The most commits we ask a peer for in each SYNCHRONIZE request. Each response is applied as a single transaction.
+    static atomic<size_t> synchronizeBatchSize;
+
+    // Whether we offer the binary peer protocol at LOGIN. It's used with any peer that offers it too.
+    static atomic<bool> binaryPeerProtocol;
+
+    // Whether we offer to compress large messages at LOGIN. It's used with any peer that offers it too.
+    static atomic<bool> peerCompression;
+
     // Get and SQLiteNode State from it's name.
     static SQLiteNodeState stateFromName(const string& name);
 
@@ -133,6 +148,11 @@ class SQLiteNode : public STCPManager {
     // Does not block.
     int getPriority() const;
 
+    // Returns how far behind leader replication is, a histogram of how long it's taken to apply replicated
+    // transactions, and peer compression counters, for `Status`.
+    // Does not block.
+    STable getReplicationInfo() const;
+
     // Sets the node priority to 1 and broadcasts STATE to the cluster.
     // Can block.
     void setShutdownPriority();
@@ -201,6 +221,38 @@ class SQLiteNode : public STCPManager {
     bool onPrepareHandlerEnabled;
 
   private:
+    // A BEGIN_TRANSACTION from leader, waiting to be applied by a replication thread, and leader's verdict on it.
+    class ReplicatedTransaction {
+      public:
+        enum class OUTCOME {
+            PENDING,
+            COMMIT,
+            ROLLBACK,
+            CANCELED,
+        };
+
+        ReplicatedTransaction(SQLitePeer* peer, const SData& message);
+
+        // Called by the sync thread when leader sends COMMIT_TRANSACTION or ROLLBACK_TRANSACTION for this
+        // transaction, or when we stop following before it does.
+        void setOutcome(OUTCOME outcome, const string& hash = "");
+
+        // Blocks until `setOutcome` is called.
+        OUTCOME waitForOutcome();
+
+        SQLitePeer* const peer;
+        const SData message;
+        const uint64_t receivedTime;
+
+        // The hash leader committed this transaction with.
+        string commitHash;
+
+      private:
+        mutex _m;
+        condition_variable _cv;
+        OUTCOME _outcome = OUTCOME::PENDING;
+    };
+
     // Utility class that can decrement _replicationThreadCount when objects go out of scope.
     template <typename CounterType>
     class ScopedDecrement {
@@ -217,12 +269,19 @@ class SQLiteNode : public STCPManager {
     // for logging.
     static const string CONSISTENCY_LEVEL_NAMES[NUM_CONSISTENCY_LEVELS];
 
+    // Upper bounds of the buckets in the replication apply latency histogram. There's one more bucket after these for
+    // everything slower.
+    static const array<uint64_t, 7> REPLICATION_LATENCY_BUCKETS_MS;
+
     static const vector<SQLitePeer*> _initPeers(const string& peerList);
 
     // Queue a SYNCHRONIZE message based on the current state of the node, thread-safe, but you need to pass the
     // *correct* DB for the thread that's making the call (i.e., you can't use the node's internal DB from a worker
     // thread with a different DB object) - which is why this is static.
-    static void _queueSynchronize(const SQLiteNode* const node, SQLitePeer* peer, SQLite& db, SData& response, bool sendAll, uint64_t timeoutAfterUS = 0);
+    // `request` is the SYNCHRONIZE or SUBSCRIBE message being answered. If it names the commit to synchronize from (a
+    // pipelined request, sent before the requester has applied its previous batch), we use that instead of the peer's
+    // current commit count.
+    static void _queueSynchronize(const SQLiteNode* const node, SQLitePeer* peer, SQLite& db, const SData& request, SData& response, bool sendAll, uint64_t timeoutAfterUS = 0);
 
     bool _isNothingBlockingShutdown() const;
     bool _majoritySubscribed() const;
@@ -236,11 +295,15 @@ class SQLiteNode : public STCPManager {
 
     string _getLostQuorumLogMessage() const;
 
-    // Handlers for transaction messages.
+    // Applies a single replicated transaction on a replication thread. Returns once it's committed, or once it's
+    // been rolled back because leader rolled it back or we stopped following. Throws if it can't be applied.
+    void _applyReplicatedTransaction(SQLite& db, ReplicatedTransaction& transaction);
+
+    // Handlers for transaction messages. If `sendResponse` is false, we prepare the transaction without approving or
+    // denying it to leader (because we already have).
     void _handleBeginTransaction(SQLite& db, SQLitePeer* peer, const SData& message);
-    void _handlePrepareTransaction(SQLite& db, SQLitePeer* peer, const SData& message, uint64_t dequeueTime);
+    void _handlePrepareTransaction(SQLite& db, SQLitePeer* peer, const SData& message, uint64_t dequeueTime, bool sendResponse = true);
     int _handleCommitTransaction(SQLite& db, SQLitePeer* peer, const uint64_t commandCommitCount, const string& commandCommitHash);
-    void _handleRollbackTransaction(SQLite& db, SQLitePeer* peer, const SData& message);
 
     // Called when we first establish a connection with a new peer
     void _onConnect(SQLitePeer* peer);
@@ -252,24 +315,30 @@ class SQLiteNode : public STCPManager {
     void _onMESSAGE(SQLitePeer* peer, const SData& message);
     void _reconnectAll();
     void _reconnectPeer(SQLitePeer* peer);
-    void _recvSynchronize(SQLitePeer* peer, const SData& message);
 
-    // This is the main replication loop that's run in the replication threads. It's instantiated in a new thread for
-    // each new relevant replication command received by the sync thread.
-    //
-    // There are three commands we currently handle here BEGIN_TRANSACTION, ROLLBACK_TRANSACTION, and
-    // COMMIT_TRANSACTION.
-    // ROLLBACK_TRANSACTION and COMMIT_TRANSACTION are trivial, they record the new highest commit number from LEADER,
-    // or instruct the node to go SEARCHING and reconnect if a distributed ROLLBACK happens.
+    // Asks `peer` for the next batch of commits. If `fromCommitCount` is set, asks for the commits after that one
+    // (whose hash is `fromHash`) rather than after our current commit count.
+    void _sendSynchronize(SQLitePeer* peer, uint64_t fromCommitCount = 0, const string& fromHash = "");
+
+    // Applies the commits in a SYNCHRONIZE_RESPONSE or SUBSCRIPTION_APPROVED as a single transaction. If we're
+    // synchronizing and the sync peer has more commits than this response contains, the next SYNCHRONIZE is sent before
+    // applying, so the peer can build the next batch while we apply this one. Returns true if it did that.
+    bool _recvSynchronize(SQLitePeer* peer, const SData& message);
+
+    // This is the main replication loop that's run in each of the `replicationThreads` replication threads. Each
+    // thread takes the next BEGIN_TRANSACTION received by the sync thread and applies it with
+    // `_applyReplicatedTransaction`. COMMIT_TRANSACTION and ROLLBACK_TRANSACTION are handled by the sync thread, which
+    // passes them to the thread applying that transaction with `ReplicatedTransaction::setOutcome`.
     //
-    // BEGIN_TRANSACTION is where the interesting case is. This starts all transactions in parallel, and then waits
-    // until each previous transaction is committed such that the final commit order matches LEADER. It also handles
-    // commit conflicts by re-running the transaction from the beginning. Most of the logic for making sure
-    // transactions are ordered correctly is done in `SQLiteSequentialNotifier`, which is worth reading.
+    // Transactions are begun in parallel, as soon as we've committed everything leader had committed when it began
+    // the same transaction (its `dbCountAtStart`), and then each waits until every previous transaction is committed
+    // so that the final commit order matches LEADER. Commit conflicts are handled by re-running the transaction from
+    // the beginning. Most of the logic for making sure transactions are ordered correctly is done in
+    // `SQLiteSequentialNotifier`, which is worth reading.
     //
-    // This thread exits on completion of handling the command or when node._replicationThreadsShouldExit is set,
-    // which happens when a node stops FOLLOWING.
-    void _replicate();
+    // These threads exit once the queue is empty after `_shouldReplicateThreadExit` is set, which happens when a node
+    // stops FOLLOWING.
+    void _replicate(size_t threadID);
 
     // Replicates any transactions that have been made on our database by other threads to peers.
     void _sendOutstandingTransactions(const set<uint64_t>& commitOnlyIDs = {});
@@ -394,9 +463,24 @@ class SQLiteNode : public STCPManager {
     // the sync node is when they run queries in stateChanged.
     SQLite* pluginDB;
 
-    thread* _replicateThread = nullptr;
+    list<thread> _replicateThreads;
     mutex _replicateMutex;
     condition_variable _replicateCV;
-    queue<pair<SQLitePeer*, SData>> _replicateQueue;
+    queue<shared_ptr<ReplicatedTransaction>> _replicateQueue;
     atomic<bool> _shouldReplicateThreadExit;
+
+    // Replicated transactions that leader hasn't committed or rolled back yet, by commit count. Only used by the sync
+    // thread.
+    map<uint64_t, shared_ptr<ReplicatedTransaction>> _uncommittedReplicatedTransactions;
+
+    // Our commit count, as replication threads commit, so that each can wait for its turn.
+    SQLiteSequentialNotifier _localCommitNotifier;
+
+    // Set when a replication thread fails to apply a transaction. Nothing after that transaction can be applied, so
+    // the sync thread reconnects to leader when it sees this.
+    atomic<bool> _replicationFailed{false};
+
+    // Counts of replicated transactions by how long they took from arriving to being committed, bucketed by
+    // `REPLICATION_LATENCY_BUCKETS_MS`.
+    array<atomic<uint64_t>, 8> _replicationApplyLatency{};
 };
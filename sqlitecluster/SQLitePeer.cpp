@@ -4,6 +4,7 @@
 #include "sqlitecluster/SQLiteNode.h"
 
 #include <libstuff/SData.h>
+#include <libstuff/SDataView.h>
 #include <libstuff/SRandom.h>
 
 #include <sys/ioctl.h>
@@ -11,6 +12,71 @@
 #undef SLOGPREFIX
 #define SLOGPREFIX "{" << name << "} "
 
+const unsigned char SQLitePeer::BINARY_FRAME_MARKER = 0xB1;
+const size_t SQLitePeer::MIN_COMPRESSION_SIZE = 1024;
+
+atomic<uint64_t> SQLitePeer::compressionBytesIn(0);
+atomic<uint64_t> SQLitePeer::compressionBytesOut(0);
+atomic<uint64_t> SQLitePeer::compressionTimeUS(0);
+atomic<uint64_t> SQLitePeer::decompressionTimeUS(0);
+
+// Method lines that get a single-byte type in binary frames. Only ever append to this list, peers on different
+// versions need to agree on what each index means.
+static const vector<string> BINARY_MESSAGE_TYPES = {
+    "",
+    "LOGIN",
+    "PING",
+    "PONG",
+    "STATE",
+    "STANDUP",
+    "STANDUP_RESPONSE",
+    "SYNCHRONIZE",
+    "SYNCHRONIZE_RESPONSE",
+    "SUBSCRIBE",
+    "SUBSCRIPTION_APPROVED",
+    "BEGIN_TRANSACTION",
+    "APPROVE_TRANSACTION",
+    "DENY_TRANSACTION",
+    "COMMIT_TRANSACTION",
+    "ROLLBACK_TRANSACTION",
+    "RECONNECT",
+};
+
+static const size_t BINARY_HASH_SIZE = 20;
+
+static void appendBinaryInteger(string& buffer, uint64_t value, size_t bytes) {
+    for (size_t i = bytes; i > 0; i--) {
+        buffer += (char)((value >> ((i - 1) * 8)) & 0xFF);
+    }
+}
+
+static void appendBinaryString(string& buffer, const string& value) {
+    appendBinaryInteger(buffer, value.size(), 8);
+    buffer += value;
+}
+
+// Reads `bytes` bytes as an integer from `buffer` at `offset`, advancing `offset`. Throws if we'd read past `end`.
+static uint64_t readBinaryInteger(const char* buffer, size_t& offset, size_t end, size_t bytes) {
+    if (offset + bytes > end) {
+        STHROW("truncated binary frame");
+    }
+    uint64_t value = 0;
+    for (size_t i = 0; i < bytes; i++) {
+        value = (value << 8) | (unsigned char)buffer[offset++];
+    }
+    return value;
+}
+
+static string readBinaryString(const char* buffer, size_t& offset, size_t end) {
+    uint64_t size = readBinaryInteger(buffer, offset, end, 8);
+    if (size > end - offset) {
+        STHROW("truncated binary frame");
+    }
+    string value(buffer + offset, size);
+    offset += size;
+    return value;
+}
+
 SQLitePeer::SQLitePeer(const string& name_, const string& host_, const STable& params_, uint64_t id_)
   : commitCount(0),
     host(host_),
@@ -28,6 +94,8 @@ SQLitePeer::SQLitePeer(const string& name_, const string& host_, const STable& p
     transactionResponse(Response::NONE),
     version(),
     lastPingTime(0),
+    binaryProtocol(false),
+    compression(false),
     forked(false),
     hash()
 { }
@@ -81,6 +149,8 @@ void SQLitePeer::reset() {
     transactionResponse = Response::NONE;
     version = "";
     lastPingTime = 0,
+    binaryProtocol = false;
+    compression = false;
     setCommit(0, "");
     forked = false;
 }
@@ -181,15 +251,167 @@ SData SQLitePeer::popMessage() {
     lock_guard<decltype(peerMutex)> lock(peerMutex);
     if (socket) {
         SData message;
-        size_t size = message.deserialize(socket->recvBuffer);
+        size_t size = 0;
+        const SFastBuffer& buffer = socket->recvBuffer;
+        if (!buffer.empty() && (unsigned char)buffer.c_str()[0] == BINARY_FRAME_MARKER) {
+            try {
+                size = deserializeBinary(buffer.c_str(), buffer.size(), message);
+            } catch (const SException& e) {
+                // There's no way to find the start of the next message, so there's nothing to do but start over.
+                SWARN("Malformed binary message from peer " << name << " (" << e.what() << "), shutting down socket.");
+                socket->shutdown();
+                throw out_of_range("no messages");
+            }
+        } else {
+            // Most calls find a message that's still arriving, so don't copy anything until it's all here.
+            SDataView view;
+            size = view.parse(buffer);
+            if (size) {
+                message.deserialize(view);
+            }
+        }
         if (size) {
             socket->recvBuffer.consumeFront(size);
+            if (message.isSet("Content-Encoding") && message["Content-Encoding"] == "gzip") {
+                uint64_t start = STimeNow();
+                string content = SGUnzip(message.content);
+                decompressionTimeUS += STimeNow() - start;
+                if (content.empty()) {
+                    SWARN("Couldn't decompress " << message.methodLine << " from peer " << name << ", shutting down socket.");
+                    socket->shutdown();
+                    throw out_of_range("no messages");
+                }
+                message.content = move(content);
+                message.erase("Content-Encoding");
+            }
             return message;
         }
     }
     throw out_of_range("no messages");
 }
 
+SData SQLitePeer::compressMessage(const SData& message) {
+    SData result = message;
+    if (message.content.size() < MIN_COMPRESSION_SIZE || message.isSet("Content-Encoding")) {
+        return result;
+    }
+
+    // These are sent while holding up replication, so we favor speed over size.
+    uint64_t start = STimeNow();
+    string compressed = SGZip(message.content, 1);
+    compressionTimeUS += STimeNow() - start;
+    if (compressed.empty() || compressed.size() >= message.content.size()) {
+        return result;
+    }
+    compressionBytesIn += message.content.size();
+    compressionBytesOut += compressed.size();
+    result.content = move(compressed);
+    result["Content-Encoding"] = "gzip";
+    return result;
+}
+
+string SQLitePeer::serializeBinary(const SData& message) {
+    string body;
+
+    // Known method lines are sent as just their index.
+    auto typeIt = find(BINARY_MESSAGE_TYPES.begin() + 1, BINARY_MESSAGE_TYPES.end(), message.methodLine);
+    unsigned char type = typeIt == BINARY_MESSAGE_TYPES.end() ? 0 : (unsigned char)(typeIt - BINARY_MESSAGE_TYPES.begin());
+
+    // CommitCount and Hash are on every message, so they get fixed slots, as long as they're in the form we expect.
+    unsigned char flags = 0;
+    uint64_t commitCount = 0;
+    string hash(BINARY_HASH_SIZE, '\0');
+    auto countIt = message.nameValueMap.find("CommitCount");
+    if (countIt != message.nameValueMap.end() && !countIt->second.empty() && to_string(SToUInt64(countIt->second)) == countIt->second) {
+        flags |= 1;
+        commitCount = SToUInt64(countIt->second);
+    }
+    auto hashIt = message.nameValueMap.find("Hash");
+    if (hashIt != message.nameValueMap.end() && hashIt->second.size() == BINARY_HASH_SIZE * 2) {
+        string raw = SStrFromHex(hashIt->second);
+        if (raw.size() == BINARY_HASH_SIZE && SToHex(raw) == hashIt->second) {
+            flags |= 2;
+            hash = raw;
+        }
+    }
+
+    body += (char)type;
+    body += (char)flags;
+    appendBinaryInteger(body, commitCount, 8);
+    body += hash;
+    if (!type) {
+        appendBinaryString(body, message.methodLine);
+    }
+
+    // Everything else is sent as name/value pairs.
+    size_t headerCount = message.nameValueMap.size() - ((flags & 1) ? 1 : 0) - ((flags & 2) ? 1 : 0);
+    appendBinaryInteger(body, headerCount, 4);
+    for (const auto& header : message.nameValueMap) {
+        if (((flags & 1) && header.first == "CommitCount") || ((flags & 2) && header.first == "Hash")) {
+            continue;
+        }
+        appendBinaryString(body, header.first);
+        appendBinaryString(body, header.second);
+    }
+    appendBinaryString(body, message.content);
+
+    string frame;
+    frame.reserve(body.size() + 9);
+    frame += (char)BINARY_FRAME_MARKER;
+    appendBinaryInteger(frame, body.size(), 8);
+    frame += body;
+    return frame;
+}
+
+size_t SQLitePeer::deserializeBinary(const char* buffer, size_t length, SData& message) {
+    if (length < 9) {
+        return 0;
+    }
+    if ((unsigned char)buffer[0] != BINARY_FRAME_MARKER) {
+        STHROW("not a binary frame");
+    }
+    size_t offset = 1;
+    uint64_t bodySize = readBinaryInteger(buffer, offset, length, 8);
+    if (bodySize > length - offset) {
+        return 0;
+    }
+    const size_t end = offset + bodySize;
+
+    uint64_t type = readBinaryInteger(buffer, offset, end, 1);
+    uint64_t flags = readBinaryInteger(buffer, offset, end, 1);
+    uint64_t commitCount = readBinaryInteger(buffer, offset, end, 8);
+    if (offset + BINARY_HASH_SIZE > end) {
+        STHROW("truncated binary frame");
+    }
+    string hash(buffer + offset, BINARY_HASH_SIZE);
+    offset += BINARY_HASH_SIZE;
+
+    message = SData();
+    if (!type) {
+        message.methodLine = readBinaryString(buffer, offset, end);
+    } else if (type < BINARY_MESSAGE_TYPES.size()) {
+        message.methodLine = BINARY_MESSAGE_TYPES[type];
+    } else {
+        STHROW("unknown binary message type");
+    }
+    if (flags & 1) {
+        message["CommitCount"] = to_string(commitCount);
+    }
+    if (flags & 2) {
+        message["Hash"] = SToHex(hash);
+    }
+    uint64_t headerCount = readBinaryInteger(buffer, offset, end, 4);
+    for (uint64_t i = 0; i < headerCount; i++) {
+        string headerName = readBinaryString(buffer, offset, end);
+        message[headerName] = readBinaryString(buffer, offset, end);
+    }
+    message.content = readBinaryString(buffer, offset, end);
+    if (offset != end) {
+        STHROW("trailing data in binary frame");
+    }
+    return end;
+}
+
 bool SQLitePeer::setSocket(STCPManager::Socket* newSocket, bool onlyIfNull) {
     lock_guard<decltype(peerMutex)> lock(peerMutex);
     if (socket && onlyIfNull) {
@@ -248,6 +470,8 @@ STable SQLitePeer::getData() const {
         {"standupResponse", responseName(standupResponse)},
         {"transactionResponse", responseName(transactionResponse)},
         {"subscribed", (subscribed ? "true" : "false")},
+        {"binaryProtocol", (binaryProtocol ? "true" : "false")},
+        {"compression", (compression ? "true" : "false")},
     });
 
     // And anything from the params (note: doesn't overwrite our standard stuff).
@@ -268,11 +492,17 @@ bool SQLitePeer::isPermafollower(const STable& params) {
     return false;
 }
 
-void SQLitePeer::sendMessage(const SData& message) {
+void SQLitePeer::sendMessage(const SData& message, bool compressionTried) {
     lock_guard<decltype(peerMutex)> lock(peerMutex);
     if (socket && socket->state.load() < STCPManager::Socket::State::SHUTTINGDOWN) {
         size_t bytesSent = 0;
-        if (!socket->send(message.serialize(), &bytesSent)) {
+        SData compressed;
+        const SData* toSend = &message;
+        if (compression && !compressionTried && message.content.size() >= MIN_COMPRESSION_SIZE && !message.isSet("Content-Encoding")) {
+            compressed = compressMessage(message);
+            toSend = &compressed;
+        }
+        if (!socket->send(binaryProtocol ? serializeBinary(*toSend) : toSend->serialize(), &bytesSent)) {
             SHMMM("Error sending " << message.methodLine << " to peer " << name << ".");
         }
     } else {
@@ -21,6 +21,42 @@ class SQLitePeer {
     // Get a string name for a Response object.
     static string responseName(Response response);
 
+    // Peers that both advertise it at LOGIN switch to a binary framing for everything after LOGIN, which is cheaper to
+    // parse and smaller on the wire than the text protocol (particularly the `CommitCount` and `Hash` headers added
+    // to every message). A binary frame looks like this, with integers in network byte order:
+    //
+    // 1 byte:   BINARY_FRAME_MARKER, which can't start a text message.
+    // 8 bytes:  Length of the rest of the frame.
+    // 1 byte:   Message type, an index into the list of known method lines, or 0 if the method line is included.
+    // 1 byte:   Flags, indicating whether CommitCount and Hash are set.
+    // 8 bytes:  CommitCount.
+    // 20 bytes: Hash, as raw bytes.
+    // The method line (if the type is 0), the remaining headers, and the content, each length-prefixed.
+    //
+    // Receiving peers look at the first byte of each message to tell which framing it uses, so a peer that doesn't
+    // advertise the binary protocol just keeps getting text.
+    static const unsigned char BINARY_FRAME_MARKER;
+    static string serializeBinary(const SData& message);
+
+    // Deserializes a binary frame from `buffer` into `message`. Returns the number of bytes consumed, or 0 if there's
+    // not a complete frame yet. Throws if the frame is malformed.
+    static size_t deserializeBinary(const char* buffer, size_t length, SData& message);
+
+    // Peers that both advertise it at LOGIN gzip the content of large messages (mostly transactions and synchronized
+    // commits, which are repetitive SQL) sent to each other. Returns a copy of `message` with its content compressed
+    // and a `Content-Encoding: gzip` header, or an unchanged copy if compressing it wouldn't help.
+    static SData compressMessage(const SData& message);
+
+    // Messages with less content than this aren't worth compressing.
+    static const size_t MIN_COMPRESSION_SIZE;
+
+    // Totals across all peers, for status: the content size of messages before and after we compressed them, and how
+    // long we've spent compressing and decompressing.
+    static atomic<uint64_t> compressionBytesIn;
+    static atomic<uint64_t> compressionBytesOut;
+    static atomic<uint64_t> compressionTimeUS;
+    static atomic<uint64_t> decompressionTimeUS;
+
     // Atomically get commit and hash.
     void getCommit(uint64_t& count, string& hashString) const;
 
@@ -49,8 +85,9 @@ class SQLitePeer {
     // This is not done internally becuase we need to expose the outstanding data on the socket before deleting it.
     PeerPostPollStatus postPoll(fd_map& fdm, uint64_t& nextActivity);
 
-    // Send a message to this peer. Thread-safe.
-    void sendMessage(const SData& message);
+    // Send a message to this peer. Thread-safe. Large messages are compressed if we've agreed to that with the peer,
+    // unless `compressionTried` says the caller has already been through `compressMessage`.
+    void sendMessage(const SData& message, bool compressionTried = false);
 
     // Atomically set commit and hash.
     void setCommit(uint64_t count, const string& hashString);
@@ -92,6 +129,12 @@ class SQLitePeer {
     atomic<string> version;
     atomic<uint64_t> lastPingTime;
 
+    // True when we've agreed with this peer to send it binary frames instead of text messages.
+    atomic<bool> binaryProtocol;
+
+    // True when we've agreed with this peer to compress large messages we send it.
+    atomic<bool> compression;
+
     // Set to true when this peer is known to be unusable, I.e., when it has a database that is forked from us.
     atomic<bool> forked;
 
@@ -9,11 +9,30 @@ SQLitePool::SQLitePool(size_t maxDBs,
                        int minJournalTables,
                        int64_t mmapSizeGB,
                        bool hctree,
-                       const string& checkpointMode)
+                       const string& checkpointMode,
+                       size_t warmDBs,
+                       uint64_t idleTimeoutUS,
+                       int64_t cacheBudgetKB,
+                       bool ringJournal)
 : _maxDBs(max(maxDBs, 1ul)),
-  _baseDB(filename, cacheSize, maxJournalSize, minJournalTables, mmapSizeGB, hctree, checkpointMode),
-  _objects(_maxDBs, nullptr)
+  _baseDB(filename, cacheSize, maxJournalSize, minJournalTables, mmapSizeGB, hctree, checkpointMode, ringJournal),
+  _warmDBs(min(warmDBs, _maxDBs - 1)),
+  _idleTimeoutUS(idleTimeoutUS),
+  _cacheBudgetKB(cacheBudgetKB),
+  _cacheSizeKB(cacheSize),
+  _objects(_maxDBs, nullptr),
+  _lastReturned(_maxDBs, 0)
 {
+    // Open the warm handles now. Nobody else can see the pool yet, so we don't need to lock.
+    if (_warmDBs) {
+        uint64_t start = STimeNow();
+        for (size_t index = 0; index < _warmDBs; index++) {
+            initializeIndex(index);
+            _availableHandles.insert(index);
+        }
+        SINFO("Opened " << _warmDBs << " DB handles in " << (STimeNow() - start) / 1000 << "ms.");
+    }
+    _baseDB.setCacheSize(_targetCacheSizeKB());
 }
 
 SQLitePool::~SQLitePool() {
@@ -35,17 +54,100 @@ SQLite& SQLitePool::getBase() {
     return _baseDB;
 }
 
+int SQLitePool::_targetCacheSizeKB() const {
+    if (!_cacheBudgetKB) {
+        return _cacheSizeKB;
+    }
+
+    // Split the budget across every handle that's open (plus the base one), or that we expect to have open.
+    int64_t handles = max(_openDBs.load(), _warmDBs) + 1;
+    int64_t target = max(_cacheBudgetKB / handles, (int64_t)MIN_HANDLE_CACHE_KB);
+    if (_cacheSizeKB) {
+        target = min(target, (int64_t)_cacheSizeKB);
+    }
+    return (int)target;
+}
+
+list<SQLite*> SQLitePool::_collectIdleHandles(uint64_t now) {
+    list<SQLite*> idle;
+    if (!_idleTimeoutUS || now < _lastIdleCheck + 1'000'000) {
+        return idle;
+    }
+    _lastIdleCheck = now;
+    for (auto it = _availableHandles.begin(); it != _availableHandles.end();) {
+        size_t index = *it;
+
+        // Warm handles are always kept, as is anything that's been used recently.
+        if (index < _warmDBs || _lastReturned[index] + _idleTimeoutUS > now) {
+            it++;
+            continue;
+        }
+        // A slot handed out with `createHandle` false may never have had a handle opened in it.
+        if (_objects[index]) {
+            idle.push_back(_objects[index]);
+            _objects[index] = nullptr;
+            _openDBs--;
+        }
+        _closedHandles.insert(index);
+        it = _availableHandles.erase(it);
+    }
+    if (idle.size()) {
+        SINFO("Closing " << idle.size() << " idle DB handles, " << _openDBs << " remain open.");
+    }
+    return idle;
+}
+
+STable SQLitePool::getStats() {
+    lock_guard<mutex> lock(_sync);
+    STable stats = {
+        {"dbPoolOpenHandles", to_string(_openDBs + 1)},
+        {"dbPoolInUseHandles", to_string(_inUseHandles.size())},
+        {"dbPoolMaxHandles", to_string(_maxDBs)},
+        {"dbPoolHandleCacheSizeKB", to_string(_targetCacheSizeKB())},
+        {"dbPoolWaitCount", to_string(_waitCount)},
+        {"dbPoolTotalWaitUS", to_string(_totalWaitUS)},
+        {"dbPoolMaxWaitUS", to_string(_maxWaitUS)},
+    };
+    for (const auto& [name, value] : _baseDB.getCommitCacheStats()) {
+        stats[name] = value;
+    }
+    for (const auto& [name, value] : _baseDB.getReadCacheStats()) {
+        stats[name] = value;
+    }
+    return stats;
+}
+
 size_t SQLitePool::getIndex(bool createHandle) {
     while (true) {
         unique_lock<mutex> lock(_sync);
         if (_availableHandles.size()) {
-            // Return an existing handle.
-            auto frontIt = _availableHandles.begin();
-            size_t index = *frontIt;
+            // Return an existing handle. Taking the lowest index means the warm handles get used first, and handles
+            // opened for a spike are the ones left to go idle and be closed.
+            auto handleIt = _availableHandles.begin();
+            size_t index = *handleIt;
             _inUseHandles.insert(index);
-            _availableHandles.erase(frontIt);
+            _availableHandles.erase(handleIt);
+            lock.unlock();
+
+            // Nobody else can touch this handle now, so bring its cache in line with the budget if that's changed
+            // since it was last used.
+            if (_objects[index]) {
+                _objects[index]->setCacheSize(_targetCacheSizeKB());
+            }
             SDEBUG("Returning existing DB handle");
             return index;
+        } else if (_closedHandles.size()) {
+            // Reuse the slot of a handle we closed for being idle. It'll be reopened by `initializeIndex`.
+            auto frontIt = _closedHandles.begin();
+            size_t index = *frontIt;
+            _inUseHandles.insert(index);
+            _closedHandles.erase(frontIt);
+            lock.unlock();
+            if (createHandle) {
+                initializeIndex(index);
+            }
+            SINFO("Reopening DB handle: " << index);
+            return index;
         } else if (_availableHandles.size() + _inUseHandles.size() < (_maxDBs - 1)) {
             size_t index = _availableHandles.size() + _inUseHandles.size();
             _inUseHandles.insert(index);
@@ -61,7 +163,12 @@ size_t SQLitePool::getIndex(bool createHandle) {
         } else {
             // Wait for a handle.
             SWARN("Waiting for DB handle");
+            uint64_t waitStart = STimeNow();
             _wait.wait(lock);
+            uint64_t waited = STimeNow() - waitStart;
+            _waitCount++;
+            _totalWaitUS += waited;
+            _maxWaitUS = max(_maxWaitUS, waited);
         }
     }
 }
@@ -73,18 +180,29 @@ SQLite& SQLitePool::initializeIndex(size_t index) {
     // It's an error to run `initializeIndex` in two threads on the same index at the same time.
     if (_objects[index] == nullptr) {
         _objects[index] = new SQLite(_baseDB);
+        _openDBs++;
+        _objects[index]->setCacheSize(_targetCacheSizeKB());
     }
     return *_objects[index];
 }
 
 void SQLitePool::returnToPool(size_t index) {
+    list<SQLite*> idle;
     {
         lock_guard<mutex> lock(_sync);
+        uint64_t now = STimeNow();
+        _lastReturned[index] = now;
         _availableHandles.insert(index);
         _inUseHandles.erase(index);
         SDEBUG("DB handle returned to pool.");
+        idle = _collectIdleHandles(now);
     }
     _wait.notify_one();
+
+    // Closing a handle can take a while, so we don't do it while holding the lock.
+    for (SQLite* db : idle) {
+        delete db;
+    }
 }
 
 SQLiteScopedHandle::SQLiteScopedHandle(SQLitePool& pool, size_t index) : _pool(pool), _index(index), _released(false)
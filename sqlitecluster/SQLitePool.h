@@ -6,8 +6,14 @@
 class SQLitePool {
   public:
     // Create a pool of DB handles.
+    // `warmDBs` handles are opened up front, so that the first burst of commands doesn't pay to open them, and are
+    // never closed for being idle. Other handles that sit unused in the pool for `idleTimeoutUS` are closed (0 keeps
+    // them forever). If `cacheBudgetKB` is set, the page cache of each handle is scaled down as handles are opened so
+    // that together they stay within it, rather than each one getting the full `cacheSize`. `ringJournal` is passed to
+    // the base handle (see `SQLite::SQLite`).
     SQLitePool(size_t maxDBs, const string& filename, int cacheSize, int maxJournalSize, int minJournalTables,
-               int64_t mmapSizeGB = 0, bool hctree = false, const string& checkpointMode = "PASSIVE");
+               int64_t mmapSizeGB = 0, bool hctree = false, const string& checkpointMode = "PASSIVE",
+               size_t warmDBs = 0, uint64_t idleTimeoutUS = 0, int64_t cacheBudgetKB = 0, bool ringJournal = false);
     ~SQLitePool();
 
     // Get the base object (the first one created, which uses the `journal` table). Note that if called by multiple
@@ -28,7 +34,21 @@ class SQLitePool {
     // Return an object to the pool.
     void returnToPool(size_t index);
 
+    // Returns counts of open and in-use handles, and how long callers have waited for one, for `Status`.
+    STable getStats();
+
   private:
+    // The smallest page cache we'll give any handle when scaling to the cache budget, in KB. This matches the sqlite
+    // default.
+    static const int MIN_HANDLE_CACHE_KB = 2000;
+
+    // Returns the cache size each handle should currently have, given how many handles are open.
+    int _targetCacheSizeKB() const;
+
+    // Closes handles that have been sitting in the pool for longer than the idle timeout. Called with `_sync` locked,
+    // and returns the handles to delete, which the caller should do after unlocking.
+    list<SQLite*> _collectIdleHandles(uint64_t now);
+
     // Synchronization variables.
     mutex _sync;
     condition_variable _wait;
@@ -40,12 +60,32 @@ class SQLitePool {
     // Our base object that all others are based upon.
     SQLite _baseDB;
 
-    // These are indexes into `_objects`.
+    // Configuration for pre-warming, idle shrinking, and the cache budget. See the constructor.
+    const size_t _warmDBs;
+    const uint64_t _idleTimeoutUS;
+    const int64_t _cacheBudgetKB;
+    const int _cacheSizeKB;
+
+    // These are indexes into `_objects`. Closed handles are ones that were opened and later closed for being idle;
+    // their index is reused (and the handle reopened) before we allocate new ones.
     set<size_t> _availableHandles;
     set<size_t> _inUseHandles;
+    set<size_t> _closedHandles;
 
     // This is a vector of pointers to all possibly allocated objects.
     vector<SQLite*> _objects;
+
+    // When each handle was last returned to the pool, for finding idle ones.
+    vector<uint64_t> _lastReturned;
+    uint64_t _lastIdleCheck = 0;
+
+    // Number of non-null entries in `_objects`, not counting `_baseDB`.
+    atomic<size_t> _openDBs = 0;
+
+    // Statistics about callers having to wait for a handle. Protected by `_sync`.
+    uint64_t _waitCount = 0;
+    uint64_t _totalWaitUS = 0;
+    uint64_t _maxWaitUS = 0;
 };
 
 class SQLiteScopedHandle {
@@ -0,0 +1,40 @@
+#include <libstuff/libstuff.h>
+#include "SQLiteSequentialNotifier.h"
+
+SQLiteSequentialNotifier::RESULT SQLiteSequentialNotifier::waitFor(uint64_t value) {
+    unique_lock<mutex> lock(_m);
+    while (true) {
+        if (_value >= value) {
+            return RESULT::COMPLETED;
+        }
+        if (_canceled) {
+            return RESULT::CANCELED;
+        }
+        _cv.wait(lock);
+    }
+}
+
+uint64_t SQLiteSequentialNotifier::getValue() {
+    lock_guard<mutex> lock(_m);
+    return _value;
+}
+
+void SQLiteSequentialNotifier::notifyThrough(uint64_t value) {
+    lock_guard<mutex> lock(_m);
+    if (value > _value) {
+        _value = value;
+        _cv.notify_all();
+    }
+}
+
+void SQLiteSequentialNotifier::cancel() {
+    lock_guard<mutex> lock(_m);
+    _canceled = true;
+    _cv.notify_all();
+}
+
+void SQLiteSequentialNotifier::reset(uint64_t value) {
+    lock_guard<mutex> lock(_m);
+    _canceled = false;
+    _value = value;
+}
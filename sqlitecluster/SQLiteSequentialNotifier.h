@@ -0,0 +1,41 @@
+#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+
+using namespace std;
+
+// Lets threads wait for a monotonically increasing value (i.e., a commit count) to reach some point. This is what lets
+// replication threads apply transactions in parallel but commit them in the same order as leader: each one waits for
+// the commit count just before its own before committing.
+class SQLiteSequentialNotifier {
+  public:
+    enum class RESULT {
+        UNKNOWN,
+        COMPLETED,
+        CANCELED,
+    };
+
+    // Blocks until the value is at least `value`, or `cancel` is called, whichever comes first. If the value has
+    // already been reached, this returns COMPLETED even if we've been canceled.
+    RESULT waitFor(uint64_t value);
+
+    // Returns the current value.
+    uint64_t getValue();
+
+    // Sets the value to `value` (if it's higher than the current value) and wakes up anything waiting for it.
+    void notifyThrough(uint64_t value);
+
+    // Wakes up everything currently waiting with CANCELED, and makes any future `waitFor` calls for values not yet
+    // reached return CANCELED immediately, until `reset` is called.
+    void cancel();
+
+    // Clears the canceled state and sets the current value.
+    void reset(uint64_t value);
+
+  private:
+    mutex _m;
+    condition_variable _cv;
+    uint64_t _value = 0;
+    bool _canceled = false;
+};
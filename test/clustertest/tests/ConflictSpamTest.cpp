@@ -291,6 +291,11 @@ struct ConflictSpamTest : tpunit::TestFixture {
             cout << "[ConflictSpamTest] Total failures: " << fail << endl;
         }
         ASSERT_EQUAL(fail, 0);
+
+        // Leader should be reporting conflicts for the command we spammed, whether or not any actually happened.
+        string report = tester->getTester(0).executeWaitVerifyContent(SData("ConflictReport"), "200 OK", true);
+        ASSERT_TRUE(SContains(report, "Command: idcollision"));
+        ASSERT_TRUE(SContains(report, "Conflicts: "));
     }
 
 } __ConflictSpamTest;
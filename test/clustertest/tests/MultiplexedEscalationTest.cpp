@@ -0,0 +1,60 @@
+#include <libstuff/SData.h>
+#include <test/clustertest/BedrockClusterTester.h>
+
+struct MultiplexedEscalationTest : tpunit::TestFixture {
+    MultiplexedEscalationTest()
+        : tpunit::TestFixture("MultiplexedEscalation",
+                              BEFORE_CLASS(MultiplexedEscalationTest::setup),
+                              AFTER_CLASS(MultiplexedEscalationTest::teardown),
+                              TEST(MultiplexedEscalationTest::test)) { }
+
+    BedrockClusterTester* tester;
+
+    void setup() {
+        tester = new BedrockClusterTester(ClusterSize::THREE_NODE_CLUSTER,
+                                          {"CREATE TABLE test (id INTEGER NOT NULL PRIMARY KEY, value TEXT NOT NULL)"},
+                                          {{"-escalationConnections", "2"}});
+    }
+
+    void teardown() {
+        delete tester;
+    }
+
+    void test() {
+        // Lots of writes to a follower at once, so that many escalations are in flight on each connection.
+        const int commandCount = 200;
+        vector<SData> requests;
+        for (int i = 0; i < commandCount; i++) {
+            SData query("Query");
+            query["query"] = "INSERT INTO test VALUES(" + SQ(i) + ", " + SQ("value" + to_string(i)) + ");";
+            requests.push_back(query);
+        }
+        auto results = tester->getTester(1).executeWaitMultipleData(requests, 40);
+
+        // Each client got the response to its own command, and every write made it to leader.
+        for (auto& result : results) {
+            ASSERT_EQUAL(result.methodLine, "200 OK");
+        }
+        SData query("Query");
+        query["query"] = "SELECT COUNT(*) FROM test;";
+        query["format"] = "json";
+        STable response = SParseJSONObject(tester->getTester(0).executeWaitVerifyContent(query));
+        ASSERT_EQUAL(SParseJSONArray(SParseJSONArray(response["rows"]).front()).front(), to_string(commandCount));
+
+        // They all went over the pipelined connections.
+        STable status = SParseJSONObject(tester->getTester(1).executeWaitVerifyContent(SData("Status")));
+        ASSERT_GREATER_THAN(SToUInt64(status["escalationCount"]), commandCount - 1);
+        ASSERT_EQUAL(status["escalationFailures"], "0");
+        ASSERT_EQUAL(status["escalationMultiplexedConnections"], "2");
+        ASSERT_GREATER_THAN(SToUInt64(status["escalationAverageUS"]), 0);
+
+        // Clients on the public command port can't multiplex, their requests are handled like any other.
+        SData multiplexed("Query");
+        multiplexed["query"] = "SELECT 1;";
+        multiplexed["MultiplexID"] = "1";
+        auto publicResults = tester->getTester(0).executeWaitMultipleData({multiplexed}, 1);
+        ASSERT_EQUAL(publicResults.front().methodLine, "200 OK");
+        ASSERT_FALSE(publicResults.front().isSet("MultiplexID"));
+    }
+
+} __MultiplexedEscalationTest;
@@ -0,0 +1,65 @@
+#include <libstuff/SData.h>
+#include <test/clustertest/BedrockClusterTester.h>
+
+struct ParallelReplicationTest : tpunit::TestFixture {
+    ParallelReplicationTest()
+        : tpunit::TestFixture("ParallelReplication",
+                              BEFORE_CLASS(ParallelReplicationTest::setup),
+                              AFTER_CLASS(ParallelReplicationTest::teardown),
+                              TEST(ParallelReplicationTest::test)) { }
+
+    BedrockClusterTester* tester;
+
+    void setup() {
+        tester = new BedrockClusterTester(ClusterSize::THREE_NODE_CLUSTER,
+                                          {"CREATE TABLE test (id INTEGER NOT NULL PRIMARY KEY, value TEXT NOT NULL)"},
+                                          {{"-replicationThreads", "4"}});
+    }
+
+    void teardown() {
+        delete tester;
+    }
+
+    void test() {
+        // Write from lots of connections at once, so that leader commits in parallel and followers get transactions
+        // that overlap.
+        const int commandCount = 500;
+        vector<SData> requests;
+        for (int i = 0; i < commandCount; i++) {
+            SData query("Query");
+            query["writeConsistency"] = "ASYNC";
+            query["query"] = "INSERT INTO test VALUES(" + SQ(i) + ", " + SQ("value" + to_string(i)) + ");";
+            requests.push_back(query);
+        }
+        auto results = tester->getTester(0).executeWaitMultipleData(requests, 20);
+        for (auto& result : results) {
+            ASSERT_EQUAL(result.methodLine, "200 OK");
+        }
+
+        // Each follower should end up with exactly what leader has.
+        SData query("Query");
+        query["query"] = "SELECT id, value FROM test ORDER BY id;";
+        string leaderResult = tester->getTester(0).executeWaitVerifyContent(query);
+        for (int i : {1, 2}) {
+            string result;
+            for (int tries = 0; tries < 50; tries++) {
+                result = tester->getTester(i).executeWaitVerifyContent(query);
+                if (result == leaderResult) {
+                    break;
+                }
+                usleep(100'000);
+            }
+            ASSERT_EQUAL(result, leaderResult);
+
+            // And report that it's caught up, having applied everything.
+            STable status = SParseJSONObject(tester->getTester(i).executeWaitVerifyContent(SData("Status")));
+            ASSERT_EQUAL(status["replicationCommitsBehind"], "0");
+            uint64_t applied = 0;
+            for (auto& count : SParseJSONArray(status["replicationApplyLatencyCounts"])) {
+                applied += SToUInt64(count);
+            }
+            ASSERT_GREATER_THAN_EQUAL(applied, (uint64_t)commandCount);
+        }
+    }
+
+} __ParallelReplicationTest;
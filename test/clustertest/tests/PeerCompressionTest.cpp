@@ -0,0 +1,63 @@
+#include <libstuff/SData.h>
+#include <test/clustertest/BedrockClusterTester.h>
+
+struct PeerCompressionTest : tpunit::TestFixture {
+    PeerCompressionTest()
+        : tpunit::TestFixture("PeerCompression",
+                              BEFORE_CLASS(PeerCompressionTest::setup),
+                              AFTER_CLASS(PeerCompressionTest::teardown),
+                              TEST(PeerCompressionTest::test)) { }
+
+    BedrockClusterTester* tester;
+
+    void setup() {
+        tester = new BedrockClusterTester(ClusterSize::THREE_NODE_CLUSTER,
+                                          {"CREATE TABLE test (id INTEGER NOT NULL PRIMARY KEY, value TEXT NOT NULL)"},
+                                          {{"-peerCompression", ""}, {"-binaryPeerProtocol", ""}});
+    }
+
+    void teardown() {
+        delete tester;
+    }
+
+    void test() {
+        // Transactions big enough to be worth compressing.
+        for (int i = 0; i < 20; i++) {
+            string query;
+            for (int j = 0; j < 50; j++) {
+                int id = i * 50 + j;
+                query += "INSERT INTO test VALUES(" + SQ(id) + ", " + SQ("value" + to_string(id)) + ");";
+            }
+            SData request("Query");
+            request["query"] = query;
+            tester->getTester(0).executeWaitVerifyContent(request);
+        }
+
+        // Followers end up with exactly what leader has.
+        SData query("Query");
+        query["query"] = "SELECT id, value FROM test ORDER BY id;";
+        string leaderResult = tester->getTester(0).executeWaitVerifyContent(query);
+        for (int i : {1, 2}) {
+            string result;
+            for (int tries = 0; tries < 50; tries++) {
+                result = tester->getTester(i).executeWaitVerifyContent(query);
+                if (result == leaderResult) {
+                    break;
+                }
+                usleep(100'000);
+            }
+            ASSERT_EQUAL(result, leaderResult);
+        }
+
+        // Leader agreed to both with its peers, and compressed what it sent them.
+        STable status = SParseJSONObject(tester->getTester(0).executeWaitVerifyContent(SData("Status")));
+        for (auto& peer : SParseJSONArray(status["peerList"])) {
+            STable peerData = SParseJSONObject(peer);
+            ASSERT_EQUAL(peerData["binaryProtocol"], "true");
+            ASSERT_EQUAL(peerData["compression"], "true");
+        }
+        ASSERT_GREATER_THAN(SToUInt64(status["peerCompressionBytesIn"]), SToUInt64(status["peerCompressionBytesOut"]));
+        ASSERT_GREATER_THAN(SToUInt64(status["peerCompressionBytesOut"]), 0);
+    }
+
+} __PeerCompressionTest;
@@ -0,0 +1,77 @@
+#include <libstuff/SData.h>
+#include <sqlitecluster/SQLiteNode.h>
+#include <test/clustertest/BedrockClusterTester.h>
+
+struct QuorumGroupCommitTest : tpunit::TestFixture {
+    QuorumGroupCommitTest()
+        : tpunit::TestFixture("QuorumGroupCommit",
+                              TEST(QuorumGroupCommitTest::test)) { }
+
+    static constexpr uint64_t commandCount = 400;
+
+    // Returns leader's commit count.
+    uint64_t getCommitCount(BedrockClusterTester& tester) {
+        SData status("Status");
+        STable json = SParseJSONObject(tester.getTester(0).executeWaitVerifyContent(status));
+        return SToUInt64(json["CommitCount"]);
+    }
+
+    // Sends a burst of `commandCount` QUORUM writes to leader and sets `commits` to how many commits they took.
+    void runBurst(BedrockClusterTester& tester, uint64_t& commits) {
+        vector<SData> requests;
+        for (uint64_t i = 0; i < commandCount; i++) {
+            SData query("Query");
+            query["writeConsistency"] = to_string(SQLiteNode::QUORUM);
+            query["query"] = "INSERT INTO test VALUES(" + SQ(i) + ", " + SQ("value" + to_string(i)) + ");";
+            requests.push_back(query);
+        }
+
+        const uint64_t startCommitCount = getCommitCount(tester);
+        auto results = tester.getTester(0).executeWaitMultipleData(requests, 20);
+
+        // Every command gets its own response, regardless of which commit it shared.
+        for (auto& result : results) {
+            ASSERT_EQUAL(result.methodLine, "200 OK");
+        }
+
+        // And every write made it to the followers.
+        for (int i : {1, 2}) {
+            string count;
+            for (int tries = 0; tries < 50; tries++) {
+                SData query("Query");
+                query["query"] = "SELECT COUNT(*) FROM test;";
+                query["format"] = "json";
+                STable response = SParseJSONObject(tester.getTester(i).executeWaitVerifyContent(query));
+                count = SParseJSONArray(SParseJSONArray(response["rows"]).front()).front();
+                if (count == to_string(commandCount)) {
+                    break;
+                }
+                usleep(100'000);
+            }
+            ASSERT_EQUAL(count, to_string(commandCount));
+        }
+
+        commits = getCommitCount(tester) - startCommitCount;
+    }
+
+    void test() {
+        const list<string> queries = {"CREATE TABLE test (id INTEGER NOT NULL PRIMARY KEY, value TEXT NOT NULL)"};
+
+        // Without grouping, every command is its own commit.
+        {
+            BedrockClusterTester tester(ClusterSize::THREE_NODE_CLUSTER, queries);
+            uint64_t commits = 0;
+            runBurst(tester, commits);
+            ASSERT_EQUAL(commits, commandCount);
+        }
+
+        // With it, commands that queue up behind a commit waiting for quorum share the next one.
+        {
+            BedrockClusterTester tester(ClusterSize::THREE_NODE_CLUSTER, queries, {{"-quorumGroupCommitSize", "20"}});
+            uint64_t commits = 0;
+            runBurst(tester, commits);
+            ASSERT_LESS_THAN(commits, commandCount);
+        }
+    }
+
+} __QuorumGroupCommitTest;
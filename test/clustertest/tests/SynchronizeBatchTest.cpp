@@ -0,0 +1,63 @@
+#include <libstuff/SData.h>
+#include <test/clustertest/BedrockClusterTester.h>
+
+struct SynchronizeBatchTest : tpunit::TestFixture {
+    SynchronizeBatchTest()
+        : tpunit::TestFixture("SynchronizeBatch",
+                              BEFORE_CLASS(SynchronizeBatchTest::setup),
+                              AFTER_CLASS(SynchronizeBatchTest::teardown),
+                              TEST(SynchronizeBatchTest::test)) { }
+
+    BedrockClusterTester* tester;
+
+    void setup() {
+        // A batch size that doesn't divide the number of commits evenly, so the last batch is a partial one.
+        tester = new BedrockClusterTester(ClusterSize::THREE_NODE_CLUSTER,
+                                          {"CREATE TABLE test (id INTEGER NOT NULL PRIMARY KEY, value TEXT NOT NULL)"},
+                                          {{"-synchronizeBatchSize", "333"}});
+    }
+
+    void teardown() {
+        delete tester;
+    }
+
+    void test() {
+        BedrockTester& leader = tester->getTester(0);
+        BedrockTester& follower = tester->getTester(2);
+
+        // Take a follower down and commit a bunch of stuff without it.
+        tester->stopNode(2);
+        const int commandCount = 2000;
+        vector<SData> requests;
+        for (int i = 0; i < commandCount; i++) {
+            SData query("Query");
+            query["writeConsistency"] = "ASYNC";
+            query["query"] = "INSERT INTO test VALUES(" + SQ(i) + ", " + SQ("value" + to_string(i)) + ");";
+            requests.push_back(query);
+        }
+        for (auto& result : leader.executeWaitMultipleData(requests, 10)) {
+            ASSERT_EQUAL(result.methodLine, "200 OK");
+        }
+
+        // When it comes back, it needs to synchronize all of that in batches, and end up identical to leader.
+        tester->startNode(2);
+        ASSERT_TRUE(follower.waitForState("FOLLOWING"));
+
+        SData status("Status");
+        string leaderCommitCount = SParseJSONObject(leader.executeWaitVerifyContent(status))["commitCount"];
+        string followerCommitCount;
+        for (int tries = 0; tries < 50; tries++) {
+            followerCommitCount = SParseJSONObject(follower.executeWaitVerifyContent(status))["commitCount"];
+            if (followerCommitCount == leaderCommitCount) {
+                break;
+            }
+            usleep(100'000);
+        }
+        ASSERT_EQUAL(followerCommitCount, leaderCommitCount);
+
+        SData query("Query");
+        query["query"] = "SELECT id, value FROM test ORDER BY id;";
+        ASSERT_EQUAL(follower.executeWaitVerifyContent(query), leader.executeWaitVerifyContent(query));
+    }
+
+} __SynchronizeBatchTest;
@@ -0,0 +1,30 @@
+#include <unistd.h>
+
+#include <libstuff/libstuff.h>
+#include "SQLiteTestHelper.h"
+
+string SQLiteTestHelper::createTempDB(const string& prefix) {
+    string filename = prefix + "XXXXXX";
+    int fd = mkstemp(filename.data());
+    SASSERT(fd != -1);
+    close(fd);
+    return filename;
+}
+
+void SQLiteTestHelper::removeDB(const string& filename) {
+    for (const char* suffix : {"", "-wal", "-shm", "-wal2"}) {
+        unlink((filename + suffix).c_str());
+    }
+}
+
+void SQLiteTestHelper::commit(SQLite& db, const string& query) {
+    if (!db.beginTransaction(SQLite::TRANSACTION_TYPE::EXCLUSIVE) || !db.write(query) || !db.prepare()) {
+        db.rollback();
+        STHROW("Failed to write '" + query + "'");
+    }
+    int result = db.commit();
+    if (result != SQLITE_OK) {
+        db.rollback();
+        STHROW("Committing '" + query + "' returned " + to_string(result));
+    }
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <libstuff/libstuff.h>
+#include <sqlitecluster/SQLite.h>
+
+// Setup shared by the tests that run against a real database file.
+class SQLiteTestHelper {
+public:
+    // Creates an empty database file in the working directory, named `prefix` followed by six random characters, and
+    // returns its name.
+    static string createTempDB(const string& prefix);
+
+    // Deletes the database at `filename`, along with the `-wal`, `-shm` and `-wal2` files sqlite keeps next to it.
+    static void removeDB(const string& filename);
+
+    // Writes `query` to `db` in a transaction of its own and commits it. Throws, failing the current test, if any step
+    // fails.
+    static void commit(SQLite& db, const string& query);
+};
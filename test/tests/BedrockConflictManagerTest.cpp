@@ -0,0 +1,51 @@
+#include <BedrockConflictManager.h>
+#include <libstuff/SData.h>
+#include <test/lib/tpunit++.hpp>
+
+struct BedrockConflictManagerTest : tpunit::TestFixture {
+    BedrockConflictManagerTest()
+        : tpunit::TestFixture("BedrockConflictManager",
+                              TEST(BedrockConflictManagerTest::parkingTest)) { }
+
+    unique_ptr<BedrockCommand> makeCommand(const string& methodLine) {
+        return make_unique<BedrockCommand>(SQLiteCommand(SData(methodLine)), nullptr);
+    }
+
+    void parkingTest() {
+        BedrockConflictManager manager;
+        BedrockCommandQueue queue;
+
+        // With nobody working on the page, there's nothing to wait for, so the command isn't taken.
+        unique_ptr<BedrockCommand> command = makeCommand("conflicter");
+        ASSERT_FALSE(manager.parkOnPage(5, command));
+        ASSERT_TRUE(command);
+        ASSERT_FALSE(manager.parkOnPage(0, command));
+        ASSERT_TRUE(command);
+
+        {
+            BedrockConflictManager::PageWork outerWork(manager, 5, queue);
+            {
+                BedrockConflictManager::PageWork innerWork(manager, 5, queue);
+
+                // While the page is being worked on, a command conflicting on it is parked rather than retried.
+                ASSERT_TRUE(manager.parkOnPage(5, command));
+                ASSERT_FALSE(command);
+                command = makeCommand("conflicter");
+                ASSERT_TRUE(manager.parkOnPage(5, command));
+
+                // But one conflicting on some other page isn't.
+                command = makeCommand("other");
+                ASSERT_FALSE(manager.parkOnPage(6, command));
+            }
+
+            // They stay parked until the last command working on the page is done.
+            ASSERT_TRUE(queue.empty());
+        }
+
+        // And then they're queued to run again.
+        ASSERT_EQUAL(queue.size(), 2);
+        ASSERT_EQUAL(queue.get()->request.methodLine, "conflicter");
+        ASSERT_EQUAL(queue.get()->request.methodLine, "conflicter");
+        ASSERT_TRUE(SContains(manager.generateReport(), "Parked: 2"));
+    }
+} __BedrockConflictManagerTest;
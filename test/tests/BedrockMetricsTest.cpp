@@ -0,0 +1,86 @@
+#include <BedrockMetrics.h>
+#include <libstuff/SData.h>
+#include <test/lib/BedrockTester.h>
+
+struct BedrockMetricsTest : tpunit::TestFixture {
+    BedrockMetricsTest()
+        : tpunit::TestFixture("BedrockMetrics",
+                              TEST(BedrockMetricsTest::histogramTest),
+                              TEST(BedrockMetricsTest::reportTest),
+                              TEST(BedrockMetricsTest::serverTest)) { }
+
+    void histogramTest() {
+        // Every value lands in a bucket whose bounds are within 12.5% of it.
+        for (uint64_t value : {0ull, 1ull, 7ull, 8ull, 9ull, 100ull, 1'000ull, 123'456ull, 10'000'000ull}) {
+            size_t index = BedrockMetrics::Histogram::bucketIndex(value);
+            uint64_t upperBound = BedrockMetrics::Histogram::bucketUpperBound(index);
+            ASSERT_GREATER_THAN_EQUAL(upperBound, value);
+            ASSERT_LESS_THAN_EQUAL(upperBound - value, value / 8);
+        }
+        ASSERT_EQUAL(BedrockMetrics::Histogram::bucketIndex(UINT64_MAX), BedrockMetrics::Histogram::BUCKET_COUNT - 1);
+
+        // 1 through 1000.
+        BedrockMetrics::Histogram histogram;
+        ASSERT_EQUAL(histogram.percentile(0.5), 0);
+        for (uint64_t i = 1; i <= 1000; i++) {
+            histogram.record(i);
+        }
+        ASSERT_EQUAL(histogram.count(), 1000);
+        ASSERT_EQUAL(histogram.sum(), 500'500);
+        ASSERT_EQUAL(histogram.max(), 1000);
+        for (auto [p, expected] : {pair<double, uint64_t>{0.5, 500}, {0.9, 900}, {0.99, 990}}) {
+            uint64_t value = histogram.percentile(p);
+            ASSERT_GREATER_THAN_EQUAL(value, expected);
+            ASSERT_LESS_THAN_EQUAL(value, expected + expected / 8);
+        }
+        ASSERT_EQUAL(histogram.percentile(1), 1000);
+    }
+
+    void reportTest() {
+        BedrockMetrics metrics;
+        array<uint64_t, BedrockMetrics::STAGE_COUNT> times{};
+        times[BedrockMetrics::PEEK] = 100;
+        times[BedrockMetrics::TOTAL] = 150;
+        metrics.record("Query", times);
+        metrics.record("Query", times);
+
+        // Stages with no time aren't reported.
+        STable report = SParseJSONObject(metrics.generateReport());
+        STable query = SParseJSONObject(report["Query"]);
+        ASSERT_EQUAL(query.size(), 2);
+        STable peek = SParseJSONObject(query["peek"]);
+        ASSERT_EQUAL(peek["count"], "2");
+        ASSERT_EQUAL(peek["max"], "100");
+
+        string text = metrics.generatePrometheusText();
+        ASSERT_TRUE(SContains(text, "bedrock_command_latency_microseconds{command=\"Query\",stage=\"peek\",quantile=\"0.99\"} 100\n"));
+        ASSERT_TRUE(SContains(text, "bedrock_command_latency_microseconds_count{command=\"Query\",stage=\"total\"} 2\n"));
+
+        // Names past the limit share a single entry.
+        for (size_t i = 0; i < BedrockMetrics::MAX_COMMAND_NAMES + 10; i++) {
+            metrics.record("Command" + to_string(i), times);
+        }
+        report = SParseJSONObject(metrics.generateReport());
+        ASSERT_EQUAL(report.size(), BedrockMetrics::MAX_COMMAND_NAMES + 1);
+        ASSERT_TRUE(report.find(BedrockMetrics::OTHER_COMMAND_NAME) != report.end());
+    }
+
+    void serverTest() {
+        BedrockTester tester;
+        for (int i = 0; i < 5; i++) {
+            SData query("Query");
+            query["query"] = "SELECT 1;";
+            tester.executeWaitVerifyContent(query);
+        }
+
+        SData report("LatencyReport");
+        STable commands = SParseJSONObject(tester.executeWaitMultipleData({report}, 1, true)[0].content);
+        STable total = SParseJSONObject(SParseJSONObject(commands["Query"])["total"]);
+        ASSERT_EQUAL(total["count"], "5");
+
+        SData metrics("GET /metrics HTTP/1.1");
+        SData response = tester.executeWaitMultipleData({metrics})[0];
+        ASSERT_EQUAL(response.methodLine, "HTTP/1.1 200 OK");
+        ASSERT_TRUE(SContains(response.content, "bedrock_command_latency_microseconds_count{command=\"Query\",stage=\"total\"} 5\n"));
+    }
+} __BedrockMetricsTest;
@@ -8,18 +8,32 @@
 struct ChainedHTTPTest : tpunit::TestFixture {
     ChainedHTTPTest()
         : tpunit::TestFixture("ChainedHTTP",
-                              TEST(ChainedHTTPTest::test))
+                              TEST(ChainedHTTPTest::test),
+                              TEST(ChainedHTTPTest::testReactor))
     { }
 
     void test() {
+        runChainedRequest({});
+    }
+
+    void testReactor() {
+        // Commands on the worker pool give up their thread while the shared reactor runs their requests, which
+        // should get the same responses with keep-alive on.
+        runChainedRequest({
+            {"-httpsReactorThreads", "2"},
+            {"-httpsKeepAliveTimeout", "10"},
+            {"-commandPortReactorThreads", "1"},
+        });
+    }
+
+    void runChainedRequest(map<string, string> args) {
         // Load the clustertest testplugin that implements our chained command.
         char cwd[1024];
         if (!getcwd(cwd, sizeof(cwd))) {
             STHROW("Couldn't get CWD");
         }
-        BedrockTester tester({
-            {"-plugins", string(cwd) + "/clustertest/testplugin/testplugin.so"},
-        });
+        args["-plugins"] = string(cwd) + "/clustertest/testplugin/testplugin.so";
+        BedrockTester tester(args);
 
         // Some of the biggest sites on the internet. These sites in particular were chosen by the fact that they
         // return 200s even with our super-simple request format.
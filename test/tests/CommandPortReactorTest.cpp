@@ -0,0 +1,45 @@
+#include <libstuff/SData.h>
+#include <test/lib/BedrockTester.h>
+
+struct CommandPortReactorTest : tpunit::TestFixture {
+    CommandPortReactorTest()
+        : tpunit::TestFixture("CommandPortReactor", TEST(CommandPortReactorTest::test)) { }
+
+    void test() {
+        BedrockTester tester({{"-commandPortReactorThreads", "2"}}, {"CREATE TABLE test (id INTEGER NOT NULL PRIMARY KEY, value TEXT NOT NULL)"});
+
+        // Send a bunch of writes over a handful of connections, so that each connection has several requests that
+        // must be answered in order.
+        vector<SData> requests;
+        for (int i = 0; i < 200; i++) {
+            SData query("Query");
+            query["query"] = "INSERT INTO test VALUES(" + SQ(i) + ", " + SQ("value" + to_string(i)) + ");";
+            requests.push_back(query);
+        }
+        auto results = tester.executeWaitMultipleData(requests, 5);
+        for (auto& result : results) {
+            ASSERT_EQUAL(result.methodLine, "200 OK");
+        }
+
+        // Reads come back in the order they were sent on the same connection.
+        requests.clear();
+        for (int i = 0; i < 50; i++) {
+            SData query("Query");
+            query["query"] = "SELECT value FROM test WHERE id = " + SQ(i) + ";";
+            query["format"] = "json";
+            requests.push_back(query);
+        }
+        results = tester.executeWaitMultipleData(requests, 1);
+        for (size_t i = 0; i < results.size(); i++) {
+            ASSERT_EQUAL(results[i].methodLine, "200 OK");
+            STable result = SParseJSONObject(results[i].content);
+            ASSERT_EQUAL(SParseJSONArray(SParseJSONArray(result["rows"]).front()).front(), "value" + to_string(i));
+        }
+
+        // Status shows the reactor connections.
+        SData status("Status");
+        STable response = SParseJSONObject(tester.executeWaitMultipleData({status})[0].content);
+        ASSERT_TRUE(response.find("commandPortReactorConnections") != response.end());
+    }
+
+} __CommandPortReactorTest;
@@ -1,5 +1,6 @@
 #include <libstuff/SFastBuffer.h>
 #include <libstuff/SData.h>
+#include <libstuff/SDataView.h>
 #include <test/lib/BedrockTester.h>
 
 struct FastHTTPParsing : tpunit::TestFixture {
@@ -9,7 +10,11 @@ struct FastHTTPParsing : tpunit::TestFixture {
                                     TEST(FastHTTPParsing::blank),
                                     TEST(FastHTTPParsing::noHeaders),
                                     TEST(FastHTTPParsing::splitSeparators),
-                                    TEST(FastHTTPParsing::reset))
+                                    TEST(FastHTTPParsing::reset),
+                                    TEST(FastHTTPParsing::view),
+                                    TEST(FastHTTPParsing::viewMatchesDeserialize),
+                                    TEST(FastHTTPParsing::viewIncomplete),
+                                    TEST(FastHTTPParsing::viewCopied))
     { }
 
     // We test both supported line ends everywhere.
@@ -96,4 +101,122 @@ struct FastHTTPParsing : tpunit::TestFixture {
             ASSERT_EQUAL(request["Content-length"], "1");
         }
     }
+
+    void view() {
+        for (const auto& end : lineEnds) {
+            string message = "GET / HTTP/1.1" + end +
+                             "Content-Length: 5" + end +
+                             "name : value  " + end +
+                             "Escaped: a\\nb" + end +
+                             "NAME: again" + end +
+                             end +
+                             "hello" + "GET";
+            SDataView view;
+            ASSERT_EQUAL(view.parse(message.c_str(), message.size()), message.size() - 3);
+            ASSERT_FALSE(view.empty());
+            ASSERT_TRUE(view.methodLine() == "GET / HTTP/1.1");
+            ASSERT_TRUE(view.content() == "hello");
+            ASSERT_EQUAL(view.headers().size(), 4);
+            ASSERT_TRUE(view.headers()[1].name == "name");
+            ASSERT_TRUE(view.headers()[1].value == "value");
+
+            // Lookups ignore case and find the last value, which is as it was sent.
+            ASSERT_TRUE(view["Name"] == "again");
+            ASSERT_TRUE(view["escaped"] == "a\\nb");
+            ASSERT_TRUE(view.isSet("content-length"));
+            ASSERT_FALSE(view.isSet("Missing"));
+            ASSERT_TRUE(view["Missing"].empty());
+
+            // The views point into the message itself.
+            ASSERT_TRUE(view.content().data() >= message.data() && view.content().data() < message.data() + message.size());
+
+            SData request;
+            ASSERT_EQUAL(request.deserialize(view), (int)message.size() - 3);
+            ASSERT_EQUAL(request["name"], "again");
+            ASSERT_EQUAL(request["Escaped"], "a\nb");
+            ASSERT_EQUAL(request.content, "hello");
+        }
+    }
+
+    void viewMatchesDeserialize() {
+        // Everything SData can deserialize from a buffer comes out the same through a view.
+        list<string> messages;
+        for (const auto& end : lineEnds) {
+            messages.push_back("GET / HTTP/1.1" + end + "Content-Length: 0" + end + end);
+            messages.push_back("GET / HTTP/1.1" + end + end);
+            messages.push_back("POST /x HTTP/1.1" + end + "Content-Length: 3" + end + end + "abcdef");
+            messages.push_back("POST /x HTTP/1.1" + end + "Content-Length: 10" + end + end + "abc");
+            messages.push_back("POST /x HTTP/1.1" + end + "Host: a" + end + end + "everything else");
+            messages.push_back(end + end + "  Query  " + end + "query:  SELECT 1;" + end + "empty:" + end + "noColon" + end + end);
+            messages.push_back("Query" + end + "json: {\"a\":[1,2]}" + end + "list: [1]" + end + "Content-Length: 2" + end + end + "{}");
+            messages.push_back("200 OK" + end + "Set-Cookie: a=1" + end + "set-cookie: b\\t=2" + end + "Other: x\\ty" + end + end);
+            messages.push_back("GET / HTTP/1.1" + end + "Content-Length: 0" + end);
+            messages.push_back("GET / HTTP/1.1" + end + "Content-Length: 0");
+            messages.push_back("");
+        }
+        messages.push_back("GET / HTTP/1.1\n\r\n\rbody");
+        messages.push_back("GET / HTTP/1.1\r\rContent-Length: 1\r\r\rxy");
+
+        for (const string& message : messages) {
+            SData expected;
+            int expectedSize = expected.deserialize(message.c_str(), message.size());
+
+            SDataView view;
+            ASSERT_EQUAL((int)view.parse(message.c_str(), message.size()), expectedSize);
+            ASSERT_EQUAL(view.empty(), !expectedSize);
+            SData request("leftover");
+            ASSERT_EQUAL(request.deserialize(view), expectedSize);
+            ASSERT_EQUAL(request.serialize(), expected.serialize());
+            ASSERT_EQUAL(request.nameValueMap.size(), expected.nameValueMap.size());
+            for (const auto& [name, value] : expected.nameValueMap) {
+                ASSERT_EQUAL(request[name], value);
+                ASSERT_EQUAL(request[name].capacity() >= value.size() + 32, value.capacity() >= value.size() + 32);
+            }
+        }
+    }
+
+    void viewIncomplete() {
+        // A message arriving a byte at a time parses only once it's all there, and the same as SData would parse it.
+        string message = "POST /x HTTP/1.1\r\nContent-Length: 4\r\nA: b\r\n\r\nbody";
+        SFastBuffer buffer;
+        SDataView view;
+        for (size_t i = 0; i < message.size(); i++) {
+            buffer.append(&message[i], 1);
+            ASSERT_EQUAL(view.parse(buffer), i + 1 == message.size() ? message.size() : 0);
+            ASSERT_EQUAL(view.empty(), i + 1 != message.size());
+        }
+        ASSERT_TRUE(view.content() == "body");
+        ASSERT_TRUE(view["A"] == "b");
+
+        // Parsing again starts over.
+        ASSERT_EQUAL(view.parse("GET", 3), 0);
+        ASSERT_TRUE(view.empty());
+        ASSERT_TRUE(view.headers().empty());
+        ASSERT_TRUE(view.methodLine().empty());
+    }
+
+    void viewCopied() {
+        // Messages that can't be viewed in place are still parsed exactly as SData would parse them.
+        list<string> messages = {
+            "POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n3\r\nabc\r\n2\r\nde\r\n0\r\n\r\n",
+            "POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n3\r\nabc\r\n",
+            "GET / HTTP/1.1\r\nLong: first\r\n  second\r\n\r\n",
+            "GET / HTTP/1.1\r\nName: first\r\n: second\r\n\r\n",
+            "GET / HTTP/1.1\r\n\tcontinued\r\n\r\n",
+        };
+        for (const string& message : messages) {
+            SData expected;
+            int expectedSize = expected.deserialize(message.c_str(), message.size());
+
+            SDataView view;
+            ASSERT_EQUAL((int)view.parse(message.c_str(), message.size()), expectedSize);
+            SData request;
+            ASSERT_EQUAL(request.deserialize(view), expectedSize);
+            ASSERT_EQUAL(request.serialize(), expected.serialize());
+            if (expectedSize) {
+                ASSERT_TRUE(view.methodLine() == expected.methodLine);
+                ASSERT_TRUE(view.content() == expected.content);
+            }
+        }
+    }
 } __FastHTTPParsing;
@@ -1,4 +1,6 @@
 #include <cstring>
+#include <sys/socket.h>
+#include <sys/un.h>
 
 #include <libstuff/libstuff.h>
 #include <libstuff/SData.h>
@@ -10,6 +12,7 @@
 struct LibStuff : tpunit::TestFixture {
     LibStuff() : tpunit::TestFixture(true, "LibStuff",
                                     TEST(LibStuff::testEncryptDecrpyt),
+                                    TEST(LibStuff::testSHA1),
                                     TEST(LibStuff::testSHMACSHA1),
                                     TEST(LibStuff::testSHMACSHA256),
                                     TEST(LibStuff::testJSONDecode),
@@ -25,6 +28,8 @@ struct LibStuff : tpunit::TestFixture {
                                     TEST(LibStuff::testParseIntegerList),
                                     TEST(LibStuff::testSData),
                                     TEST(LibStuff::testSTable),
+                                    TEST(LibStuff::testSTableMatchesMap),
+                                    TEST(LibStuff::testSTableReferencesStable),
                                     TEST(LibStuff::testFileIO),
                                     TEST(LibStuff::testSQList),
                                     TEST(LibStuff::testRandom),
@@ -36,7 +41,10 @@ struct LibStuff : tpunit::TestFixture {
                                     TEST(LibStuff::SREReplaceTest),
                                     TEST(LibStuff::SQResultTest),
                                     TEST(LibStuff::testReturningClause),
-                                    TEST(LibStuff::SRedactSensitiveValuesTest)
+                                    TEST(LibStuff::testStatementCache),
+                                    TEST(LibStuff::testBoundQueries),
+                                    TEST(LibStuff::SRedactSensitiveValuesTest),
+                                    TEST(LibStuff::testAsyncLogging)
                                     )
     { }
 
@@ -50,6 +58,31 @@ struct LibStuff : tpunit::TestFixture {
         ASSERT_EQUAL(clearText, decrypted);
     }
 
+    void testSHA1() {
+        ASSERT_EQUAL(SToHex(SHashSHA1("abc")), "A9993E364706816ABA3E25717850C26C9CD0D89D");
+
+        // Lengths either side of where the padding spills into another block, and some that take many blocks.
+        const map<size_t, string> expected = {
+            {0, "DA39A3EE5E6B4B0D3255BFEF95601890AFD80709"},
+            {55, "A617D006D1CA12671785098A19A87FE58443BDE9"},
+            {56, "4AD5BB7AE3C4024768D364B77C52128EA3CFFEBE"},
+            {63, "FC8A5AB77259625085EAD3EC96515B3B8D933FAD"},
+            {64, "93249D4C2F8903EBF41AC358473148AE6DDD7042"},
+            {65, "CF2A63CC308225CF07B498D2309A01DD0DF52F67"},
+            {119, "EDD0F1133D0E4CA5F3E98BB7E0295F31D20D2CDB"},
+            {120, "23A58EEE587AA1F50D19A969AB36A3FE3E88C393"},
+            {1000, "0C1E754AD8A0130E18BF2D3B0A57E29AD95E75CD"},
+            {1 << 20, "DD89D1965604BD939EC68A6CA4552788F0EB1F88"},
+        };
+        for (const auto& [length, hash] : expected) {
+            string buffer;
+            for (size_t i = 0; i < length; i++) {
+                buffer += (char)('a' + i % 26);
+            }
+            ASSERT_EQUAL(SToHex(SHashSHA1(buffer)), hash);
+        }
+    }
+
     void testSHMACSHA1() {
         ASSERT_EQUAL(SToHex(SHMACSHA1("", "")), "FBDB1D1B18AA6C08324B7D64B71FB76370690E1D");
         ASSERT_EQUAL(SToHex(SHMACSHA1("key", "The quick brown fox jumps over the lazy dog")),
@@ -447,6 +480,94 @@ struct LibStuff : tpunit::TestFixture {
         ASSERT_EQUAL(test["k"], "false");
     }
 
+    void testSTableMatchesMap() {
+        // Names that differ only in case, in bytes past the first 8, by a trailing null, or by bytes above 0x7F.
+        const vector<string> names = {"a", "A", "b", "", "Content-Length", "content-length", "Content-Type",
+                                      "Content-", "Content-LengthX", string("a\0", 2), string("a\0b", 3), "\xff",
+                                      "\xc3\xa9", "zzzzzzzzzz", "ZZZZZZZZZy", "query", "Query"};
+
+        // Doing the same random things to an STable and to the map it replaced leaves them the same.
+        map<string, SString, STableComp> expected;
+        STable table;
+        for (int i = 0; i < 10000; i++) {
+            const string& name = names[SRandom::rand64() % names.size()];
+            const string value = to_string(i);
+            switch (SRandom::rand64() % 5) {
+                case 0:
+                    expected[name] = value;
+                    table[name] = value;
+                    break;
+                case 1:
+                    ASSERT_EQUAL(table.emplace(name, value).second, expected.emplace(name, value).second);
+                    break;
+                case 2:
+                    ASSERT_EQUAL(table.erase(name), expected.erase(name));
+                    break;
+                case 3:
+                    ASSERT_EQUAL(table.count(name), expected.count(name));
+                    if (expected.count(name)) {
+                        ASSERT_EQUAL(table.find(name)->second, expected.find(name)->second);
+                        ASSERT_EQUAL(table.at(name), expected.at(name));
+                    } else {
+                        ASSERT_TRUE(table.find(name) == table.end());
+                        ASSERT_THROW(table.at(name), out_of_range);
+                    }
+                    break;
+                case 4:
+                    ASSERT_EQUAL(table.lower_bound(name) - table.begin(), distance(expected.begin(), expected.lower_bound(name)));
+                    ASSERT_EQUAL(table.upper_bound(name) - table.begin(), distance(expected.begin(), expected.upper_bound(name)));
+                    break;
+            }
+            ASSERT_EQUAL(table.size(), expected.size());
+            ASSERT_TRUE(equal(table.begin(), table.end(), expected.begin(), expected.end(), [](const auto& a, const auto& b) {
+                return a.first == b.first && a.second == b.second;
+            }));
+        }
+
+        // Copies compare equal, and erasing through an iterator returns the next one.
+        STable copy = table;
+        ASSERT_TRUE(copy == table);
+        for (auto it = copy.begin(); it != copy.end();) {
+            it = it->first.size() % 2 ? copy.erase(it) : next(it);
+        }
+        for (const auto& [name, value] : copy) {
+            ASSERT_EQUAL(name.size() % 2, 0);
+            ASSERT_EQUAL(table[name], value);
+        }
+    }
+
+    void testSTableReferencesStable() {
+        // Callers hold references to values while adding other names, as `std::map` always allowed.
+        STable table;
+        table["requestID"] = "1";
+        table["value"] = "v";
+        const string& held = table["value"];
+        const string& heldName = table.find("value")->first;
+        for (int i = 0; i < 1000; i++) {
+            table["a" + to_string(i)] = to_string(i);
+        }
+        ASSERT_EQUAL(held, "v");
+        ASSERT_EQUAL(heldName, "value");
+
+        // Including when the names before it have been erased and their space re-used.
+        for (int i = 0; i < 1000; i += 2) {
+            table.erase("a" + to_string(i));
+        }
+        table.erase("requestID");
+        for (int i = 0; i < 1000; i++) {
+            table["b" + to_string(i)] = to_string(i);
+        }
+        ASSERT_EQUAL(held, "v");
+        ASSERT_EQUAL(table["a1"], "1");
+        ASSERT_EQUAL(table["b999"], "999");
+        ASSERT_EQUAL(table.size(), 1501);
+
+        // And when the table is moved.
+        STable moved = move(table);
+        ASSERT_EQUAL(held, "v");
+        ASSERT_EQUAL(&held, &moved["value"]);
+    }
+
     void testFileIO() {
         const string path = "./fileio.test";
         const string contents = "test";
@@ -808,6 +929,124 @@ struct LibStuff : tpunit::TestFixture {
         ASSERT_EQUAL(result[0]["value"], "value1");
     }
 
+    void testStatementCache() {
+        SQLite db(":memory:", 1000, 1000, 1);
+        db.beginTransaction(SQLite::TRANSACTION_TYPE::EXCLUSIVE);
+        db.write("CREATE TABLE testCache(id INTEGER PRIMARY KEY, name STRING);");
+        db.write("INSERT INTO testCache VALUES(1, 'name1');");
+        db.prepare();
+        db.commit();
+
+        // Running the same query twice in separate transactions should hit the cache the second time, and still
+        // record the tables used.
+        uint64_t hitsBefore = SQStatementCache::hits;
+        for (int i = 0; i < 2; i++) {
+            db.beginTransaction(SQLite::TRANSACTION_TYPE::SHARED);
+            SQResult result;
+            ASSERT_TRUE(db.read("SELECT * FROM testCache ORDER BY id;", result));
+            ASSERT_EQUAL(result.size(), 1);
+            ASSERT_EQUAL(result[0]["name"], "name1");
+            ASSERT_EQUAL(db.getTablesUsed(), set<string>{"testCache"});
+            db.rollback();
+        }
+        ASSERT_EQUAL(SQStatementCache::hits, hitsBefore + 1);
+
+        // Changing the schema should drop the cached statement, so `*` picks up the new column.
+        db.beginTransaction(SQLite::TRANSACTION_TYPE::EXCLUSIVE);
+        db.write("ALTER TABLE testCache ADD COLUMN value STRING;");
+        db.write("UPDATE testCache SET value = 'value1';");
+        db.prepare();
+        db.commit();
+        db.beginTransaction(SQLite::TRANSACTION_TYPE::SHARED);
+        SQResult result;
+        ASSERT_TRUE(db.read("SELECT * FROM testCache ORDER BY id;", result));
+        ASSERT_EQUAL(result[0]["value"], "value1");
+        db.rollback();
+
+        // Non-deterministic queries aren't cached.
+        hitsBefore = SQStatementCache::hits;
+        for (int i = 0; i < 2; i++) {
+            db.beginTransaction(SQLite::TRANSACTION_TYPE::SHARED);
+            db.read("SELECT random();");
+            db.rollback();
+        }
+        ASSERT_EQUAL(SQStatementCache::hits, hitsBefore);
+    }
+
+    void testBoundQueries() {
+        SQLite db(":memory:", 1000, 1000, 1);
+        db.beginTransaction(SQLite::TRANSACTION_TYPE::EXCLUSIVE);
+        db.write("CREATE TABLE testBound(id INTEGER PRIMARY KEY, name STRING, data BLOB, amount REAL, note STRING);");
+        db.prepare();
+        db.commit();
+
+        // Write some values that would need escaping, including a `?` inside a literal that must not be bound.
+        db.beginTransaction(SQLite::TRANSACTION_TYPE::SHARED);
+        ASSERT_TRUE(db.write("INSERT INTO testBound VALUES(?, ?, ?, ?, '?');",
+                             {1, SQValue("it's"), SQValue(SQValue::TYPE::BLOB, string("\x00\x01\xff", 3)), 0.1}));
+        db.prepare();
+        db.commit();
+
+        // The journaled version of the query has the values spelled out.
+        string query, hash;
+        ASSERT_TRUE(db.getCommit(db.getCommitCount(), query, hash));
+        ASSERT_EQUAL(query, "INSERT INTO testBound VALUES(1, 'it''s', X'0001FF', 0.10000000000000001, '?');");
+
+        // And we can read them back with bindings.
+        db.beginTransaction(SQLite::TRANSACTION_TYPE::SHARED);
+        SQResult result;
+        ASSERT_TRUE(db.read("SELECT name, length(data), amount, note FROM testBound WHERE id = ? AND name = ?;", {1, SQValue("it's")}, result));
+        ASSERT_EQUAL(result.size(), 1);
+        ASSERT_EQUAL(result[0][0], "it's");
+        ASSERT_EQUAL(result[0][1], "3");
+        ASSERT_EQUAL(result[0][2], "0.1");
+        ASSERT_EQUAL(result[0][3], "?");
+
+        // The wrong number of bindings is an error.
+        ASSERT_FALSE(db.read("SELECT name FROM testBound WHERE id = ?;", {1, 2}, result, true));
+        db.rollback();
+
+        // Text containing a null byte can't be written as a quoted literal, which would end at the null when the
+        // journaled query is parsed, so it's spelled out as bytes instead. Running the expanded query stores exactly
+        // what binding the value does.
+        const SQValue withNull(string("a\0b'c", 5));
+        const string expanded = SQExpandBindings("INSERT INTO testBound (id, name) VALUES(?, ?);", {2, withNull});
+        ASSERT_EQUAL(expanded, "INSERT INTO testBound (id, name) VALUES(2, CAST(X'6100622763' AS TEXT));");
+        db.beginTransaction(SQLite::TRANSACTION_TYPE::SHARED);
+        ASSERT_TRUE(db.write(expanded));
+        ASSERT_TRUE(db.write("INSERT INTO testBound (id, name) VALUES(?, ?);", {3, withNull}));
+        db.prepare();
+        db.commit();
+        db.beginTransaction(SQLite::TRANSACTION_TYPE::SHARED);
+        ASSERT_TRUE(db.read("SELECT typeof(name), hex(name) FROM testBound WHERE id IN (2, 3);", result));
+        db.rollback();
+        ASSERT_EQUAL(result.size(), 2);
+        for (size_t i = 0; i < result.size(); i++) {
+            ASSERT_EQUAL(result[i][0], "text");
+            ASSERT_EQUAL(result[i][1], "6100622763");
+        }
+
+        // A re-written query runs in place of the original, but one with bindings can't be, as the replacement has no
+        // way to use their values.
+        db.setRewriteHandler([](int actionCode, const char* table, string& newQuery) {
+            if (actionCode == SQLITE_INSERT && !strcmp(table, "testBound")) {
+                newQuery = "INSERT INTO testBound (id, name) VALUES(4, 'rewritten');";
+                return true;
+            }
+            return false;
+        });
+        db.enableRewrite(true);
+        db.beginTransaction(SQLite::TRANSACTION_TYPE::SHARED);
+        ASSERT_TRUE(db.write("INSERT INTO testBound (id, name) VALUES(5, 'original');"));
+        ASSERT_FALSE(db.write("INSERT INTO testBound (id, name) VALUES(?, ?);", {6, SQValue("original")}));
+        ASSERT_TRUE(db.read("SELECT id, name FROM testBound WHERE id > 3;", result));
+        db.rollback();
+        db.enableRewrite(false);
+        ASSERT_EQUAL(result.size(), 1);
+        ASSERT_EQUAL(result[0][0], "4");
+        ASSERT_EQUAL(result[0][1], "rewritten");
+    }
+
     void SRedactSensitiveValuesTest() {
         string logValue = R"({"edits":["test1", "test2", "test3"]})";
         SRedactSensitiveValues(logValue);
@@ -821,4 +1060,87 @@ struct LibStuff : tpunit::TestFixture {
         SRedactSensitiveValues(logValue);
         ASSERT_EQUAL(R"({"html":"<REDACTED>"})", logValue);
     }
+
+    void testAsyncLogging() {
+        // Listen where the async log thread will send to, and read everything it sends until it's stopped.
+        const string path = "/tmp/bedrockAsyncLogTest" + to_string(getpid()) + ".sock";
+        unlink(path.c_str());
+        int socketFD = socket(AF_UNIX, SOCK_DGRAM, 0);
+        struct sockaddr_un addr = {};
+        addr.sun_family = AF_UNIX;
+        strcpy(addr.sun_path, path.c_str());
+        ASSERT_EQUAL(::bind(socketFD, (struct sockaddr*)&addr, sizeof(addr)), 0);
+        atomic<bool> stopped(false);
+        mutex receivedMutex;
+        vector<string> received;
+        thread reader([&]() {
+            char buffer[10'000];
+            while (true) {
+                bool wasStopped = stopped;
+                ssize_t size = recv(socketFD, buffer, sizeof(buffer), MSG_DONTWAIT);
+                if (size > 0) {
+                    lock_guard<mutex> lock(receivedMutex);
+                    received.emplace_back(buffer, size);
+                } else if (wasStopped) {
+                    break;
+                } else {
+                    this_thread::sleep_for(chrono::milliseconds(1));
+                }
+            }
+        });
+
+        // Log from a few threads at once, with buffers small enough that some lines may be dropped.
+        const uint64_t droppedBefore = SLogAsyncDropped;
+        SLogAsyncStart(16 * 1024, path);
+        const int threadCount = 4;
+        const int linesPerThread = 2000;
+        vector<thread> threads;
+        for (int t = 0; t < threadCount; t++) {
+            threads.emplace_back([t]() {
+                for (int i = 0; i < linesPerThread; i++) {
+                    SSyslogAsync(LOG_INFO, "%s", ("thread " + to_string(t) + " line " + to_string(i)).c_str());
+                }
+            });
+        }
+        for (auto& t : threads) {
+            t.join();
+        }
+
+        // An error is sent right away, but not before what was buffered ahead of it.
+        SSyslogAsync(LOG_INFO, "%s", "before the error");
+        SSyslogAsync(LOG_ERR, "%s", "the error");
+        bool sawError = false;
+        for (int i = 0; i < 5000 && !sawError; i++) {
+            this_thread::sleep_for(chrono::milliseconds(1));
+            lock_guard<mutex> lock(receivedMutex);
+            auto errorLine = find_if(received.begin(), received.end(), [](const string& line) { return SStartsWith(line, "<11>"); });
+            if (errorLine != received.end()) {
+                sawError = true;
+                ASSERT_TRUE(SContains(*errorLine, "the error"));
+                ASSERT_TRUE(any_of(received.begin(), errorLine, [](const string& line) { return SContains(line, "before the error"); }));
+            }
+        }
+        ASSERT_TRUE(sawError);
+        SLogAsyncStop();
+        stopped = true;
+        reader.join();
+        close(socketFD);
+        unlink(path.c_str());
+
+        // Every line was either sent or counted as dropped, and each thread's lines arrived in order.
+        ASSERT_EQUAL(received.size() + (SLogAsyncDropped - droppedBefore), threadCount * linesPerThread + 2);
+        vector<int> lastLine(threadCount, -1);
+        for (const string& line : received) {
+            if (SContains(line, "the error")) {
+                continue;
+            }
+            ASSERT_TRUE(SStartsWith(line, "<14>"));
+            size_t threadOffset = line.find("thread ");
+            ASSERT_NOT_EQUAL(threadOffset, string::npos);
+            int t = stoi(line.substr(threadOffset + 7));
+            int i = stoi(line.substr(line.find("line ") + 5));
+            ASSERT_GREATER_THAN(i, lastLine[t]);
+            lastLine[t] = i;
+        }
+    }
 } __LibStuff;
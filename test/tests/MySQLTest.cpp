@@ -1,6 +1,8 @@
 #include <test/lib/tpunit++.hpp>
 #include <libstuff/libstuff.h>
+#include <libstuff/SQColumnarResult.h>
 #include <plugins/MySQL.h>
+#include <sqlitecluster/SQLite.h>
 
 using namespace std;
 
@@ -22,7 +24,9 @@ struct MySQLTest : tpunit::TestFixture {
                               TEST(MySQLTest::testInformationSchemaQueriesDetection),
                               TEST(MySQLTest::testShowKeysQueryDetection),
                               TEST(MySQLTest::testForeignKeyQueryDetection),
-                              TEST(MySQLTest::testComplexForeignKeyQueryDetection)) { }
+                              TEST(MySQLTest::testComplexForeignKeyQueryDetection),
+                              TEST(MySQLTest::testRowPackets),
+                              TEST(MySQLTest::testPreparedStatements)) { }
 
     void testVersionQueryResponse() {
         // Test that VERSION() queries are properly detected and handled
@@ -145,4 +149,102 @@ struct MySQLTest : tpunit::TestFixture {
         tableName = MySQLUtils::extractTableNameFromForeignKeyQuery(alternativeQuery);
         ASSERT_TRUE(tableName == "users");
     }
+
+    void testRowPackets() {
+        SQLite db(":memory:", 1000, 1000, 1);
+        db.beginTransaction(SQLite::TRANSACTION_TYPE::SHARED);
+        SQColumnarResult rows;
+        ASSERT_TRUE(db.read("SELECT 1 AS a, NULL AS b, 'text' AS c;", rows));
+        db.rollback();
+
+        // A result sent in pieces is numbered on from the request, and has its columns, the rows, and an EOF.
+        string output;
+        uint8_t sequenceID = 0;
+        MySQLPacket::appendColumns(output, sequenceID, rows.headers);
+        ASSERT_EQUAL(sequenceID, 5);
+        string columns = output;
+        MySQLPacket::appendRows(output, sequenceID, rows, false);
+        ASSERT_EQUAL(output.substr(columns.size()), string("\x08\0\0\x06" "\x01" "1" "\xFB" "\x04" "text", 12));
+        MySQLPacket::appendEOF(output, sequenceID);
+        ASSERT_EQUAL(sequenceID, 7);
+
+        // Which is the same as sending it all at once.
+        SQResult result = rows.toSQResult();
+        ASSERT_EQUAL(output.substr(0, columns.size()), MySQLPacket::serializeQueryResponse(0, result).substr(0, columns.size()));
+
+        // In the binary protocol, the row has a header and a bitmap of NULLs, offset by two bits.
+        output.clear();
+        sequenceID = 0;
+        MySQLPacket::appendRows(output, sequenceID, rows, true);
+        ASSERT_EQUAL(output, string("\x09\0\0\x01" "\0" "\x08" "\x01" "1" "\x04" "text", 13));
+
+        // A row too big for one packet is split into packets of the maximum size, and a shorter one to end it.
+        db.beginTransaction(SQLite::TRANSACTION_TYPE::SHARED);
+        SQColumnarResult bigRows;
+        ASSERT_TRUE(db.read("SELECT substr(hex(zeroblob(8388608)), 1, 16777215) AS a;", bigRows));
+        db.rollback();
+        output.clear();
+        sequenceID = 0;
+        MySQLPacket::appendRows(output, sequenceID, bigRows, false);
+        ASSERT_EQUAL(sequenceID, 2);
+        MySQLPacket packet;
+        int size = packet.deserialize(output.c_str(), output.size());
+        ASSERT_EQUAL(packet.sequenceID, 1);
+        ASSERT_EQUAL(packet.payload.size(), 0xFFFFFF);
+        ASSERT_EQUAL(packet.payload.substr(0, 5), "\xFD\xFF\xFF\xFF" "0");
+        ASSERT_EQUAL(packet.deserialize(output.c_str() + size, output.size() - size), 8);
+        ASSERT_EQUAL(packet.sequenceID, 2);
+        ASSERT_EQUAL(packet.payload, "0000");
+    }
+
+    void testPreparedStatements() {
+        ASSERT_EQUAL(SQCountBindings("SELECT * FROM t WHERE a = ? AND b = '?' AND c = ? -- ?\n;"), 2);
+
+        MySQLPreparedStatement statement;
+        statement.query = "SELECT ?, ?, ?, ?, ?;";
+        statement.paramCount = SQCountBindings(statement.query);
+        ASSERT_EQUAL(statement.paramCount, 5);
+
+        // COM_STMT_EXECUTE for statement 1, with the third parameter NULL, and types: signed LONGLONG, unsigned TINY,
+        // NULL, VAR_STRING, DOUBLE.
+        string payload("\x17\x01\0\0\0\0\x01\0\0\0" "\x04" "\x01"
+                       "\x08\0" "\x01\x80" "\x06\0" "\xfd\0" "\x05\0", 22);
+        int64_t integer = -5;
+        SAppend(payload, &integer, 8);
+        payload += "\xff";
+        payload += MySQLPacket::lenEncStr("it's");
+        double real = 2.5;
+        SAppend(payload, &real, 8);
+
+        vector<SQValue> params;
+        ASSERT_TRUE(MySQLPacket::deserializeExecute(payload, statement, params));
+        ASSERT_EQUAL(SQExpandBindings(statement.query, params), "SELECT -5, 255, NULL, 'it''s', 2.5;");
+
+        // Later executions can leave the types out, and send values beforehand as long data.
+        statement.longData[3] = "long";
+        payload = string("\x17\x01\0\0\0\0\x01\0\0\0" "\x1f" "\0", 12);
+        ASSERT_TRUE(MySQLPacket::deserializeExecute(payload, statement, params));
+        ASSERT_EQUAL(SQExpandBindings(statement.query, params), "SELECT NULL, NULL, NULL, 'long', NULL;");
+        ASSERT_TRUE(statement.longData.empty());
+
+        // A truncated packet is rejected.
+        payload = string("\x17\x01\0\0\0\0\x01\0\0\0" "\0" "\0", 12);
+        ASSERT_FALSE(MySQLPacket::deserializeExecute(payload, statement, params));
+
+        // And the response to COM_STMT_PREPARE describes each parameter.
+        string prepareOK = MySQLPacket::serializePrepareOK(0, 1, 5);
+        MySQLPacket packet;
+        int size = packet.deserialize(prepareOK.c_str(), prepareOK.size());
+        ASSERT_EQUAL(packet.sequenceID, 1);
+        ASSERT_EQUAL(packet.payload, string("\0\x01\0\0\0\0\0\x05\0\0\0\0", 12));
+        int packets = 1;
+        while (size_t(size) < prepareOK.size()) {
+            int next = packet.deserialize(prepareOK.c_str() + size, prepareOK.size() - size);
+            ASSERT_GREATER_THAN(next, 0);
+            size += next;
+            packets++;
+        }
+        ASSERT_EQUAL(packets, 7);
+        ASSERT_EQUAL(packet.sequenceID, 7);
+    }
 } __MySQLTest;
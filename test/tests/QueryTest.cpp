@@ -12,6 +12,7 @@ struct QueryTest : tpunit::TestFixture {
                               TEST(QueryTest::testWrite),
                               TEST(QueryTest::testWriteInSecondStatement),
                               TEST(QueryTest::testNoWhere),
+                              TEST(QueryTest::testStream),
                               AFTER_CLASS(QueryTest::tearDown)) { }
 
     BedrockTester* tester;
@@ -86,4 +87,27 @@ struct QueryTest : tpunit::TestFixture {
         query["query"] = "DELETE FROM queryTest;";
         tester->executeWaitVerifyContent(query, "502 Query aborted");
     }
+
+    void testStream() {
+        SData insert("Query");
+        insert["query"] = "INSERT INTO queryTest WITH RECURSIVE n(i) AS (SELECT 100 UNION ALL SELECT i + 1 FROM n WHERE i < 20099) "
+                          "SELECT i, 'streamed value ' || i FROM n;";
+        tester->executeWaitVerifyContent(insert);
+
+        // A streamed result should be exactly the same as one sent all at once, in each format that can be streamed.
+        for (const char* flags : {"-json", "-csv -header", "-tsv -noheader", "-quote", ""}) {
+            SData query("Query");
+            query["query"] = "SELECT key, value FROM queryTest ORDER BY key;";
+            query["ReadDBFlags"] = flags;
+            const string expected = tester->executeWaitVerifyContent(query);
+            query["Stream"] = "true";
+            ASSERT_EQUAL(tester->executeWaitVerifyContent(query), expected);
+        }
+
+        // Errors before anything has been sent are returned as normal.
+        SData query("Query");
+        query["query"] = "SELECT nonexistent FROM queryTest;";
+        query["Stream"] = "true";
+        tester->executeWaitVerifyContent(query, "402 Bad query");
+    }
 } __QueryTest;
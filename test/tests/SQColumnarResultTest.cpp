@@ -0,0 +1,141 @@
+#include <libstuff/libstuff.h>
+#include <libstuff/SQColumnarResult.h>
+#include <libstuff/SQResultFormatter.h>
+#include <sqlitecluster/SQLite.h>
+#include <test/lib/tpunit++.hpp>
+
+struct SQColumnarResultTest : tpunit::TestFixture {
+    SQColumnarResultTest()
+        : tpunit::TestFixture("SQColumnarResult",
+                              TEST(SQColumnarResultTest::testTypedAccessors),
+                              TEST(SQColumnarResultTest::testMatchesSQResult),
+                              TEST(SQColumnarResultTest::testStream)) { }
+
+    void testTypedAccessors() {
+        SQLite db(":memory:", 1000, 1000, 1);
+        db.beginTransaction(SQLite::TRANSACTION_TYPE::SHARED);
+        SQColumnarResult result;
+        ASSERT_TRUE(db.read("SELECT 1 AS i, 2.5 AS r, 'text' AS t, x'00ff' AS b, NULL AS n UNION ALL SELECT -7, 0.1, '', x'', 3;", result));
+        db.rollback();
+
+        ASSERT_EQUAL(result.size(), 2);
+        ASSERT_EQUAL(result.columnCount(), 5);
+        ASSERT_EQUAL(SComposeList(result.headers), "i, r, t, b, n");
+
+        ASSERT_TRUE(result.getType(0, 0) == SQValue::TYPE::INTEGER);
+        ASSERT_EQUAL(result.getInt64(0, 0), 1);
+        ASSERT_EQUAL(result.getInt64(1, 0), -7);
+        ASSERT_TRUE(result.getType(0, 1) == SQValue::TYPE::REAL);
+        ASSERT_EQUAL(result.getDouble(0, 1), 2.5);
+        ASSERT_TRUE(result.getType(0, 2) == SQValue::TYPE::TEXT);
+        ASSERT_TRUE(result.getText(0, 2) == "text");
+        ASSERT_TRUE(result.getText(1, 2).empty());
+        ASSERT_TRUE(result.getType(0, 3) == SQValue::TYPE::BLOB);
+        ASSERT_TRUE(result.getText(0, 3) == string("\0\xff", 2));
+        ASSERT_TRUE(result.getType(0, 4) == SQValue::TYPE::NONE);
+
+        // Values of other types read as zero or empty, and as strings they're formatted like SQValue.
+        ASSERT_EQUAL(result.getInt64(0, 2), 0);
+        ASSERT_TRUE(result.getText(0, 0).empty());
+        ASSERT_EQUAL(result[0]["r"], "2.5");
+        ASSERT_EQUAL(result[1][1], "0.1");
+        ASSERT_EQUAL(result[0][4], "");
+        ASSERT_EQUAL(result[1][4], "3");
+
+        ASSERT_THROW(result.getType(2, 0), SException);
+        ASSERT_THROW(result.getType(0, 5), SException);
+        ASSERT_THROW(result[0]["missing"], SException);
+    }
+
+    void testMatchesSQResult() {
+        SQLite db(":memory:", 1000, 1000, 1);
+        db.beginTransaction(SQLite::TRANSACTION_TYPE::EXCLUSIVE);
+        db.write("CREATE TABLE test (id INTEGER, name TEXT, price REAL, data BLOB, note TEXT);");
+        db.write("INSERT INTO test VALUES (1, 'Bob', 19.99, NULL, 'ok'), (2, 'Smith, John', 1.23e+10, x'41', NULL), "
+                 "(3, 'Alice \"Ace\"', -0.5, NULL, 'line one\nline two'), (4, 'caf\xc3\xa9', NULL, NULL, '[1,2]'), "
+                 "(5, '', 0, NULL, 'has\ttab');");
+        db.prepare();
+        db.commit();
+
+        db.beginTransaction(SQLite::TRANSACTION_TYPE::SHARED);
+        SQResult result;
+        SQColumnarResult columnar;
+        ASSERT_TRUE(db.read("SELECT * FROM test ORDER BY id;", result));
+        ASSERT_TRUE(db.read("SELECT * FROM test ORDER BY id;", columnar));
+        db.rollback();
+
+        // Every format comes out exactly the same from either kind of result.
+        for (auto format : {SQResultFormatter::FORMAT::COLUMN, SQResultFormatter::FORMAT::CSV, SQResultFormatter::FORMAT::TABS,
+                            SQResultFormatter::FORMAT::JSON, SQResultFormatter::FORMAT::QUOTE, SQResultFormatter::FORMAT::LIST}) {
+            for (bool header : {true, false}) {
+                SQResultFormatter::FORMAT_OPTIONS options;
+                options.header = header;
+                ASSERT_EQUAL(SQResultFormatter::format(columnar, format, options), SQResultFormatter::format(result, format, options));
+            }
+        }
+
+        // And so does one converted back to an SQResult.
+        ASSERT_EQUAL(columnar.toSQResult().serializeToJSON(), result.serializeToJSON());
+    }
+
+    void testStream() {
+        SQLite db(":memory:", 1000, 1000, 1);
+        db.beginTransaction(SQLite::TRANSACTION_TYPE::EXCLUSIVE);
+        db.write("CREATE TABLE test (id INTEGER, name TEXT, price REAL);");
+        db.write("INSERT INTO test WITH RECURSIVE n(i) AS (SELECT 1 UNION ALL SELECT i + 1 FROM n WHERE i < 1000) "
+                 "SELECT i, 'name, ' || i, i / 8.0 FROM n;");
+        db.prepare();
+        db.commit();
+
+        const string query = "SELECT * FROM test ORDER BY id;";
+        db.beginTransaction(SQLite::TRANSACTION_TYPE::SHARED);
+        SQColumnarResult result;
+        ASSERT_TRUE(db.read(query, result));
+
+        // Formatting the rows a small batch at a time comes out the same as formatting them all at once.
+        for (auto format : {SQResultFormatter::FORMAT::CSV, SQResultFormatter::FORMAT::TABS, SQResultFormatter::FORMAT::JSON,
+                            SQResultFormatter::FORMAT::QUOTE, SQResultFormatter::FORMAT::LIST}) {
+            for (bool header : {true, false}) {
+                SQResultFormatter::FORMAT_OPTIONS options;
+                options.header = header;
+                SQResultFormatter::Stream stream(format, options);
+                string output;
+                size_t batches = 0;
+                size_t rows = 0;
+                ASSERT_TRUE(db.read(query, {}, 1024, [&](SQColumnarResult& batch) {
+                    if (!batches++) {
+                        stream.start(batch.headers, output);
+                    }
+                    EXPECT_TRUE(batch.byteSize() < 2048);
+                    rows += batch.size();
+                    stream.append(batch, output);
+                    return true;
+                }));
+                stream.finish(output);
+                ASSERT_GREATER_THAN(batches, 10);
+                ASSERT_EQUAL(rows, 1000);
+                ASSERT_EQUAL(output, SQResultFormatter::format(result, format, options));
+            }
+        }
+        ASSERT_FALSE(SQResultFormatter::Stream::canStream(SQResultFormatter::FORMAT::COLUMN));
+
+        // An empty result still gets one (empty) batch, with the headers.
+        size_t batches = 0;
+        ASSERT_TRUE(db.read("SELECT * FROM test WHERE id < 0;", {}, 1024, [&](SQColumnarResult& batch) {
+            batches++;
+            EXPECT_EQUAL(batch.size(), 0);
+            EXPECT_EQUAL(SComposeList(batch.headers), "id, name, price");
+            return true;
+        }));
+        ASSERT_EQUAL(batches, 1);
+
+        // Returning false stops the query.
+        batches = 0;
+        ASSERT_FALSE(db.read(query, {}, 1024, [&](SQColumnarResult& batch) {
+            batches++;
+            return false;
+        }));
+        ASSERT_EQUAL(batches, 1);
+        db.rollback();
+    }
+} __SQColumnarResultTest;
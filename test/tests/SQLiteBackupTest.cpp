@@ -0,0 +1,143 @@
+#include <unistd.h>
+
+#include <libstuff/libstuff.h>
+#include <libstuff/SQResult.h>
+#include <sqlitecluster/SQLite.h>
+#include <test/lib/SQLiteTestHelper.h>
+#include <test/lib/tpunit++.hpp>
+
+struct SQLiteBackupTest : tpunit::TestFixture {
+    SQLiteBackupTest() : tpunit::TestFixture("SQLiteBackup",
+                                             BEFORE(SQLiteBackupTest::setup),
+                                             AFTER(SQLiteBackupTest::teardown),
+                                             TEST(SQLiteBackupTest::testBackupIsSnapshot),
+                                             TEST(SQLiteBackupTest::testBackupWithCheckpointMode),
+                                             TEST(SQLiteBackupTest::testBackupStopped),
+                                             TEST(SQLiteBackupTest::testBackupCommits),
+                                             TEST(SQLiteBackupTest::testBackupCommitsTruncated)) { }
+
+    // Filenames for the temp DB and its backup.
+    string filename;
+    string backupFilename;
+
+    void setup() {
+        filename = SQLiteTestHelper::createTempDB("br_backup_db");
+        backupFilename = filename + ".backup";
+    }
+
+    void teardown() {
+        for (const string& name : {filename, backupFilename, backupFilename + ".commits"}) {
+            SQLiteTestHelper::removeDB(name);
+        }
+    }
+
+    string readAll(const string& path, const string& query) {
+        sqlite3* db = nullptr;
+        sqlite3_open(path.c_str(), &db);
+        SQResult result;
+        SQuery(db, "reading backup", query, result);
+        sqlite3_close(db);
+        return result.serializeToJSON();
+    }
+
+    void testBackupIsSnapshot() {
+        SQLite db(filename, 1000, 1000, 1);
+        SQLiteTestHelper::commit(db, "CREATE TABLE test (id INTEGER PRIMARY KEY, value TEXT);");
+        for (int i = 0; i < 200; i++) {
+            SQLiteTestHelper::commit(db, "INSERT INTO test VALUES (" + SQ(i) + ", " + SQ(string(1000, 'a')) + ");");
+        }
+        uint64_t commitCount = db.getCommitCount();
+
+        // Commits made by another handle while the copy is going don't make it into the copy, or start it over.
+        SQLite writer(db);
+        int steps = 0;
+        ASSERT_EQUAL(db.backup(backupFilename, 10, [&](int remaining, int pageCount) {
+            SQLiteTestHelper::commit(writer, "INSERT INTO test VALUES (" + SQ(1000 + steps) + ", 'new');");
+            steps++;
+            return true;
+        }), commitCount);
+        ASSERT_GREATER_THAN(steps, 1);
+        ASSERT_EQUAL(readAll(backupFilename, "SELECT COUNT(*) FROM test;"), readAll(filename, "SELECT COUNT(*) FROM test WHERE id < 1000;"));
+    }
+
+    void testBackupWithCheckpointMode() {
+        SQLite db(filename, 1000, 1000, 1, 0, false, "TRUNCATE");
+        SQLiteTestHelper::commit(db, "CREATE TABLE test (id INTEGER PRIMARY KEY, value TEXT);");
+        for (int i = 0; i < 100; i++) {
+            SQLiteTestHelper::commit(db, "INSERT INTO test VALUES (" + SQ(i) + ", " + SQ(string(1000, 'a')) + ");");
+        }
+
+        // A TRUNCATE checkpoint after each commit would wait on the backup's snapshot, so commits made while the copy
+        // is going have to checkpoint passively instead.
+        SQLite writer(db);
+        uint64_t slowestCommit = 0;
+        ASSERT_TRUE(db.backup(backupFilename, 10, [&](int remaining, int pageCount) {
+            uint64_t start = STimeNow();
+            SQLiteTestHelper::commit(writer, "INSERT INTO test VALUES (NULL, 'new');");
+            slowestCommit = max(slowestCommit, STimeNow() - start);
+            return slowestCommit < 5'000'000;
+        }));
+        ASSERT_LESS_THAN(slowestCommit, 5'000'000);
+    }
+
+    void testBackupStopped() {
+        SQLite db(filename, 1000, 1000, 1);
+        SQLiteTestHelper::commit(db, "CREATE TABLE test (id INTEGER PRIMARY KEY, value TEXT);");
+        for (int i = 0; i < 100; i++) {
+            SQLiteTestHelper::commit(db, "INSERT INTO test VALUES (" + SQ(i) + ", " + SQ(string(1000, 'a')) + ");");
+        }
+        ASSERT_EQUAL(db.backup(backupFilename, 10, [](int remaining, int pageCount) { return false; }), 0);
+
+        // And the handle can be used normally afterwards.
+        SQLiteTestHelper::commit(db, "INSERT INTO test VALUES (1000, 'after');");
+    }
+
+    void testBackupCommits() {
+        SQLite db(filename, 1000, 1000, 1);
+        SQLiteTestHelper::commit(db, "CREATE TABLE test (id INTEGER PRIMARY KEY, value TEXT);");
+        SQLiteTestHelper::commit(db, "INSERT INTO test VALUES (1, 'one');");
+        uint64_t fromCommit = db.backup(backupFilename, 100, [](int remaining, int pageCount) { return true; });
+        ASSERT_EQUAL(fromCommit, db.getCommitCount());
+        for (int i = 2; i < 50; i++) {
+            SQLiteTestHelper::commit(db, "INSERT INTO test VALUES (" + SQ(i) + ", " + SQ(i * 10) + ");");
+        }
+        SQLiteTestHelper::commit(db, "UPDATE test SET value = 'updated' WHERE id < 10;");
+
+        // Copy the commits in small batches, so it takes several.
+        int batches = 0;
+        ASSERT_EQUAL(db.backupCommits(backupFilename + ".commits", fromCommit, 100, [&]() {
+            batches++;
+            return true;
+        }), db.getCommitCount());
+        ASSERT_GREATER_THAN(batches, 1);
+
+        // Replaying them on the backup brings it up to date.
+        sqlite3* backup = nullptr;
+        sqlite3_open(backupFilename.c_str(), &backup);
+        SQuery(backup, "attaching", "ATTACH " + SQ(backupFilename + ".commits") + " AS commits;");
+        SQResult commits;
+        SQuery(backup, "reading commits", "SELECT query FROM commits.journal ORDER BY id;", commits);
+        ASSERT_EQUAL((int)commits.size(), (int)(db.getCommitCount() - fromCommit));
+        for (size_t i = 0; i < commits.size(); i++) {
+            ASSERT_FALSE(SQuery(backup, "replaying", commits[i][0]));
+        }
+        sqlite3_close(backup);
+        ASSERT_EQUAL(readAll(backupFilename, "SELECT * FROM test ORDER BY id;"), readAll(filename, "SELECT * FROM test ORDER BY id;"));
+
+        // With nothing new, there's nothing to copy, and a stopped copy fails.
+        unlink((backupFilename + ".commits").c_str());
+        ASSERT_EQUAL(db.backupCommits(backupFilename + ".commits", db.getCommitCount(), 100, []() { return true; }), db.getCommitCount());
+        unlink((backupFilename + ".commits").c_str());
+        ASSERT_EQUAL(db.backupCommits(backupFilename + ".commits", fromCommit, 100, []() { return false; }), 0);
+    }
+
+    void testBackupCommitsTruncated() {
+        // With a journal this small, the first commits are soon deleted from it.
+        SQLite db(filename, 1000, 10, 1);
+        SQLiteTestHelper::commit(db, "CREATE TABLE test (id INTEGER PRIMARY KEY, value TEXT);");
+        for (int i = 0; i < 100; i++) {
+            SQLiteTestHelper::commit(db, "INSERT INTO test VALUES (" + SQ(i) + ", 'a');");
+        }
+        ASSERT_EQUAL(db.backupCommits(backupFilename + ".commits", 1, 1000, []() { return true; }), 0);
+    }
+} __SQLiteBackupTest;
@@ -0,0 +1,108 @@
+#include <libstuff/libstuff.h>
+#include <libstuff/SQResult.h>
+#include <sqlitecluster/SQLite.h>
+#include <test/lib/SQLiteTestHelper.h>
+#include <test/lib/tpunit++.hpp>
+
+struct SQLiteCommitCacheTest : tpunit::TestFixture {
+    SQLiteCommitCacheTest() : tpunit::TestFixture("SQLiteCommitCache",
+                                                  BEFORE(SQLiteCommitCacheTest::setup),
+                                                  AFTER(SQLiteCommitCacheTest::teardown),
+                                                  TEST(SQLiteCommitCacheTest::testCachedCommits),
+                                                  TEST(SQLiteCommitCacheTest::testCacheBytes),
+                                                  TEST(SQLiteCommitCacheTest::testCacheDisabled)) { }
+
+    // Filename for temp DB.
+    string filename;
+
+    void setup() {
+        filename = SQLiteTestHelper::createTempDB("br_cache_db");
+    }
+
+    void teardown() {
+        SQLiteTestHelper::removeDB(filename);
+    }
+
+    void testCachedCommits() {
+        SQLite db(filename, 1000, 1000, 1);
+        db.setCommitCacheSize(10);
+        SQLiteTestHelper::commit(db, "CREATE TABLE test (id INTEGER PRIMARY KEY);");
+        for (int i = 0; i < 30; i++) {
+            SQLiteTestHelper::commit(db, "INSERT INTO test VALUES (" + SQ(i) + ");");
+        }
+        ASSERT_EQUAL(db.getCommitCacheStats()["commitCacheCount"], "10");
+
+        // The journal has every commit, so read what each range should be from it directly.
+        auto readJournal = [&](uint64_t from, uint64_t to) {
+            SQResult result;
+            string query = "SELECT hash, query FROM (SELECT id, hash, query FROM journal UNION SELECT id, hash, query FROM journal0000 "
+                           "UNION SELECT id, hash, query FROM journal0001) WHERE id >= " + SQ(from) + " AND id <= " + SQ(to) + " ORDER BY id;";
+            db.read(query, result);
+            return result;
+        };
+
+        // A range of recent commits is served from the cache.
+        SQResult result;
+        ASSERT_FALSE(db.getCommits(25, 31, result));
+        ASSERT_EQUAL(result.serializeToJSON(), readJournal(25, 31).serializeToJSON());
+        ASSERT_FALSE(db.getCommits(22, 0, result));
+        ASSERT_EQUAL(result.serializeToJSON(), readJournal(22, 31).serializeToJSON());
+        string query, hash;
+        ASSERT_TRUE(db.getCommit(31, query, hash));
+        ASSERT_EQUAL(hash, db.getCommittedHash());
+        ASSERT_EQUAL(db.getCommitCacheStats()["commitCacheHits"], "3");
+        ASSERT_EQUAL(db.getCommitCacheStats()["commitCacheMisses"], "0");
+
+        // Anything older comes from the journal, and looks the same.
+        ASSERT_FALSE(db.getCommits(15, 25, result));
+        ASSERT_EQUAL(result.serializeToJSON(), readJournal(15, 25).serializeToJSON());
+        ASSERT_TRUE(db.getCommit(5, query, hash));
+        ASSERT_EQUAL(query, "INSERT INTO test VALUES (3);");
+        ASSERT_EQUAL(db.getCommitCacheStats()["commitCacheMisses"], "2");
+
+        // Shrinking the cache drops the oldest commits.
+        db.setCommitCacheSize(2);
+        ASSERT_EQUAL(db.getCommitCacheStats()["commitCacheCount"], "2");
+        ASSERT_FALSE(db.getCommits(29, 31, result));
+        ASSERT_EQUAL(db.getCommitCacheStats()["commitCacheMisses"], "3");
+        ASSERT_FALSE(db.getCommits(30, 31, result));
+        ASSERT_EQUAL(db.getCommitCacheStats()["commitCacheHits"], "4");
+    }
+
+    void testCacheBytes() {
+        SQLite db(filename, 1000, 1000, 1);
+        db.setCommitCacheSize(10);
+        db.setCommitCacheBytes(3'500);
+        SQLiteTestHelper::commit(db, "CREATE TABLE test (value TEXT);");
+
+        // Each of these is about 1KB, so only the last three fit, however many commits the cache could hold.
+        const string value(1'000, 'x');
+        for (int i = 0; i < 5; i++) {
+            SQLiteTestHelper::commit(db, "INSERT INTO test VALUES (" + SQ(value) + ");");
+        }
+        ASSERT_EQUAL(db.getCommitCacheStats()["commitCacheCount"], "3");
+        ASSERT_LESS_THAN(SToUInt64(db.getCommitCacheStats()["commitCacheBytes"]), 3'500);
+        SQResult result;
+        ASSERT_FALSE(db.getCommits(4, 6, result));
+        ASSERT_EQUAL(result.size(), 3);
+        ASSERT_EQUAL(db.getCommitCacheStats()["commitCacheHits"], "1");
+
+        // A commit bigger than the limit isn't kept at all.
+        db.setCommitCacheBytes(500);
+        ASSERT_EQUAL(db.getCommitCacheStats()["commitCacheCount"], "0");
+        ASSERT_EQUAL(db.getCommitCacheStats()["commitCacheBytes"], "0");
+        SQLiteTestHelper::commit(db, "INSERT INTO test VALUES (" + SQ(value) + ");");
+        ASSERT_EQUAL(db.getCommitCacheStats()["commitCacheCount"], "0");
+    }
+
+    void testCacheDisabled() {
+        SQLite db(filename, 1000, 1000, 1);
+        db.setCommitCacheSize(0);
+        SQLiteTestHelper::commit(db, "CREATE TABLE test (id INTEGER PRIMARY KEY);");
+        ASSERT_EQUAL(db.getCommitCacheStats()["commitCacheCount"], "0");
+        string query, hash;
+        ASSERT_TRUE(db.getCommit(1, query, hash));
+        ASSERT_EQUAL(query, "CREATE TABLE test (id INTEGER PRIMARY KEY);");
+        ASSERT_EQUAL(db.getCommitCacheStats()["commitCacheMisses"], "1");
+    }
+} __SQLiteCommitCacheTest;
@@ -0,0 +1,189 @@
+#include <libstuff/libstuff.h>
+#include <libstuff/SQResult.h>
+#include <sqlitecluster/SQLite.h>
+#include <test/lib/SQLiteTestHelper.h>
+#include <test/lib/tpunit++.hpp>
+
+struct SQLiteJournalTest : tpunit::TestFixture {
+    SQLiteJournalTest() : tpunit::TestFixture("SQLiteJournal",
+                                              BEFORE(SQLiteJournalTest::setup),
+                                              AFTER(SQLiteJournalTest::teardown),
+                                              TEST(SQLiteJournalTest::testRingJournal),
+                                              TEST(SQLiteJournalTest::testRingJournalGetCommits),
+                                              TEST(SQLiteJournalTest::testRingJournalBatched),
+                                              TEST(SQLiteJournalTest::testBatchedJournalTrimmed),
+                                              TEST(SQLiteJournalTest::testExistingJournalKept)) { }
+
+    // Filename for temp DB.
+    string filename;
+
+    void setup() {
+        filename = SQLiteTestHelper::createTempDB("br_journal_db");
+    }
+
+    void teardown() {
+        SQLiteTestHelper::removeDB(filename);
+    }
+
+    void testRingJournal() {
+        // Three tables (`-1` through `1`) of four commits each. The commit cache is turned off, so that commits are
+        // read from the journal.
+        uint64_t commitCount = 0;
+        {
+            SQLite db(filename, 1000, 10, 1, 0, false, "PASSIVE", true);
+            db.setCommitCacheSize(0);
+            SQLiteTestHelper::commit(db, "CREATE TABLE test (id INTEGER PRIMARY KEY);");
+            for (int i = 0; i < 99; i++) {
+                SQLiteTestHelper::commit(db, "INSERT INTO test VALUES (" + SQ(i) + ");");
+            }
+            commitCount = db.getCommitCount();
+            ASSERT_EQUAL((int)commitCount, 100);
+
+            // It never holds more commits than it has rows.
+            SQResult result;
+            ASSERT_TRUE(db.read("SELECT COUNT(*) FROM journalRing0000;", result));
+            ASSERT_EQUAL(result[0][0], "4");
+            ASSERT_FALSE(SQVerifyTableExists(db.getDBHandle(), "journal"));
+
+            // The last twelve commits are all there, and nothing before them.
+            string query, hash;
+            for (uint64_t id = commitCount - 11; id <= commitCount; id++) {
+                ASSERT_TRUE(db.getCommit(id, query, hash));
+            }
+            ASSERT_EQUAL(query, "INSERT INTO test VALUES (98);");
+            ASSERT_EQUAL(hash, db.getCommittedHash());
+            ASSERT_FALSE(db.getCommit(commitCount - 12, query, hash));
+        }
+
+        // Reopening it with different journal settings keeps the ring it was created with, and finds where it was.
+        SQLite db(filename, 1000, 1000, 5, 0, false, "PASSIVE", false);
+        ASSERT_EQUAL(db.getCommitCount(), commitCount);
+        SQLiteTestHelper::commit(db, "INSERT INTO test VALUES (1000);");
+        SQResult result;
+        ASSERT_TRUE(db.read("SELECT COUNT(*) FROM (SELECT id FROM journalRing0000 UNION ALL SELECT id FROM journalRing0001 UNION ALL SELECT id FROM journalRing0002);", result));
+        ASSERT_EQUAL(result[0][0], "12");
+        string query, hash;
+        ASSERT_TRUE(db.getCommit(commitCount + 1, query, hash));
+        ASSERT_EQUAL(query, "INSERT INTO test VALUES (1000);");
+
+        // A copy opened afresh finds the newest commit too, wherever it is in the ring. Each copy needs a new name, as
+        // handles to a file we've opened before share what they know about it.
+        for (int i = 0; i < 13; i++) {
+            const string copyFilename = filename + ".copy" + to_string(i);
+            SQLiteTestHelper::commit(db, "INSERT INTO test VALUES (" + SQ(1001 + i) + ");");
+            ASSERT_EQUAL(db.backup(copyFilename, 100, [](int remaining, int pageCount) { return true; }), db.getCommitCount());
+            {
+                SQLite copy(copyFilename, 1000, 1000, 5, 0, false, "PASSIVE", false);
+                ASSERT_EQUAL(copy.getCommitCount(), db.getCommitCount());
+            }
+            SQLiteTestHelper::removeDB(copyFilename);
+        }
+    }
+
+    void testRingJournalGetCommits() {
+        // Four tables of eight commits each.
+        SQLite db(filename, 1000, 32, 2, 0, false, "PASSIVE", true);
+        db.setCommitCacheSize(0);
+        SQLiteTestHelper::commit(db, "CREATE TABLE test (id INTEGER PRIMARY KEY);");
+        for (int i = 0; i < 100; i++) {
+            SQLiteTestHelper::commit(db, "INSERT INTO test VALUES (" + SQ(i) + ");");
+        }
+
+        // Every range of what's still in the journal, including ranges that wrap around the end of a table.
+        const uint64_t commitCount = db.getCommitCount();
+        const uint64_t oldest = commitCount - 31;
+        for (uint64_t from = oldest; from <= commitCount; from++) {
+            for (uint64_t to = from; to <= commitCount; to++) {
+                SQResult result;
+                ASSERT_FALSE(db.getCommits(from, to, result));
+                ASSERT_EQUAL((int)result.size(), (int)(to - from + 1));
+                for (size_t i = 0; i < result.size(); i++) {
+                    string query, hash;
+                    db.getCommit(from + i, query, hash);
+                    ASSERT_EQUAL(result[i][0], hash);
+                    ASSERT_EQUAL(result[i][1], query);
+                }
+            }
+        }
+
+        // With no end, everything from the start.
+        SQResult result;
+        ASSERT_FALSE(db.getCommits(oldest, 0, result));
+        ASSERT_EQUAL((int)result.size(), 32);
+
+        // Commits that have been replaced aren't returned.
+        ASSERT_FALSE(db.getCommits(1, commitCount, result));
+        ASSERT_EQUAL((int)result.size(), 32);
+    }
+
+    void testRingJournalBatched() {
+        SQLite db(filename, 1000, 32, 2, 0, false, "PASSIVE", true);
+        SQLiteTestHelper::commit(db, "CREATE TABLE test (id INTEGER PRIMARY KEY);");
+
+        // Work out the hashes of three commits, and then commit them as one batch.
+        string hash = db.getCommittedHash();
+        vector<string> queries = {"INSERT INTO test VALUES (1);", "INSERT INTO test VALUES (2);", "INSERT INTO test VALUES (3);"};
+        ASSERT_TRUE(db.beginTransaction(SQLite::TRANSACTION_TYPE::EXCLUSIVE));
+        for (const string& query : queries) {
+            hash = SToHex(SHashSHA1(hash + query));
+            ASSERT_TRUE(db.write(query));
+            ASSERT_TRUE(db.prepareBatched(hash));
+        }
+        ASSERT_EQUAL(db.commit(), SQLITE_OK);
+        ASSERT_EQUAL((int)db.getCommitCount(), 4);
+
+        // Each is in its own table.
+        for (size_t i = 0; i < queries.size(); i++) {
+            string query, ignore;
+            ASSERT_TRUE(db.getCommit(i + 2, query, ignore));
+            ASSERT_EQUAL(query, queries[i]);
+        }
+        SQResult result;
+        ASSERT_TRUE(db.read("SELECT query FROM journalRing0000;", result));
+        ASSERT_EQUAL((int)result.size(), 1);
+        ASSERT_EQUAL(result[0][0], queries[2]);
+    }
+
+    void testBatchedJournalTrimmed() {
+        // Batches of commits, as a follower catching up would make, are kept to the same journal size as single ones.
+        SQLite db(filename, 1000, 10, 1);
+        SQLiteTestHelper::commit(db, "CREATE TABLE test (id INTEGER PRIMARY KEY);");
+        string hash = db.getCommittedHash();
+        for (int batch = 0; batch < 20; batch++) {
+            ASSERT_TRUE(db.beginTransaction(SQLite::TRANSACTION_TYPE::EXCLUSIVE));
+            for (int i = 0; i < 20; i++) {
+                const string query = "INSERT INTO test VALUES (" + SQ(batch * 20 + i) + ");";
+                hash = SToHex(SHashSHA1(hash + query));
+                ASSERT_TRUE(db.write(query));
+                ASSERT_TRUE(db.prepareBatched(hash));
+            }
+            ASSERT_EQUAL(db.commit(), SQLITE_OK);
+        }
+        ASSERT_EQUAL((int)db.getCommitCount(), 401);
+
+        SQResult tables;
+        ASSERT_TRUE(db.read("SELECT name FROM sqlite_master WHERE type = 'table' AND name LIKE 'journal%';", tables));
+        int rows = 0;
+        for (const auto& table : tables) {
+            rows += SToInt(db.read("SELECT COUNT(*) FROM " + table[0] + ";"));
+        }
+        ASSERT_LESS_THAN(rows, 40);
+    }
+
+    void testExistingJournalKept() {
+        {
+            SQLite db(filename, 1000, 1000, 1);
+            SQLiteTestHelper::commit(db, "CREATE TABLE test (id INTEGER PRIMARY KEY);");
+        }
+
+        // Asking for a ring journal for a database that already has a journal changes nothing.
+        SQLite db(filename, 1000, 1000, 1, 0, false, "PASSIVE", true);
+        SQLiteTestHelper::commit(db, "INSERT INTO test VALUES (1);");
+        SQResult result;
+        ASSERT_TRUE(db.read("SELECT COUNT(*) FROM sqlite_master WHERE name LIKE 'journalRing%' OR name = 'ringJournalConfig';", result));
+        ASSERT_EQUAL(result[0][0], "0");
+        string query, hash;
+        ASSERT_TRUE(db.getCommit(2, query, hash));
+        ASSERT_EQUAL(query, "INSERT INTO test VALUES (1);");
+    }
+} __SQLiteJournalTest;
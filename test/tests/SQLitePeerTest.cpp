@@ -0,0 +1,114 @@
+#include <libstuff/libstuff.h>
+#include <libstuff/SData.h>
+#include <sqlitecluster/SQLitePeer.h>
+#include <test/lib/tpunit++.hpp>
+
+struct SQLitePeerTest : tpunit::TestFixture {
+    SQLitePeerTest() : tpunit::TestFixture("SQLitePeer",
+                                           TEST(SQLitePeerTest::testBinaryRoundTrip),
+                                           TEST(SQLitePeerTest::testBinaryUnknownMethod),
+                                           TEST(SQLitePeerTest::testBinaryPartialFrames),
+                                           TEST(SQLitePeerTest::testBinaryMalformed),
+                                           TEST(SQLitePeerTest::testCompressMessage)) { }
+
+    void testBinaryRoundTrip() {
+        SData message("BEGIN_TRANSACTION");
+        message["CommitCount"] = "123456789";
+        message["Hash"] = SToHex(SHashSHA1("some query;"));
+        message["NewCount"] = "123456790";
+        message["ID"] = "ASYNC_123456790";
+        message.content = "INSERT INTO test VALUES(1, 'one');";
+
+        string frame = SQLitePeer::serializeBinary(message);
+        ASSERT_EQUAL((unsigned char)frame[0], SQLitePeer::BINARY_FRAME_MARKER);
+
+        // The known method line, commit count, and hash all fit in fixed-size fields, so this beats the text version.
+        ASSERT_LESS_THAN(frame.size(), message.serialize().size());
+
+        SData result;
+        ASSERT_EQUAL(SQLitePeer::deserializeBinary(frame.c_str(), frame.size(), result), frame.size());
+        ASSERT_EQUAL(result.methodLine, message.methodLine);
+        ASSERT_EQUAL(SComposeJSONObject(result.nameValueMap), SComposeJSONObject(message.nameValueMap));
+        ASSERT_EQUAL(result.content, message.content);
+    }
+
+    void testBinaryUnknownMethod() {
+        // Method lines we don't have a type for, and hashes that aren't SHA1 hex, are sent as-is.
+        SData message("SOME_NEW_MESSAGE");
+        message["Hash"] = "";
+        message["CommitCount"] = "0";
+        message["Binary"] = string("a\0b\r\n", 5);
+
+        string frame = SQLitePeer::serializeBinary(message);
+        SData result;
+        ASSERT_EQUAL(SQLitePeer::deserializeBinary(frame.c_str(), frame.size(), result), frame.size());
+        ASSERT_EQUAL(result.methodLine, "SOME_NEW_MESSAGE");
+        ASSERT_EQUAL(SComposeJSONObject(result.nameValueMap), SComposeJSONObject(message.nameValueMap));
+        ASSERT_TRUE(result.content.empty());
+    }
+
+    void testBinaryPartialFrames() {
+        SData first("PING");
+        first["Timestamp"] = to_string(STimeNow());
+        SData second("COMMIT_TRANSACTION");
+        second["NewCount"] = "10";
+        string stream = SQLitePeer::serializeBinary(first) + SQLitePeer::serializeBinary(second);
+        size_t firstSize = SQLitePeer::serializeBinary(first).size();
+
+        // Nothing is consumed until the whole frame is there.
+        SData result;
+        for (size_t length = 0; length < firstSize; length++) {
+            ASSERT_EQUAL(SQLitePeer::deserializeBinary(stream.c_str(), length, result), 0);
+        }
+
+        // And back-to-back frames come apart cleanly.
+        ASSERT_EQUAL(SQLitePeer::deserializeBinary(stream.c_str(), stream.size(), result), firstSize);
+        ASSERT_EQUAL(result.methodLine, "PING");
+        ASSERT_EQUAL(SQLitePeer::deserializeBinary(stream.c_str() + firstSize, stream.size() - firstSize, result), stream.size() - firstSize);
+        ASSERT_EQUAL(result.methodLine, "COMMIT_TRANSACTION");
+        ASSERT_EQUAL(result["NewCount"], "10");
+    }
+
+    void testBinaryMalformed() {
+        SData message("STATE");
+        message["State"] = "LEADING";
+        string frame = SQLitePeer::serializeBinary(message);
+
+        // Claim a header count bigger than what's actually in the frame. It's the first thing after the marker, length,
+        // type, flags, commit count, and hash.
+        frame[1 + 8 + 1 + 1 + 8 + 20] = (char)0x7F;
+        SData result;
+        bool threw = false;
+        try {
+            SQLitePeer::deserializeBinary(frame.c_str(), frame.size(), result);
+        } catch (const SException& e) {
+            threw = true;
+        }
+        ASSERT_TRUE(threw);
+    }
+
+    void testCompressMessage() {
+        // Small messages are left alone.
+        SData small("BEGIN_TRANSACTION");
+        small.content = "INSERT INTO test VALUES(1, 'one');";
+        SData result = SQLitePeer::compressMessage(small);
+        ASSERT_FALSE(result.isSet("Content-Encoding"));
+        ASSERT_EQUAL(result.content, small.content);
+
+        // Large, repetitive ones are compressed, and come back the same.
+        SData large("BEGIN_TRANSACTION");
+        for (int i = 0; i < 100; i++) {
+            large.content += "INSERT INTO test VALUES(" + SQ(i) + ", " + SQ("value" + to_string(i)) + ");";
+        }
+        uint64_t bytesIn = SQLitePeer::compressionBytesIn;
+        result = SQLitePeer::compressMessage(large);
+        ASSERT_EQUAL(result["Content-Encoding"], "gzip");
+        ASSERT_LESS_THAN(result.content.size(), large.content.size());
+        ASSERT_EQUAL(SGUnzip(result.content), large.content);
+        ASSERT_EQUAL(SQLitePeer::compressionBytesIn - bytesIn, large.content.size());
+
+        // And already compressed messages aren't compressed again.
+        ASSERT_EQUAL(SQLitePeer::compressMessage(result).content, result.content);
+    }
+
+} __SQLitePeerTest;
@@ -0,0 +1,92 @@
+#include <libstuff/libstuff.h>
+#include <sqlitecluster/SQLitePool.h>
+#include <test/lib/SQLiteTestHelper.h>
+#include <test/lib/tpunit++.hpp>
+
+struct SQLitePoolTest : tpunit::TestFixture {
+    SQLitePoolTest() : tpunit::TestFixture("SQLitePool",
+                                           BEFORE(SQLitePoolTest::setup),
+                                           AFTER(SQLitePoolTest::teardown),
+                                           TEST(SQLitePoolTest::testWarmHandles),
+                                           TEST(SQLitePoolTest::testIdleHandlesClosed),
+                                           TEST(SQLitePoolTest::testCacheBudget)) { }
+
+    // Filename for temp DB.
+    string filename;
+
+    void setup() {
+        filename = SQLiteTestHelper::createTempDB("br_pool_db");
+    }
+
+    void teardown() {
+        SQLiteTestHelper::removeDB(filename);
+    }
+
+    void testWarmHandles() {
+        SQLitePool pool(10, filename, 10000, 5000, 0, 0, false, "PASSIVE", 4);
+        STable stats = pool.getStats();
+
+        // Four warm handles plus the base one, none of which are in use yet.
+        ASSERT_EQUAL(stats["dbPoolOpenHandles"], "5");
+        ASSERT_EQUAL(stats["dbPoolInUseHandles"], "0");
+
+        // Taking a handle reuses a warm one rather than opening another.
+        {
+            SQLiteScopedHandle handle(pool, pool.getIndex());
+            handle.db().read("SELECT 1;");
+            stats = pool.getStats();
+            ASSERT_EQUAL(stats["dbPoolOpenHandles"], "5");
+            ASSERT_EQUAL(stats["dbPoolInUseHandles"], "1");
+        }
+        ASSERT_EQUAL(pool.getStats()["dbPoolInUseHandles"], "0");
+    }
+
+    void testIdleHandlesClosed() {
+        SQLitePool pool(10, filename, 10000, 5000, 0, 0, false, "PASSIVE", 1, 1);
+
+        // Open a few more handles than are warm, all at once.
+        list<SQLiteScopedHandle> handles;
+        for (int i = 0; i < 4; i++) {
+            handles.emplace_back(pool, pool.getIndex());
+        }
+        ASSERT_EQUAL(pool.getStats()["dbPoolOpenHandles"], "5");
+        handles.clear();
+
+        // Once they've been idle long enough, the next return to the pool closes all but the warm one.
+        usleep(1'100'000);
+        {
+            SQLiteScopedHandle handle(pool, pool.getIndex());
+        }
+        ASSERT_EQUAL(pool.getStats()["dbPoolOpenHandles"], "2");
+
+        // A slot that never had a handle opened in it goes idle without closing anything.
+        {
+            SQLiteScopedHandle warm(pool, pool.getIndex());
+            pool.returnToPool(pool.getIndex(false));
+            usleep(1'100'000);
+        }
+        ASSERT_EQUAL(pool.getStats()["dbPoolOpenHandles"], "2");
+
+        // And closed handles can be used again.
+        for (int i = 0; i < 4; i++) {
+            handles.emplace_back(pool, pool.getIndex());
+            handles.back().db().read("SELECT 1;");
+        }
+        ASSERT_EQUAL(pool.getStats()["dbPoolOpenHandles"], "5");
+    }
+
+    void testCacheBudget() {
+        // With no budget, everything gets the full cache size.
+        {
+            SQLitePool pool(10, filename, 10000, 5000, 0, 0, false, "PASSIVE", 3);
+            ASSERT_EQUAL(pool.getStats()["dbPoolHandleCacheSizeKB"], "10000");
+            ASSERT_EQUAL(pool.getBase().getCacheSize(), 10000);
+        }
+
+        // With a budget, it's split across the handles, but never more than the cache size.
+        SQLitePool pool(10, filename, 10000, 5000, 0, 0, false, "PASSIVE", 3, 0, 20000);
+        ASSERT_EQUAL(pool.getStats()["dbPoolHandleCacheSizeKB"], "5000");
+        SQLiteScopedHandle handle(pool, pool.getIndex());
+        ASSERT_EQUAL(handle.db().getCacheSize(), 5000);
+    }
+} __SQLitePoolTest;
@@ -0,0 +1,137 @@
+#include <libstuff/libstuff.h>
+#include <libstuff/SQResult.h>
+#include <sqlitecluster/SQLite.h>
+#include <test/lib/SQLiteTestHelper.h>
+#include <test/lib/tpunit++.hpp>
+
+struct SQLiteReadCacheTest : tpunit::TestFixture {
+    SQLiteReadCacheTest() : tpunit::TestFixture("SQLiteReadCache",
+                                                BEFORE(SQLiteReadCacheTest::setup),
+                                                AFTER(SQLiteReadCacheTest::teardown),
+                                                TEST(SQLiteReadCacheTest::testSharedBetweenTransactions),
+                                                TEST(SQLiteReadCacheTest::testInvalidatedByCommits),
+                                                TEST(SQLiteReadCacheTest::testOnlyUsedByQueryOnlyTransactions)) { }
+
+    // Filename for temp DB.
+    string filename;
+
+    void setup() {
+        filename = SQLiteTestHelper::createTempDB("br_read_db");
+    }
+
+    void teardown() {
+        SQLiteTestHelper::removeDB(filename);
+    }
+
+    // Reads `query` in a query-only transaction of its own, as a peek would.
+    string peek(SQLite& db, const string& query) {
+        db.beginTransaction();
+        db.setQueryOnly(true);
+        string result = db.read(query);
+        db.setQueryOnly(false);
+        db.rollback();
+        return result;
+    }
+
+    void createTables(SQLite& db) {
+        SQLiteTestHelper::commit(db, "CREATE TABLE test (id INTEGER PRIMARY KEY, value TEXT);");
+        SQLiteTestHelper::commit(db, "CREATE TABLE other (id INTEGER PRIMARY KEY, value TEXT);");
+        SQLiteTestHelper::commit(db, "INSERT INTO test VALUES (1, 'one');");
+    }
+
+    void testSharedBetweenTransactions() {
+        SQLite db(filename, 1000, 1000, 1);
+        db.setReadCacheSize(10);
+        createTables(db);
+
+        // The first read misses, and every read after it, from any handle, hits.
+        SQLite db2(db);
+        ASSERT_EQUAL(peek(db, "SELECT value FROM test WHERE id = 1;"), "one");
+        ASSERT_EQUAL(peek(db, "SELECT value FROM test WHERE id = 1;"), "one");
+        ASSERT_EQUAL(peek(db2, "SELECT value FROM test WHERE id = 1;"), "one");
+        ASSERT_EQUAL(db.getReadCacheStats()["readCacheCount"], "1");
+        ASSERT_EQUAL(db.getReadCacheStats()["readCacheHits"], "2");
+        ASSERT_EQUAL(db.getReadCacheStats()["readCacheMisses"], "1");
+
+        // Reads from the cache still count as using their tables.
+        db.beginTransaction();
+        db.setQueryOnly(true);
+        db.read("SELECT value FROM test WHERE id = 1;");
+        ASSERT_TRUE(db.usedReadCache());
+        ASSERT_EQUAL(db.getTablesUsed(), set<string>{"test"});
+        db.setQueryOnly(false);
+        db.rollback();
+
+        // Non-deterministic queries, queries with bindings, and pragmas aren't shared.
+        peek(db, "SELECT value || random() FROM test;");
+        db.beginTransaction();
+        db.setQueryOnly(true);
+        db.read("SELECT value FROM test WHERE id = ?;", {1});
+        db.setQueryOnly(false);
+        db.rollback();
+        peek(db, "PRAGMA user_version;");
+        ASSERT_EQUAL(db.getReadCacheStats()["readCacheCount"], "1");
+
+        // Nor is anything with the cache turned off.
+        db.setReadCacheSize(0);
+        ASSERT_EQUAL(db.getReadCacheStats()["readCacheCount"], "0");
+        peek(db, "SELECT value FROM test WHERE id = 1;");
+        ASSERT_EQUAL(db.getReadCacheStats()["readCacheCount"], "0");
+    }
+
+    void testInvalidatedByCommits() {
+        SQLite db(filename, 1000, 1000, 1);
+        db.setReadCacheSize(10);
+        createTables(db);
+        ASSERT_EQUAL(peek(db, "SELECT value FROM test WHERE id = 1;"), "one");
+        ASSERT_EQUAL(peek(db, "SELECT COUNT(*) FROM test JOIN other USING (id);"), "0");
+
+        // Writing another table changes nothing.
+        SQLiteTestHelper::commit(db, "INSERT INTO other VALUES (2, 'two');");
+        ASSERT_EQUAL(peek(db, "SELECT value FROM test WHERE id = 1;"), "one");
+        ASSERT_EQUAL(db.getReadCacheStats()["readCacheHits"], "1");
+
+        // Writing the table, even from another handle, means the next read sees the change.
+        SQLite db2(db);
+        SQLiteTestHelper::commit(db2, "UPDATE test SET value = 'uno' WHERE id = 1;");
+        ASSERT_EQUAL(peek(db, "SELECT value FROM test WHERE id = 1;"), "uno");
+        ASSERT_EQUAL(db.getReadCacheStats()["readCacheHits"], "1");
+        ASSERT_EQUAL(peek(db, "SELECT value FROM test WHERE id = 1;"), "uno");
+        ASSERT_EQUAL(db.getReadCacheStats()["readCacheHits"], "2");
+
+        // Results using several tables are dropped when any of them is written.
+        SQLiteTestHelper::commit(db, "INSERT INTO other VALUES (1, 'one');");
+        ASSERT_EQUAL(peek(db, "SELECT COUNT(*) FROM test JOIN other USING (id);"), "1");
+
+        // And everything is dropped when the schema changes.
+        SQLiteTestHelper::commit(db, "ALTER TABLE test ADD COLUMN extra TEXT;");
+        ASSERT_EQUAL(peek(db, "SELECT value FROM test WHERE id = 1;"), "uno");
+        ASSERT_EQUAL(db.getReadCacheStats()["readCacheHits"], "2");
+    }
+
+    void testOnlyUsedByQueryOnlyTransactions() {
+        SQLite db(filename, 1000, 1000, 1);
+        db.setReadCacheSize(10);
+        createTables(db);
+        ASSERT_EQUAL(peek(db, "SELECT value FROM test WHERE id = 1;"), "one");
+
+        // A transaction that can write may commit, and sqlite can't check what it read from the cache for conflicts,
+        // so it reads everything itself.
+        SQLite db2(db);
+        ASSERT_TRUE(db.beginTransaction());
+        ASSERT_EQUAL(db.read("SELECT value FROM test WHERE id = 1;"), "one");
+        ASSERT_FALSE(db.usedReadCache());
+        ASSERT_EQUAL(db.getReadCacheStats()["readCacheHits"], "0");
+
+        // So a commit to another table in the meantime doesn't make it conflict, as sqlite checks what it really read.
+        SQLiteTestHelper::commit(db2, "INSERT INTO other VALUES (1, 'one');");
+        ASSERT_TRUE(db.write("UPDATE test SET value = 'uno' WHERE id = 1;"));
+        ASSERT_EQUAL(db.read("SELECT value FROM test WHERE id = 1;"), "uno");
+        ASSERT_TRUE(db.prepare());
+        ASSERT_EQUAL(db.commit(), SQLITE_OK);
+
+        // And what it changed isn't served from the cache afterwards.
+        ASSERT_EQUAL(peek(db2, "SELECT value FROM test WHERE id = 1;"), "uno");
+        ASSERT_EQUAL(db.getReadCacheStats()["readCacheHits"], "0");
+    }
+} __SQLiteReadCacheTest;